@@ -86,7 +86,7 @@ public:
     
      static void viewAllUsers() {
         cout << "\n[Admin Action] Viewing all registered users..." << endl;
-        ifstream inFile("data/users.txt");
+        TrackedIfstream inFile(IoStats::Users, "data/users.txt");
         if (!inFile) {
             cerr << "Error: Could not open users.txt." << endl;
             return;
@@ -16,6 +16,7 @@
 #include "UserManagementWidget.h"
 #include "OrderManagementWidget.h"
 #include "InventoryViewWidget.h"
+#include "DiagnosticsWidget.h"
 
 class AdminDashboardDialog : public QDialog
 {
@@ -45,6 +46,7 @@ private:
     UserManagementWidget *userManagementWidget;
     OrderManagementWidget *orderManagementWidget;
     InventoryViewWidget *inventoryViewWidget;
+    DiagnosticsWidget *diagnosticsWidget;
 };
 
 inline AdminDashboardDialog::AdminDashboardDialog(QWidget *parent)
@@ -101,6 +103,9 @@ inline AdminDashboardDialog::AdminDashboardDialog(QWidget *parent)
     inventoryViewWidget = new InventoryViewWidget(this);
     tabWidget->addTab(inventoryViewWidget, "Inventory View");
 
+    diagnosticsWidget = new DiagnosticsWidget(this);
+    tabWidget->addTab(diagnosticsWidget, "Diagnostics");
+
     mainLayout->addWidget(tabWidget);
     setLayout(mainLayout);
 }
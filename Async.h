@@ -0,0 +1,91 @@
+#pragma once
+
+#include <iostream>
+#include <memory>
+#include <coroutine>
+#include <exception>
+#include <utility>
+
+#include "TaskScheduler.h"
+
+using namespace std;
+
+// Coroutine support for code that waits on the task pool, mainly the widgets.
+//
+// A method returning AsyncAction may co_await a TaskFuture. The coroutine is suspended
+// while the task runs and resumed through the scheduler's dispatcher - on the GUI thread
+// once main() has installed it - so the code after a co_await may touch widgets again:
+//
+//     AsyncAction ReviewWidget::loadReviews() {
+//         vector<ReviewRecord> reviews = co_await withCancellation(AsyncStorage::getReviews(productId), reviewLoads.restart());
+//         ...fill the list...
+//     }
+//
+// A coroutine awaiting through withCancellation() is destroyed instead of resumed if
+// its CancellationToken (see TaskScheduler.h) was cancelled meanwhile, so a widget that
+// closes, or starts a newer load, never sees a stale result. Destroying it runs the
+// destructors of its locals, as if it had returned at the co_await. A task that threw
+// rethrows from co_await.
+//
+// Trace spans nest per thread, so open a TRACE_SCOPE after the last co_await, not before.
+
+// Return type of a coroutine started and left to run, like a slot. It runs up to its
+// first co_await on the caller's thread and frees itself when it finishes; an exception
+// it lets escape is reported on cerr.
+struct AsyncAction {
+    struct promise_type {
+        AsyncAction get_return_object() { return AsyncAction(); }
+        suspend_never initial_suspend() noexcept { return suspend_never(); }
+        suspend_never final_suspend() noexcept { return suspend_never(); }
+        void return_void() {}
+        void unhandled_exception() {
+            try {
+                rethrow_exception(current_exception());
+            } catch (const exception& e) {
+                cerr << "Error: Async action failed: " << e.what() << endl;
+            } catch (...) {
+                cerr << "Error: Async action failed." << endl;
+            }
+        }
+    };
+};
+
+template <typename T>
+class TaskAwaiter {
+private:
+    TaskFuture<T> future;
+    CancellationToken token;
+    bool cancellable;
+
+public:
+    TaskAwaiter(TaskFuture<T> task, CancellationToken cancelToken, bool canCancel)
+        : future(task), token(cancelToken), cancellable(canCancel) {}
+
+    bool await_ready() const {
+        return future.isReady() && !(cancellable && token.isCancelled());
+    }
+
+    void await_suspend(coroutine_handle<> waiting) {
+        CancellationToken cancelToken = token;
+        bool canCancel = cancellable;
+        future.whenDone([waiting, cancelToken, canCancel]() {
+            TaskScheduler::getInstance().dispatch([waiting, cancelToken, canCancel]() {
+                if (canCancel && cancelToken.isCancelled()) waiting.destroy();
+                else waiting.resume();
+            });
+        });
+    }
+
+    T await_resume() const { return future.get(); }
+};
+
+template <typename T>
+TaskAwaiter<T> operator co_await(TaskFuture<T> future) {
+    return TaskAwaiter<T>(future, CancellationToken(), false);
+}
+
+// Awaits future unless token is cancelled by the time it is done (see above).
+template <typename T>
+TaskAwaiter<T> withCancellation(TaskFuture<T> future, CancellationToken token) {
+    return TaskAwaiter<T>(future, token, true);
+}
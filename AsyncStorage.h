@@ -0,0 +1,189 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "TaskScheduler.h"
+#include "ProductCatalog.h"
+#include "ProductSearch.h"
+#include "Product.h"
+#include "User.h"
+#include "Order.h"
+#include "OrderStore.h"
+#include "Wishlist.h"
+#include "CheckoutPipeline.h"
+#include "StoreLocks.h"
+#include "IoStats.h"
+#include "Trace.h"
+
+using namespace std;
+
+// One review of a product, with its author's email already looked up
+struct ReviewRecord {
+    int userID;
+    int rating;
+    string comment;
+    string author;          // Empty if the user no longer exists
+
+    ReviewRecord() : userID(0), rating(0) {}
+};
+
+// A checkout handed to the pipeline: its ticket, 0 if the pipeline was full, and its outcome
+struct CheckoutSubmission {
+    long long ticket;
+    TaskFuture<CheckoutProgress> outcome;
+
+    CheckoutSubmission() : ticket(0) {}
+};
+
+// Non-blocking versions of the storage reads and writes the widgets make. Each one runs
+// on the task pool under the store locks it needs and returns a TaskFuture, which a
+// coroutine can co_await (see Async.h) and anything else can get() or deliver().
+class AsyncStorage {
+private:
+    static vector<ReviewRecord> readReviews(int productID) {
+        TRACE_SCOPE("review", "AsyncStorage::getReviews");
+        vector<ReviewRecord> reviews;
+        StoreLockSet locks;
+        locks.add(IoStats::Reviews, StoreLocks::Shared);
+        locks.add(IoStats::Users, StoreLocks::Shared);
+        locks.acquire();
+
+        TrackedIfstream reviewFile(IoStats::Reviews, "data/reviews/reviews.txt");
+        if (!reviewFile) return reviews;
+
+        string line;
+        while (getline(reviewFile, line)) {
+            if (line.empty()) continue;
+            stringstream ss(line);
+            string segment;
+            ReviewRecord review;
+            int currentProductID;
+
+            getline(ss, segment, ',');
+            try { currentProductID = stoi(segment); } catch (...) { continue; }
+            if (currentProductID != productID) continue;
+
+            getline(ss, segment, ',');
+            try { review.userID = stoi(segment); } catch (...) { continue; }
+            getline(ss, segment, ',');
+            try { review.rating = stoi(segment); } catch (...) { continue; }
+            getline(ss, review.comment); // Rest is the comment
+
+            if (!User::getUserEmailById(review.userID, review.author)) review.author.clear();
+            reviews.push_back(review);
+        }
+        return reviews;
+    }
+
+    static bool readHasPurchased(int userID, int productID) {
+        TRACE_SCOPE("order", "AsyncStorage::hasPurchased");
+        // The order index lists this user's orders without reading every order
+        // Checkouts append to the order segments on their own threads
+        StoreLockSet locks;
+        locks.add(IoStats::Orders, StoreLocks::Shared);
+        locks.acquire();
+        OrderStore& orderStore = OrderStore::getInstance();
+        if (!orderStore.ensureLoaded()) return false;
+        OrderQuery query;
+        query.userID = userID;
+        query.limit = 0;
+        OrderPage page = orderStore.query(query);
+
+        for (size_t row = 0; row < page.rows.size(); ++row) {
+            int productCount = 0;
+            int* productIDs = Order::getProductIDsForOrder(orderStore.getOrderID(page.rows[row]), productCount);
+            bool found = false;
+            for (int i = 0; productIDs && i < productCount && !found; ++i) {
+                found = (productIDs[i] == productID);
+            }
+            delete[] productIDs;
+            if (found) return true;
+        }
+        return false;
+    }
+
+    static vector<shared_ptr<Product> > readWishlist(int userID) {
+        TRACE_SCOPE("wishlist", "AsyncStorage::getWishlist");
+        vector<shared_ptr<Product> > products;
+        StoreLockSet locks;
+        locks.addUser(IoStats::Wishlists, userID);
+        locks.acquire();
+
+        Wishlist wishlist(userID); // Creates the user's file on first use
+        TrackedIfstream wishlistFile(IoStats::Wishlists, "data/wishlist/wishlist_" + to_string(userID) + ".txt");
+        if (!wishlistFile) return products;
+
+        // Products come from the catalog snapshot rather than a scan of products.txt each
+        string line;
+        while (getline(wishlistFile, line)) {
+            if (line.empty()) continue;
+            int productID = 0;
+            try { productID = stoi(line); } catch (...) { continue; }
+            if (productID <= 0) continue;
+            Product* product = Product::getProductForEdit(productID);
+            if (product) products.push_back(shared_ptr<Product>(product));
+        }
+        return products;
+    }
+
+public:
+    // The current catalog version, loading the catalog first if need be. Null if it
+    // could not be loaded.
+    static TaskFuture<shared_ptr<const CatalogSnapshot> > catalog() {
+        return TaskScheduler::getInstance().run([]() {
+            ProductCatalog& products = ProductCatalog::getInstance();
+            return products.ensureLoaded() ? products.snapshot() : shared_ptr<const CatalogSnapshot>();
+        });
+    }
+
+    // The rows of the snapshot matching the query (see ProductSearch.h). Stops early, with
+    // an incomplete result, once token is cancelled.
+    static TaskFuture<vector<int> > searchProducts(shared_ptr<const CatalogSnapshot> snapshot, const ProductQuery& query,
+                                                  CancellationToken token) {
+        return TaskScheduler::getInstance().run([snapshot, query, token]() {
+            return ProductSearch::getInstance().search(snapshot, query, token);
+        });
+    }
+
+    // The product as the catalog holds it now, or null if there is no such product.
+    static TaskFuture<shared_ptr<Product> > getProduct(int productID) {
+        return TaskScheduler::getInstance().run([productID]() {
+            return shared_ptr<Product>(Product::getProductForEdit(productID));
+        });
+    }
+
+    static TaskFuture<vector<ReviewRecord> > getReviews(int productID) {
+        return TaskScheduler::getInstance().run([productID]() { return readReviews(productID); });
+    }
+
+    // True if any of the user's orders contains the product.
+    static TaskFuture<bool> hasPurchased(int userID, int productID) {
+        return TaskScheduler::getInstance().run([userID, productID]() { return readHasPurchased(userID, productID); });
+    }
+
+    // The products on the user's wishlist that are still in the catalog, in list order.
+    static TaskFuture<vector<shared_ptr<Product> > > getWishlist(int userID) {
+        return TaskScheduler::getInstance().run([userID]() { return readWishlist(userID); });
+    }
+
+    // Places the user's cart as an order through the checkout pipeline. The ticket is
+    // known at once, for following the stages; the outcome arrives when the checkout has
+    // completed or failed. A ticket of 0 means the pipeline was full and nothing was
+    // submitted. Repeats with the same idempotency key cannot order twice.
+    static CheckoutSubmission placeOrder(int userID, const string& paymentMethod, const string& idempotencyKey) {
+        shared_ptr<TaskState<CheckoutProgress> > outcome = make_shared<TaskState<CheckoutProgress> >();
+        CheckoutSubmission submission;
+        submission.ticket = CheckoutPipeline::getInstance().trySubmit(userID, paymentMethod,
+            [outcome](const CheckoutProgress& progress) {
+                CheckoutProgress result = progress;
+                outcome->finish(&result, nullptr);
+            }, idempotencyKey);
+        if (submission.ticket != 0) submission.outcome = TaskFuture<CheckoutProgress>(outcome);
+        return submission;
+    }
+};
@@ -0,0 +1,454 @@
+#pragma once
+
+#include <iostream>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <chrono>
+#include <ctime>
+#include <iomanip>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <atomic>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Timings of one benchmark at one data scale. Samples are wall-clock nanoseconds per
+// call, in the order they were taken.
+struct BenchmarkResult {
+    string name;
+    string scale;
+    int warmup;
+    int failures;          // Calls whose body reported failure; still timed
+    vector<double> samples;
+    double minimum;
+    double median;
+    double mean;
+    double p90;
+    double p95;
+    double p99;
+    double maximum;
+    double allocations;    // Median heap allocations per call
+    double bytesRead;      // Median bytes read per call; -1 where the platform can't say
+
+    BenchmarkResult() : warmup(0), failures(0), minimum(0), median(0), mean(0), p90(0), p95(0), p99(0), maximum(0),
+                        allocations(0), bytesRead(-1) {}
+};
+
+// Heap allocations made by the process. bench.cpp replaces the global operator new
+// to feed it; in any other program it stays at zero.
+class AllocationTally {
+public:
+    static atomic<unsigned long long>& calls() {
+        static atomic<unsigned long long> value(0);
+        return value;
+    }
+    static unsigned long long current() { return calls().load(memory_order_relaxed); }
+};
+
+// Bytes this process has read through read()-style calls, from /proc/self/io (rchar),
+// so page-cache hits count as well as disk reads. Uses raw syscalls so probing it
+// neither allocates nor skews the count by more than the fixed amount it subtracts.
+class ReadByteCounter {
+private:
+    bool available;
+    unsigned long long probeCost;
+
+    static bool sample(unsigned long long& value) {
+        int fd = open("/proc/self/io", O_RDONLY);
+        if (fd < 0) return false;
+        char buffer[512];
+        ssize_t length = read(fd, buffer, sizeof(buffer) - 1);
+        close(fd);
+        if (length <= 0) return false;
+        buffer[length] = '\0';
+        const char* field = strstr(buffer, "rchar:");
+        if (!field) return false;
+        value = strtoull(field + 6, nullptr, 10);
+        return true;
+    }
+
+public:
+    ReadByteCounter() : available(false), probeCost(0) {
+        unsigned long long first = 0, second = 0;
+        available = sample(first) && sample(second);
+        if (available) probeCost = second - first;
+    }
+
+    bool isAvailable() const { return available; }
+
+    unsigned long long current() const {
+        unsigned long long value = 0;
+        return (available && sample(value)) ? value : 0;
+    }
+
+    // Bytes read between two current() calls, not counting the second probe's own read.
+    unsigned long long delta(unsigned long long before, unsigned long long after) const {
+        unsigned long long raw = after - before;
+        return raw > probeCost ? raw - probeCost : 0;
+    }
+};
+
+// Swaps cout/cerr for a sink while in scope, so the console output of the functions
+// under test neither floods the terminal nor dominates their timings.
+class OutputSilencer {
+private:
+    class NullBuffer : public streambuf {
+    protected:
+        int overflow(int c) override { return c == EOF ? 0 : c; }
+        streamsize xsputn(const char*, streamsize count) override { return count; }
+    };
+
+    NullBuffer sink;
+    streambuf* savedOut;
+    streambuf* savedErr;
+
+public:
+    OutputSilencer() : savedOut(cout.rdbuf(&sink)), savedErr(cerr.rdbuf(&sink)) {}
+    ~OutputSilencer() {
+        cout.rdbuf(savedOut);
+        cerr.rdbuf(savedErr);
+    }
+};
+
+// Runs benchmarks with untimed per-call setup, warmup calls and a repetition count
+// capped by a time budget, and reports percentiles as a table or JSON.
+class BenchmarkRunner {
+public:
+    struct Options {
+        int warmup;
+        int repetitions;
+        double maxSeconds;  // Per benchmark; stops repeating early once exceeded
+        string filter;      // Substring of the benchmark name; empty runs everything
+
+        Options() : warmup(3), repetitions(20), maxSeconds(10.0) {}
+    };
+
+    typedef function<void()> Setup;
+    typedef function<bool()> Body;   // Returns false if the operation failed
+    typedef function<void(const string&)> StartHook;
+
+    // Median allocations per call may grow by this many before counting as a regression,
+    // since inputs drawn per call (a product, a search term) allocate a little differently.
+    static constexpr double AllocationSlack = 2.0;
+
+private:
+    Options options;
+    string scale;
+    StartHook onStart;
+    vector<BenchmarkResult> finished;
+    ReadByteCounter readBytes;
+
+    static string jsonEscape(const string& text) {
+        string escaped;
+        for (size_t i = 0; i < text.size(); ++i) {
+            char c = text[i];
+            if (c == '"' || c == '\\') { escaped += '\\'; escaped += c; }
+            else if (c == '\n') escaped += "\\n";
+            else if (static_cast<unsigned char>(c) < 0x20) escaped += ' ';
+            else escaped += c;
+        }
+        return escaped;
+    }
+
+    static string formatDuration(double nanoseconds) {
+        stringstream ss;
+        ss << fixed << setprecision(nanoseconds < 1e4 ? 0 : 2);
+        if (nanoseconds < 1e4) ss << nanoseconds << " ns";
+        else if (nanoseconds < 1e6) ss << nanoseconds / 1e3 << " us";
+        else if (nanoseconds < 1e9) ss << nanoseconds / 1e6 << " ms";
+        else ss << nanoseconds / 1e9 << " s";
+        return ss.str();
+    }
+
+    static string formatBytes(double bytes) {
+        if (bytes < 0) return "n/a";
+        stringstream ss;
+        ss << fixed << setprecision(bytes < 1024 ? 0 : 1);
+        if (bytes < 1024) ss << bytes << " B";
+        else if (bytes < 1024.0 * 1024) ss << bytes / 1024 << " KB";
+        else ss << bytes / (1024.0 * 1024) << " MB";
+        return ss.str();
+    }
+
+    static void summarize(BenchmarkResult& result) {
+        if (result.samples.empty()) return;
+        vector<double> sorted = result.samples;
+        sort(sorted.begin(), sorted.end());
+        double sum = 0.0;
+        for (size_t i = 0; i < sorted.size(); ++i) sum += sorted[i];
+        result.minimum = sorted.front();
+        result.maximum = sorted.back();
+        result.mean = sum / sorted.size();
+        result.median = percentile(sorted, 50.0);
+        result.p90 = percentile(sorted, 90.0);
+        result.p95 = percentile(sorted, 95.0);
+        result.p99 = percentile(sorted, 99.0);
+    }
+
+public:
+    explicit BenchmarkRunner(const Options& opts) : options(opts) {}
+
+    void setScale(const string& name) { scale = name; }
+
+    // Runs before a selected benchmark's warmup and again before its measured calls, e.g.
+    // to reseed the inputs its setup draws; an empty hook removes it.
+    void setStartHook(const StartHook& hook) { onStart = hook; }
+    const vector<BenchmarkResult>& results() const { return finished; }
+
+    bool selected(const string& name) const {
+        return options.filter.empty() || name.find(options.filter) != string::npos;
+    }
+
+    // Linear interpolation between closest ranks; `sorted` must be ascending.
+    static double percentile(const vector<double>& sorted, double percent) {
+        if (sorted.empty()) return 0.0;
+        double rank = (percent / 100.0) * (sorted.size() - 1);
+        size_t lower = static_cast<size_t>(rank);
+        size_t upper = min(lower + 1, sorted.size() - 1);
+        return sorted[lower] + (sorted[upper] - sorted[lower]) * (rank - lower);
+    }
+
+    // `setup` runs before every call, warmup included, and is not timed.
+    void run(const string& name, const Setup& setup, const Body& body) {
+        if (!selected(name)) return;
+        BenchmarkResult result;
+        result.name = name;
+        result.scale = scale;
+
+        if (onStart) onStart(name);
+        auto budgetStart = chrono::steady_clock::now();
+        for (int i = 0; i < options.warmup; ++i) {
+            if (setup) setup();
+            OutputSilencer quiet;
+            body();
+            result.warmup++;
+            if (chrono::duration<double>(chrono::steady_clock::now() - budgetStart).count() > options.maxSeconds) break;
+        }
+
+        vector<double> allocations, bytes;
+        if (onStart) onStart(name);   // The warmup may have been cut short by the budget
+        budgetStart = chrono::steady_clock::now();
+        for (int i = 0; i < options.repetitions; ++i) {
+            if (setup) setup();
+            bool ok;
+            chrono::steady_clock::time_point started, stopped;
+            unsigned long long allocationsBefore, allocationsAfter, bytesBefore, bytesAfter;
+            {
+                OutputSilencer quiet;
+                bytesBefore = readBytes.current();
+                allocationsBefore = AllocationTally::current();
+                started = chrono::steady_clock::now();
+                ok = body();
+                stopped = chrono::steady_clock::now();
+                allocationsAfter = AllocationTally::current();
+                bytesAfter = readBytes.current();
+            }
+            result.samples.push_back(static_cast<double>(chrono::duration_cast<chrono::nanoseconds>(stopped - started).count()));
+            allocations.push_back(static_cast<double>(allocationsAfter - allocationsBefore));
+            bytes.push_back(static_cast<double>(readBytes.delta(bytesBefore, bytesAfter)));
+            if (!ok) result.failures++;
+            // Always keep at least a few samples so the percentiles mean something
+            if (i >= 2 && chrono::duration<double>(chrono::steady_clock::now() - budgetStart).count() > options.maxSeconds) break;
+        }
+
+        summarize(result);
+        sort(allocations.begin(), allocations.end());
+        result.allocations = percentile(allocations, 50.0);
+        if (readBytes.isAvailable()) {
+            sort(bytes.begin(), bytes.end());
+            result.bytesRead = percentile(bytes, 50.0);
+        }
+        printRow(cout, result);
+        finished.push_back(result);
+    }
+
+    void run(const string& name, const Body& body) { run(name, Setup(), body); }
+
+    static void printHeader(ostream& out) {
+        out << left << setw(34) << "Benchmark" << setw(12) << "Scale" << right << setw(6) << "Reps"
+            << setw(13) << "Median" << setw(13) << "p95" << setw(13) << "p99" << setw(13) << "Max"
+            << setw(10) << "Allocs" << setw(12) << "Read" << setw(7) << "Fail" << endl;
+    }
+
+    static void printRow(ostream& out, const BenchmarkResult& result) {
+        out << left << setw(34) << result.name << setw(12) << result.scale << right << setw(6) << result.samples.size()
+            << setw(13) << formatDuration(result.median) << setw(13) << formatDuration(result.p95)
+            << setw(13) << formatDuration(result.p99) << setw(13) << formatDuration(result.maximum)
+            << setw(10) << static_cast<long long>(result.allocations) << setw(12) << formatBytes(result.bytesRead)
+            << setw(7) << result.failures << endl;
+    }
+
+    // Results plus free-form context (build, host, data sizes) as a JSON document.
+    bool writeJson(const string& path, const vector<pair<string, string> >& context) const {
+        ofstream out(path, ios::trunc);
+        if (!out) {
+            cerr << "Error: Could not open " << path << " for writing." << endl;
+            return false;
+        }
+        out << "{\n  \"context\": {";
+        for (size_t i = 0; i < context.size(); ++i) {
+            out << (i ? ",\n" : "\n") << "    \"" << jsonEscape(context[i].first) << "\": \""
+                << jsonEscape(context[i].second) << "\"";
+        }
+        out << "\n  },\n  \"benchmarks\": [";
+        out << fixed << setprecision(0);
+        for (size_t i = 0; i < finished.size(); ++i) {
+            const BenchmarkResult& r = finished[i];
+            out << (i ? ",\n" : "\n") << "    {\"name\": \"" << jsonEscape(r.name) << "\", \"scale\": \""
+                << jsonEscape(r.scale) << "\", \"repetitions\": " << r.samples.size() << ", \"warmup\": " << r.warmup
+                << ", \"failures\": " << r.failures << ", \"min_ns\": " << r.minimum << ", \"median_ns\": " << r.median
+                << ", \"mean_ns\": " << r.mean << ", \"p90_ns\": " << r.p90 << ", \"p95_ns\": " << r.p95
+                << ", \"p99_ns\": " << r.p99 << ", \"max_ns\": " << r.maximum << ", \"allocations\": " << r.allocations
+                << ", \"bytes_read\": " << r.bytesRead << ", \"samples_ns\": [";
+            for (size_t s = 0; s < r.samples.size(); ++s) out << (s ? ", " : "") << r.samples[s];
+            out << "]}";
+        }
+        out << "\n  ]\n}\n";
+        return static_cast<bool>(out);
+    }
+
+    // Baseline file, one benchmark per line in the same comma-separated style as the data files:
+    //   scale,name,median_ns,p95_ns,allocations,bytes_read,sample;sample;...
+    bool saveBaseline(const string& path) const {
+        ofstream out(path, ios::trunc);
+        if (!out) {
+            cerr << "Error: Could not open " << path << " for writing." << endl;
+            return false;
+        }
+        out << fixed << setprecision(0);
+        for (size_t i = 0; i < finished.size(); ++i) {
+            const BenchmarkResult& r = finished[i];
+            out << r.scale << "," << r.name << "," << r.median << "," << r.p95 << "," << r.allocations << ","
+                << r.bytesRead << ",";
+            for (size_t s = 0; s < r.samples.size(); ++s) out << (s ? ";" : "") << r.samples[s];
+            out << "\n";
+        }
+        return static_cast<bool>(out);
+    }
+
+    static bool loadBaseline(const string& path, vector<BenchmarkResult>& baseline) {
+        ifstream in(path);
+        if (!in) {
+            cerr << "Error: Could not open baseline " << path << "." << endl;
+            return false;
+        }
+        string line;
+        while (getline(in, line)) {
+            if (line.empty()) continue;
+            stringstream ss(line);
+            BenchmarkResult r;
+            string median, p95, allocations, bytes, samples;
+            if (!getline(ss, r.scale, ',') || !getline(ss, r.name, ',') || !getline(ss, median, ',') ||
+                !getline(ss, p95, ',') || !getline(ss, allocations, ',') || !getline(ss, bytes, ',')) {
+                cerr << "Warning: Skipping malformed baseline line: " << line << endl;
+                continue;
+            }
+            getline(ss, samples);
+            r.median = atof(median.c_str());
+            r.p95 = atof(p95.c_str());
+            r.allocations = atof(allocations.c_str());
+            r.bytesRead = atof(bytes.c_str());
+            stringstream sampleStream(samples);
+            string sample;
+            while (getline(sampleStream, sample, ';')) {
+                if (!sample.empty()) r.samples.push_back(atof(sample.c_str()));
+            }
+            baseline.push_back(r);
+        }
+        return true;
+    }
+
+    // One-sided Mann-Whitney U test: p-value for "current tends to take longer than base".
+    // Normal approximation with tie correction, fine from about eight samples each.
+    static double mannWhitneySlowerP(const vector<double>& base, const vector<double>& current) {
+        size_t n1 = current.size(), n2 = base.size();
+        if (n1 == 0 || n2 == 0) return 1.0;
+        vector<pair<double, int> > pooled;
+        for (size_t i = 0; i < n1; ++i) pooled.push_back(make_pair(current[i], 0));
+        for (size_t i = 0; i < n2; ++i) pooled.push_back(make_pair(base[i], 1));
+        sort(pooled.begin(), pooled.end());
+
+        double rankSumCurrent = 0.0, tieTerm = 0.0;
+        for (size_t i = 0; i < pooled.size();) {
+            size_t j = i;
+            while (j < pooled.size() && pooled[j].first == pooled[i].first) j++;
+            double averageRank = (i + 1 + j) / 2.0;   // Ranks are 1-based
+            for (size_t k = i; k < j; ++k) {
+                if (pooled[k].second == 0) rankSumCurrent += averageRank;
+            }
+            double ties = static_cast<double>(j - i);
+            tieTerm += ties * ties * ties - ties;
+            i = j;
+        }
+        double u = rankSumCurrent - n1 * (n1 + 1) / 2.0;
+        double n = static_cast<double>(n1 + n2);
+        double mean = n1 * n2 / 2.0;
+        double variance = n1 * n2 / 12.0 * ((n + 1) - tieTerm / (n * (n - 1)));
+        if (variance <= 0.0) return 1.0;
+        double z = (u - mean - 0.5) / sqrt(variance);   // Continuity correction
+        return 0.5 * erfc(z / sqrt(2.0));
+    }
+
+    // Prints a diff table against a baseline and returns how many benchmarks regressed.
+    // Time regresses when the median is more than thresholdPercent slower and the
+    // Mann-Whitney test is significant at alpha; allocations and bytes read (which are
+    // nearly deterministic) regress on the threshold alone, past a small absolute slack.
+    int compareWithBaseline(const vector<BenchmarkResult>& baseline, double thresholdPercent, double alpha,
+                            ostream& out) const {
+        int regressions = 0;
+        out << left << setw(34) << "Benchmark" << setw(12) << "Scale" << right << setw(13) << "Base"
+            << setw(13) << "Current" << setw(9) << "Change" << setw(9) << "p" << setw(17) << "Allocs"
+            << setw(21) << "Read" << "  Verdict" << endl;
+        for (size_t i = 0; i < finished.size(); ++i) {
+            const BenchmarkResult& current = finished[i];
+            const BenchmarkResult* base = nullptr;
+            for (size_t b = 0; b < baseline.size(); ++b) {
+                if (baseline[b].name == current.name && baseline[b].scale == current.scale) { base = &baseline[b]; break; }
+            }
+            out << left << setw(34) << current.name << setw(12) << current.scale << right;
+            if (!base) {
+                out << setw(13) << "-" << setw(13) << formatDuration(current.median) << "  new" << endl;
+                continue;
+            }
+
+            double change = base->median > 0 ? (current.median - base->median) / base->median * 100.0 : 0.0;
+            double p = mannWhitneySlowerP(base->samples, current.samples);
+            bool slower = change > thresholdPercent && p < alpha;
+            bool faster = change < -thresholdPercent && mannWhitneySlowerP(current.samples, base->samples) < alpha;
+            bool moreAllocations = current.allocations > base->allocations * (1.0 + thresholdPercent / 100.0) &&
+                                   current.allocations - base->allocations > AllocationSlack;
+            bool moreReads = base->bytesRead >= 0 && current.bytesRead >= 0 &&
+                             current.bytesRead > base->bytesRead * (1.0 + thresholdPercent / 100.0) &&
+                             current.bytesRead - base->bytesRead >= 4096;
+
+            stringstream allocationText, readText, changeText, pText;
+            allocationText << fixed << setprecision(0) << base->allocations << ">" << current.allocations;
+            readText << formatBytes(base->bytesRead) << ">" << formatBytes(current.bytesRead);
+            changeText << showpos << fixed << setprecision(1) << change << "%";
+            pText << fixed << setprecision(3) << p;
+
+            string verdict = "same";
+            if (slower || moreAllocations || moreReads) {
+                verdict = "REGRESSED";
+                if (slower) verdict += " time";
+                if (moreAllocations) verdict += " allocs";
+                if (moreReads) verdict += " reads";
+                regressions++;
+            } else if (faster) {
+                verdict = "faster";
+            }
+            out << setw(13) << formatDuration(base->median) << setw(13) << formatDuration(current.median)
+                << setw(9) << changeText.str() << setw(9) << pText.str() << setw(17) << allocationText.str()
+                << setw(21) << readText.str() << "  " << verdict << endl;
+        }
+        return regressions;
+    }
+};
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+using namespace std;
+
+// Fixed-capacity FIFO between threads. push() blocks while the queue is full, which
+// is how a slow consumer pushes back on its producers; popBatch() hands a consumer
+// everything waiting, up to a limit, so it can amortize one expensive step (a file
+// rewrite, a lock acquisition) over many items. close() wakes everyone: pushes fail
+// from then on and pops drain what is left, then return nothing.
+template <typename T>
+class BoundedQueue {
+private:
+    mutable mutex lock;
+    condition_variable notEmpty;
+    condition_variable notFull;
+    deque<T> items;
+    size_t capacity;
+    bool closed;
+
+public:
+    explicit BoundedQueue(size_t maxItems) : capacity(maxItems > 0 ? maxItems : 1), closed(false) {}
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    // Waits for room; false if the queue was closed.
+    bool push(T item) {
+        unique_lock<mutex> guard(lock);
+        notFull.wait(guard, [this]() { return closed || items.size() < capacity; });
+        if (closed) return false;
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    // Never waits; false if the queue is full or closed.
+    bool tryPush(T item) {
+        lock_guard<mutex> guard(lock);
+        if (closed || items.size() >= capacity) return false;
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    // Waits for at least one item and moves up to maxItems into batch. Returns false
+    // once the queue is closed and drained.
+    bool popBatch(vector<T>& batch, size_t maxItems) {
+        batch.clear();
+        unique_lock<mutex> guard(lock);
+        notEmpty.wait(guard, [this]() { return closed || !items.empty(); });
+        if (items.empty()) return false;
+        while (!items.empty() && batch.size() < maxItems) {
+            batch.push_back(std::move(items.front()));
+            items.pop_front();
+        }
+        notFull.notify_all();
+        return true;
+    }
+
+    void close() {
+        lock_guard<mutex> guard(lock);
+        closed = true;
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+
+    size_t size() const {
+        lock_guard<mutex> guard(lock);
+        return items.size();
+    }
+
+    size_t maxSize() const { return capacity; }
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <functional>
+#include <atomic>
+
+#include "ListenerSet.h"
+
+using namespace std;
+
+// Entity deltas published by the storage classes after a write has reached disk.
+// Views subscribe and patch themselves (one row changed, inserted or removed)
+// instead of reloading whole files.
+enum class EntityType {
+    Product,
+    Order,
+    User,
+    Review,
+    Cart,
+    Wishlist
+};
+
+enum class ChangeKind {
+    Inserted,
+    Updated,
+    Removed
+};
+
+// Bit flags for EntityDelta::changedFields when entity == EntityType::Product.
+namespace ProductField {
+    const unsigned int Name        = 1u << 0;
+    const unsigned int Category    = 1u << 1;
+    const unsigned int Price       = 1u << 2;
+    const unsigned int Rating      = 1u << 3;
+    const unsigned int Stock       = 1u << 4;
+    const unsigned int Description = 1u << 5;
+    const unsigned int All         = 0x3Fu;
+}
+
+// Bit flags for EntityDelta::changedFields when entity == EntityType::Order.
+namespace OrderField {
+    const unsigned int Items  = 1u << 0;
+    const unsigned int Status = 1u << 1;
+    const unsigned int All    = 0x3u;
+}
+
+struct EntityDelta {
+    EntityType entity;
+    ChangeKind kind;
+    int entityID;
+    unsigned int changedFields;
+    unsigned long long version; // Feed-wide sequence number, strictly increasing
+};
+
+class ChangeFeed {
+public:
+    typedef ListenerSet<EntityDelta>::Listener Listener;
+
+private:
+    ListenerSet<EntityDelta> listeners;
+    atomic<unsigned long long> nextVersion;
+
+    ChangeFeed() : nextVersion(1) {}
+
+public:
+    ChangeFeed(const ChangeFeed&) = delete;
+    ChangeFeed& operator=(const ChangeFeed&) = delete;
+
+    static ChangeFeed& getInstance() {
+        static ChangeFeed instance;
+        return instance;
+    }
+
+    // Returns a token for unsubscribe(). Listeners run on the publishing thread;
+    // UI subscribers are expected to re-post to their own thread.
+    int subscribe(Listener listener) {
+        return listeners.subscribe(std::move(listener));
+    }
+
+    // Waits for calls of the listener still running on publishing threads, so a view can
+    // unsubscribe in its destructor.
+    void unsubscribe(int token) {
+        listeners.unsubscribe(token);
+    }
+
+    unsigned long long publish(EntityType entity, ChangeKind kind, int entityID, unsigned int changedFields) {
+        EntityDelta delta;
+        delta.entity = entity;
+        delta.kind = kind;
+        delta.entityID = entityID;
+        delta.changedFields = changedFields;
+        delta.version = nextVersion.fetch_add(1);
+
+        listeners.notify(delta);
+        return delta.version;
+    }
+
+    unsigned long long currentVersion() const {
+        return nextVersion.load() - 1;
+    }
+};
@@ -0,0 +1,878 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <future>
+#include <ctime>
+#include <cstdio>
+#include <cstdlib>
+
+#include "BoundedQueue.h"
+#include "StoreLocks.h"
+#include "ShoppingCart.h"
+#include "Order.h"
+#include "OrderSegments.h"
+#include "OrderStore.h"
+#include "Payment.h"
+#include "ProductCatalog.h"
+#include "IdempotencyIndex.h"
+#include "StockReservations.h"
+#include "ShardedStockCounter.h"
+#include "ChangeFeed.h"
+#include "ListenerSet.h"
+#include "IoStats.h"
+#include "Trace.h"
+
+using namespace std;
+
+enum class CheckoutStage {
+    Queued,
+    Validating,
+    Reserving,
+    Authorizing,
+    Persisting,
+    ReleasingCart,
+    Completed,
+    Failed
+};
+
+inline const char* checkoutStageName(CheckoutStage stage) {
+    switch (stage) {
+        case CheckoutStage::Queued: return "Queued";
+        case CheckoutStage::Validating: return "Validating cart";
+        case CheckoutStage::Reserving: return "Reserving stock";
+        case CheckoutStage::Authorizing: return "Authorizing payment";
+        case CheckoutStage::Persisting: return "Saving order";
+        case CheckoutStage::ReleasingCart: return "Clearing cart";
+        case CheckoutStage::Completed: return "Completed";
+        case CheckoutStage::Failed: return "Failed";
+    }
+    return "";
+}
+
+// Where one checkout has got to. items and total are set once stock is reserved,
+// orderID from the Authorizing stage on.
+struct CheckoutProgress {
+    long long ticket;
+    int userID;
+    CheckoutStage stage;
+    int orderID;
+    double total;
+    vector<OrderLineItem> items;
+    string error;           // Why the checkout failed, when stage == Failed
+
+    CheckoutProgress() : ticket(0), userID(0), stage(CheckoutStage::Queued), orderID(0), total(0.0) {}
+};
+
+struct CheckoutPipelineConfig {
+    int cartWorkers;        // Threads for each of the two per-user stages (validate, release cart)
+    size_t queueCapacity;   // Jobs waiting in front of each stage before producers block
+    size_t maxBatch;        // Most jobs one stage handles with a single file rewrite or append
+
+    CheckoutPipelineConfig() : cartWorkers(2), queueCapacity(256), maxBatch(64) {}
+};
+
+// Checkout as a staged pipeline, replacing one synchronous Order::placeOrder per order:
+//
+//   validate cart -> reserve stock -> authorize payment -> persist order -> release cart -> events
+//
+// Stages are joined by bounded queues, so a slow stage blocks its producers instead of
+// piling up work. The per-user stages (validate, release cart) run on several threads
+// under the user's cart lock. The stages that own a shared file run on one thread each
+// and take everything queued in front of them: one products.txt rewrite reserves stock
+// for a whole batch, one scan and append records its payments, one segment append
+// persists its orders. Throughput then grows with the batch size rather than being
+// capped at one full-file rewrite per order.
+//
+// products.txt is replaced with a single rename, so readers that take no lock (the GUI's
+// Product::getProductByID) always see either the old or the new file. Everything else the
+// stages touch is guarded by StoreLocks; code elsewhere that writes products, orders or
+// payments while the pipeline runs must take the same locks. Order IDs are handed out by
+// the pipeline, so while it runs all checkouts should go through it.
+//
+// A job that fails after its stock was reserved gets the stock back before it is reported.
+//
+// A checkout submitted with an idempotency key (see IdempotencyIndex.h) runs at most once:
+// a repeat while it is in the pipeline is attached to it and hears the same outcome, and
+// a repeat after it completed is answered from the index without touching any file.
+//
+// The in-memory indexes (ProductCatalog stock, OrderStore rows) are updated by the stage
+// that wrote the file, while it still holds the file's lock, so they never run ahead of or
+// behind the disk. The ChangeFeed deltas and the completion callbacks are then delivered
+// by the events stage through the dispatcher, in pipeline order. By default that runs on
+// the events thread; the GUI installs one that posts to its event loop, so its views hear
+// about changes on its own thread and never wait on a stage's file I/O.
+// Progress listeners see every stage change on the worker threads, like ChangeFeed
+// listeners; UI subscribers re-post to their own thread.
+class CheckoutPipeline {
+public:
+    typedef ListenerSet<CheckoutProgress>::Listener Listener;
+    typedef function<void(function<void()>)> Dispatcher;
+
+    struct StageStats {
+        long long jobs;
+        long long batches;
+        long long failures;
+
+        StageStats() : jobs(0), batches(0), failures(0) {}
+    };
+
+private:
+    struct Job {
+        CheckoutProgress progress;
+        string method;
+        vector<pair<int, int> > cartLines;  // The cart as validated, for releasing it later
+        vector<OrderLineItem> items;        // One per product; prices set when stock is reserved
+        long long timestamp;
+        Listener onFinished;
+        string idempotencyKey;
+        bool ownsKey;                       // Claimed the key in IdempotencyIndex
+        bool admitted;                      // Took its units from HotStockCounters
+        vector<Listener> duplicates;        // Repeats submitted under the same key; guarded by stateLock
+    };
+    typedef shared_ptr<Job> JobPtr;
+
+    // One unit of work for the events stage.
+    struct Event {
+        vector<int> stockChanged;   // Products whose catalog stock was just updated
+        int orderID;                // Order just added to OrderStore, when > 0
+        JobPtr finished;            // Completed or failed job to report
+
+        Event() : orderID(0) {}
+    };
+
+    static const int StageCount = 6;
+    enum StageIndex { ValidateStage, ReserveStage, AuthorizeStage, PersistStage, ReleaseStage, EventStage };
+
+    CheckoutPipelineConfig config;
+    BoundedQueue<JobPtr>* validateQueue;
+    BoundedQueue<JobPtr>* reserveQueue;
+    BoundedQueue<JobPtr>* authorizeQueue;
+    BoundedQueue<JobPtr>* persistQueue;
+    BoundedQueue<JobPtr>* releaseQueue;
+    BoundedQueue<Event>* eventQueue;
+    vector<thread> stageThreads[StageCount];
+
+    mutex stateLock;                  // Guards running, submitting, dispatcher, stats and pendingKeys
+    bool running;
+    int submitting;                   // Submits between their running check and their last push
+    condition_variable submitsDone;   // Signalled when submitting drops to zero
+    map<string, JobPtr> pendingKeys;  // "userID:key" -> the job that owns the key
+    ListenerSet<CheckoutProgress> listeners;
+    Dispatcher dispatcher;
+    StageStats stats[StageCount];
+    atomic<long long> nextTicket;
+    int nextOrderID;                  // Authorize stage only
+
+    CheckoutPipeline() : validateQueue(nullptr), reserveQueue(nullptr), authorizeQueue(nullptr),
+                         persistQueue(nullptr), releaseQueue(nullptr), eventQueue(nullptr), running(false),
+                         submitting(0), nextTicket(1), nextOrderID(0) {}
+
+    void countBatch(StageIndex stage, size_t jobs, size_t failures) {
+        lock_guard<mutex> guard(stateLock);
+        stats[stage].jobs += static_cast<long long>(jobs);
+        stats[stage].batches++;
+        stats[stage].failures += static_cast<long long>(failures);
+    }
+
+    void notify(const JobPtr& job, CheckoutStage stage) {
+        job->progress.stage = stage;
+        publish(job->progress);
+    }
+
+    void publish(const CheckoutProgress& progress) {
+        listeners.notify(progress);
+    }
+
+    void fail(const JobPtr& job, const string& error) {
+        job->progress.error = error;
+        if (job->admitted) {
+            for (size_t i = 0; i < job->items.size(); ++i) {
+                HotStockCounters::getInstance().put(job->items[i].productID, job->items[i].quantity);
+            }
+            job->admitted = false;
+        }
+        Event event;
+        event.finished = job;
+        eventQueue->push(event);
+    }
+
+    // Changes the stock of the listed products in products.txt in one rewrite: each job's
+    // items are taken (reserve) or put back (!reserve). When reserving, a job that cannot
+    // be filled in full gets an error and changes nothing; the others get their unit
+    // prices and totals. Units other users hold (see StockReservations.h) count as gone,
+    // except the holds of jobs filled earlier in the batch. Returns false only if
+    // products.txt could not be rewritten, in which case no job was filled. The changes
+    // are returned as deltas for applyStock().
+    static bool rewriteStock(vector<JobPtr>& jobs, bool reserve, vector<pair<int, int> >& stockChanges) {
+        TRACE_SCOPE("checkout", "CheckoutPipeline::rewriteStock");
+        struct ProductLine {
+            size_t line;
+            size_t stockStart;      // Offset of the stock field within the line
+            size_t stockEnd;
+            int stock;
+            int original;
+            double price;
+            bool changed;
+        };
+        map<int, ProductLine> wanted;
+        for (size_t j = 0; j < jobs.size(); ++j) {
+            for (size_t i = 0; i < jobs[j]->items.size(); ++i) {
+                ProductLine entry = {0, 0, 0, 0, 0, 0.0, false};
+                wanted[jobs[j]->items[i].productID] = entry;
+            }
+        }
+
+        vector<string> lines;
+        size_t found = 0;
+        {
+            TrackedIfstream in(IoStats::Products, "data/products.txt");
+            if (!in) return false;
+            string line;
+            while (getline(in, line)) {
+                lines.push_back(line);
+                if (line.empty() || found == wanted.size()) continue;
+                auto entry = wanted.find(atoi(line.c_str()));
+                if (entry == wanted.end()) continue;
+                // id,name,category,price,rating,stock
+                size_t commas[5];
+                size_t pos = 0;
+                int count = 0;
+                while (count < 5 && (pos = line.find(',', pos)) != string::npos) commas[count++] = pos++;
+                if (count < 5) continue;
+                entry->second.line = lines.size() - 1;
+                entry->second.price = strtod(line.c_str() + commas[2] + 1, nullptr);
+                entry->second.stockStart = commas[4] + 1;
+                size_t stockEnd = line.find(',', entry->second.stockStart);
+                entry->second.stockEnd = (stockEnd == string::npos) ? line.length() : stockEnd;
+                entry->second.stock = atoi(line.c_str() + entry->second.stockStart);
+                entry->second.original = entry->second.stock;
+                entry->second.changed = true;   // Marks the product as present
+                found++;
+            }
+        }
+        for (auto it = wanted.begin(); it != wanted.end(); ++it) {
+            bool present = it->second.changed;
+            it->second.changed = false;
+            if (!present) it->second.stock = -1;
+        }
+
+        // Fill the jobs in queue order against the running stock levels
+        StockReservations& reservations = StockReservations::getInstance();
+        map<int, int> filledHolds;          // productID -> held units already taken by this batch
+        for (size_t j = 0; j < jobs.size(); ++j) {
+            Job& job = *jobs[j];
+            if (!job.progress.error.empty()) continue;
+            if (reserve) {
+                for (size_t i = 0; i < job.items.size() && job.progress.error.empty(); ++i) {
+                    int productID = job.items[i].productID;
+                    const ProductLine& entry = wanted[productID];
+                    int heldElsewhere = max(0, reservations.heldByOthers(job.progress.userID, productID) - filledHolds[productID]);
+                    if (entry.stock < 0) {
+                        job.progress.error = "Product " + to_string(productID) + " no longer exists";
+                    } else if (entry.stock < job.items[i].quantity) {
+                        job.progress.error = "Not enough stock for product " + to_string(productID) +
+                                             " (" + to_string(entry.stock) + " left)";
+                    } else if (entry.stock - heldElsewhere < job.items[i].quantity) {
+                        job.progress.error = "Product " + to_string(productID) + " is held by other shoppers (" +
+                                             to_string(max(0, entry.stock - heldElsewhere)) + " available)";
+                    }
+                }
+                if (!job.progress.error.empty()) continue;
+                for (size_t i = 0; i < job.items.size(); ++i) {
+                    int productID = job.items[i].productID;
+                    filledHolds[productID] += min(reservations.heldBy(job.progress.userID, productID), job.items[i].quantity);
+                }
+            }
+            double total = 0.0;
+            for (size_t i = 0; i < job.items.size(); ++i) {
+                ProductLine& entry = wanted[job.items[i].productID];
+                if (entry.stock < 0) continue;   // Removed since it was reserved; nothing to put back
+                entry.stock += reserve ? -job.items[i].quantity : job.items[i].quantity;
+                entry.changed = true;
+                if (reserve) {
+                    job.items[i].unitPrice = entry.price;
+                    total += entry.price * job.items[i].quantity;
+                }
+            }
+            if (reserve) job.progress.total = total;
+        }
+
+        stockChanges.clear();
+        for (auto it = wanted.begin(); it != wanted.end(); ++it) {
+            if (!it->second.changed || it->second.stock == it->second.original) continue;
+            string& line = lines[it->second.line];
+            line.replace(it->second.stockStart, it->second.stockEnd - it->second.stockStart, to_string(it->second.stock));
+            stockChanges.push_back(make_pair(it->first, it->second.stock - it->second.original));
+        }
+        if (stockChanges.empty()) return true;
+
+        {
+            TrackedOfstream out(IoStats::Products, "data/temp_products.txt");
+            if (!out) return false;
+            for (size_t i = 0; i < lines.size(); ++i) out << lines[i] << "\n";
+            out.close();
+            if (!out) {
+                remove("data/temp_products.txt");
+                return false;
+            }
+        }
+        // rename() replaces the old file in one step; removing it first would leave a moment
+        // with no products.txt for unlocked readers
+        if (rename("data/temp_products.txt", "data/products.txt") != 0) {
+            remove("data/temp_products.txt");
+            stockChanges.clear();
+            return false;
+        }
+        IoStats::add(IoStats::Products, IoStats::TempRewrites);
+        return true;
+    }
+
+    // Adds stock deltas just written to products.txt to the catalog as one version and
+    // returns the products that changed. Called with the Products lock still held, so the
+    // catalog and the file move together.
+    static vector<int> applyStock(const vector<pair<int, int> >& stockChanges) {
+        vector<int> changed;
+        ProductCatalog& catalog = ProductCatalog::getInstance();
+        ProductCatalog::WriteBatch batch(catalog);
+        for (size_t i = 0; i < stockChanges.size(); ++i) {
+            int productID = stockChanges[i].first;
+            int row = catalog.findRow(productID);
+            if (row >= 0 && catalog.setStock(productID, catalog.getStock(row) + stockChanges[i].second)) {
+                changed.push_back(productID);
+            }
+        }
+        return changed;
+    }
+
+    // Puts back the stock of jobs that failed after reserving it, then reports them with
+    // the error each one carries.
+    void restockAndFail(vector<JobPtr>& jobs) {
+        if (jobs.empty()) return;
+        vector<JobPtr> restock(jobs);
+        for (size_t i = 0; i < restock.size(); ++i) restock[i]->progress.error.clear();
+        vector<string> errors;
+        for (size_t i = 0; i < jobs.size(); ++i) errors.push_back(jobs[i]->progress.error);
+        Event event;
+        {
+            StoreLockSet locks;
+            locks.add(IoStats::Products, StoreLocks::Exclusive);
+            locks.acquire();
+            vector<pair<int, int> > stockChanges;
+            if (rewriteStock(restock, false, stockChanges)) {
+                event.stockChanged = applyStock(stockChanges);
+            } else {
+                cerr << "Error: Could not return reserved stock to products.txt for " << jobs.size() << " failed checkouts." << endl;
+            }
+        }
+        if (!event.stockChanged.empty()) eventQueue->push(event);
+        for (size_t i = 0; i < jobs.size(); ++i) fail(jobs[i], errors[i]);
+    }
+
+    // Takes the job's units of hot products (see ShardedStockCounter.h), so a sold-out
+    // product turns buyers away here instead of after the stock rewrite.
+    static void admit(const JobPtr& job) {
+        HotStockCounters& counters = HotStockCounters::getInstance();
+        for (size_t i = 0; i < job->items.size(); ++i) {
+            if (counters.tryTake(job->items[i].productID, job->items[i].quantity)) continue;
+            for (size_t taken = 0; taken < i; ++taken) counters.put(job->items[taken].productID, job->items[taken].quantity);
+            job->progress.error = "Product " + to_string(job->items[i].productID) + " is sold out";
+            return;
+        }
+        job->admitted = true;
+    }
+
+    void runValidate() {
+        vector<JobPtr> batch;
+        while (validateQueue->popBatch(batch, 1)) {
+            const JobPtr& job = batch[0];
+            notify(job, CheckoutStage::Validating);
+            {
+                StoreLockSet locks;
+                locks.addUser(IoStats::Carts, job->progress.userID);
+                locks.acquire();
+                ShoppingCart cart(job->progress.userID);
+                job->cartLines = cart.getItems();
+            }
+            map<int, int> quantities;
+            for (size_t i = 0; i < job->cartLines.size(); ++i) quantities[job->cartLines[i].first] += job->cartLines[i].second;
+            for (auto it = quantities.begin(); it != quantities.end(); ++it) {
+                if (it->second <= 0) {
+                    job->progress.error = "Invalid quantity for product " + to_string(it->first);
+                    break;
+                }
+                OrderLineItem item;
+                item.productID = it->first;
+                item.quantity = it->second;
+                item.unitPrice = 0.0;
+                job->items.push_back(item);
+            }
+            if (job->items.empty() && job->progress.error.empty()) job->progress.error = "The cart is empty";
+            if (job->progress.error.empty()) admit(job);
+            countBatch(ValidateStage, 1, job->progress.error.empty() ? 0 : 1);
+            if (!job->progress.error.empty()) fail(job, job->progress.error);
+            else reserveQueue->push(job);
+        }
+    }
+
+    void runReserve() {
+        vector<JobPtr> batch;
+        while (reserveQueue->popBatch(batch, config.maxBatch)) {
+            for (size_t i = 0; i < batch.size(); ++i) notify(batch[i], CheckoutStage::Reserving);
+            Event event;
+            bool written;
+            {
+                StoreLockSet locks;
+                locks.add(IoStats::Products, StoreLocks::Exclusive);
+                locks.acquire();
+                vector<pair<int, int> > stockChanges;
+                written = rewriteStock(batch, true, stockChanges);
+                if (written) event.stockChanged = applyStock(stockChanges);
+            }
+            if (!event.stockChanged.empty()) eventQueue->push(event);
+            size_t failures = 0;
+            for (size_t i = 0; i < batch.size(); ++i) {
+                if (!written) batch[i]->progress.error = "Could not update stock in products.txt";
+                if (!batch[i]->progress.error.empty()) {
+                    failures++;
+                    fail(batch[i], batch[i]->progress.error);
+                } else {
+                    // The user's holds are now part of the order
+                    for (size_t p = 0; p < batch[i]->items.size(); ++p) {
+                        StockReservations::getInstance().release(batch[i]->progress.userID, batch[i]->items[p].productID);
+                    }
+                    batch[i]->progress.items = batch[i]->items;
+                    authorizeQueue->push(batch[i]);
+                }
+            }
+            countBatch(ReserveStage, batch.size(), failures);
+        }
+    }
+
+    void runAuthorize() {
+        vector<JobPtr> batch;
+        while (authorizeQueue->popBatch(batch, config.maxBatch)) {
+            for (size_t i = 0; i < batch.size(); ++i) notify(batch[i], CheckoutStage::Authorizing);
+            vector<Payment> payments;
+            vector<JobPtr> declined;
+            vector<JobPtr> authorized;
+            {
+                StoreLockSet locks;
+                locks.add(IoStats::Orders, StoreLocks::Exclusive);
+                locks.add(IoStats::Payments, StoreLocks::Exclusive);
+                locks.acquire();
+                // Never reuse an ID, even if something else appended orders meanwhile
+                int storedMax = OrderSegmentStore::getInstance().maxOrderID();
+                nextOrderID = max(nextOrderID, storedMax == 0 ? 1001 : storedMax + 1);
+                for (size_t i = 0; i < batch.size(); ++i) {
+                    Job& job = *batch[i];
+                    if (job.progress.total <= 0.0 || job.method.empty()) {
+                        job.progress.error = "Payment declined: invalid amount or payment method";
+                        declined.push_back(batch[i]);
+                        continue;
+                    }
+                    job.progress.orderID = nextOrderID++;
+                    job.timestamp = static_cast<long long>(time(nullptr));
+                    payments.push_back(Payment(0, job.progress.orderID, job.progress.userID, job.progress.total,
+                                               job.method.c_str(), "Pending"));
+                    authorized.push_back(batch[i]);
+                }
+                if (!Payment::recordPayments(payments)) {
+                    for (size_t i = 0; i < authorized.size(); ++i) {
+                        authorized[i]->progress.error = "The payment could not be recorded";
+                        declined.push_back(authorized[i]);
+                    }
+                    authorized.clear();
+                }
+            }
+            for (size_t i = 0; i < authorized.size(); ++i) persistQueue->push(authorized[i]);
+            countBatch(AuthorizeStage, batch.size(), declined.size());
+            restockAndFail(declined);
+        }
+    }
+
+    void runPersist() {
+        vector<JobPtr> batch;
+        while (persistQueue->popBatch(batch, config.maxBatch)) {
+            for (size_t i = 0; i < batch.size(); ++i) notify(batch[i], CheckoutStage::Persisting);
+            vector<OrderRecord> records;
+            for (size_t i = 0; i < batch.size(); ++i) {
+                OrderRecord record;
+                record.orderID = batch[i]->progress.orderID;
+                record.userID = batch[i]->progress.userID;
+                record.items = Order::formatLineItems(batch[i]->items);
+                record.timestamp = batch[i]->timestamp;
+                record.status = "Complete";
+                record.total = batch[i]->progress.total;
+                records.push_back(record);
+            }
+            vector<IdempotencyIndex::Completion> completions;
+            for (size_t i = 0; i < batch.size(); ++i) {
+                if (!batch[i]->ownsKey) continue;
+                IdempotencyIndex::Completion completion;
+                completion.userID = batch[i]->progress.userID;
+                completion.key = batch[i]->idempotencyKey;
+                completion.orderID = batch[i]->progress.orderID;
+                completion.total = batch[i]->progress.total;
+                completions.push_back(completion);
+            }
+            bool saved;
+            {
+                StoreLockSet locks;
+                locks.add(IoStats::Orders, StoreLocks::Exclusive);
+                locks.acquire();
+                // Keys are logged before their orders, as in Order::placeOrder
+                if (!IdempotencyIndex::getInstance().complete(completions)) {
+                    cerr << "Warning: Could not log the idempotency keys of " << completions.size() << " checkouts." << endl;
+                    completions.clear();
+                }
+                saved = OrderSegmentStore::getInstance().appendBatch(records);
+                if (saved) {
+                    for (size_t i = 0; i < records.size(); ++i) OrderStore::getInstance().appendOrder(records[i]);
+                } else {
+                    IdempotencyIndex::getInstance().withdraw(completions);
+                }
+            }
+            countBatch(PersistStage, batch.size(), saved ? 0 : batch.size());
+            if (!saved) {
+                for (size_t i = 0; i < batch.size(); ++i) {
+                    batch[i]->progress.error = "The order could not be saved; its payment was recorded and needs a refund";
+                }
+                restockAndFail(batch);
+                continue;
+            }
+            for (size_t i = 0; i < batch.size(); ++i) {
+                Event event;
+                event.orderID = records[i].orderID;
+                eventQueue->push(event);
+                releaseQueue->push(batch[i]);
+            }
+        }
+    }
+
+    void runRelease() {
+        vector<JobPtr> batch;
+        while (releaseQueue->popBatch(batch, 1)) {
+            const JobPtr& job = batch[0];
+            notify(job, CheckoutStage::ReleasingCart);
+            bool cleared;
+            {
+                StoreLockSet locks;
+                locks.addUser(IoStats::Carts, job->progress.userID);
+                locks.acquire();
+                ShoppingCart cart(job->progress.userID);
+                if (cart.getItems() == job->cartLines) {
+                    cleared = cart.clearCart();
+                } else {
+                    // Changed since checkout began: drop only what was ordered
+                    cleared = true;
+                    for (size_t i = 0; i < job->items.size(); ++i) cart.removeFromCart(job->items[i].productID);
+                }
+            }
+            if (!cleared) {
+                cerr << "Warning: Order placed (ID: " << job->progress.orderID << ") but failed to clear the shopping cart." << endl;
+            }
+            countBatch(ReleaseStage, 1, cleared ? 0 : 1);
+            Event event;
+            event.finished = job;
+            eventQueue->push(event);
+        }
+    }
+
+    void applyEvents(const vector<Event>& events) {
+        TRACE_SCOPE("checkout", "CheckoutPipeline::applyEvents");
+        ChangeFeed& feed = ChangeFeed::getInstance();
+        for (size_t i = 0; i < events.size(); ++i) {
+            const Event& event = events[i];
+            for (size_t s = 0; s < event.stockChanged.size(); ++s) {
+                feed.publish(EntityType::Product, ChangeKind::Updated, event.stockChanged[s], ProductField::Stock);
+            }
+            if (event.orderID > 0) {
+                feed.publish(EntityType::Order, ChangeKind::Inserted, event.orderID, OrderField::All);
+            }
+            if (event.finished) {
+                const JobPtr& job = event.finished;
+                vector<Listener> duplicates;
+                if (job->ownsKey) duplicates = releaseKey(job);
+                notify(job, job->progress.error.empty() ? CheckoutStage::Completed : CheckoutStage::Failed);
+                if (job->onFinished) job->onFinished(job->progress);
+                for (size_t d = 0; d < duplicates.size(); ++d) duplicates[d](job->progress);
+            }
+        }
+    }
+
+    void runEvents() {
+        vector<Event> batch;
+        while (eventQueue->popBatch(batch, config.maxBatch * 4)) {
+            size_t finished = 0, failures = 0;
+            for (size_t i = 0; i < batch.size(); ++i) {
+                if (!batch[i].finished) continue;
+                finished++;
+                if (!batch[i].finished->progress.error.empty()) failures++;
+            }
+            // A batch of stock and order notifications alone finishes no job
+            if (finished > 0) countBatch(EventStage, finished, failures);
+            Dispatcher dispatch;
+            {
+                lock_guard<mutex> guard(stateLock);
+                dispatch = dispatcher;
+            }
+            if (dispatch) {
+                shared_ptr<vector<Event> > events = make_shared<vector<Event> >(batch);
+                dispatch([this, events]() { applyEvents(*events); });
+            } else {
+                applyEvents(batch);
+            }
+        }
+    }
+
+    // Keeps stop() from deleting the queues while a submit may still push to them.
+    struct Submission {
+        CheckoutPipeline& pipeline;
+
+        explicit Submission(CheckoutPipeline& owner) : pipeline(owner) {}
+        ~Submission() {
+            lock_guard<mutex> guard(pipeline.stateLock);
+            if (--pipeline.submitting == 0) pipeline.submitsDone.notify_all();
+        }
+    };
+
+    static string pendingKey(int userID, const string& key) {
+        return to_string(userID) + ":" + key;
+    }
+
+    // Ends a finished job's hold on its key and returns the repeats waiting on it. A
+    // completed job's key was logged by the persist stage, so the release only matters
+    // for failures, which leave the key free for another attempt.
+    vector<Listener> releaseKey(const JobPtr& job) {
+        IdempotencyIndex::getInstance().release(job->progress.userID, job->idempotencyKey);
+        lock_guard<mutex> guard(stateLock);
+        pendingKeys.erase(pendingKey(job->progress.userID, job->idempotencyKey));
+        return job->duplicates;
+    }
+
+    long long enqueue(int userID, const string& method, const string& idempotencyKey, Listener onFinished, bool wait) {
+        JobPtr job = make_shared<Job>();
+        job->progress.ticket = nextTicket.fetch_add(1);
+        job->progress.userID = userID;
+        job->method = method;
+        job->timestamp = 0;
+        job->onFinished = onFinished;
+        job->idempotencyKey = idempotencyKey;
+        job->ownsKey = false;
+        job->admitted = false;
+        IdempotencyIndex::State keyState = IdempotencyIndex::Unknown;
+        IdempotencyIndex::Entry existing;
+        {
+            lock_guard<mutex> guard(stateLock);
+            if (!running) return 0;
+            if (!idempotencyKey.empty()) {
+                auto pending = pendingKeys.find(pendingKey(userID, idempotencyKey));
+                if (pending != pendingKeys.end()) {
+                    if (onFinished) pending->second->duplicates.push_back(onFinished);
+                    return pending->second->progress.ticket;
+                }
+                keyState = IdempotencyIndex::getInstance().claim(userID, idempotencyKey, existing);
+                if (keyState == IdempotencyIndex::Unknown) {
+                    job->ownsKey = true;
+                    pendingKeys[pendingKey(userID, idempotencyKey)] = job;
+                }
+            }
+            submitting++;
+        }
+        Submission submission(*this);
+
+        if (keyState != IdempotencyIndex::Unknown) {
+            // Answered from the index; the outcome still arrives through the events stage
+            if (keyState == IdempotencyIndex::Completed) {
+                job->progress.orderID = existing.orderID;
+                job->progress.total = existing.total;
+            } else if (keyState == IdempotencyIndex::InFlight) {
+                job->progress.error = "This checkout is already being processed";
+            } else {
+                job->progress.error = "Invalid idempotency key";
+            }
+            Event event;
+            event.finished = job;
+            bool answered = wait ? eventQueue->push(event) : eventQueue->tryPush(event);
+            return answered ? job->progress.ticket : 0;
+        }
+
+        // Once queued, the job belongs to the validate stage; announce a copy taken before
+        CheckoutProgress queuedProgress = job->progress;
+        queuedProgress.stage = CheckoutStage::Queued;
+        bool queued = wait ? validateQueue->push(job) : validateQueue->tryPush(job);
+        if (!queued) {
+            if (job->ownsKey) {
+                // Repeats may have attached meanwhile; tell them, but not the caller
+                job->onFinished = Listener();
+                job->progress.error = "The checkout queue is full";
+                Event event;
+                event.finished = job;
+                if (!eventQueue->push(event)) releaseKey(job);
+            }
+            return 0;
+        }
+        publish(queuedProgress);
+        return queuedProgress.ticket;
+    }
+
+    template <typename T>
+    void drain(BoundedQueue<T>* queue, vector<thread>& threads) {
+        queue->close();
+        for (size_t i = 0; i < threads.size(); ++i) threads[i].join();
+        threads.clear();
+    }
+
+public:
+    CheckoutPipeline(const CheckoutPipeline&) = delete;
+    CheckoutPipeline& operator=(const CheckoutPipeline&) = delete;
+
+    static CheckoutPipeline& getInstance() {
+        static CheckoutPipeline instance;
+        return instance;
+    }
+
+    ~CheckoutPipeline() {
+        stop();
+    }
+
+    // Starts the stage threads; false if already running.
+    bool start(const CheckoutPipelineConfig& settings = CheckoutPipelineConfig()) {
+        {
+            lock_guard<mutex> guard(stateLock);
+            if (running) return false;
+            running = true;
+            for (int i = 0; i < StageCount; ++i) stats[i] = StageStats();
+            pendingKeys.clear();
+        }
+        {
+            // Read the key log now rather than inside the first keyed submit
+            StoreLockSet locks;
+            locks.add(IoStats::Orders, StoreLocks::Exclusive);
+            locks.acquire();
+            IdempotencyIndex::getInstance().ensureLoaded();
+        }
+        config = settings;
+        if (config.cartWorkers < 1) config.cartWorkers = 1;
+        if (config.maxBatch < 1) config.maxBatch = 1;
+        validateQueue = new BoundedQueue<JobPtr>(config.queueCapacity);
+        reserveQueue = new BoundedQueue<JobPtr>(config.queueCapacity);
+        authorizeQueue = new BoundedQueue<JobPtr>(config.queueCapacity);
+        persistQueue = new BoundedQueue<JobPtr>(config.queueCapacity);
+        releaseQueue = new BoundedQueue<JobPtr>(config.queueCapacity);
+        // Every job can produce up to three events; keep the last stage from throttling the rest
+        eventQueue = new BoundedQueue<Event>(config.queueCapacity * 4);
+        for (int i = 0; i < config.cartWorkers; ++i) {
+            stageThreads[ValidateStage].push_back(thread(&CheckoutPipeline::runValidate, this));
+            stageThreads[ReleaseStage].push_back(thread(&CheckoutPipeline::runRelease, this));
+        }
+        stageThreads[ReserveStage].push_back(thread(&CheckoutPipeline::runReserve, this));
+        stageThreads[AuthorizeStage].push_back(thread(&CheckoutPipeline::runAuthorize, this));
+        stageThreads[PersistStage].push_back(thread(&CheckoutPipeline::runPersist, this));
+        stageThreads[EventStage].push_back(thread(&CheckoutPipeline::runEvents, this));
+        return true;
+    }
+
+    // Stops taking checkouts, finishes the ones already submitted and joins the stage
+    // threads. Events already handed to a dispatcher are applied whenever it runs them.
+    void stop() {
+        {
+            unique_lock<mutex> guard(stateLock);
+            if (!running) return;
+            running = false;
+            // Submits that passed the running check still push; the stages keep popping
+            submitsDone.wait(guard, [this]() { return submitting == 0; });
+        }
+        drain(validateQueue, stageThreads[ValidateStage]);
+        drain(reserveQueue, stageThreads[ReserveStage]);
+        drain(authorizeQueue, stageThreads[AuthorizeStage]);
+        drain(persistQueue, stageThreads[PersistStage]);
+        drain(releaseQueue, stageThreads[ReleaseStage]);
+        drain(eventQueue, stageThreads[EventStage]);
+        delete validateQueue; validateQueue = nullptr;
+        delete reserveQueue; reserveQueue = nullptr;
+        delete authorizeQueue; authorizeQueue = nullptr;
+        delete persistQueue; persistQueue = nullptr;
+        delete releaseQueue; releaseQueue = nullptr;
+        delete eventQueue; eventQueue = nullptr;
+    }
+
+    bool isRunning() {
+        lock_guard<mutex> guard(stateLock);
+        return running;
+    }
+
+    // Runs each batch of change notifications and completions; set it before start().
+    void setDispatcher(Dispatcher runner) {
+        lock_guard<mutex> guard(stateLock);
+        dispatcher = runner;
+    }
+
+    // Returns a token for unsubscribe(). Listeners run on the pipeline's threads.
+    int subscribe(Listener listener) {
+        return listeners.subscribe(listener);
+    }
+
+    // Waits for calls of the listener still running on the pipeline's threads, so a dialog
+    // can unsubscribe in its destructor.
+    void unsubscribe(int token) {
+        listeners.unsubscribe(token);
+    }
+
+    // Queues a checkout of the user's current cart, waiting while the first stage is
+    // full. onFinished runs once, through the dispatcher, when the checkout has completed
+    // or failed. Returns the ticket, or 0 if the pipeline is not running. With an
+    // idempotency key, a repeat of a checkout still in the pipeline gets that checkout's
+    // ticket and outcome, and a repeat of a completed one gets its order back.
+    long long submit(int userID, const string& paymentMethod, Listener onFinished = Listener(),
+                     const string& idempotencyKey = string()) {
+        return enqueue(userID, paymentMethod, idempotencyKey, onFinished, true);
+    }
+
+    // As submit(), but returns 0 at once if the first stage is full.
+    long long trySubmit(int userID, const string& paymentMethod, Listener onFinished = Listener(),
+                        const string& idempotencyKey = string()) {
+        return enqueue(userID, paymentMethod, idempotencyKey, onFinished, false);
+    }
+
+    // Submits and waits for the outcome. Must not be called from the thread the
+    // dispatcher runs completions on.
+    CheckoutProgress checkout(int userID, const string& paymentMethod, const string& idempotencyKey = string()) {
+        shared_ptr<promise<CheckoutProgress> > outcome = make_shared<promise<CheckoutProgress> >();
+        future<CheckoutProgress> result = outcome->get_future();
+        long long ticket = submit(userID, paymentMethod, [outcome](const CheckoutProgress& progress) {
+            outcome->set_value(progress);
+        }, idempotencyKey);
+        if (ticket == 0) {
+            CheckoutProgress rejected;
+            rejected.userID = userID;
+            rejected.stage = CheckoutStage::Failed;
+            rejected.error = "The checkout pipeline is not running";
+            return rejected;
+        }
+        return result.get();
+    }
+
+    // Jobs, batches and failures per stage since start(): validate, reserve, authorize,
+    // persist, release cart, events.
+    vector<StageStats> stageStats() {
+        lock_guard<mutex> guard(stateLock);
+        return vector<StageStats>(stats, stats + StageCount);
+    }
+
+    static const char* stageStatsName(size_t index) {
+        static const char* names[] = {"validate", "reserve", "authorize", "persist", "release cart", "events"};
+        return index < sizeof(names) / sizeof(names[0]) ? names[index] : "";
+    }
+};
@@ -0,0 +1,609 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <cstdint>
+#include <cerrno>
+#include <iomanip>
+#include <cmath>
+#include <ctime>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+
+#include "User.h"
+#include "OrderSegments.h"
+
+using namespace std;
+
+// Sizes and knobs for one generated data set.
+struct GeneratorConfig {
+    int products;
+    int users;
+    long long orders;
+    long long reviews;
+    int carts;
+    int wishlists;
+    unsigned long long seed;
+    int threads;
+    double zipfExponent;         // Skew of product and buyer popularity; 0 is uniform
+    OrderPartition partition;
+    long long startTime;         // Orders are spread evenly over [startTime, endTime]
+    long long endTime;
+
+    GeneratorConfig() : products(1000), users(200), orders(5000), reviews(2000), carts(50), wishlists(50),
+                        seed(42), threads(static_cast<int>(thread::hardware_concurrency())), zipfExponent(1.0),
+                        partition(OrderPartition::Monthly) {
+        if (threads < 1) threads = 1;
+        // Whole days, so reruns on the same day produce identical files
+        endTime = static_cast<long long>(time(nullptr));
+        endTime -= endTime % (24 * 3600);
+        startTime = endTime - 2LL * 365 * 24 * 3600;
+    }
+};
+
+// splitmix64; small, fast and good enough for test data.
+class GeneratorRandom {
+private:
+    uint64_t state;
+
+public:
+    explicit GeneratorRandom(uint64_t seed) : state(seed) {}
+
+    static uint64_t mix(uint64_t value) {
+        value += 0x9E3779B97F4A7C15ULL;
+        value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+        return value ^ (value >> 31);
+    }
+
+    // Seed for one (stream, index) pair, so every chunk and every entity has its own sequence.
+    static uint64_t derive(uint64_t seed, uint64_t stream, uint64_t index) {
+        return mix(mix(seed ^ (stream * 0xD1B54A32D192ED03ULL)) + index);
+    }
+
+    uint64_t next() {
+        state += 0x9E3779B97F4A7C15ULL;
+        uint64_t value = state;
+        value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+        return value ^ (value >> 31);
+    }
+
+    double uniform() { return static_cast<double>(next() >> 11) * (1.0 / 9007199254740992.0); }
+
+    long long below(long long bound) { return static_cast<long long>(next() % static_cast<uint64_t>(bound)); }
+};
+
+// Zipf(n, s) sampler using rejection-inversion (Hormann & Derflinger), so it needs no
+// table and works for millions of elements. Returns ranks 1..n, rank 1 the most popular.
+class ZipfSampler {
+private:
+    long long count;
+    double exponent;
+    double hIntegralX1;
+    double hIntegralCount;
+    double threshold;
+
+    static double helper1(double x) {
+        return fabs(x) > 1e-8 ? log1p(x) / x : 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+    }
+    static double helper2(double x) {
+        return fabs(x) > 1e-8 ? expm1(x) / x : 1.0 + x * 0.5 * (1.0 + x / 3.0 * (1.0 + 0.25 * x));
+    }
+    double h(double x) const { return exp(-exponent * log(x)); }
+    double hIntegral(double x) const {
+        double logX = log(x);
+        return helper2((1.0 - exponent) * logX) * logX;
+    }
+    double hIntegralInverse(double x) const {
+        double t = x * (1.0 - exponent);
+        if (t < -1.0) t = -1.0;
+        return exp(helper1(t) * x);
+    }
+
+public:
+    ZipfSampler(long long n, double s) : count(n < 1 ? 1 : n), exponent(s < 0.0 ? 0.0 : s) {
+        hIntegralX1 = hIntegral(1.5) - 1.0;
+        hIntegralCount = hIntegral(static_cast<double>(count) + 0.5);
+        threshold = 2.0 - hIntegralInverse(hIntegral(2.5) - h(2.0));
+    }
+
+    long long sample(GeneratorRandom& random) const {
+        while (true) {
+            double u = hIntegralCount + random.uniform() * (hIntegralX1 - hIntegralCount);
+            double x = hIntegralInverse(u);
+            long long k = static_cast<long long>(x + 0.5);
+            if (k < 1) k = 1;
+            else if (k > count) k = count;
+            if (k - x <= threshold || u >= hIntegral(k + 0.5) - h(static_cast<double>(k))) {
+                return k;
+            }
+        }
+    }
+};
+
+// Writes a referentially valid data set under data/ in the formats the storage headers
+// parse: products.txt, users.txt, payments.txt, reviews/reviews.txt, cart/cart_<id>.txt,
+// wishlist/wishlist_<id>.txt, and orders straight into the order segments.
+//
+// Output depends only on the config, never on the thread count: work is cut into fixed
+// chunks, each chunk draws from its own seeded stream, and chunks are written in order.
+// Per-product attributes (name, category, price, stock) are a pure function of the seed
+// and product ID, so order line items carry exactly the price products.txt lists.
+class DataGenerator {
+public:
+    static constexpr int FirstProductID = 101;
+    static constexpr int FirstOrderID = 1001;
+    static constexpr int FirstPaymentID = 5001;
+    static constexpr long long ChunkSize = 65536;
+
+private:
+    enum Stream : uint64_t {
+        ProductStream = 1,
+        OrderStream,
+        ReviewStream,
+        CartStream,
+        WishlistStream,
+        PopularityStream
+    };
+
+    struct CategoryInfo {
+        const char* name;
+        const char* nouns[6];
+        int minCents;
+        int maxCents;
+    };
+
+    static const CategoryInfo& category(int index) {
+        static const CategoryInfo categories[] = {
+            {"Electronics", {"Laptop", "Phone", "Headphones", "Monitor", "Tablet", "Speaker"}, 1999, 249999},
+            {"Books", {"Novel", "Cookbook", "Guide", "Biography", "Anthology", "Textbook"}, 499, 8999},
+            {"Appliances", {"Blender", "Toaster", "Kettle", "Microwave", "Air Fryer", "Coffee Maker"}, 1999, 59999},
+            {"Home", {"Lamp", "Rug", "Cushion", "Clock", "Mirror", "Shelf"}, 999, 29999},
+            {"Wearables", {"Fitness Tracker", "Smartwatch", "Ring", "Band", "Clip", "Monitor"}, 2999, 79999},
+            {"Clothing", {"Jacket", "Shirt", "Sneakers", "Hoodie", "Jeans", "Scarf"}, 999, 19999},
+            {"Sports", {"Yoga Mat", "Racket", "Football", "Dumbbell", "Helmet", "Bottle"}, 799, 39999},
+            {"Toys", {"Puzzle", "Robot", "Doll", "Blocks", "Kite", "Board Game"}, 599, 14999}
+        };
+        return categories[index];
+    }
+    static constexpr int CategoryCount = 8;
+
+    static const char* adjective(uint64_t hash) {
+        static const char* adjectives[] = {"Classic", "Compact", "Deluxe", "Eco", "Essential", "Nova", "Prime",
+                                           "Pro", "Smart", "Ultra", "Vintage", "Zen"};
+        return adjectives[hash % 12];
+    }
+
+    GeneratorConfig config;
+    vector<atomic<int>> ratingSums;   // Per product, filled while generating reviews
+    vector<atomic<int>> ratingCounts;
+    uint64_t productStride;           // Maps popularity rank to product slot (coprime to products)
+    uint64_t productOffset;
+    uint64_t userStride;
+
+    static uint64_t coprimeStride(uint64_t n, uint64_t seed) {
+        if (n <= 1) return 1;
+        uint64_t stride = (seed % n) | 1;
+        while (gcd(stride, n) != 1) stride += 2;
+        return stride % n == 0 ? 1 : stride;
+    }
+    static uint64_t gcd(uint64_t a, uint64_t b) {
+        while (b != 0) { uint64_t t = a % b; a = b; b = t; }
+        return a;
+    }
+
+    uint64_t productHash(int productID, uint64_t salt) const {
+        return GeneratorRandom::derive(config.seed, ProductStream + (salt << 8), static_cast<uint64_t>(productID));
+    }
+
+    // Popular products and heavy buyers are scattered across the ID range rather than
+    // clustered at the front, so sorted scans don't see them all at once.
+    int productForRank(long long rank) const {
+        uint64_t slot = (static_cast<uint64_t>(rank - 1) * productStride + productOffset) %
+                        static_cast<uint64_t>(config.products);
+        return FirstProductID + static_cast<int>(slot);
+    }
+    int userForRank(long long rank) const {
+        return 1 + static_cast<int>((static_cast<uint64_t>(rank - 1) * userStride) % static_cast<uint64_t>(config.users));
+    }
+
+    // Deletes the regular files directly inside a directory; the directory itself stays.
+    static void clearDirectory(const string& path) {
+        DIR* dir = opendir(path.c_str());
+        if (!dir) return;
+        while (struct dirent* entry = readdir(dir)) {
+            string file = path + "/" + entry->d_name;
+            struct stat info;
+            if (stat(file.c_str(), &info) == 0 && S_ISREG(info.st_mode)) {
+                unlink(file.c_str());
+            }
+        }
+        closedir(dir);
+    }
+
+    static bool makeDirectory(const string& path) {
+        return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+    }
+
+    static void appendCents(string& out, long long cents) {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%lld.%02lld", cents / 100, cents % 100);
+        out += buffer;
+    }
+
+    // Runs chunkCount chunks on up to config.threads workers, then hands each finished
+    // chunk to the writer in chunk order. A round holds at most `threads` chunks in memory.
+    template <typename Chunk>
+    bool runChunks(long long chunkCount, const function<void(long long, Chunk&)>& build,
+                   const function<bool(long long, Chunk&)>& write) {
+        long long workers = max(1, config.threads);
+        for (long long first = 0; first < chunkCount; first += workers) {
+            long long inRound = min(workers, chunkCount - first);
+            vector<Chunk> chunks(static_cast<size_t>(inRound));
+            vector<thread> pool;
+            for (long long i = 1; i < inRound; ++i) {
+                pool.emplace_back([&build, &chunks, first, i]() { build(first + i, chunks[i]); });
+            }
+            build(first, chunks[0]);
+            for (size_t i = 0; i < pool.size(); ++i) pool[i].join();
+            for (long long i = 0; i < inRound; ++i) {
+                if (!write(first + i, chunks[i])) return false;
+            }
+        }
+        return true;
+    }
+
+    static bool writeAll(ofstream& out, const string& text) {
+        out.write(text.data(), static_cast<streamsize>(text.size()));
+        return static_cast<bool>(out);
+    }
+
+    void report(const char* what, long long count, chrono::steady_clock::time_point started) const {
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+        cout << "Generated " << count << " " << what << " in " << fixed << setprecision(2) << seconds << " s" << endl;
+    }
+
+public:
+    explicit DataGenerator(const GeneratorConfig& cfg)
+        : config(cfg), ratingSums(cfg.products > 0 ? cfg.products : 0),
+          ratingCounts(cfg.products > 0 ? cfg.products : 0) {
+        productStride = coprimeStride(static_cast<uint64_t>(max(config.products, 1)),
+                                      GeneratorRandom::derive(config.seed, PopularityStream, 0));
+        productOffset = GeneratorRandom::derive(config.seed, PopularityStream, 2) % static_cast<uint64_t>(max(config.products, 1));
+        userStride = coprimeStride(static_cast<uint64_t>(max(config.users, 1)),
+                                   GeneratorRandom::derive(config.seed, PopularityStream, 1));
+    }
+
+    // Named presets shared by datagen and bench; leaves the config alone for an unknown name.
+    static bool applyScale(const string& name, GeneratorConfig& config) {
+        if (name == "small") {
+            config.products = 1000; config.users = 200; config.orders = 5000; config.reviews = 2000;
+            config.carts = 50; config.wishlists = 50;
+        } else if (name == "medium") {
+            config.products = 100000; config.users = 20000; config.orders = 500000; config.reviews = 200000;
+            config.carts = 1000; config.wishlists = 1000;
+        } else if (name == "large") {
+            config.products = 1000000; config.users = 400000; config.orders = 10000000; config.reviews = 4000000;
+            config.carts = 5000; config.wishlists = 5000;
+        } else if (name == "production") {
+            config.products = 5000000; config.users = 2000000; config.orders = 50000000; config.reviews = 20000000;
+            config.carts = 20000; config.wishlists = 20000;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    // --- Per-product attributes; pure functions of (seed, productID) ---
+
+    int categoryOf(int productID) const { return static_cast<int>(productHash(productID, 1) % CategoryCount); }
+
+    long long priceCentsOf(int productID) const {
+        const CategoryInfo& info = category(categoryOf(productID));
+        double u = static_cast<double>(productHash(productID, 2) >> 11) * (1.0 / 9007199254740992.0);
+        // Skewed toward the cheap end of the category, and ending in .99 like real listings
+        long long cents = info.minCents + static_cast<long long>((info.maxCents - info.minCents) * u * u);
+        return (cents / 100) * 100 + 99;
+    }
+
+    int stockOf(int productID) const {
+        uint64_t hash = productHash(productID, 3);
+        return (hash % 20 == 0) ? 0 : static_cast<int>((hash >> 8) % 200) + 1;
+    }
+
+    // Mean review score a product tends toward, 2.5 to 5.0.
+    double qualityOf(int productID) const {
+        return 2.5 + 2.5 * static_cast<double>(productHash(productID, 4) % 1000) / 999.0;
+    }
+
+    string nameOf(int productID) const {
+        const CategoryInfo& info = category(categoryOf(productID));
+        uint64_t hash = productHash(productID, 5);
+        return string(adjective(hash)) + " " + info.nouns[(hash >> 8) % 6] + " " + to_string(productID);
+    }
+
+    // --- Files ---
+
+    bool generateUsers() {
+        auto started = chrono::steady_clock::now();
+        ofstream out("data/users.txt", ios::binary | ios::trunc);
+        if (!out) {
+            cerr << "Error: Could not open data/users.txt for writing." << endl;
+            return false;
+        }
+        long long chunkCount = (config.users + ChunkSize - 1) / ChunkSize;
+        bool ok = runChunks<string>(chunkCount,
+            [this](long long chunk, string& text) {
+                int first = static_cast<int>(chunk * ChunkSize) + 1;
+                int last = static_cast<int>(min<long long>(config.users, (chunk + 1) * ChunkSize));
+                text.reserve(static_cast<size_t>(last - first + 1) * 48);
+                for (int id = first; id <= last; ++id) {
+                    string username = (id == 1) ? "admin" : "user" + to_string(id);
+                    string password = "pass" + to_string(id);
+                    char* hashed = User::hashPassword(password.c_str());
+                    text += to_string(id) + "," + username + "," + hashed + "," + username + "@example.com," +
+                            (id == 1 ? "1" : "0") + "\n";
+                    delete[] hashed;
+                }
+            },
+            [&out](long long, string& text) { return writeAll(out, text); });
+        out.close();
+        if (ok) report("users", config.users, started);
+        return ok && static_cast<bool>(out);
+    }
+
+    // Each user reviews distinct products, picked by popularity. Ratings accumulate per
+    // product so products.txt can carry the averages Review::updateProductRating would.
+    bool generateReviews() {
+        auto started = chrono::steady_clock::now();
+        makeDirectory("data/reviews");
+        ofstream out("data/reviews/reviews.txt", ios::binary | ios::trunc);
+        if (!out) {
+            cerr << "Error: Could not open data/reviews/reviews.txt for writing." << endl;
+            return false;
+        }
+        static const char* comments[] = {"Great value", "Works as described", "Would buy again",
+                                         "Not what I expected", "Arrived quickly", "Decent quality for the price",
+                                         "Stopped working after a month", "Exactly what I needed"};
+        long long perUser = config.users > 0 ? config.reviews / config.users : 0;
+        long long extra = config.users > 0 ? config.reviews % config.users : 0;
+        ZipfSampler popularity(config.products, config.zipfExponent);
+
+        long long chunkCount = (config.users + ChunkSize - 1) / ChunkSize;
+        bool ok = runChunks<string>(chunkCount,
+            [&](long long chunk, string& text) {
+                GeneratorRandom random(GeneratorRandom::derive(config.seed, ReviewStream, static_cast<uint64_t>(chunk)));
+                int first = static_cast<int>(chunk * ChunkSize) + 1;
+                int last = static_cast<int>(min<long long>(config.users, (chunk + 1) * ChunkSize));
+                vector<int> picked;
+                for (int userID = first; userID <= last; ++userID) {
+                    long long wanted = perUser + (userID <= extra ? 1 : 0);
+                    wanted = min<long long>(wanted, config.products);
+                    picked.clear();
+                    for (long long attempt = 0; static_cast<long long>(picked.size()) < wanted; ++attempt) {
+                        int productID = (attempt < 8 * wanted)
+                                            ? productForRank(popularity.sample(random))
+                                            : FirstProductID + static_cast<int>(random.below(config.products));
+                        if (find(picked.begin(), picked.end(), productID) != picked.end()) continue;
+                        picked.push_back(productID);
+
+                        int rating = static_cast<int>(lround(qualityOf(productID) + (random.uniform() - 0.5) * 2.0));
+                        rating = max(1, min(5, rating));
+                        ratingSums[productID - FirstProductID].fetch_add(rating, memory_order_relaxed);
+                        ratingCounts[productID - FirstProductID].fetch_add(1, memory_order_relaxed);
+                        text += to_string(productID) + "," + to_string(userID) + "," + to_string(rating) + "," +
+                                comments[random.below(8)] + "\n";
+                    }
+                }
+            },
+            [&out](long long, string& text) { return writeAll(out, text); });
+        out.close();
+        if (ok) report("reviews", config.reviews, started);
+        return ok && static_cast<bool>(out);
+    }
+
+    // Written after the reviews so the rating column is the average of what was generated.
+    bool generateProducts() {
+        auto started = chrono::steady_clock::now();
+        ofstream out("data/products.txt", ios::binary | ios::trunc);
+        if (!out) {
+            cerr << "Error: Could not open data/products.txt for writing." << endl;
+            return false;
+        }
+        long long chunkCount = (config.products + ChunkSize - 1) / ChunkSize;
+        bool ok = runChunks<string>(chunkCount,
+            [this](long long chunk, string& text) {
+                int first = FirstProductID + static_cast<int>(chunk * ChunkSize);
+                int last = FirstProductID + static_cast<int>(min<long long>(config.products, (chunk + 1) * ChunkSize)) - 1;
+                text.reserve(static_cast<size_t>(last - first + 1) * 56);
+                char rating[16];
+                for (int id = first; id <= last; ++id) {
+                    int count = ratingCounts[id - FirstProductID].load(memory_order_relaxed);
+                    double average = count > 0
+                                         ? static_cast<double>(ratingSums[id - FirstProductID].load(memory_order_relaxed)) / count
+                                         : 0.0;
+                    snprintf(rating, sizeof(rating), "%.1f", average);
+                    text += to_string(id) + "," + nameOf(id) + "," + category(categoryOf(id)).name + ",";
+                    appendCents(text, priceCentsOf(id));
+                    text += string(",") + rating + "," + to_string(stockOf(id)) + "\n";
+                }
+            },
+            [&out](long long, string& text) { return writeAll(out, text); });
+        out.close();
+        if (ok) report("products", config.products, started);
+        return ok && static_cast<bool>(out);
+    }
+
+    // Orders go straight into the order segments in time order, one appendBatch per chunk,
+    // with a completed payment logged for each one.
+    bool generateOrders() {
+        auto started = chrono::steady_clock::now();
+        if (config.orders <= 0) return true;
+        OrderSegmentStore& segments = OrderSegmentStore::getInstance();
+        segments.setPartition(config.partition);
+        if (!segments.open()) {
+            cerr << "Error: Could not open the order segments." << endl;
+            return false;
+        }
+        ofstream payments("data/payments.txt", ios::binary | ios::trunc);
+        if (!payments) {
+            cerr << "Error: Could not open data/payments.txt for writing." << endl;
+            return false;
+        }
+        static const char* methods[] = {"VISA", "Mastercard", "JazzCash", "EasyPaisa", "PayPak"};
+        ZipfSampler productPopularity(config.products, config.zipfExponent);
+        ZipfSampler buyerActivity(config.users, config.zipfExponent * 0.5);
+        double step = static_cast<double>(max(1LL, config.endTime - config.startTime)) / config.orders;
+
+        struct OrderChunk {
+            vector<OrderRecord> records;
+            string payments;
+        };
+        long long chunkCount = (config.orders + ChunkSize - 1) / ChunkSize;
+        bool ok = runChunks<OrderChunk>(chunkCount,
+            [&](long long chunk, OrderChunk& out) {
+                GeneratorRandom random(GeneratorRandom::derive(config.seed, OrderStream, static_cast<uint64_t>(chunk)));
+                long long first = chunk * ChunkSize;
+                long long last = min(config.orders, (chunk + 1) * ChunkSize);
+                out.records.resize(static_cast<size_t>(last - first));
+                out.payments.reserve(static_cast<size_t>(last - first) * 40);
+                for (long long n = first; n < last; ++n) {
+                    OrderRecord& record = out.records[static_cast<size_t>(n - first)];
+                    record.orderID = FirstOrderID + static_cast<int>(n);
+                    record.userID = userForRank(buyerActivity.sample(random));
+                    // Evenly spaced with jitter inside the slot, so timestamps never go backwards
+                    record.timestamp = config.startTime + static_cast<long long>(step * (n + random.uniform()));
+
+                    int lines = 1;
+                    while (lines < 5 && lines < config.products && random.uniform() < 0.35) lines++;
+                    long long totalCents = 0;
+                    int picked[5];
+                    for (int i = 0; i < lines; ++i) {
+                        int productID = productForRank(productPopularity.sample(random));
+                        if (find(picked, picked + i, productID) != picked + i) { --i; continue; }
+                        picked[i] = productID;
+                        int quantity = 1 + static_cast<int>(random.below(3));
+                        long long cents = priceCentsOf(productID);
+                        if (i > 0) record.items += "|";
+                        record.items += to_string(productID) + ":" + to_string(quantity) + "@";
+                        appendCents(record.items, cents);
+                        totalCents += cents * quantity;
+                    }
+                    record.total = static_cast<double>(totalCents) / 100.0;
+
+                    long long age = config.endTime - record.timestamp;
+                    double roll = random.uniform();
+                    if (age > 30LL * 24 * 3600) record.status = roll < 0.03 ? "Cancelled" : "Delivered";
+                    else if (age > 7LL * 24 * 3600) record.status = roll < 0.5 ? "Shipped" : "Delivered";
+                    else record.status = roll < 0.6 ? "Processing" : "Complete";
+
+                    out.payments += to_string(FirstPaymentID + n) + "," + to_string(record.orderID) + "," +
+                                    to_string(record.userID) + ",";
+                    appendCents(out.payments, totalCents);
+                    out.payments += string(",") + methods[random.below(5)] + "," +
+                                    (record.status == "Cancelled" ? "Failed" : "Completed") + "\n";
+                }
+            },
+            [&](long long, OrderChunk& out) {
+                if (!segments.appendBatch(out.records)) {
+                    cerr << "Error: Could not append generated orders to the order segments." << endl;
+                    return false;
+                }
+                return writeAll(payments, out.payments);
+            });
+        payments.close();
+        if (ok) report("orders", config.orders, started);
+        return ok && static_cast<bool>(payments);
+    }
+
+    bool generateCarts() {
+        auto started = chrono::steady_clock::now();
+        makeDirectory("data/cart");
+        ZipfSampler popularity(config.products, config.zipfExponent);
+        for (int i = 0; i < config.carts && i < config.users; ++i) {
+            GeneratorRandom random(GeneratorRandom::derive(config.seed, CartStream, static_cast<uint64_t>(i)));
+            int userID = userForRank(i + 1);
+            ofstream out("data/cart/cart_" + to_string(userID) + ".txt", ios::trunc);
+            if (!out) {
+                cerr << "Error: Could not create cart file for user " << userID << "." << endl;
+                return false;
+            }
+            vector<int> picked;
+            long long lines = min<long long>(1 + random.below(5), config.products);
+            while (static_cast<long long>(picked.size()) < lines) {
+                int productID = productForRank(popularity.sample(random));
+                if (find(picked.begin(), picked.end(), productID) != picked.end()) continue;
+                picked.push_back(productID);
+                out << productID << "," << (1 + random.below(3)) << "\n";
+            }
+        }
+        report("carts", min(config.carts, config.users), started);
+        return true;
+    }
+
+    bool generateWishlists() {
+        auto started = chrono::steady_clock::now();
+        makeDirectory("data/wishlist");
+        ZipfSampler popularity(config.products, config.zipfExponent);
+        for (int i = 0; i < config.wishlists && i < config.users; ++i) {
+            GeneratorRandom random(GeneratorRandom::derive(config.seed, WishlistStream, static_cast<uint64_t>(i)));
+            int userID = userForRank(i + 1);
+            ofstream out("data/wishlist/wishlist_" + to_string(userID) + ".txt", ios::trunc);
+            if (!out) {
+                cerr << "Error: Could not create wishlist file for user " << userID << "." << endl;
+                return false;
+            }
+            vector<int> picked;
+            long long lines = min<long long>(1 + random.below(10), config.products);
+            while (static_cast<long long>(picked.size()) < lines) {
+                int productID = productForRank(popularity.sample(random));
+                if (find(picked.begin(), picked.end(), productID) != picked.end()) continue;
+                picked.push_back(productID);
+                out << productID << "\n";
+            }
+        }
+        report("wishlists", min(config.wishlists, config.users), started);
+        return true;
+    }
+
+    // True if data/ under the current directory already holds a data set.
+    static bool dataSetExists() {
+        struct stat info;
+        return stat("data/orders/segments/manifest.txt", &info) == 0 || stat("data/orders/orders.txt", &info) == 0 ||
+               stat("data/products.txt", &info) == 0;
+    }
+
+    // Removes what generateAll() appends to or leaves behind per user, so a new set
+    // doesn't mix with the old one. The flat files are simply overwritten.
+    static void removeDataSet() {
+        clearDirectory("data/orders/segments");
+        clearDirectory("data/cart");
+        clearDirectory("data/wishlist");
+        remove("data/orders/orders.txt");
+        remove("data/orders/orders.txt.imported");
+    }
+
+    // Generates everything into data/ under the current directory. Existing files are
+    // overwritten; order segments must not exist yet (see datagen --force).
+    bool generateAll() {
+        if (config.products < 1 || config.users < 1) {
+            cerr << "Error: At least one product and one user are required." << endl;
+            return false;
+        }
+        makeDirectory("data");
+        makeDirectory("data/orders");
+        return generateUsers() && generateReviews() && generateProducts() && generateOrders() &&
+               generateCarts() && generateWishlists();
+    }
+};
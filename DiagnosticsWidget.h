@@ -0,0 +1,176 @@
+#ifndef DIAGNOSTICSWIDGET_H
+#define DIAGNOSTICSWIDGET_H
+
+#include <QWidget>
+#include <QTableWidget>
+#include <QTableWidgetItem>
+#include <QPushButton>
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QTimer>
+#include <QFileDialog>
+#include <QMessageBox>
+#include "../../include/IoStats.h"
+
+// Live view of the process-wide I/O counters: totals since the last reset and rates
+// over the last refresh interval, per store.
+class DiagnosticsWidget : public QWidget
+{
+    Q_OBJECT
+
+public:
+    inline explicit DiagnosticsWidget(QWidget *parent = nullptr);
+    inline ~DiagnosticsWidget();
+
+private slots:
+    inline void refreshCounters();
+    inline void resetCounters();
+    inline void exportSnapshot();
+
+private:
+    enum Column { StoreColumn, OpensColumn, OpensRateColumn, ReadColumn, ReadRateColumn, WrittenColumn,
+                  WriteRateColumn, RewritesColumn, CacheHitColumn, ColumnCount };
+
+    inline void setupUi();
+    inline void setCell(int row, int column, const QString &text);
+    static inline QString formatBytes(double bytes);
+    static inline QString formatHitRatio(long long hits, long long misses);
+
+    QTableWidget *countersTable;
+    QLabel *allocationsLabel;
+    QLabel *sinceLabel;
+    QTimer *refreshTimer;
+    IoStats::Snapshot previous;
+    bool hasPrevious;
+};
+
+inline DiagnosticsWidget::DiagnosticsWidget(QWidget *parent)
+    : QWidget(parent), hasPrevious(false)
+{
+    setupUi();
+    refreshCounters();
+}
+
+inline DiagnosticsWidget::~DiagnosticsWidget() {}
+
+inline void DiagnosticsWidget::setupUi() {
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+
+    QLabel *titleLabel = new QLabel("I/O and Allocation Counters", this);
+    titleLabel->setStyleSheet("font-size: 16px; font-weight: bold;");
+    mainLayout->addWidget(titleLabel, 0, Qt::AlignCenter);
+
+    countersTable = new QTableWidget(IoStats::StoreCount + 1, ColumnCount, this); // Last row holds the totals
+    countersTable->setHorizontalHeaderLabels({"Store", "Opens", "Opens/s", "Read", "Read/s", "Written",
+                                              "Written/s", "Rewrites", "Cache Hits"});
+    countersTable->verticalHeader()->setVisible(false);
+    countersTable->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    countersTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    countersTable->setSelectionMode(QAbstractItemView::NoSelection);
+    countersTable->setAlternatingRowColors(true);
+    mainLayout->addWidget(countersTable);
+
+    allocationsLabel = new QLabel(this);
+    mainLayout->addWidget(allocationsLabel);
+    sinceLabel = new QLabel(this);
+    mainLayout->addWidget(sinceLabel);
+
+    QHBoxLayout *buttonLayout = new QHBoxLayout();
+    QPushButton *resetButton = new QPushButton("Reset Counters", this);
+    QPushButton *exportButton = new QPushButton("Export Snapshot", this);
+    buttonLayout->addStretch();
+    buttonLayout->addWidget(resetButton);
+    buttonLayout->addWidget(exportButton);
+    mainLayout->addLayout(buttonLayout);
+
+    connect(resetButton, &QPushButton::clicked, this, &DiagnosticsWidget::resetCounters);
+    connect(exportButton, &QPushButton::clicked, this, &DiagnosticsWidget::exportSnapshot);
+
+    // Refresh only while the tab is on screen
+    refreshTimer = new QTimer(this);
+    refreshTimer->setInterval(1000);
+    connect(refreshTimer, &QTimer::timeout, this, &DiagnosticsWidget::refreshCounters);
+    refreshTimer->start();
+
+    setLayout(mainLayout);
+}
+
+inline void DiagnosticsWidget::setCell(int row, int column, const QString &text) {
+    QTableWidgetItem *item = countersTable->item(row, column);
+    if (!item) {
+        item = new QTableWidgetItem();
+        item->setTextAlignment(column == StoreColumn ? (Qt::AlignLeft | Qt::AlignVCenter) : (Qt::AlignRight | Qt::AlignVCenter));
+        countersTable->setItem(row, column, item);
+    }
+    item->setText(text);
+}
+
+inline QString DiagnosticsWidget::formatBytes(double bytes) {
+    if (bytes < 1024.0) return QString("%1 B").arg(bytes, 0, 'f', 0);
+    if (bytes < 1024.0 * 1024.0) return QString("%1 KB").arg(bytes / 1024.0, 0, 'f', 1);
+    if (bytes < 1024.0 * 1024.0 * 1024.0) return QString("%1 MB").arg(bytes / (1024.0 * 1024.0), 0, 'f', 1);
+    return QString("%1 GB").arg(bytes / (1024.0 * 1024.0 * 1024.0), 0, 'f', 2);
+}
+
+inline QString DiagnosticsWidget::formatHitRatio(long long hits, long long misses) {
+    if (hits + misses == 0) return "-";
+    return QString("%1% of %2").arg(100.0 * hits / (hits + misses), 0, 'f', 1).arg(hits + misses);
+}
+
+inline void DiagnosticsWidget::refreshCounters() {
+    if (!isVisible() && hasPrevious) return;
+
+    IoStats::Snapshot current = IoStats::snapshot();
+    double interval = hasPrevious ? current.seconds - previous.seconds : 0.0;
+    auto rate = [&](int store, IoStats::Counter counter) -> double {
+        if (interval <= 0.0) return 0.0;
+        long long before = (store < IoStats::StoreCount) ? previous.values[store][counter] : previous.total(counter);
+        long long now = (store < IoStats::StoreCount) ? current.values[store][counter] : current.total(counter);
+        return (now >= before) ? (now - before) / interval : 0.0; // A reset in between reads as idle
+    };
+
+    for (int row = 0; row <= IoStats::StoreCount; ++row) {
+        bool totals = (row == IoStats::StoreCount);
+        auto value = [&](IoStats::Counter counter) -> long long {
+            return totals ? current.total(counter) : current.values[row][counter];
+        };
+        setCell(row, StoreColumn, totals ? QString("Total") : QString(IoStats::storeName(row)));
+        setCell(row, OpensColumn, QString::number(value(IoStats::Opens)));
+        setCell(row, OpensRateColumn, QString::number(rate(row, IoStats::Opens), 'f', 1));
+        setCell(row, ReadColumn, formatBytes(static_cast<double>(value(IoStats::BytesRead))));
+        setCell(row, ReadRateColumn, formatBytes(rate(row, IoStats::BytesRead)) + "/s");
+        setCell(row, WrittenColumn, formatBytes(static_cast<double>(value(IoStats::BytesWritten))));
+        setCell(row, WriteRateColumn, formatBytes(rate(row, IoStats::BytesWritten)) + "/s");
+        setCell(row, RewritesColumn, QString::number(value(IoStats::TempRewrites)));
+        setCell(row, CacheHitColumn, formatHitRatio(value(IoStats::CacheHits), value(IoStats::CacheMisses)));
+    }
+
+    double allocationRate = (interval > 0.0 && current.allocations >= previous.allocations)
+        ? (current.allocations - previous.allocations) / interval : 0.0;
+    allocationsLabel->setText(QString("Heap allocations: %1 total, %2/s")
+                                  .arg(current.allocations).arg(allocationRate, 0, 'f', 0));
+    sinceLabel->setText(QString("Counting for %1 s").arg(current.seconds, 0, 'f', 0));
+
+    previous = current;
+    hasPrevious = true;
+}
+
+inline void DiagnosticsWidget::resetCounters() {
+    IoStats::reset();
+    hasPrevious = false;
+    refreshCounters();
+}
+
+inline void DiagnosticsWidget::exportSnapshot() {
+    QString path = QFileDialog::getSaveFileName(this, "Export Counters", "io_stats.csv", "CSV Files (*.csv)");
+    if (path.isEmpty()) return;
+    if (IoStats::writeSnapshot(path.toStdString(), IoStats::snapshot())) {
+        QMessageBox::information(this, "Export Counters", "Counters written to " + path + ".");
+    } else {
+        QMessageBox::warning(this, "Export Counters", "Could not write " + path + ".");
+    }
+}
+
+#endif // DIAGNOSTICSWIDGET_H
@@ -0,0 +1,301 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <mutex>
+#include <ctime>
+#include <cstdio>
+#include <cstdlib>
+
+#include "OrderSegments.h"
+#include "TaskScheduler.h"
+#include "IoStats.h"
+#include "Trace.h"
+
+using namespace std;
+
+// Remembers which order each checkout request key produced, so a repeated checkout
+// (a double click, a retry after a slow write, a client that timed out) gets the first
+// order back instead of placing a second one and taking the stock twice.
+//
+// Keys are chosen by the client and scoped to the user. The index holds the most
+// recent Capacity keys in memory, oldest evicted first, and logs each completed key to
+// data/orders/idempotency.txt:
+//
+//   userID,key,orderID,total,epochSeconds      (orderID 0 withdraws the key)
+//
+// A key is logged before its order is appended to the segments. If the order then fails
+// to save, the key is withdrawn; after a crash in between, load() drops keys whose order
+// ID is past the last stored order. Once the log grows past twice the capacity it is
+// compacted to the keys still held, as a background task so checkouts do not wait for it.
+//
+// Thread-safe. The first use reads the log and the segment manifest, so it should happen
+// with the orders lock held (see StoreLocks.h) when other threads write orders.
+class IdempotencyIndex {
+public:
+    enum State {
+        Unknown,        // Never seen (or forgotten): the caller now owns the key
+        InFlight,       // Claimed by a checkout that has not finished
+        Completed,      // Produced an order; see Entry
+        Invalid         // Not a usable key
+    };
+
+    struct Entry {
+        int orderID;
+        double total;
+
+        Entry() : orderID(0), total(0.0) {}
+    };
+
+    // One completed checkout to log.
+    struct Completion {
+        int userID;
+        string key;
+        int orderID;
+        double total;
+    };
+
+    static const size_t Capacity = 50000;
+    static const size_t MaxKeyLength = 128;
+
+private:
+    mutable mutex lock;
+    unordered_map<string, Entry> completed;
+    unordered_map<string, bool> inFlight;
+    deque<string> order;              // Completed keys, oldest first, for eviction
+    size_t logLines;
+    bool loaded;
+    bool compactionQueued;
+
+    IdempotencyIndex() : logLines(0), loaded(false), compactionQueued(false) {}
+
+    static const char* logPath() { return "data/orders/idempotency.txt"; }
+
+    static string scoped(int userID, const string& key) {
+        return to_string(userID) + ":" + key;
+    }
+
+    void remember(const string& scopedKey, const Entry& entry) {
+        if (completed.find(scopedKey) == completed.end()) order.push_back(scopedKey);
+        completed[scopedKey] = entry;
+        while (order.size() > Capacity) {
+            completed.erase(order.front());
+            order.pop_front();
+        }
+    }
+
+    // Only withdrawn orders get here, so the linear search is rare
+    void forgetLocked(const string& scopedKey) {
+        if (completed.erase(scopedKey) == 0) return;
+        for (size_t i = order.size(); i-- > 0;) {
+            if (order[i] == scopedKey) {
+                order.erase(order.begin() + static_cast<long>(i));
+                break;
+            }
+        }
+    }
+
+    bool loadLocked() {
+        TRACE_SCOPE("idempotency", "IdempotencyIndex::load");
+        completed.clear();
+        order.clear();
+        logLines = 0;
+        int lastStoredOrder = OrderSegmentStore::getInstance().maxOrderID();
+        TrackedIfstream in(IoStats::Orders, logPath());
+        string line;
+        while (getline(in, line)) {
+            if (line.empty()) continue;
+            logLines++;
+            stringstream ss(line);
+            string userField, key, orderField, totalField;
+            if (!getline(ss, userField, ',') || !getline(ss, key, ',') || !getline(ss, orderField, ',')) continue;
+            getline(ss, totalField, ',');
+            string scopedKey = scoped(atoi(userField.c_str()), key);
+            Entry entry;
+            entry.orderID = atoi(orderField.c_str());
+            entry.total = atof(totalField.c_str());
+            if (entry.orderID <= 0 || entry.orderID > lastStoredOrder) forgetLocked(scopedKey);
+            else remember(scopedKey, entry);
+        }
+        loaded = true;
+        return true;
+    }
+
+    bool ensureLoadedLocked() {
+        return loaded || loadLocked();
+    }
+
+    // Rewrites the log with only the keys still held.
+    bool compactLocked() {
+        TRACE_SCOPE("idempotency", "IdempotencyIndex::compact");
+        string tempPath = string(logPath()) + ".tmp";
+        TrackedOfstream out(IoStats::Orders, tempPath);
+        if (!out) return false;
+        size_t written = 0;
+        out << fixed << setprecision(2);
+        for (size_t i = 0; i < order.size(); ++i) {
+            auto found = completed.find(order[i]);
+            if (found == completed.end()) continue;
+            size_t colon = order[i].find(':');
+            out << order[i].substr(0, colon) << "," << order[i].substr(colon + 1) << "," << found->second.orderID << ","
+                << found->second.total << "," << static_cast<long long>(time(nullptr)) << "\n";
+            written++;
+        }
+        out.close();
+        if (!out || rename(tempPath.c_str(), logPath()) != 0) {
+            remove(tempPath.c_str());
+            return false;
+        }
+        IoStats::add(IoStats::Orders, IoStats::TempRewrites);
+        logLines = written;
+        return true;
+    }
+
+    bool appendLocked(const vector<Completion>& completions, bool withdraw) {
+        TrackedOfstream out(IoStats::Orders, logPath(), ios::app);
+        if (!out) {
+            cerr << "Error: Could not open " << logPath() << " for appending." << endl;
+            return false;
+        }
+        out << fixed << setprecision(2);
+        long long now = static_cast<long long>(time(nullptr));
+        for (size_t i = 0; i < completions.size(); ++i) {
+            const Completion& entry = completions[i];
+            out << entry.userID << "," << entry.key << "," << (withdraw ? 0 : entry.orderID) << ","
+                << (withdraw ? 0.0 : entry.total) << "," << now << "\n";
+        }
+        out.close();
+        logLines += completions.size();
+        return static_cast<bool>(out);
+    }
+
+public:
+    IdempotencyIndex(const IdempotencyIndex&) = delete;
+    IdempotencyIndex& operator=(const IdempotencyIndex&) = delete;
+
+    static IdempotencyIndex& getInstance() {
+        static IdempotencyIndex instance;
+        return instance;
+    }
+
+    // Keys are written to a CSV log, so they may not contain commas or line breaks.
+    static bool isValidKey(const string& key) {
+        if (key.empty() || key.length() > MaxKeyLength) return false;
+        for (size_t i = 0; i < key.length(); ++i) {
+            char c = key[i];
+            if (c == ',' || c == '\n' || c == '\r') return false;
+        }
+        return true;
+    }
+
+    // A fresh key for a client that has none of its own.
+    static string generateKey() {
+        static mutex counterLock;
+        static unsigned long long counter = 0;
+        lock_guard<mutex> guard(counterLock);
+        stringstream ss;
+        ss << hex << static_cast<long long>(time(nullptr)) << "-" << rand() << "-" << ++counter;
+        return ss.str();
+    }
+
+    bool ensureLoaded() {
+        lock_guard<mutex> guard(lock);
+        return ensureLoadedLocked();
+    }
+
+    // Re-reads the log, e.g. after the data directory changed.
+    bool reload() {
+        lock_guard<mutex> guard(lock);
+        inFlight.clear();
+        return loadLocked();
+    }
+
+    // What is known about a key, without claiming it.
+    State lookup(int userID, const string& key, Entry& existing) {
+        if (!isValidKey(key)) return Invalid;
+        lock_guard<mutex> guard(lock);
+        ensureLoadedLocked();
+        string scopedKey = scoped(userID, key);
+        auto found = completed.find(scopedKey);
+        if (found != completed.end()) {
+            existing = found->second;
+            return Completed;
+        }
+        return inFlight.count(scopedKey) ? InFlight : Unknown;
+    }
+
+    // Starts a checkout under the key. Unknown means the caller now owns it and must end
+    // with complete() or release(); otherwise nothing changes and the state says why.
+    State claim(int userID, const string& key, Entry& existing) {
+        if (!isValidKey(key)) return Invalid;
+        lock_guard<mutex> guard(lock);
+        ensureLoadedLocked();
+        string scopedKey = scoped(userID, key);
+        auto found = completed.find(scopedKey);
+        if (found != completed.end()) {
+            existing = found->second;
+            return Completed;
+        }
+        if (inFlight.count(scopedKey)) return InFlight;
+        inFlight[scopedKey] = true;
+        return Unknown;
+    }
+
+    // The claimed checkout placed no order; the key may be used again.
+    void release(int userID, const string& key) {
+        lock_guard<mutex> guard(lock);
+        inFlight.erase(scoped(userID, key));
+    }
+
+    // Logs claimed keys as completed with their orders. Call before the orders are stored.
+    bool complete(const vector<Completion>& completions) {
+        TRACE_SCOPE("idempotency", "IdempotencyIndex::complete");
+        if (completions.empty()) return true;
+        bool compactLater = false;
+        {
+            lock_guard<mutex> guard(lock);
+            ensureLoadedLocked();
+            if (!appendLocked(completions, false)) return false;
+            for (size_t i = 0; i < completions.size(); ++i) {
+                string scopedKey = scoped(completions[i].userID, completions[i].key);
+                Entry entry;
+                entry.orderID = completions[i].orderID;
+                entry.total = completions[i].total;
+                inFlight.erase(scopedKey);
+                remember(scopedKey, entry);
+            }
+            if (logLines > 2 * Capacity && !compactionQueued) compactionQueued = compactLater = true;
+        }
+        if (compactLater) {
+            TaskScheduler::getInstance().post([this]() {
+                lock_guard<mutex> guard(lock);
+                compactionQueued = false;
+                if (logLines > 2 * Capacity) compactLocked();
+            }, TaskPriority::Background);
+        }
+        return true;
+    }
+
+    // Withdraws completed keys whose orders could not be stored after all.
+    void withdraw(const vector<Completion>& completions) {
+        if (completions.empty()) return;
+        lock_guard<mutex> guard(lock);
+        appendLocked(completions, true);
+        for (size_t i = 0; i < completions.size(); ++i) {
+            string scopedKey = scoped(completions[i].userID, completions[i].key);
+            forgetLocked(scopedKey);
+            inFlight.erase(scopedKey);
+        }
+    }
+
+    size_t size() const {
+        lock_guard<mutex> guard(lock);
+        return completed.size();
+    }
+};
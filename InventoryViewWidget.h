@@ -2,14 +2,18 @@
 #define INVENTORYVIEWWIDGET_H
 
 #include <QWidget>
-#include <QTableWidget>
+#include <QTableView>
+#include <QItemSelectionModel>
 #include <QVBoxLayout>
 #include <QHeaderView>
 #include <QLabel> // For a title or description
 #include <QMessageBox> // For error messages if needed
+#include <QTimer>
 #include "../../include/Admin.h"
 #include "../../include/Product.h"
+#include "../../include/Trace.h"
 #include "AddEditProductDialog.h" // For ProductDetails struct
+#include "ProductTableModel.h"
 
 // Placeholder for Inventory data structure
 // struct InventoryItemData { ... };
@@ -29,9 +33,12 @@ private slots:
 
 private:
     inline void loadInventory();
+    inline void updateStockSummary(); // Recounts low-stock items for the status label
     inline void setupUi();
 
-    QTableWidget *inventoryTable;
+    QTableView *inventoryTable;
+    ProductTableModel *inventoryModel;
+    QTimer *summaryTimer; // Coalesces label updates when many deltas arrive together
     QLabel *totalItemsLabel;
     bool hasLowStock;
 };
@@ -52,10 +59,12 @@ inline void InventoryViewWidget::setupUi() {
     titleLabel->setStyleSheet("font-size: 16px; font-weight: bold;");
     mainLayout->addWidget(titleLabel, 0, Qt::AlignCenter);
 
-    inventoryTable = new QTableWidget(this);
-    // Add Rating column that was missing before
-    inventoryTable->setColumnCount(6);
-    inventoryTable->setHorizontalHeaderLabels({"ID", "Name", "Category", "Price", "Rating", "Stock"});
+    inventoryModel = new ProductTableModel({ProductTableModel::IdColumn, ProductTableModel::NameColumn,
+                                            ProductTableModel::CategoryColumn, ProductTableModel::PriceColumn,
+                                            ProductTableModel::RatingColumn, ProductTableModel::StockColumn}, this);
+    inventoryModel->setInventoryStyle(true); // Currency prices and colour-coded stock levels
+    inventoryTable = new QTableView(this);
+    inventoryTable->setModel(inventoryModel);
     inventoryTable->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
     inventoryTable->setSelectionBehavior(QAbstractItemView::SelectRows);
     inventoryTable->setSelectionMode(QAbstractItemView::SingleSelection);
@@ -68,72 +77,51 @@ inline void InventoryViewWidget::setupUi() {
     totalItemsLabel->setAlignment(Qt::AlignRight);
     mainLayout->addWidget(totalItemsLabel);
     
+    // Rows patched in place by the model (checkouts, admin edits) only need the label recounted
+    summaryTimer = new QTimer(this);
+    summaryTimer->setSingleShot(true);
+    summaryTimer->setInterval(200);
+    connect(summaryTimer, &QTimer::timeout, this, [this]() { updateStockSummary(); });
+    connect(inventoryModel, &QAbstractItemModel::dataChanged, summaryTimer, qOverload<>(&QTimer::start));
+    connect(inventoryModel, &QAbstractItemModel::rowsInserted, summaryTimer, qOverload<>(&QTimer::start));
+    connect(inventoryModel, &QAbstractItemModel::rowsRemoved, summaryTimer, qOverload<>(&QTimer::start));
+
     // Connect selection signal for low stock highlighting
-    connect(inventoryTable, &QTableWidget::itemSelectionChanged, this, &InventoryViewWidget::handleLowStockHighlight);
+    connect(inventoryTable->selectionModel(), &QItemSelectionModel::selectionChanged, this, &InventoryViewWidget::handleLowStockHighlight);
 
     setLayout(mainLayout);
 }
 
 inline void InventoryViewWidget::loadInventory() {
-    inventoryTable->setRowCount(0); // Clear existing rows
+    TRACE_SCOPE("ui", "InventoryViewWidget::loadInventory");
     hasLowStock = false;
 
-    int productCount = 0;
-    // Use the real Product::loadAllProducts method
-    Product* products = Product::loadAllProducts(productCount);
-
-    if (!products || productCount == 0) {
+    ProductCatalog &catalog = ProductCatalog::getInstance();
+    if (!catalog.ensureLoaded() || catalog.snapshot()->liveSize() == 0) {
+        inventoryModel->setRows(std::vector<int>());
         totalItemsLabel->setText("Total Items: 0");
         QMessageBox::information(this, "Inventory", "No products found in the inventory.");
         return;
     }
 
-    inventoryTable->setRowCount(productCount);
+    inventoryModel->showAllRows();
+    updateStockSummary();
+}
+
+inline void InventoryViewWidget::updateStockSummary() {
+    // Low-stock counting is a scan over the stock column only; cells are formatted
+    // and coloured on demand by the model. One snapshot keeps the count and the total
+    // consistent while checkouts change stock.
+    std::shared_ptr<const CatalogSnapshot> snapshot = ProductCatalog::getInstance().snapshot();
+    const CatalogSnapshot &catalog = *snapshot;
+    int productCount = catalog.liveSize();
     int lowStockCount = 0;
-    
-    for (int i = 0; i < productCount; ++i) {
-        QTableWidgetItem* idItem = new QTableWidgetItem(QString::number(products[i].getProductID()));
-        QTableWidgetItem* nameItem = new QTableWidgetItem(
-            products[i].getName() ? QString(products[i].getName()) : "Unnamed Product"
-        );
-        QTableWidgetItem* categoryItem = new QTableWidgetItem(
-            products[i].getCategory() ? QString(products[i].getCategory()) : "Uncategorized"
-        );
-        QTableWidgetItem* priceItem = new QTableWidgetItem(
-            QString("$%1").arg(products[i].getPrice(), 0, 'f', 2)
-        );
-        QTableWidgetItem* ratingItem = new QTableWidgetItem(
-            QString("%1").arg(products[i].getRating(), 0, 'f', 1)
-        );
-        QTableWidgetItem* stockItem = new QTableWidgetItem(
-            QString::number(products[i].getStock())
-        );
-        
-        // Format low stock or out of stock items
-        int stock = products[i].getStock();
-        if (stock == 0) {
-            stockItem->setBackground(QColor(255, 200, 200)); // Light red for out of stock
-            stockItem->setForeground(QColor(255, 0, 0)); // Red text
-            stockItem->setText(stockItem->text() + " - OUT OF STOCK!");
-            hasLowStock = true;
-            lowStockCount++;
-        } else if (stock < 5) {
-            stockItem->setBackground(QColor(255, 255, 200)); // Light yellow for low stock
-            stockItem->setForeground(QColor(255, 140, 0)); // Orange text
-            stockItem->setText(stockItem->text() + " - LOW STOCK!");
-            hasLowStock = true;
+    for (int row = 0; row < catalog.size(); ++row) {
+        if (catalog.isAlive(row) && catalog.getStock(row) < ProductTableModel::LowStockThreshold) {
             lowStockCount++;
         }
-        
-        inventoryTable->setItem(i, 0, idItem);
-        inventoryTable->setItem(i, 1, nameItem);
-        inventoryTable->setItem(i, 2, categoryItem);
-        inventoryTable->setItem(i, 3, priceItem);
-        inventoryTable->setItem(i, 4, ratingItem);
-        inventoryTable->setItem(i, 5, stockItem);
     }
-    
-    delete[] products; // Clean up
+    hasLowStock = (lowStockCount > 0);
     
     // Update the total items label including low stock warning if applicable
     QString statusText = QString("Total Items: %1").arg(productCount);
@@ -144,9 +132,6 @@ inline void InventoryViewWidget::loadInventory() {
         totalItemsLabel->setStyleSheet("");
     }
     totalItemsLabel->setText(statusText);
-    
-    // Make sure the table columns are properly sized
-    inventoryTable->resizeColumnsToContents();
 }
 
 inline void InventoryViewWidget::handleLowStockHighlight() {
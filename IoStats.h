@@ -0,0 +1,246 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <atomic>
+#include <chrono>
+
+using namespace std;
+
+// Process-wide I/O counters, grouped by data store and operation.
+//
+// Counters are sharded per thread (each thread is given one of ShardCount cache-line
+// sized slots), so hot paths on different threads never write the same line; a
+// snapshot sums the shards. The backend opens its data files through TrackedIfstream
+// and TrackedOfstream, which count the open and the bytes moved, and reports temp-file
+// rewrites and cache lookups explicitly. Heap allocations are counted process-wide by
+// the operator new replacement in main.cpp.
+class IoStats {
+public:
+    enum Store { Products, Users, Carts, Wishlists, Reviews, Orders, Payments, StoreCount };
+    enum Counter { Opens, BytesRead, BytesWritten, TempRewrites, CacheHits, CacheMisses, CounterCount };
+
+    static constexpr int ShardCount = 16;
+
+    struct Snapshot {
+        long long values[StoreCount][CounterCount];
+        long long allocations;
+        double seconds; // Since the last reset
+
+        long long total(Counter counter) const {
+            long long sum = 0;
+            for (int store = 0; store < StoreCount; ++store) sum += values[store][counter];
+            return sum;
+        }
+    };
+
+private:
+    struct alignas(64) Shard {
+        atomic<long long> counters[StoreCount][CounterCount];
+        atomic<long long> allocations;
+    };
+
+    // Static storage is zero-initialised before any code runs, so counting is safe
+    // from operator new during static initialisation.
+    static inline Shard shards[ShardCount];
+    static inline atomic<int> nextShard{0};
+    static inline atomic<long long> resetAtNs{0};
+
+    static Shard& localShard() {
+        thread_local int index = -1;
+        if (index < 0) index = nextShard.fetch_add(1, memory_order_relaxed) % ShardCount;
+        return shards[index];
+    }
+
+    static long long steadyNs() {
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+public:
+    static void add(Store store, Counter counter, long long amount = 1) {
+        localShard().counters[store][counter].fetch_add(amount, memory_order_relaxed);
+    }
+
+    static void countAllocation() {
+        localShard().allocations.fetch_add(1, memory_order_relaxed);
+    }
+
+    static void cacheLookup(Store store, bool hit) {
+        add(store, hit ? CacheHits : CacheMisses);
+    }
+
+    static Snapshot snapshot() {
+        Snapshot result;
+        for (int store = 0; store < StoreCount; ++store) {
+            for (int counter = 0; counter < CounterCount; ++counter) {
+                long long sum = 0;
+                for (int s = 0; s < ShardCount; ++s) sum += shards[s].counters[store][counter].load(memory_order_relaxed);
+                result.values[store][counter] = sum;
+            }
+        }
+        result.allocations = 0;
+        for (int s = 0; s < ShardCount; ++s) result.allocations += shards[s].allocations.load(memory_order_relaxed);
+        long long since = resetAtNs.load(memory_order_relaxed);
+        if (since == 0) {
+            // First use: measure from now on
+            long long expected = 0;
+            resetAtNs.compare_exchange_strong(expected, steadyNs());
+            since = resetAtNs.load(memory_order_relaxed);
+        }
+        result.seconds = static_cast<double>(steadyNs() - since) / 1e9;
+        return result;
+    }
+
+    // Zeroes every counter. Increments racing with a reset land on one side of it.
+    static void reset() {
+        for (int s = 0; s < ShardCount; ++s) {
+            for (int store = 0; store < StoreCount; ++store) {
+                for (int counter = 0; counter < CounterCount; ++counter) {
+                    shards[s].counters[store][counter].store(0, memory_order_relaxed);
+                }
+            }
+            shards[s].allocations.store(0, memory_order_relaxed);
+        }
+        resetAtNs.store(steadyNs(), memory_order_relaxed);
+    }
+
+    static const char* storeName(int store) {
+        static const char* names[StoreCount] = {"Products", "Users", "Carts", "Wishlists", "Reviews", "Orders", "Payments"};
+        return (store >= 0 && store < StoreCount) ? names[store] : "";
+    }
+
+    static const char* counterName(int counter) {
+        static const char* names[CounterCount] = {"opens", "bytes_read", "bytes_written", "temp_rewrites",
+                                                  "cache_hits", "cache_misses"};
+        return (counter >= 0 && counter < CounterCount) ? names[counter] : "";
+    }
+
+    // Writes a snapshot as CSV: one row per store, then the allocation count.
+    static bool writeSnapshot(const string& path, const Snapshot& snap) {
+        ofstream out(path, ios::trunc);
+        if (!out) {
+            cerr << "Error: Could not open " << path << " for writing." << endl;
+            return false;
+        }
+        out << "store";
+        for (int counter = 0; counter < CounterCount; ++counter) out << "," << counterName(counter);
+        out << "\n";
+        for (int store = 0; store < StoreCount; ++store) {
+            out << storeName(store);
+            for (int counter = 0; counter < CounterCount; ++counter) out << "," << snap.values[store][counter];
+            out << "\n";
+        }
+        out << "allocations," << snap.allocations << "\n";
+        out << "seconds," << snap.seconds << "\n";
+        return static_cast<bool>(out);
+    }
+};
+
+// A filebuf that counts its open and the bytes it moves. Bytes are counted by file
+// position between seeks, so a reader that jumps between index blocks is charged only
+// for the ranges it actually walked.
+class TrackedFilebuf : public filebuf {
+private:
+    IoStats::Store store;
+    IoStats::Counter counter;
+    ios::openmode direction;
+    streamoff mark; // Where the current sequential run started
+
+    void settle() {
+        if (!is_open()) return;
+        streamoff here = filebuf::seekoff(0, ios::cur, direction);
+        if (here < 0) return;
+        if (here > mark) IoStats::add(store, counter, here - mark);
+        mark = here;
+    }
+
+protected:
+    pos_type seekoff(off_type offset, ios::seekdir way, ios::openmode which) override {
+        settle();
+        pos_type result = filebuf::seekoff(offset, way, which);
+        if (result != pos_type(off_type(-1))) mark = result;
+        return result;
+    }
+
+    pos_type seekpos(pos_type position, ios::openmode which) override {
+        settle();
+        pos_type result = filebuf::seekpos(position, which);
+        if (result != pos_type(off_type(-1))) mark = result;
+        return result;
+    }
+
+public:
+    explicit TrackedFilebuf(IoStats::Store fileStore)
+        : store(fileStore), counter(IoStats::BytesRead), direction(ios::in), mark(0) {}
+
+    ~TrackedFilebuf() override { settle(); }
+
+    bool openFile(const string& path, ios::openmode mode) {
+        IoStats::add(store, IoStats::Opens);
+        if (!filebuf::open(path, mode)) return false;
+        direction = (mode & ios::out) ? ios::out : ios::in;
+        counter = (mode & ios::out) ? IoStats::BytesWritten : IoStats::BytesRead;
+        // Appends start at the end of the file, not at its (unmoved) descriptor offset
+        if (mode & ios::app) filebuf::seekoff(0, ios::end, ios::out);
+        streamoff start = filebuf::seekoff(0, ios::cur, direction);
+        mark = (start < 0) ? 0 : start;
+        return true;
+    }
+
+    bool closeFile() {
+        settle();
+        return filebuf::close() != nullptr;
+    }
+};
+
+// Drop-in replacements for ifstream/ofstream on the data files.
+class TrackedIfstream : public istream {
+private:
+    TrackedFilebuf buffer;
+
+public:
+    explicit TrackedIfstream(IoStats::Store store) : istream(nullptr), buffer(store) { init(&buffer); }
+
+    TrackedIfstream(IoStats::Store store, const string& path, ios::openmode mode = ios::in)
+        : istream(nullptr), buffer(store) {
+        init(&buffer);
+        open(path, mode);
+    }
+
+    void open(const string& path, ios::openmode mode = ios::in) {
+        if (buffer.openFile(path, mode | ios::in)) clear();
+        else setstate(ios::failbit);
+    }
+
+    bool is_open() const { return buffer.is_open(); }
+
+    void close() {
+        if (!buffer.closeFile()) setstate(ios::failbit);
+    }
+};
+
+class TrackedOfstream : public ostream {
+private:
+    TrackedFilebuf buffer;
+
+public:
+    explicit TrackedOfstream(IoStats::Store store) : ostream(nullptr), buffer(store) { init(&buffer); }
+
+    TrackedOfstream(IoStats::Store store, const string& path, ios::openmode mode = ios::out)
+        : ostream(nullptr), buffer(store) {
+        init(&buffer);
+        open(path, mode);
+    }
+
+    void open(const string& path, ios::openmode mode = ios::out) {
+        if (buffer.openFile(path, mode | ios::out)) clear();
+        else setstate(ios::failbit);
+    }
+
+    bool is_open() const { return buffer.is_open(); }
+
+    void close() {
+        if (!buffer.closeFile()) setstate(ios::failbit);
+    }
+};
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+// Latency histogram in the HdrHistogram layout: values are grouped by power of two and
+// each power of two is split into SubBucketHalfCount linear sub-buckets, so every
+// recorded value is kept to within 1/128 (under 1%) of its true value across the whole
+// range (1 ns to about 36 minutes). Recording is a few shifts and an increment, with no
+// allocation. A histogram is not thread-safe: give each thread its own and merge() them.
+class LatencyHistogram {
+public:
+    static const int SubBucketHalfCountMagnitude = 7;
+    static const long long SubBucketHalfCount = 1LL << SubBucketHalfCountMagnitude;   // 128
+    static const long long SubBucketCount = SubBucketHalfCount * 2;                   // 256
+    static const int BucketCount = 34;                     // Top bucket ends at 2^41 ns
+    static const long long HighestTrackable = (SubBucketCount << (BucketCount - 1)) - 1;
+
+private:
+    vector<long long> counts;
+    long long totalCount;
+    long long minValue;
+    long long maxValue;
+    long double sum;
+
+    static int highestBit(unsigned long long value) {
+        int bit = 0;
+        while (value >>= 1) ++bit;
+        return bit;
+    }
+
+    static size_t indexFor(long long value) {
+        int bucket = highestBit(static_cast<unsigned long long>(value) | (SubBucketCount - 1)) - SubBucketHalfCountMagnitude;
+        long long subBucket = value >> bucket;
+        return static_cast<size_t>((static_cast<long long>(bucket) << SubBucketHalfCountMagnitude) + subBucket);
+    }
+
+    // Highest value that lands in the same slot as the slot's index
+    static long long highestEquivalent(size_t index) {
+        long long bucket = static_cast<long long>(index >> SubBucketHalfCountMagnitude);
+        long long subBucket = static_cast<long long>(index) - (bucket << SubBucketHalfCountMagnitude);
+        if (bucket > 0) {
+            bucket -= 1;
+            subBucket += SubBucketHalfCount;
+        }
+        long long low = subBucket << bucket;
+        return low + (1LL << bucket) - 1;
+    }
+
+public:
+    LatencyHistogram()
+        : counts(static_cast<size_t>((BucketCount + 1) * SubBucketHalfCount), 0), totalCount(0),
+          minValue(0), maxValue(0), sum(0) {}
+
+    // Records a latency in nanoseconds; values past the range are clamped to it.
+    void record(long long valueNs) {
+        if (valueNs < 0) valueNs = 0;
+        if (valueNs > HighestTrackable) valueNs = HighestTrackable;
+        counts[indexFor(valueNs)]++;
+        if (totalCount == 0 || valueNs < minValue) minValue = valueNs;
+        if (valueNs > maxValue) maxValue = valueNs;
+        totalCount++;
+        sum += valueNs;
+    }
+
+    void merge(const LatencyHistogram& other) {
+        if (other.totalCount == 0) return;
+        for (size_t i = 0; i < counts.size(); ++i) counts[i] += other.counts[i];
+        if (totalCount == 0 || other.minValue < minValue) minValue = other.minValue;
+        maxValue = std::max(maxValue, other.maxValue);
+        totalCount += other.totalCount;
+        sum += other.sum;
+    }
+
+    void reset() {
+        fill(counts.begin(), counts.end(), 0);
+        totalCount = 0;
+        minValue = maxValue = 0;
+        sum = 0;
+    }
+
+    long long count() const { return totalCount; }
+    long long min() const { return minValue; }
+    long long max() const { return maxValue; }
+    double mean() const { return totalCount ? static_cast<double>(sum / totalCount) : 0.0; }
+
+    // Value at or below which the given percentage of recorded values fall.
+    long long valueAtPercentile(double percentile) const {
+        if (totalCount == 0) return 0;
+        double clamped = std::min(100.0, std::max(0.0, percentile));
+        long long target = static_cast<long long>(clamped / 100.0 * totalCount + 0.5);
+        if (target < 1) target = 1;
+        long long seen = 0;
+        for (size_t i = 0; i < counts.size(); ++i) {
+            seen += counts[i];
+            if (seen >= target) return std::min(highestEquivalent(i), maxValue);
+        }
+        return maxValue;
+    }
+
+    static string formatNs(double ns) {
+        ostringstream text;
+        text << fixed;
+        if (ns < 1e3) text << setprecision(0) << ns << " ns";
+        else if (ns < 1e6) text << setprecision(1) << ns / 1e3 << " us";
+        else if (ns < 1e9) text << setprecision(2) << ns / 1e6 << " ms";
+        else text << setprecision(2) << ns / 1e9 << " s";
+        return text.str();
+    }
+
+    // Percentile ladder in the style of HdrHistogram's output: 50, 75, 87.5, ... 100.
+    void printPercentiles(ostream& out, const string& title) const {
+        out << title << " (" << totalCount << " values, mean " << formatNs(mean()) << ")\n";
+        if (totalCount == 0) return;
+        for (double remaining = 50.0; ; remaining /= 2.0) {
+            double percentile = 100.0 - remaining;
+            out << "  " << setw(10) << fixed << setprecision(4) << percentile << "%  "
+                << formatNs(static_cast<double>(valueAtPercentile(percentile))) << "\n";
+            if (remaining < 0.002 || remaining / 100.0 * totalCount < 1.0) break;
+        }
+        out << "  " << setw(10) << "100.0000" << "%  " << formatNs(static_cast<double>(maxValue)) << "\n";
+    }
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+// Subscribers to a stream of events. notify() calls them on the publishing thread
+// outside the lock, so a listener may publish, subscribe or unsubscribe itself.
+// unsubscribe() waits for calls of that listener already under way on other threads:
+// once it returns the listener never runs again, and whatever it captured (a widget's
+// this) can be destroyed.
+template <typename Event>
+class ListenerSet {
+public:
+    typedef function<void(const Event&)> Listener;
+
+private:
+    struct Entry {
+        int token;
+        Listener listener;
+        int calls;      // Calls under way
+        bool removed;   // Unsubscribed; no new calls start
+    };
+    typedef shared_ptr<Entry> EntryPtr;
+
+    mutex lock;                     // Guards entries, nextToken and every Entry's calls and removed
+    condition_variable callsDone;
+    vector<EntryPtr> entries;
+    int nextToken;
+
+    // The entries this thread is calling, innermost last
+    static vector<const Entry*>& callingOnThisThread() {
+        static thread_local vector<const Entry*> calling;
+        return calling;
+    }
+
+public:
+    ListenerSet() : nextToken(1) {}
+
+    ListenerSet(const ListenerSet&) = delete;
+    ListenerSet& operator=(const ListenerSet&) = delete;
+
+    int subscribe(Listener listener) {
+        lock_guard<mutex> guard(lock);
+        EntryPtr entry = make_shared<Entry>();
+        entry->token = nextToken++;
+        entry->listener = std::move(listener);
+        entry->calls = 0;
+        entry->removed = false;
+        entries.push_back(entry);
+        return entry->token;
+    }
+
+    void unsubscribe(int token) {
+        unique_lock<mutex> guard(lock);
+        for (size_t i = 0; i < entries.size(); ++i) {
+            if (entries[i]->token != token) continue;
+            EntryPtr entry = entries[i];
+            entries.erase(entries.begin() + i);
+            entry->removed = true;
+            // A listener unsubscribing itself would otherwise wait for its own call
+            const vector<const Entry*>& calling = callingOnThisThread();
+            int own = static_cast<int>(count(calling.begin(), calling.end(), entry.get()));
+            callsDone.wait(guard, [&entry, own]() { return entry->calls == own; });
+            return;
+        }
+    }
+
+    void notify(const Event& event) {
+        vector<EntryPtr> current;
+        {
+            lock_guard<mutex> guard(lock);
+            current = entries;
+        }
+        vector<const Entry*>& calling = callingOnThisThread();
+        for (size_t i = 0; i < current.size(); ++i) {
+            Entry& entry = *current[i];
+            {
+                lock_guard<mutex> guard(lock);
+                if (entry.removed) continue;
+                entry.calls++;
+            }
+            calling.push_back(&entry);
+            entry.listener(event);
+            calling.pop_back();
+            lock_guard<mutex> guard(lock);
+            entry.calls--;
+            if (entry.removed) callsDone.notify_all();
+        }
+    }
+};
@@ -6,9 +6,14 @@
 #include "gui/include/ShoppingCartDialog.h"
 #include "gui/include/UserDashboardDialog.h"
 #include "gui/include/AdminDashboardDialog.h"
+#include "gui/include/StallWatchdog.h"
 #include "include/Product.h"
 #include "include/ShoppingCart.h"
 #include "include/Wishlist.h"
+#include "include/Order.h"
+#include "include/IoStats.h"
+#include "include/Trace.h"
+#include "include/SessionRecorder.h"
 
 #include <QApplication>
 #include <QMenuBar>
@@ -25,6 +30,8 @@
 #include <QStatusBar>
 #include <QLabel>
 #include <QTextStream>
+#include <QFileDialog>
+#include <QPushButton>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent),
@@ -35,6 +42,9 @@ MainWindow::MainWindow(QWidget *parent)
       viewCartAction(nullptr),
       userDashboardAction(nullptr),
       adminDashboardAction(nullptr),
+      traceAction(nullptr),
+      stallReportAction(nullptr),
+      sessionAction(nullptr),
       loginDialog(nullptr),
       registrationDialog(nullptr),
       welcomeLabel(nullptr),
@@ -83,6 +93,13 @@ void MainWindow::createMenusAndToolbar() {
     userDashboardAction = new QAction(tr("&User Dashboard"), this);
     adminDashboardAction = new QAction(tr("&Admin Dashboard"), this);
     logoutAction = new QAction(tr("&Logout"), this);
+    traceAction = new QAction(tr("Record &Trace"), this);
+    traceAction->setCheckable(true);
+    traceAction->setChecked(Trace::isEnabled());
+    stallReportAction = new QAction(tr("&Stall Report"), this);
+    sessionAction = new QAction(tr("Record &Session..."), this);
+    sessionAction->setCheckable(true);
+    sessionAction->setChecked(SessionRecorder::getInstance().isRecording());
 
     connect(loginAction, &QAction::triggered, this, &MainWindow::showLoginDialog);
     connect(registerAction, &QAction::triggered, this, &MainWindow::showRegisterDialog);
@@ -92,12 +109,17 @@ void MainWindow::createMenusAndToolbar() {
     connect(userDashboardAction, &QAction::triggered, this, &MainWindow::showUserDashboardDialog);
     connect(adminDashboardAction, &QAction::triggered, this, &MainWindow::adminDashboard);
     connect(logoutAction, &QAction::triggered, this, &MainWindow::handleLogout);
+    connect(traceAction, &QAction::toggled, this, &MainWindow::toggleTraceRecording);
+    connect(stallReportAction, &QAction::triggered, this, &MainWindow::showStallReport);
+    connect(sessionAction, &QAction::toggled, this, &MainWindow::toggleSessionRecording);
 
     QMenu *fileMenu = menuBar()->addMenu(tr("&File"));
     fileMenu->addAction(loginAction);
     fileMenu->addAction(registerAction);
     fileMenu->addAction(viewProductsAction);
     fileMenu->addSeparator();
+    fileMenu->addAction(sessionAction);
+    fileMenu->addSeparator();
     fileMenu->addAction(exitAction);
 
     QMenu *userMenu = menuBar()->addMenu(tr("&User"));
@@ -108,11 +130,16 @@ void MainWindow::createMenusAndToolbar() {
 
     QMenu *adminMenu = menuBar()->addMenu(tr("&Admin"));
     adminMenu->addAction(adminDashboardAction);
+    adminMenu->addSeparator();
+    adminMenu->addAction(traceAction);
+    adminMenu->addAction(stallReportAction);
 
 
     viewCartAction->setEnabled(false);
     userDashboardAction->setEnabled(false);
     adminDashboardAction->setEnabled(false);
+    traceAction->setEnabled(false);
+    stallReportAction->setEnabled(false);
     logoutAction->setEnabled(false);
 }
 
@@ -138,6 +165,14 @@ void MainWindow::initDataDirectories() {
     if (!dataDir.exists("data/reviews")) {
         dataDir.mkdir("data/reviews");
     }
+
+    // One-time upgrade of a legacy orders.txt into priced, time-partitioned segments
+    if (!Order::migrateLegacyOrders()) {
+        QMessageBox::warning(this, "Orders", "Could not migrate existing orders to the new format.");
+    }
+
+    // Segments of past periods no longer change: seal them read-only and compress them
+    OrderSegmentStore::getInstance().sealCompletedPeriods(true);
 }
 
 void MainWindow::refreshViews() {
@@ -178,6 +213,7 @@ void MainWindow::onUserLoggedIn(int userId, const QString& username, bool isAdmi
     currentUserId = userId;
     currentUsername = username;
     isAdminUser = isAdmin;
+    SessionRecorder::getInstance().record("login", std::to_string(userId));
     
     welcomeLabel->setText("Welcome back, " + currentUsername + "!");
     
@@ -188,6 +224,8 @@ void MainWindow::onUserLoggedIn(int userId, const QString& username, bool isAdmi
     logoutAction->setEnabled(true);
     
     adminDashboardAction->setEnabled(isAdmin);
+    traceAction->setEnabled(isAdmin);
+    stallReportAction->setEnabled(isAdmin);
     
     emit userUpdated(userId);
     
@@ -238,7 +276,7 @@ void MainWindow::viewProducts() {
             dataDir.mkdir("data");
         }
         
-        std::ofstream outFile("data/products.txt");
+        TrackedOfstream outFile(IoStats::Products, "data/products.txt");
         if (outFile.is_open()) {
             outFile << "101,Laptop Pro X,Electronics,1299.99,4.5,10\n";
             outFile << "102,Wireless Mouse,Electronics,24.99,4.2,50\n";
@@ -279,6 +317,7 @@ void MainWindow::viewProducts() {
 }
 
 void MainWindow::showProductDetails(int productId) {
+    SessionRecorder::getInstance().record("view", std::to_string(productId));
     ProductDetailDialog detailDialog(productId, isAuthenticated, currentUserId, this);
     
     connect(&detailDialog, &ProductDetailDialog::addToCartRequested, 
@@ -301,6 +340,7 @@ void MainWindow::handleAddToCart(int productId, int quantity) {
         return;
     }
     
+    SessionRecorder::getInstance().record("cart-add", std::to_string(productId) + " " + std::to_string(quantity));
     ShoppingCart cart(currentUserId);
     
     if (cart.addToCart(productId, quantity)) {
@@ -321,6 +361,7 @@ void MainWindow::handleAddToWishlist(int productId) {
         return;
     }
     
+    SessionRecorder::getInstance().record("wishlist-add", std::to_string(productId));
     Wishlist wishlist(currentUserId);
     
     if (wishlist.addToWishlist(productId)) {
@@ -341,6 +382,7 @@ void MainWindow::showShoppingCartDialog() {
         return;
     }
     
+    SessionRecorder::getInstance().record("cart");
     ShoppingCartDialog cartDialog(currentUserId, this);
     
     connect(&cartDialog, &ShoppingCartDialog::cartUpdated, 
@@ -425,6 +467,66 @@ void MainWindow::adminDashboard() {
     statusLabel->setText("Admin operations completed");
 }
 
+void MainWindow::showStallReport() {
+    StallWatchdog& watchdog = StallWatchdog::getInstance();
+    QString report = QString::fromStdString(watchdog.report(15));
+
+    QMessageBox box(this);
+    box.setWindowTitle("UI Stall Report");
+    box.setText("<pre>" + report.toHtmlEscaped() + "</pre>");
+    QPushButton *resetButton = box.addButton("Reset", QMessageBox::ResetRole);
+    box.addButton(QMessageBox::Close);
+    box.exec();
+    if (box.clickedButton() == resetButton) {
+        watchdog.resetTotals();
+        statusLabel->setText("Stall totals reset");
+    }
+}
+
+void MainWindow::toggleTraceRecording(bool on) {
+    Trace& trace = Trace::getInstance();
+    if (on) {
+        trace.clear();
+        trace.setEnabled(true);
+        statusLabel->setText("Recording trace");
+        return;
+    }
+
+    trace.setEnabled(false);
+    QString path = QFileDialog::getSaveFileName(this, "Save Trace", "trace.json", "Trace Files (*.json)");
+    if (path.isEmpty()) {
+        statusLabel->setText("Trace discarded");
+        return;
+    }
+    if (trace.exportChromeJson(path.toStdString())) {
+        statusLabel->setText("Trace saved to " + path + " (open it in ui.perfetto.dev)");
+    } else {
+        QMessageBox::warning(this, "Trace", "Could not write the trace to " + path + ".");
+    }
+}
+
+void MainWindow::toggleSessionRecording(bool on) {
+    SessionRecorder& recorder = SessionRecorder::getInstance();
+    if (!on) {
+        QString path = QString::fromStdString(recorder.currentPath());
+        long long actions = recorder.actionCount();
+        recorder.stop();
+        statusLabel->setText(QString("Session saved to %1 (%2 actions; replay with ecomcli --replay)").arg(path).arg(actions));
+        return;
+    }
+
+    QString path = QFileDialog::getSaveFileName(this, "Record Session", "session.txt", "Session Files (*.txt)");
+    if (path.isEmpty() || !recorder.start(path.toStdString())) {
+        if (!path.isEmpty()) QMessageBox::warning(this, "Record Session", "Could not write to " + path + ".");
+        sessionAction->blockSignals(true);
+        sessionAction->setChecked(false);
+        sessionAction->blockSignals(false);
+        return;
+    }
+    // Replays act as whoever was logged in when recording began
+    if (isAuthenticated) recorder.record("login", std::to_string(currentUserId));
+    statusLabel->setText("Recording session to " + path);
+}
 
 void MainWindow::onProductDataChanged() {
     if (productListingWidget) {
@@ -473,6 +575,7 @@ void MainWindow::onReviewDataChanged() {
 }
 
 void MainWindow::handleLogout() {
+    SessionRecorder::getInstance().record("logout");
     isAuthenticated = false;
     currentUserId = 0;
     currentUsername = "";
@@ -485,6 +588,8 @@ void MainWindow::handleLogout() {
     viewCartAction->setEnabled(false);
     userDashboardAction->setEnabled(false);
     adminDashboardAction->setEnabled(false);
+    traceAction->setEnabled(false);
+    stallReportAction->setEnabled(false);
     logoutAction->setEnabled(false); 
     
     QMessageBox::information(this, "Logged Out", "You have been successfully logged out.");
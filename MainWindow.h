@@ -69,6 +69,9 @@ private slots:
     void showShoppingCartDialog();
     void showUserDashboardDialog();
     void adminDashboard();
+    void toggleTraceRecording(bool on);
+    void toggleSessionRecording(bool on);
+    void showStallReport();
     
     // Product interaction slots
     void showProductDetails(int productId);
@@ -97,6 +100,9 @@ private:
     QAction *userDashboardAction;
     QAction *adminDashboardAction;
     QAction *logoutAction; // New action for logout button
+    QAction *traceAction; // Admin toggle for span tracing
+    QAction *stallReportAction;
+    QAction *sessionAction; // Records user actions for replay (SessionRecorder.h)
 
     LoginDialog *loginDialog;
     RegistrationDialog *registrationDialog;
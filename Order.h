@@ -8,12 +8,32 @@
 #include <ctime>
 #include <cstdio>
 #include <iomanip>
+#include <vector>
 
 #include "ShoppingCart.h"
 #include "Product.h"
+#include "OrderSegments.h"
+#include "OrderStore.h"
+#include "IdempotencyIndex.h"
+#include "StockReservations.h"
+#include "ShardedStockCounter.h"
+#include "IoStats.h"
+#include "Trace.h"
 
 using namespace std;
 
+// One entry of an order's item list. unitPrice is the price charged at purchase time;
+// it is negative for legacy records that were written before prices were captured.
+struct OrderLineItem {
+    int productID;
+    int quantity;
+    double unitPrice;
+};
+
+// Orders are kept in time-partitioned segments (see OrderSegments.h); every record carries
+// its line items as productID:qty@unitPrice|... plus the order total.
+// A legacy data/orders/orders.txt (orderID,userID,items,date,status[,total]) is upgraded by
+// migrateLegacyOrders() and then imported into segments by OrderSegmentStore::open().
 class Order {
 private:
     int orderID;
@@ -21,6 +41,7 @@ private:
     char* orderItems;
     char* orderDate;
     char* status;
+    double orderTotal;
 
     void allocateAndCopy(char*& dest, const char* src) {
         delete[] dest;
@@ -33,33 +54,10 @@ private:
     }
 
     static int getNextOrderID() {
-        ifstream inFile("data/orders/orders.txt");
-        string line;
-        int maxID = 0;
-        int currentID = 0;
-
-        if (!inFile) {
-            return 1001;
-        }
-
-        while (getline(inFile, line)) {
-            if (line.empty()) continue;
-            stringstream ss(line);
-            string segment;
-
-            if (getline(ss, segment, ',')) {
-                try {
-                     if (!segment.empty()) {
-                        currentID = stoi(segment);
-                        if (currentID > maxID) {
-                            maxID = currentID;
-                        }
-                     }
-                } catch (...) {
-                }
-            }
-        }
-        inFile.close();
+        TRACE_SCOPE("order", "Order::getNextOrderID");
+        // The order index already knows the highest ID; otherwise the segment manifest does
+        OrderStore& store = OrderStore::getInstance();
+        int maxID = store.isLoaded() ? store.maxOrderID() : OrderSegmentStore::getInstance().maxOrderID();
         return (maxID == 0) ? 1001 : maxID + 1;
     }
 
@@ -72,17 +70,19 @@ private:
     }
 
 public:
-    Order() : orderID(0), userID(0), orderItems(nullptr), orderDate(nullptr), status(nullptr) {}
+    Order() : orderID(0), userID(0), orderItems(nullptr), orderDate(nullptr), status(nullptr), orderTotal(0.0) {}
 
     Order(int oid, int uid, const char* items, const char* date, const char* stat) :
-        orderID(oid), userID(uid), orderItems(nullptr), orderDate(nullptr), status(nullptr) {
+        orderID(oid), userID(uid), orderItems(nullptr), orderDate(nullptr), status(nullptr), orderTotal(0.0) {
         allocateAndCopy(orderItems, items);
         allocateAndCopy(orderDate, date);
         allocateAndCopy(status, stat);
+        orderTotal = calculateTotal(orderItems);
     }
 
     Order(const Order& other) :
-        orderID(other.orderID), userID(other.userID), orderItems(nullptr), orderDate(nullptr), status(nullptr) {
+        orderID(other.orderID), userID(other.userID), orderItems(nullptr), orderDate(nullptr), status(nullptr),
+        orderTotal(other.orderTotal) {
         allocateAndCopy(orderItems, other.orderItems);
         allocateAndCopy(orderDate, other.orderDate);
         allocateAndCopy(status, other.status);
@@ -92,6 +92,7 @@ public:
         if (this != &other) {
             orderID = other.orderID;
             userID = other.userID;
+            orderTotal = other.orderTotal;
             allocateAndCopy(orderItems, other.orderItems);
             allocateAndCopy(orderDate, other.orderDate);
             allocateAndCopy(status, other.status);
@@ -110,8 +111,107 @@ public:
     const char* getOrderItems() const { return orderItems; }
     const char* getOrderDate() const { return orderDate; }
     const char* getStatus() const { return status; }
+    double getOrderTotal() const { return orderTotal; }
+
+    // Parses "id:qty@price|id:qty|..." (legacy entries get unitPrice = -1).
+    static vector<OrderLineItem> parseLineItems(const char* items) {
+        vector<OrderLineItem> lineItems;
+        if (!items) return lineItems;
+        const char* cursor = items;
+        while (*cursor) {
+            const char* end = strchr(cursor, '|');
+            if (!end) end = cursor + strlen(cursor);
+            char* parseEnd = nullptr;
+            OrderLineItem item;
+            item.productID = static_cast<int>(strtol(cursor, &parseEnd, 10));
+            item.quantity = 0;
+            item.unitPrice = -1.0;
+            if (parseEnd != cursor && parseEnd < end && *parseEnd == ':') {
+                const char* qtyStart = parseEnd + 1;
+                item.quantity = static_cast<int>(strtol(qtyStart, &parseEnd, 10));
+                if (parseEnd != qtyStart) {
+                    if (parseEnd < end && *parseEnd == '@') {
+                        item.unitPrice = strtod(parseEnd + 1, nullptr);
+                    }
+                    lineItems.push_back(item);
+                }
+            }
+            cursor = (*end == '|') ? end + 1 : end;
+        }
+        return lineItems;
+    }
+
+    static string formatLineItems(const vector<OrderLineItem>& lineItems) {
+        stringstream ss;
+        ss << fixed << setprecision(2);
+        for (size_t i = 0; i < lineItems.size(); ++i) {
+            if (i > 0) ss << "|";
+            ss << lineItems[i].productID << ":" << lineItems[i].quantity;
+            if (lineItems[i].unitPrice >= 0.0) {
+                ss << "@" << lineItems[i].unitPrice;
+            }
+        }
+        return ss.str();
+    }
+
+    // Sum of the captured line prices; needs no product lookups.
+    static double calculateTotal(const char* items) {
+        vector<OrderLineItem> lineItems = parseLineItems(items);
+        double total = 0.0;
+        for (size_t i = 0; i < lineItems.size(); ++i) {
+            if (lineItems[i].unitPrice > 0.0) {
+                total += lineItems[i].unitPrice * lineItems[i].quantity;
+            }
+        }
+        return total;
+    }
+
+    // Total column of an orders.txt line, falling back to the line-item prices if the
+    // line predates the total column.
+    static double parseOrderTotal(const string& totalField, const string& itemsField) {
+        if (!totalField.empty()) {
+            char* parseEnd = nullptr;
+            double total = strtod(totalField.c_str(), &parseEnd);
+            if (parseEnd != totalField.c_str()) return total;
+        }
+        return calculateTotal(itemsField.c_str());
+    }
+
+    static bool migrateLegacyOrders();
+    static bool upgradeLegacyOrderFile();
     
-    int placeOrder(ShoppingCart& cart) {
+    // Places an order for everything in the cart. With an idempotency key (see
+    // IdempotencyIndex.h), a repeat of a checkout that already produced an order returns
+    // that order's ID and takes no stock; a repeat while the first is still running fails.
+    int placeOrder(ShoppingCart& cart, const string& idempotencyKey = string()) {
+        TRACE_SCOPE("order", "Order::placeOrder");
+        if (idempotencyKey.empty()) return placeClaimedOrder(cart, idempotencyKey);
+
+        IdempotencyIndex& keys = IdempotencyIndex::getInstance();
+        IdempotencyIndex::Entry existing;
+        switch (keys.claim(this->userID, idempotencyKey, existing)) {
+            case IdempotencyIndex::Completed:
+                this->orderID = existing.orderID;
+                this->orderTotal = existing.total;
+                cout << "Order already placed for this checkout. Order ID: " << this->orderID << endl;
+                return this->orderID;
+            case IdempotencyIndex::InFlight:
+                cerr << "Error: This checkout is already being processed." << endl;
+                return 0;
+            case IdempotencyIndex::Invalid:
+                cerr << "Error: Invalid idempotency key." << endl;
+                return 0;
+            case IdempotencyIndex::Unknown:
+                break;
+        }
+        int placedID = placeClaimedOrder(cart, idempotencyKey);
+        if (placedID <= 0) keys.release(this->userID, idempotencyKey);
+        return placedID;
+    }
+
+private:
+    // The body of placeOrder; a non-empty key has been claimed by the caller.
+    int placeClaimedOrder(ShoppingCart& cart, const string& idempotencyKey) {
         if (cart.isEmpty()) {
             cerr << "Error: Cannot place order. Shopping cart is empty." << endl;
             return 0;
@@ -127,16 +227,14 @@ public:
              return 0;
         }
 
-        ifstream cartFile(cart.getCartFilename());
+        TrackedIfstream cartFile(IoStats::Carts, cart.getCartFilename());
         
         if (!cartFile) {
             cerr << "Error: Could not open cart file: " << cart.getCartFilename() << endl;
             return 0;
         }
 
-        string itemsString = "";
         string line;
-        bool firstItem = true;
 
         int itemCount = 0;
         while(getline(cartFile, line)) { if (!line.empty()) itemCount++; }
@@ -149,6 +247,8 @@ public:
 
         int* productIDs = new int[itemCount];
         int* quantities = new int[itemCount];
+        int* newStocks = new int[itemCount];
+        double* unitPrices = new double[itemCount];
         int currentItemIndex = 0;
 
         cartFile.clear();
@@ -168,25 +268,36 @@ public:
                  continue;
             }
 
-            if (!firstItem) {
-                itemsString += "|";
-            }
-            itemsString += to_string(prodID) + ":" + to_string(qty);
-            firstItem = false;
-
             productIDs[currentItemIndex] = prodID;
             quantities[currentItemIndex] = qty;
+            newStocks[currentItemIndex] = -1;
+            unitPrices[currentItemIndex] = 0.0;
             currentItemIndex++;
         }
         cartFile.close();
-        allocateAndCopy(this->orderItems, itemsString.c_str());
 
-        ifstream productInFile("data/products.txt");
-        ofstream productTempFile("data/temp_products.txt");
+        // Units other shoppers hold are not for sale; the in-memory catalog rules most
+        // shortfalls out before products.txt is rewritten (see StockReservations.h)
+        StockReservations& reservations = StockReservations::getInstance();
+        ProductCatalog& catalog = ProductCatalog::getInstance();
+        int* othersHeld = new int[itemCount];
+        for (int i = 0; i < currentItemIndex; ++i) {
+            othersHeld[i] = reservations.heldByOthers(this->userID, productIDs[i]);
+            int row = catalog.isLoaded() ? catalog.findRow(productIDs[i]) : -1;
+            if (row >= 0 && quantities[i] > catalog.getStock(row) - othersHeld[i]) {
+                cerr << "Error: Product ID " << productIDs[i] << " is sold out or held by other shoppers. Order cancelled." << endl;
+                delete[] productIDs; delete[] quantities; delete[] newStocks; delete[] unitPrices; delete[] othersHeld;
+                this->orderID = 0;
+                return 0;
+            }
+        }
+
+        TrackedIfstream productInFile(IoStats::Products, "data/products.txt");
+        TrackedOfstream productTempFile(IoStats::Products, "data/temp_products.txt");
         if (!productInFile || !productTempFile) {
             cerr << "Error: Could not open product files for stock update." << endl;
              productInFile.close(); productTempFile.close(); remove("data/temp_products.txt");
-             delete[] productIDs; delete[] quantities;
+             delete[] productIDs; delete[] quantities; delete[] newStocks; delete[] unitPrices; delete[] othersHeld;
             return 0;
         }
         
@@ -210,6 +321,7 @@ public:
                      getline(ss, rating_str, ',');
                      getline(ss, stock_str, ',');
                      try { oldStock = stoi(stock_str); } catch(...) { oldStock = 0; }
+                     try { unitPrices[i] = stod(price_str); } catch(...) { unitPrices[i] = 0.0; }
 
                      int newStock = oldStock - quantities[i];
                      if (newStock < 0) {
@@ -217,9 +329,15 @@ public:
                          stockUpdateSuccessful = false;
                          break;
                      }
+                     if (newStock < othersHeld[i]) {
+                         cerr << "Error: Product ID " << currentProdID << " is held by other shoppers. Order cancelled." << endl;
+                         stockUpdateSuccessful = false;
+                         break;
+                     }
                      
                      productTempFile << currentProdID << "," << name_str << "," << cat_str << "," 
                                      << price_str << "," << rating_str << "," << newStock << endl;
+                     newStocks[i] = newStock;
                      matched = true;
                      break;
                  }
@@ -233,10 +351,24 @@ public:
         }
         productInFile.close();
         productTempFile.close();
-        delete[] productIDs;
+
+        // Capture the price charged for every line, so totals never depend on later catalog edits
+        vector<OrderLineItem> lineItems;
+        for (int i = 0; i < currentItemIndex; ++i) {
+            OrderLineItem item;
+            item.productID = productIDs[i];
+            item.quantity = quantities[i];
+            item.unitPrice = unitPrices[i];
+            lineItems.push_back(item);
+        }
         delete[] quantities;
+        delete[] unitPrices;
+        delete[] othersHeld;
+        allocateAndCopy(this->orderItems, formatLineItems(lineItems).c_str());
+        this->orderTotal = calculateTotal(this->orderItems);
 
         if (!stockUpdateSuccessful) {
+            delete[] productIDs; delete[] newStocks;
             remove("data/temp_products.txt");
              delete[] this->orderItems; this->orderItems = nullptr;
              delete[] this->orderDate; this->orderDate = nullptr;
@@ -246,29 +378,65 @@ public:
 
         if (remove("data/products.txt") != 0 || rename("data/temp_products.txt", "data/products.txt") != 0) {
             cerr << "Error: Failed to update products.txt with new stock levels. Order placement failed." << endl;
+            delete[] productIDs; delete[] newStocks;
             delete[] this->orderItems; this->orderItems = nullptr;
              delete[] this->orderItems; this->orderItems = nullptr;
              delete[] this->orderDate; this->orderDate = nullptr;
              this->orderID = 0;
             return 0;
         }
+        IoStats::add(IoStats::Products, IoStats::TempRewrites);
 
-        ofstream orderFile("data/orders/orders.txt", ios::app);
-        if (!orderFile) {
-            cerr << "Error: Could not open orders.txt to save order." << endl;
+        vector<int> stockChanged;
+        {
+            ProductCatalog::WriteBatch batch(catalog); // Snapshots see all of the order's stock changes or none
+            for (int i = 0; i < currentItemIndex; ++i) {
+                reservations.release(this->userID, productIDs[i]); // The hold became part of the order
+                HotStockCounters::getInstance().adjust(productIDs[i], -lineItems[i].quantity);
+                if (newStocks[i] >= 0 && catalog.setStock(productIDs[i], newStocks[i])) stockChanged.push_back(productIDs[i]);
+            }
+        }
+        for (size_t i = 0; i < stockChanged.size(); ++i) {
+            ChangeFeed::getInstance().publish(EntityType::Product, ChangeKind::Updated, stockChanged[i], ProductField::Stock);
+        }
+        delete[] productIDs;
+        delete[] newStocks;
+
+        allocateAndCopy(this->status, "Complete");
+
+        OrderRecord record;
+        record.orderID = this->orderID;
+        record.userID = this->userID;
+        record.items = this->orderItems;
+        record.timestamp = OrderSegmentStore::toEpochSeconds(this->orderDate);
+        record.status = this->status;
+        record.total = this->orderTotal;
+
+        // The key is logged first, so a crash before the append cannot lose it for a stored order
+        vector<IdempotencyIndex::Completion> completions;
+        if (!idempotencyKey.empty()) {
+            IdempotencyIndex::Completion completion;
+            completion.userID = this->userID;
+            completion.key = idempotencyKey;
+            completion.orderID = this->orderID;
+            completion.total = this->orderTotal;
+            completions.push_back(completion);
+            if (!IdempotencyIndex::getInstance().complete(completions)) {
+                cerr << "Warning: Could not log the idempotency key for order " << this->orderID << "." << endl;
+                IdempotencyIndex::getInstance().release(this->userID, idempotencyKey);
+                completions.clear();
+            }
+        }
+        if (!OrderSegmentStore::getInstance().append(record)) {
+            cerr << "Error: Could not save order to the order segments." << endl;
+            IdempotencyIndex::getInstance().withdraw(completions);
             delete[] this->orderItems; this->orderItems = nullptr;
              delete[] this->orderDate; this->orderDate = nullptr;
              this->orderID = 0;
             return 0;
         }
-        allocateAndCopy(this->status, "Complete");
-        
-        orderFile << this->orderID << "," 
-                  << this->userID << "," 
-                  << this->orderItems << "," 
-                  << this->orderDate << "," 
-                  << this->status << endl;
-        orderFile.close();
+        OrderStore::getInstance().appendOrder(record);
+        ChangeFeed::getInstance().publish(EntityType::Order, ChangeKind::Inserted, this->orderID, OrderField::All);
         
         if (!cart.clearCart()) {
             cerr << "Warning: Order placed (ID: " << this->orderID << ") but failed to clear the shopping cart." << endl;
@@ -278,150 +446,59 @@ public:
         return this->orderID;
     }
 
+public:
+
     static void trackOrder(int orderIDToTrack) {
-        ifstream inFile("data/orders/orders.txt");
-        if (!inFile) {
-            cerr << "Error: Could not open orders file to track order." << endl;
+        TRACE_SCOPE("order", "Order::trackOrder");
+        cout << "\n--- Tracking Order ID: " << orderIDToTrack << " ---" << endl;
+        OrderRecord record;
+        if (!OrderSegmentStore::getInstance().findOrder(orderIDToTrack, record)) {
+            cout << "Order ID " << orderIDToTrack << " not found." << endl;
+            cout << "------------------------------------" << endl;
             return;
         }
 
-        cout << "\n--- Tracking Order ID: " << orderIDToTrack << " ---" << endl;
-        string line;
-        bool found = false;
-        while (getline(inFile, line)) {
-            if (line.empty()) continue;
-            stringstream ss(line);
-            string segment;
-            int currentOrderID;
-
-            getline(ss, segment, ',');
-            try { currentOrderID = stoi(segment); } catch (...) { continue; }
-
-            if (currentOrderID == orderIDToTrack) {
-                found = true;
-                string uid_str, items_str, date_str, status_str;
-                getline(ss, uid_str, ',');
-                getline(ss, items_str, ',');
-                getline(ss, date_str, ',');
-                getline(ss, status_str, ',');
-
-                cout << "Order ID:    " << currentOrderID << endl;
-                cout << "User ID:     " << uid_str << endl;
-                cout << "Order Date:  " << date_str << endl;
-                cout << "Status:      " << status_str << endl;
-                cout << "Items:       " << endl;
-
-                stringstream item_ss(items_str);
-                string item_segment;
-                cout << left << "  " << setw(8) << "ProdID" << setw(8) << "Qty" << setw(25) << "Name" << endl;
-                 cout << "  " << setfill('-') << setw(41) << "" << setfill(' ') << endl;
-
-                while (getline(item_ss, item_segment, '|')) {
-                    stringstream pair_ss(item_segment);
-                    string id_part, qty_part;
-                    int itemID, itemQty;
-                    getline(pair_ss, id_part, ':');
-                    getline(pair_ss, qty_part, ':');
-                    try {
-                         itemID = stoi(id_part);
-                         itemQty = stoi(qty_part);
-                         Product* p = Product::getProductByID(itemID);
-                         cout << left << "  " << setw(8) << itemID 
-                              << setw(8) << itemQty 
-                              << setw(25) << (p ? (p->getName() ? p->getName() : "N/A") : "<Details N/A>") << endl;
-                          delete p;
-                    } catch (...) {
-                        cout << "  <Error parsing item: " << item_segment << ">" << endl;
-                    }
-                }
-                break;
-            }
-        }
-        inFile.close();
+        cout << "Order ID:    " << record.orderID << endl;
+        cout << "User ID:     " << record.userID << endl;
+        cout << "Order Date:  " << OrderSegmentStore::formatEpochSeconds(record.timestamp) << endl;
+        cout << "Status:      " << record.status << endl;
+        cout << "Items:       " << endl;
 
-        if (!found) {
-            cout << "Order ID " << orderIDToTrack << " not found." << endl;
+        cout << left << "  " << setw(8) << "ProdID" << setw(8) << "Qty" << setw(25) << "Name" << endl;
+         cout << "  " << setfill('-') << setw(41) << "" << setfill(' ') << endl;
+
+        vector<OrderLineItem> lineItems = parseLineItems(record.items.c_str());
+        for (size_t i = 0; i < lineItems.size(); ++i) {
+            Product* p = Product::getProductByID(lineItems[i].productID);
+            cout << left << "  " << setw(8) << lineItems[i].productID
+                 << setw(8) << lineItems[i].quantity
+                 << setw(25) << (p ? (p->getName() ? p->getName() : "N/A") : "<Details N/A>") << endl;
+            delete p;
         }
         cout << "------------------------------------" << endl;
     }
 
     static bool updateStatus(int orderIDToUpdate, const char* newStatus) {
+        TRACE_SCOPE("order", "Order::updateStatus");
          if (!newStatus || strlen(newStatus) == 0) {
              cerr << "Error: New status cannot be empty." << endl;
              return false;
          }
 
-        cout << "[Debug] updateStatus called for Order ID: " << orderIDToUpdate << " with Status: " << newStatus << endl;
-
-        ifstream inFile("data/orders/orders.txt");
-        string tempFilenameStr = "data/orders/temp_orders.txt";
-        ofstream tempFile(tempFilenameStr);
-        if (!inFile || !tempFile) {
-            cerr << "Error: Could not open order files for status update." << endl;
-             inFile.close(); tempFile.close(); remove(tempFilenameStr.c_str());
-            return false;
-        }
-
-        string line;
-        bool found = false;
-        while (getline(inFile, line)) {
-            if (line.empty()) continue;
-            stringstream ss(line);
-            string segment;
-            int currentOrderID;
-            
-            streampos lineStartPos = ss.tellg();
-            getline(ss, segment, ',');
-            try { currentOrderID = stoi(segment); } catch (...) { tempFile << line << endl; continue; }
-
-            if (currentOrderID == orderIDToUpdate) {
-                found = true;
-                cout << "[Debug] Found matching Order ID: " << currentOrderID << endl;
-                 string uid_str, items_str, date_str, old_status_ignored;
-                 getline(ss, uid_str, ',');
-                 getline(ss, items_str, ',');
-                 getline(ss, date_str, ',');
-
-                 string updatedLine = to_string(currentOrderID) + "," + uid_str + "," + items_str + "," + date_str + "," + newStatus;
-                 tempFile << updatedLine << endl;
-                 cout << "[Debug] Writing updated line to temp file: " << updatedLine << endl;
-            } else {
-                tempFile << line << endl;
-            }
-        }
-        inFile.close();
-        tempFile.close();
-
-        if (!found) {
+        // Only the segment holding this order is rewritten (or amended, if sealed)
+        if (!OrderSegmentStore::getInstance().updateStatus(orderIDToUpdate, newStatus)) {
             cerr << "Error: Order ID " << orderIDToUpdate << " not found for status update." << endl;
-            remove(tempFilenameStr.c_str());
             return false;
         }
 
-        cout << "[Debug] Attempting to replace original file..." << endl;
-        if (remove("data/orders/orders.txt") != 0) {
-             cerr << "Error: Could not delete original orders file." << endl;
-             remove(tempFilenameStr.c_str());
-             return false;
-        }
-        if (rename(tempFilenameStr.c_str(), "data/orders/orders.txt") != 0) {
-            cerr << "Error: Could not rename temp file to orders.txt." << endl;
-            return false;
-        }
-
-        cout << "[Debug] File replaced successfully." << endl;
+        OrderStore::getInstance().setStatus(orderIDToUpdate, newStatus);
+        ChangeFeed::getInstance().publish(EntityType::Order, ChangeKind::Updated, orderIDToUpdate, OrderField::Status);
         return true;
     }
     
     static void viewAllOrders() {
-         ifstream inFile("data/orders/orders.txt");
-        if (!inFile) {
-            cerr << "Error: Could not open orders file." << endl;
-            return;
-        }
-
+        TRACE_SCOPE("order", "Order::viewAllOrders");
         cout << "\n--- All Orders ---" << endl;
-        string line;
         int orderCount = 0;
 
         cout << left << setw(8) << "Order ID" 
@@ -431,27 +508,16 @@ public:
              << setw(15) << "Status" << endl;
         cout << setfill('-') << setw(91) << "" << setfill(' ') << endl;
 
-        while (getline(inFile, line)) {
-            if (line.empty()) continue;
+        OrderSegmentStore::getInstance().forEach([&orderCount](const OrderRecord& record) {
             orderCount++;
-            stringstream ss(line);
-            string oid_str, uid_str, items_str, date_str, status_str;
-            
-            getline(ss, oid_str, ',');
-            getline(ss, uid_str, ',');
-            getline(ss, items_str, ',');
-            getline(ss, date_str, ',');
-            getline(ss, status_str, ',');
-            
-            string items_summary = items_str.substr(0, 35) + (items_str.length() > 35 ? "..." : "");
-
-            cout << left << setw(8) << oid_str 
-                 << setw(8) << uid_str 
-                 << setw(20) << date_str 
+            string items_summary = record.items.substr(0, 35) + (record.items.length() > 35 ? "..." : "");
+            cout << left << setw(8) << record.orderID 
+                 << setw(8) << record.userID 
+                 << setw(20) << OrderSegmentStore::formatEpochSeconds(record.timestamp) 
                  << setw(40) << items_summary
-                 << setw(15) << status_str << endl;
-        }
-        inFile.close();
+                 << setw(15) << record.status << endl;
+            return true;
+        });
         
         if (orderCount == 0) {
             cout << "No orders found." << endl;
@@ -462,15 +528,8 @@ public:
     }
 
     static void viewOrdersForUser(int userIDToView) {
-         ifstream inFile("data/orders/orders.txt");
-        if (!inFile) {
-            cerr << "Error: Could not open orders file." << endl;
-            return;
-        }
-
+        TRACE_SCOPE("order", "Order::viewOrdersForUser");
         cout << "\n--- Your Order History (User ID: " << userIDToView << ") ---" << endl;
-        string line;
-        int orderCount = 0;
         bool foundOrders = false;
 
         cout << left << setw(8) << "Order ID" 
@@ -479,35 +538,16 @@ public:
              << setw(15) << "Status" << endl;
         cout << setfill('-') << setw(83) << "" << setfill(' ') << endl;
 
-        while (getline(inFile, line)) {
-            if (line.empty()) continue;
-            stringstream ss(line);
-            string oid_str, uid_str, items_str, date_str, status_str;
-            int currentUserID;
-            
-            getline(ss, oid_str, ',');
-            getline(ss, uid_str, ',');
-            getline(ss, items_str, ',');
-            getline(ss, date_str, ',');
-            getline(ss, status_str, ',');
-
-            try {
-                 currentUserID = stoi(uid_str);
-                 if (currentUserID == userIDToView) {
-                     foundOrders = true;
-                     orderCount++;
-                     string items_summary = items_str.substr(0, 35) + (items_str.length() > 35 ? "..." : "");
-
-                     cout << left << setw(8) << oid_str 
-                          << setw(20) << date_str 
-                          << setw(40) << items_summary
-                          << setw(15) << status_str << endl;
-                 }
-            } catch (...) {
-                continue;
-            }
-        }
-        inFile.close();
+        OrderSegmentStore::getInstance().forEach([userIDToView, &foundOrders](const OrderRecord& record) {
+            if (record.userID != userIDToView) return true;
+            foundOrders = true;
+            string items_summary = record.items.substr(0, 35) + (record.items.length() > 35 ? "..." : "");
+            cout << left << setw(8) << record.orderID 
+                 << setw(20) << OrderSegmentStore::formatEpochSeconds(record.timestamp) 
+                 << setw(40) << items_summary
+                 << setw(15) << record.status << endl;
+            return true;
+        });
         
         if (!foundOrders) {
             cout << "No orders found for your account." << endl;
@@ -517,92 +557,121 @@ public:
         cout << "------------------------------------" << endl;
     }
 
-        static int* getProductIDsForOrder(int orderID, int& count) {
+    // Orders placed between two epoch-second bounds (0 leaves a bound open).
+    // Only segments whose time range overlaps are opened.
+    static vector<OrderRecord> getOrdersInRange(long long fromTime, long long toTime) {
+        TRACE_SCOPE("order", "Order::getOrdersInRange");
+        vector<OrderRecord> records;
+        OrderSegmentStore::getInstance().forEachInRange(fromTime, toTime, [&records](const OrderRecord& record) {
+            records.push_back(record);
+            return true;
+        });
+        return records;
+    }
+
+    static int* getProductIDsForOrder(int orderID, int& count) {
+        TRACE_SCOPE("order", "Order::getProductIDsForOrder");
         count = 0;
-        ifstream file("data/orders/orders.txt");
-        if (!file.is_open()) {
-            cerr << "Error: Could not open orders file for reading." << endl;
+        OrderRecord record;
+        if (!OrderSegmentStore::getInstance().findOrder(orderID, record)) {
             return nullptr;
         }
 
-        string line;
-        string productIDsStr;
-        bool orderFound = false;
-
-        while (getline(file, line)) {
-            if (line.empty()) continue;
-            stringstream ss(line);
-            string segment;
-            int currentOrderID = -1;
-
-            if (getline(ss, segment, ',')) {
-                 try {
-                    currentOrderID = stoi(segment);
-                } catch (const invalid_argument& e) {
-                     cerr << "Warning: Could not parse order ID in getProductIDsForOrder: " << segment << endl;
-                     continue;
-                 }
-            } else continue;
-
-            if (currentOrderID == orderID) {
-                if (!getline(ss, segment, ',')) continue;
-
-                if (getline(ss, productIDsStr, ',')) {
-                    orderFound = true;
-                    break;
-                }
-                continue;
-            }
-        }
-        file.close();
-
-        if (!orderFound || productIDsStr.empty()) {
+        vector<OrderLineItem> lineItems = parseLineItems(record.items.c_str());
+        if (lineItems.empty()) {
             return nullptr;
         }
 
-        stringstream count_ss(productIDsStr);
-        string itemSegmentForCount;
-        int tempCount = 0;
-        while (getline(count_ss, itemSegmentForCount, '|')) {
-             if (!itemSegmentForCount.empty()) {
-                 tempCount++;
-             }
+        int* productIDs = new int[lineItems.size()];
+        for (size_t i = 0; i < lineItems.size(); ++i) {
+            productIDs[i] = lineItems[i].productID;
         }
+        count = static_cast<int>(lineItems.size());
+        return productIDs;
+    }
 
-        if (tempCount == 0) {
-            return nullptr;
-        }
+};
 
-       
-        int* productIDs = new int[tempCount];
-        stringstream parse_ss(productIDsStr);
-        string itemSegmentForParse;
-        int index = 0;
-        while (index < tempCount && getline(parse_ss, itemSegmentForParse, '|')) {
-             if (!itemSegmentForParse.empty()) {
-                 stringstream pair_ss(itemSegmentForParse);
-                 string idPart;
-                 if (getline(pair_ss, idPart, ':')) {
-                    try {
-                        productIDs[index++] = stoi(idPart);
-                    } catch (const invalid_argument& e) {
-                        cerr << "Warning: Could not parse product ID from segment: " << idPart << " in item " << itemSegmentForParse << endl;
-                    } catch (const out_of_range& e) {
-                         cerr << "Warning: Product ID out of range from segment: " << idPart << " in item " << itemSegmentForParse << endl;
-                    }
-                 } else {
-                      cerr << "Warning: Malformed item segment (missing ':'): " << itemSegmentForParse << endl;
-                 }
-             }
+// Brings a legacy data/orders/orders.txt up to the current record format and imports it
+// into the order segments. Safe to call on every start-up.
+inline bool Order::migrateLegacyOrders() {
+    TRACE_SCOPE("order", "Order::migrateLegacyOrders");
+    if (!upgradeLegacyOrderFile()) {
+        return false;
+    }
+    return OrderSegmentStore::getInstance().open();
+}
+
+// Upgrades orders.txt lines written before line-item prices were captured.
+// Unknown unit prices are filled from the current catalog (the best information left
+// for those orders) and the total column is appended. Lines already in the current
+// format are copied unchanged, so running this repeatedly is harmless.
+inline bool Order::upgradeLegacyOrderFile() {
+    TRACE_SCOPE("order", "Order::upgradeLegacyOrderFile");
+    TrackedIfstream inFile(IoStats::Orders, "data/orders/orders.txt");
+    if (!inFile) {
+        return true; // Nothing to migrate yet
+    }
+
+    ProductCatalog& catalog = ProductCatalog::getInstance();
+    string tempFilename = "data/orders/temp_orders_migrate.txt";
+    TrackedOfstream tempFile(IoStats::Orders, tempFilename);
+    if (!tempFile) {
+        cerr << "Error: Could not create temporary file for order migration." << endl;
+        return false;
+    }
+
+    string line;
+    int migratedCount = 0;
+    while (getline(inFile, line)) {
+        if (line.empty()) continue;
+        stringstream ss(line);
+        string oid_str, uid_str, items_str, date_str, status_str, total_str;
+        getline(ss, oid_str, ',');
+        getline(ss, uid_str, ',');
+        getline(ss, items_str, ',');
+        getline(ss, date_str, ',');
+        getline(ss, status_str, ',');
+        getline(ss, total_str, ',');
+
+        vector<OrderLineItem> lineItems = parseLineItems(items_str.c_str());
+        bool needsPrices = false;
+        for (size_t i = 0; i < lineItems.size(); ++i) {
+            if (lineItems[i].unitPrice < 0.0) needsPrices = true;
+        }
+        if (!needsPrices && !total_str.empty()) {
+            tempFile << line << endl;
+            continue;
+        }
+
+        if (needsPrices) {
+            catalog.ensureLoaded();
+            for (size_t i = 0; i < lineItems.size(); ++i) {
+                if (lineItems[i].unitPrice < 0.0) {
+                    int row = catalog.findRow(lineItems[i].productID);
+                    lineItems[i].unitPrice = (row >= 0) ? catalog.getPrice(row) : 0.0;
+                }
+            }
+            items_str = formatLineItems(lineItems);
         }
 
-         count = index;
-         if (count == 0) {
-            delete[] productIDs;
-            return nullptr;
-         }
+        tempFile << oid_str << "," << uid_str << "," << items_str << "," << date_str << "," << status_str << ","
+                 << fixed << setprecision(2) << calculateTotal(items_str.c_str()) << endl;
+        migratedCount++;
+    }
+    inFile.close();
+    tempFile.close();
 
-         return productIDs;
+    if (migratedCount == 0) {
+        remove(tempFilename.c_str());
+        return true;
     }
 
-}; 
\ No newline at end of file
+    if (remove("data/orders/orders.txt") != 0 || rename(tempFilename.c_str(), "data/orders/orders.txt") != 0) {
+        cerr << "Error: Could not replace orders.txt during order migration." << endl;
+        return false;
+    }
+    IoStats::add(IoStats::Orders, IoStats::TempRewrites);
+    cout << "Migrated " << migratedCount << " legacy order(s) to the line-item price format." << endl;
+    return true;
+}
@@ -0,0 +1,161 @@
+#include "../include/OrderHistoryWidget.h"
+#include "../../include/ProductCatalog.h"
+#include "../../include/OrderStore.h"
+#include "../../include/Trace.h"
+#include "../../include/StoreLocks.h"
+#include <vector>
+
+OrderHistoryWidget::OrderHistoryWidget(int userId, QWidget *parent)
+    : QWidget(parent), userId(userId)
+{
+    setupUI();
+
+    connect(viewDetailsButton, &QPushButton::clicked, this, &OrderHistoryWidget::handleViewOrderDetails);
+    connect(trackOrderButton, &QPushButton::clicked, this, &OrderHistoryWidget::handleTrackOrder);
+    connect(refreshButton, &QPushButton::clicked, this, &OrderHistoryWidget::handleRefreshOrders);
+    connect(ordersTableWidget, &QTableWidget::cellDoubleClicked, this, &OrderHistoryWidget::handleViewOrderDetails);
+
+    loadOrderHistory();
+}
+
+OrderHistoryWidget::~OrderHistoryWidget()
+{
+    // Qt handles cleanup of child widgets
+}
+
+void OrderHistoryWidget::setupUI()
+{
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+
+    QLabel *titleLabel = new QLabel("<h2>My Orders</h2>", this);
+    titleLabel->setAlignment(Qt::AlignCenter);
+    mainLayout->addWidget(titleLabel);
+
+    ordersTableWidget = new QTableWidget(this);
+    ordersTableWidget->setColumnCount(5);
+    ordersTableWidget->setHorizontalHeaderLabels({"Order ID", "Date", "Items", "Total", "Status"});
+    ordersTableWidget->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    ordersTableWidget->setSelectionBehavior(QAbstractItemView::SelectRows);
+    ordersTableWidget->setSelectionMode(QAbstractItemView::SingleSelection);
+    ordersTableWidget->setEditTriggers(QAbstractItemView::NoEditTriggers); // Read-only
+    ordersTableWidget->setAlternatingRowColors(true);
+    mainLayout->addWidget(ordersTableWidget);
+
+    QHBoxLayout *buttonLayout = new QHBoxLayout();
+
+    viewDetailsButton = new QPushButton("View Details", this);
+    trackOrderButton = new QPushButton("Track Order", this);
+    refreshButton = new QPushButton("Refresh", this);
+
+    buttonLayout->addWidget(viewDetailsButton);
+    buttonLayout->addWidget(trackOrderButton);
+    buttonLayout->addStretch();
+    buttonLayout->addWidget(refreshButton);
+
+    mainLayout->addLayout(buttonLayout);
+
+    setLayout(mainLayout);
+}
+
+void OrderHistoryWidget::loadOrderHistory()
+{
+    TRACE_SCOPE("ui", "OrderHistoryWidget::loadOrderHistory");
+    ordersTableWidget->setRowCount(0);
+
+    // The user index answers this directly; totals are the ones captured at checkout
+    OrderStore &store = OrderStore::getInstance();
+    bool loaded;
+    {
+        // Checkouts append to the order segments on their own threads
+        StoreLockSet locks;
+        locks.add(IoStats::Orders, StoreLocks::Shared);
+        locks.acquire();
+        loaded = store.ensureLoaded();
+    }
+    if (!loaded) {
+        return;
+    }
+    OrderQuery query;
+    query.userID = userId;
+    query.limit = 0;
+    OrderPage page = store.query(query);
+
+    ordersTableWidget->setRowCount(static_cast<int>(page.rows.size()));
+    for (int row = 0; row < static_cast<int>(page.rows.size()); ++row) {
+        int storeRow = page.rows[row];
+        ordersTableWidget->setItem(row, 0, new QTableWidgetItem(QString::number(store.getOrderID(storeRow))));
+        ordersTableWidget->setItem(row, 1, new QTableWidgetItem(
+            QString::fromStdString(OrderSegmentStore::formatEpochSeconds(store.getTimestamp(storeRow)))));
+        ordersTableWidget->setItem(row, 2, new QTableWidgetItem(QString::number(store.getItemCount(storeRow))));
+        ordersTableWidget->setItem(row, 3, new QTableWidgetItem("$" + QString::number(store.getTotal(storeRow), 'f', 2)));
+        ordersTableWidget->setItem(row, 4, new QTableWidgetItem(QString::fromStdString(store.getStatus(storeRow))));
+    }
+}
+
+void OrderHistoryWidget::handleViewOrderDetails()
+{
+    int row = ordersTableWidget->currentRow();
+    if (row < 0) {
+        QMessageBox::warning(this, "Order Details", "Please select an order to view.");
+        return;
+    }
+
+    // Line items live only in the order's segment; the ID ranges lead straight to it
+    int orderId = ordersTableWidget->item(row, 0)->text().toInt();
+    OrderRecord record;
+    bool found;
+    {
+        // Checkouts append to the segments on their own threads
+        StoreLockSet locks;
+        locks.add(IoStats::Orders, StoreLocks::Shared);
+        locks.acquire();
+        found = OrderSegmentStore::getInstance().findOrder(orderId, record);
+    }
+    if (!found) {
+        QMessageBox::warning(this, "Order Details", "Could not find this order.");
+        return;
+    }
+    std::vector<OrderLineItem> lineItems = Order::parseLineItems(record.items.c_str());
+
+    // Names are display-only and come from the in-memory catalog; prices are the ones charged
+    ProductCatalog::getInstance().ensureLoaded();
+    std::shared_ptr<const CatalogSnapshot> catalog = ProductCatalog::getInstance().snapshot();
+
+    QString details = QString("Order ID: %1\nDate: %2\nStatus: %3\n\nItems:\n")
+                          .arg(QString::number(orderId),
+                               ordersTableWidget->item(row, 1)->text(),
+                               ordersTableWidget->item(row, 4)->text());
+    for (size_t i = 0; i < lineItems.size(); ++i) {
+        int catalogRow = catalog->findSlot(lineItems[i].productID);
+        QString name = (catalogRow >= 0) ? QString::fromUtf8(catalog->getName(catalogRow))
+                                         : QString("Product #%1").arg(lineItems[i].productID);
+        double unitPrice = lineItems[i].unitPrice > 0.0 ? lineItems[i].unitPrice : 0.0;
+        details += QString("  %1 x%2 @ $%3 = $%4\n")
+                       .arg(name)
+                       .arg(lineItems[i].quantity)
+                       .arg(unitPrice, 0, 'f', 2)
+                       .arg(unitPrice * lineItems[i].quantity, 0, 'f', 2);
+    }
+    details += "\nTotal: " + ordersTableWidget->item(row, 3)->text();
+
+    QMessageBox::information(this, "Order Details", details);
+}
+
+void OrderHistoryWidget::handleTrackOrder()
+{
+    int row = ordersTableWidget->currentRow();
+    if (row < 0) {
+        QMessageBox::warning(this, "Track Order", "Please select an order to track.");
+        return;
+    }
+
+    QMessageBox::information(this, "Track Order",
+                             QString("Order %1 is currently: %2")
+                                 .arg(ordersTableWidget->item(row, 0)->text(),
+                                      ordersTableWidget->item(row, 4)->text()));
+}
+
+void OrderHistoryWidget::handleRefreshOrders()
+{
+    loadOrderHistory();
+}
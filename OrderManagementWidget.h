@@ -2,18 +2,25 @@
 #define ORDERMANAGEMENTWIDGET_H
 
 #include <QWidget>
-#include <QTableWidget>
+#include <QTableView>
 #include <QPushButton>
+#include <QComboBox>
+#include <QLabel>
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QHeaderView>
 #include <QMessageBox>
-#include <QInputDialog>
-#include <sstream>
+#include <QItemSelectionModel>
+#include <QStringList>
 #include <string>
-#include <fstream>
 #include "UpdateOrderStatusDialog.h"
+#include "OrderTableModel.h"
 #include "../../include/Order.h" // Include actual Order class
+#include "../../include/OrderStore.h"
+#include "../../include/StoreLocks.h"
+#include "../../include/Trace.h"
+#include "../../include/StoreLocks.h"
+#include "../../include/SessionRecorder.h"
 
 class OrderManagementWidget : public QWidget
 {
@@ -26,13 +33,18 @@ public:
 private slots:
     inline void handleUpdateStatus();
     inline void handleRefresh(); // New method to refresh order list
+    inline void handleStatusFilterChanged(int index);
 
 private:
-    inline void loadOrders(); // Modified to use actual Order class
+    inline void loadOrders(); // Loads the order index and shows the first page
     inline void setupUi();
-    inline double calculateOrderTotal(const char* orderItems); // Helper to calculate order total
+    inline void populateStatusFilter();
+    inline void updateCountLabel();
 
-    QTableWidget *ordersTable;
+    QTableView *ordersTable;
+    OrderTableModel *ordersModel;
+    QComboBox *statusFilterComboBox;
+    QLabel *orderCountLabel;
     QPushButton *updateStatusButton;
     QPushButton *refreshButton; // New refresh button
 };
@@ -49,13 +61,26 @@ inline OrderManagementWidget::~OrderManagementWidget() {}
 inline void OrderManagementWidget::setupUi() {
     QVBoxLayout *mainLayout = new QVBoxLayout(this);
 
-    ordersTable = new QTableWidget(this);
-    ordersTable->setColumnCount(5); // ID, UserID, Date, Total, Status
-    ordersTable->setHorizontalHeaderLabels({"Order ID", "User ID", "Date", "Total", "Status"});
+    QHBoxLayout *filterLayout = new QHBoxLayout();
+    statusFilterComboBox = new QComboBox(this);
+    orderCountLabel = new QLabel(this);
+    filterLayout->addWidget(new QLabel("Status:", this));
+    filterLayout->addWidget(statusFilterComboBox);
+    filterLayout->addStretch();
+    filterLayout->addWidget(orderCountLabel);
+    mainLayout->addLayout(filterLayout);
+
+    // Pages of the order index are fetched as the user scrolls
+    ordersModel = new OrderTableModel(this);
+    ordersTable = new QTableView(this);
+    ordersTable->setModel(ordersModel);
     ordersTable->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
     ordersTable->setSelectionBehavior(QAbstractItemView::SelectRows);
     ordersTable->setSelectionMode(QAbstractItemView::SingleSelection);
     ordersTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    ordersTable->verticalHeader()->setVisible(false);
+    ordersTable->setSortingEnabled(true);
+    ordersTable->horizontalHeader()->setSortIndicator(OrderTableModel::IdColumn, Qt::AscendingOrder);
     mainLayout->addWidget(ordersTable);
 
     QHBoxLayout *buttonLayout = new QHBoxLayout();
@@ -70,124 +95,91 @@ inline void OrderManagementWidget::setupUi() {
 
     connect(updateStatusButton, &QPushButton::clicked, this, &OrderManagementWidget::handleUpdateStatus);
     connect(refreshButton, &QPushButton::clicked, this, &OrderManagementWidget::handleRefresh);
+    connect(statusFilterComboBox, QOverload<int>::of(&QComboBox::activated), this, &OrderManagementWidget::handleStatusFilterChanged);
+    connect(ordersModel, &QAbstractItemModel::rowsInserted, this, &OrderManagementWidget::updateCountLabel);
+    connect(ordersModel, &QAbstractItemModel::rowsRemoved, this, &OrderManagementWidget::updateCountLabel);
+    connect(ordersModel, &QAbstractItemModel::modelReset, this, &OrderManagementWidget::updateCountLabel);
 }
 
-inline double OrderManagementWidget::calculateOrderTotal(const char* orderItems) {
-    if (!orderItems) return 0.0;
-    
-    double total = 0.0;
-    std::string items(orderItems);
-    std::stringstream ss(items);
-    std::string item;
-    
-    // Format: "productID1:qty1|productID2:qty2|..."
-    while (std::getline(ss, item, '|')) {
-        std::stringstream itemStream(item);
-        std::string idStr, qtyStr;
-        if (std::getline(itemStream, idStr, ':') && std::getline(itemStream, qtyStr)) {
-            try {
-                int productId = std::stoi(idStr);
-                int quantity = std::stoi(qtyStr);
-                
-                // Get product price from Product class
-                Product* product = Product::getProductByID(productId);
-                if (product) {
-                    total += product->getPrice() * quantity;
-                    delete product;
-                }
-            } catch (...) {
-                // Skip invalid entries
-            }
+inline void OrderManagementWidget::populateStatusFilter() {
+    QString previous = statusFilterComboBox->currentText();
+
+    QStringList statuses;
+    for (const std::string &status : OrderStore::getInstance().getStatuses()) {
+        if (!status.empty()) {
+            statuses << QString::fromStdString(status);
         }
     }
-    
-    return total;
+    statuses.sort(Qt::CaseInsensitive);
+
+    statusFilterComboBox->blockSignals(true);
+    statusFilterComboBox->clear();
+    statusFilterComboBox->addItem("All Statuses");
+    statusFilterComboBox->addItems(statuses);
+    int previousIndex = statusFilterComboBox->findText(previous);
+    statusFilterComboBox->setCurrentIndex(previousIndex >= 0 ? previousIndex : 0);
+    statusFilterComboBox->blockSignals(false);
 }
 
-inline void OrderManagementWidget::loadOrders() {
-    ordersTable->setRowCount(0); // Clear existing rows
-    
-    // Read orders directly from the file
-    std::ifstream inFile("data/orders/orders.txt");
-    if (!inFile.is_open()) {
-        QMessageBox::warning(this, "Order Management", "No orders found or could not open orders file.");
-        return;
+inline void OrderManagementWidget::updateCountLabel() {
+    int total = ordersModel->matchingOrderCount();
+    if (total >= 0) {
+        orderCountLabel->setText(QString("Showing %1 of %2 orders").arg(ordersModel->rowCount()).arg(total));
+    } else {
+        orderCountLabel->setText(QString("Showing %1 orders").arg(ordersModel->rowCount()));
     }
-    
-    std::string line;
-    int row = 0;
-    
-    // First count the number of rows to set the table size
-    int orderCount = 0;
-    while (std::getline(inFile, line)) {
-        if (!line.empty()) orderCount++;
+}
+
+inline void OrderManagementWidget::loadOrders() {
+    TRACE_SCOPE("ui", "OrderManagementWidget::loadOrders");
+    OrderStore &store = OrderStore::getInstance();
+    bool loaded;
+    {
+        // Checkouts append to the order segments on their own threads
+        StoreLockSet locks;
+        locks.add(IoStats::Orders, StoreLocks::Shared);
+        locks.acquire();
+        loaded = store.load();
     }
-    
-    // Reset file position to beginning
-    inFile.clear();
-    inFile.seekg(0, std::ios::beg);
-    
-    if (orderCount == 0) {
-        QMessageBox::information(this, "Order Management", "No orders found in the system.");
-        inFile.close();
+    if (!loaded) {
+        QMessageBox::warning(this, "Order Management", "Could not load the orders file.");
         return;
     }
-    
-    ordersTable->setRowCount(orderCount);
-    
-    while (std::getline(inFile, line)) {
-        if (line.empty()) continue;
-        
-        std::stringstream ss(line);
-        std::string oid_str, uid_str, items_str, date_str, status_str;
-        
-        std::getline(ss, oid_str, ',');
-        std::getline(ss, uid_str, ',');
-        std::getline(ss, items_str, ',');
-        std::getline(ss, date_str, ',');
-        std::getline(ss, status_str, ',');
-        
-        try {
-            int orderId = std::stoi(oid_str);
-            int userId = std::stoi(uid_str);
-            
-            // Calculate order total from items
-            double total = calculateOrderTotal(items_str.c_str());
-            
-            // Set table items
-            ordersTable->setItem(row, 0, new QTableWidgetItem(QString::number(orderId)));
-            ordersTable->setItem(row, 1, new QTableWidgetItem(QString::number(userId)));
-            ordersTable->setItem(row, 2, new QTableWidgetItem(QString::fromStdString(date_str)));
-            ordersTable->setItem(row, 3, new QTableWidgetItem(QString::number(total, 'f', 2)));
-            ordersTable->setItem(row, 4, new QTableWidgetItem(QString::fromStdString(status_str)));
-            
-            row++;
-        } catch (...) {
-            // Skip invalid entries
-        }
-    }
-    
-    inFile.close();
+    populateStatusFilter();
+    handleStatusFilterChanged(statusFilterComboBox->currentIndex());
+}
+
+inline void OrderManagementWidget::handleStatusFilterChanged(int index) {
+    // Served by the store's status index; the header sort is kept
+    ordersModel->setStatusFilter(index <= 0 ? QString() : statusFilterComboBox->currentText());
 }
 
 inline void OrderManagementWidget::handleUpdateStatus() {
-    QList<QTableWidgetItem*> selectedItems = ordersTable->selectedItems();
-    if (selectedItems.isEmpty()) {
+    QModelIndexList selectedRows = ordersTable->selectionModel()->selectedRows();
+    if (selectedRows.isEmpty()) {
         QMessageBox::warning(this, "Update Status", "Please select an order to update.");
         return;
     }
 
-    int selectedRow = selectedItems.first()->row();
-    int orderId = ordersTable->item(selectedRow, 0)->text().toInt();
-    QString currentStatus = ordersTable->item(selectedRow, 4)->text();
+    int selectedRow = selectedRows.first().row();
+    int orderId = ordersModel->orderIdAt(selectedRow);
+    QString currentStatus = ordersModel->statusAt(selectedRow);
 
     UpdateOrderStatusDialog dialog(orderId, currentStatus, this);
     if (dialog.exec() == QDialog::Accepted) {
         QString newStatus = dialog.getNewStatus();
-        // Call the actual Order class method
-        if (Order::updateStatus(orderId, newStatus.toStdString().c_str())) {
+        SessionRecorder::getInstance().record("order-status", std::to_string(orderId) + " " + newStatus.toStdString());
+        // Call the actual Order class method, holding off checkouts that append to the segments
+        bool updated;
+        {
+            StoreLockSet locks;
+            locks.add(IoStats::Orders, StoreLocks::Exclusive);
+            locks.acquire();
+            updated = Order::updateStatus(orderId, newStatus.toStdString().c_str());
+        }
+        if (updated) {
             QMessageBox::information(this, "Update Status", "Order status updated successfully.");
-            loadOrders(); // Refresh the table
+            populateStatusFilter(); // The row itself is patched through the change feed
         } else {
             QMessageBox::critical(this, "Update Status", "Failed to update order status.");
         }
@@ -198,4 +190,4 @@ inline void OrderManagementWidget::handleRefresh() {
     loadOrders();
 }
 
-#endif // ORDERMANAGEMENTWIDGET_H 
\ No newline at end of file
+#endif // ORDERMANAGEMENTWIDGET_H
@@ -0,0 +1,745 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <ctime>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <functional>
+#include <iomanip>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include "IoStats.h"
+#include "Trace.h"
+
+using namespace std;
+
+// One order as stored in a segment:
+//   orderID,userID,productID:qty@unitPrice|...,epochSeconds,status,orderTotal
+struct OrderRecord {
+    int orderID;
+    int userID;
+    string items;
+    long long timestamp; // Seconds since the Unix epoch
+    string status;
+    double total;
+
+    OrderRecord() : orderID(0), userID(0), timestamp(0), total(0.0) {}
+};
+
+// Time span covered by one segment file.
+enum class OrderPartition {
+    Daily,
+    Monthly,
+    Yearly
+};
+
+// Durable order storage, partitioned by order time.
+// data/orders/segments/ holds one file per period (orders_2025-05.seg for monthly
+// partitions) plus a manifest with each segment's time range, order-ID range, row count
+// and state. Every segment has a sparse index (orders_<period>.idx) with one entry per
+// IndexStride records: byte offset, time range and ID range of that block. A date-range
+// scan opens only the segments whose range overlaps and seeks straight to the first
+// overlapping block; a lookup by ID does the same with the ID ranges.
+//
+// Segments for completed periods can be sealed (read-only) and then compressed with zlib.
+// Status changes to orders in a sealed segment go to an append-only amendments file that
+// readers apply on top of the segment, so sealed files are never rewritten.
+// The partition span is fixed when the manifest is first created.
+class OrderSegmentStore {
+public:
+    typedef function<bool(const OrderRecord&)> RecordVisitor; // Return false to stop
+
+    static constexpr int IndexStride = 64;
+
+private:
+    struct SegmentInfo {
+        string period;
+        long long minTime;
+        long long maxTime;
+        int minOrderID;
+        int maxOrderID;
+        int count;
+        bool sealed;
+        bool compressed;
+    };
+
+    struct IndexBlock {
+        long long offset;
+        long long minTime;
+        long long maxTime;
+        int minOrderID;
+        int maxOrderID;
+        int count;
+    };
+
+    vector<SegmentInfo> segments; // Ascending by period
+    unordered_map<string, vector<IndexBlock>> indexCache;
+    unordered_map<int, string> statusAmendments;
+    OrderPartition partition;
+    bool opened;
+
+    OrderSegmentStore() : partition(OrderPartition::Monthly), opened(false) {}
+
+    static string segmentDir() { return "data/orders/segments/"; }
+    static string manifestPath() { return segmentDir() + "manifest.txt"; }
+    static string amendmentsPath() { return segmentDir() + "amendments.txt"; }
+    static string dataPath(const SegmentInfo& info) {
+        return segmentDir() + "orders_" + info.period + (info.compressed ? ".seg.z" : ".seg");
+    }
+    static string indexPath(const string& period) { return segmentDir() + "orders_" + period + ".idx"; }
+
+    static const char* partitionName(OrderPartition value) {
+        switch (value) {
+        case OrderPartition::Daily: return "daily";
+        case OrderPartition::Yearly: return "yearly";
+        default: return "monthly";
+        }
+    }
+
+    static bool fileExists(const string& path) {
+        struct stat info;
+        return stat(path.c_str(), &info) == 0;
+    }
+
+    static long long fileSize(const string& path) {
+        struct stat info;
+        return (stat(path.c_str(), &info) == 0) ? static_cast<long long>(info.st_size) : 0;
+    }
+
+    SegmentInfo* findSegment(const string& period) {
+        for (size_t i = 0; i < segments.size(); ++i) {
+            if (segments[i].period == period) return &segments[i];
+        }
+        return nullptr;
+    }
+
+    // Period of the open segment a new record goes to, creating the segment if needed.
+    string appendTarget(long long timestamp) {
+        string period = periodOf(timestamp);
+        SegmentInfo* info = findSegment(period);
+        if (info && !info->sealed) return period;
+        if (info) {
+            for (size_t i = segments.size(); i-- > 0;) {
+                if (!segments[i].sealed) return segments[i].period;
+            }
+            period = periodOf(static_cast<long long>(time(nullptr)));
+            info = findSegment(period);
+            if (info && !info->sealed) return period;
+            if (info) period += "-late";
+        }
+        if (!findSegment(period)) {
+            SegmentInfo created = {period, 0, 0, 0, 0, 0, false, false};
+            segments.push_back(created);
+            sort(segments.begin(), segments.end(),
+                 [](const SegmentInfo& a, const SegmentInfo& b) { return a.period < b.period; });
+        }
+        return period;
+    }
+
+    static void widen(SegmentInfo& info, const OrderRecord& record) {
+        if (info.count == 0) {
+            info.minTime = info.maxTime = record.timestamp;
+            info.minOrderID = info.maxOrderID = record.orderID;
+        } else {
+            info.minTime = min(info.minTime, record.timestamp);
+            info.maxTime = max(info.maxTime, record.timestamp);
+            info.minOrderID = min(info.minOrderID, record.orderID);
+            info.maxOrderID = max(info.maxOrderID, record.orderID);
+        }
+        info.count++;
+    }
+
+    static void widen(IndexBlock& block, const OrderRecord& record) {
+        if (block.count == 0) {
+            block.minTime = block.maxTime = record.timestamp;
+            block.minOrderID = block.maxOrderID = record.orderID;
+        } else {
+            block.minTime = min(block.minTime, record.timestamp);
+            block.maxTime = max(block.maxTime, record.timestamp);
+            block.minOrderID = min(block.minOrderID, record.orderID);
+            block.maxOrderID = max(block.maxOrderID, record.orderID);
+        }
+        block.count++;
+    }
+
+    bool saveManifest() {
+        string tempPath = segmentDir() + "manifest.tmp";
+        TrackedOfstream out(IoStats::Orders, tempPath);
+        if (!out) {
+            cerr << "Error: Could not write order segment manifest." << endl;
+            return false;
+        }
+        out << "partition," << partitionName(partition) << endl;
+        for (size_t i = 0; i < segments.size(); ++i) {
+            const SegmentInfo& info = segments[i];
+            out << info.period << "," << info.minTime << "," << info.maxTime << ","
+                << info.minOrderID << "," << info.maxOrderID << "," << info.count << ","
+                << (info.compressed ? "compressed" : (info.sealed ? "sealed" : "open")) << endl;
+        }
+        out.close();
+        remove(manifestPath().c_str());
+        if (rename(tempPath.c_str(), manifestPath().c_str()) != 0) return false;
+        IoStats::add(IoStats::Orders, IoStats::TempRewrites);
+        return true;
+    }
+
+    bool loadManifest() {
+        TrackedIfstream in(IoStats::Orders, manifestPath());
+        if (!in) return false;
+        segments.clear();
+        string line;
+        while (getline(in, line)) {
+            if (line.empty()) continue;
+            stringstream ss(line);
+            string field;
+            getline(ss, field, ',');
+            if (field == "partition") {
+                getline(ss, field, ',');
+                partition = (field == "daily") ? OrderPartition::Daily
+                          : (field == "yearly") ? OrderPartition::Yearly : OrderPartition::Monthly;
+                continue;
+            }
+            SegmentInfo info;
+            info.period = field;
+            string minTime, maxTime, minID, maxID, count, state;
+            getline(ss, minTime, ',');
+            getline(ss, maxTime, ',');
+            getline(ss, minID, ',');
+            getline(ss, maxID, ',');
+            getline(ss, count, ',');
+            getline(ss, state, ',');
+            info.minTime = atoll(minTime.c_str());
+            info.maxTime = atoll(maxTime.c_str());
+            info.minOrderID = atoi(minID.c_str());
+            info.maxOrderID = atoi(maxID.c_str());
+            info.count = atoi(count.c_str());
+            info.compressed = (state == "compressed");
+            info.sealed = info.compressed || state == "sealed";
+            segments.push_back(info);
+        }
+        return true;
+    }
+
+    void loadAmendments() {
+        statusAmendments.clear();
+        TrackedIfstream in(IoStats::Orders, amendmentsPath());
+        string line;
+        while (getline(in, line)) {
+            size_t comma = line.find(',');
+            if (comma == string::npos) continue;
+            statusAmendments[atoi(line.c_str())] = line.substr(comma + 1); // Later lines win
+        }
+    }
+
+    const vector<IndexBlock>& indexFor(const string& period) {
+        auto it = indexCache.find(period);
+        IoStats::cacheLookup(IoStats::Orders, it != indexCache.end());
+        if (it != indexCache.end()) return it->second;
+        vector<IndexBlock>& blocks = indexCache[period];
+        TrackedIfstream in(IoStats::Orders, indexPath(period));
+        string line;
+        while (getline(in, line)) {
+            if (line.empty()) continue;
+            IndexBlock block;
+            if (sscanf(line.c_str(), "%lld,%lld,%lld,%d,%d,%d", &block.offset, &block.minTime, &block.maxTime,
+                       &block.minOrderID, &block.maxOrderID, &block.count) == 6) {
+                blocks.push_back(block);
+            }
+        }
+        return blocks;
+    }
+
+    bool saveIndex(const string& period, const vector<IndexBlock>& blocks) {
+        TrackedOfstream out(IoStats::Orders, indexPath(period));
+        if (!out) return false;
+        for (size_t i = 0; i < blocks.size(); ++i) {
+            out << blocks[i].offset << "," << blocks[i].minTime << "," << blocks[i].maxTime << ","
+                << blocks[i].minOrderID << "," << blocks[i].maxOrderID << "," << blocks[i].count << "\n";
+        }
+        indexCache[period] = blocks;
+        return true;
+    }
+
+    // Writes a whole plain segment and its index; used by import and status rewrites.
+    bool writeSegment(SegmentInfo& info, const vector<OrderRecord>& records) {
+        string finalPath = dataPath(info);
+        string tempPath = finalPath + ".tmp";
+        TrackedOfstream out(IoStats::Orders, tempPath);
+        if (!out) {
+            cerr << "Error: Could not write order segment " << info.period << "." << endl;
+            return false;
+        }
+        vector<IndexBlock> blocks;
+        info.count = 0;
+        long long offset = 0;
+        for (size_t i = 0; i < records.size(); ++i) {
+            if (blocks.empty() || blocks.back().count == IndexStride) {
+                IndexBlock block;
+                block.offset = offset;
+                block.count = 0;
+                blocks.push_back(block);
+            }
+            string line = formatRecord(records[i]);
+            out << line << "\n";
+            offset += static_cast<long long>(line.length()) + 1;
+            widen(blocks.back(), records[i]);
+            widen(info, records[i]);
+        }
+        out.close();
+        remove(finalPath.c_str());
+        if (rename(tempPath.c_str(), finalPath.c_str()) != 0) {
+            cerr << "Error: Could not replace order segment " << info.period << "." << endl;
+            return false;
+        }
+        IoStats::add(IoStats::Orders, IoStats::TempRewrites);
+        return saveIndex(info.period, blocks);
+    }
+
+    bool readCompressed(const SegmentInfo& info, string& content) {
+        TrackedIfstream in(IoStats::Orders, dataPath(info), ios::binary);
+        if (!in) {
+            cerr << "Error: Could not open order segment " << info.period << "." << endl;
+            return false;
+        }
+        unsigned long long rawSize = 0;
+        in.read(reinterpret_cast<char*>(&rawSize), sizeof(rawSize));
+        string packed((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+        content.resize(rawSize);
+        uLongf destLength = static_cast<uLongf>(rawSize);
+        if (uncompress(reinterpret_cast<Bytef*>(&content[0]), &destLength,
+                       reinterpret_cast<const Bytef*>(packed.data()), packed.size()) != Z_OK ||
+            destLength != rawSize) {
+            cerr << "Error: Could not decompress order segment " << info.period << "." << endl;
+            return false;
+        }
+        return true;
+    }
+
+    enum ScanResult { ScanDone, ScanStopped, ScanFailed };
+
+    // Reads the blocks of one segment that pass the block filter, record by record. A
+    // segment that can't be read (a missing file, a corrupt archive) is logged and
+    // reported as ScanFailed, never as an empty one.
+    ScanResult scanSegment(const SegmentInfo& info, const function<bool(const IndexBlock&)>& blockFilter,
+                           const RecordVisitor& visit) {
+        const vector<IndexBlock>& blocks = indexFor(info.period);
+        string content;
+        TrackedIfstream plainFile(IoStats::Orders);
+        istringstream compressedStream;
+        istream* in = nullptr;
+        if (info.compressed) {
+            if (!readCompressed(info, content)) return ScanFailed;
+            compressedStream.str(content);
+            in = &compressedStream;
+        } else {
+            plainFile.open(dataPath(info));
+            if (!plainFile) {
+                cerr << "Error: Could not open order segment " << info.period << "." << endl;
+                return ScanFailed;
+            }
+            in = &plainFile;
+        }
+
+        string line;
+        OrderRecord record;
+        for (size_t b = 0; b < blocks.size(); ++b) {
+            if (!blockFilter(blocks[b])) continue;
+            in->clear();
+            in->seekg(blocks[b].offset);
+            for (int i = 0; i < blocks[b].count && getline(*in, line); ++i) {
+                if (!parseRecord(line, record)) continue;
+                if (info.sealed) {
+                    auto amended = statusAmendments.find(record.orderID);
+                    if (amended != statusAmendments.end()) record.status = amended->second;
+                }
+                if (!visit(record)) return ScanStopped;
+            }
+        }
+        return ScanDone;
+    }
+
+    // Segment holding an order, narrowed by the manifest and index ID ranges.
+    SegmentInfo* locateOrder(int orderID, OrderRecord& result) {
+        for (size_t i = 0; i < segments.size(); ++i) {
+            SegmentInfo& info = segments[i];
+            if (info.count == 0 || orderID < info.minOrderID || orderID > info.maxOrderID) continue;
+            bool found = false;
+            scanSegment(info,
+                [orderID](const IndexBlock& block) { return orderID >= block.minOrderID && orderID <= block.maxOrderID; },
+                [&](const OrderRecord& record) {
+                    if (record.orderID != orderID) return true;
+                    result = record;
+                    found = true;
+                    return false;
+                });
+            if (found) return &info;
+        }
+        return nullptr;
+    }
+
+    bool readAllRecords(const SegmentInfo& info, vector<OrderRecord>& records) {
+        records.clear();
+        records.reserve(info.count);
+        return scanSegment(info, [](const IndexBlock&) { return true; },
+                           [&records](const OrderRecord& record) { records.push_back(record); return true; }) == ScanDone;
+    }
+
+public:
+    OrderSegmentStore(const OrderSegmentStore&) = delete;
+    OrderSegmentStore& operator=(const OrderSegmentStore&) = delete;
+
+    static OrderSegmentStore& getInstance() {
+        static OrderSegmentStore instance;
+        return instance;
+    }
+
+    // "YYYY-MM-DD HH:MM:SS" in local time to epoch seconds (0 if unparseable).
+    static long long toEpochSeconds(const char* dateTime) {
+        tm parts;
+        memset(&parts, 0, sizeof(parts));
+        if (!dateTime || sscanf(dateTime, "%d-%d-%d %d:%d:%d", &parts.tm_year, &parts.tm_mon, &parts.tm_mday,
+                                &parts.tm_hour, &parts.tm_min, &parts.tm_sec) < 3) {
+            return 0;
+        }
+        parts.tm_year -= 1900;
+        parts.tm_mon -= 1;
+        parts.tm_isdst = -1;
+        return static_cast<long long>(mktime(&parts));
+    }
+
+    static string formatEpochSeconds(long long seconds) {
+        time_t value = static_cast<time_t>(seconds);
+        tm parts;
+        localtime_r(&value, &parts);
+        char buffer[20];
+        strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &parts);
+        return buffer;
+    }
+
+    static string formatRecord(const OrderRecord& record) {
+        stringstream ss;
+        ss << record.orderID << "," << record.userID << "," << record.items << "," << record.timestamp << ","
+           << record.status << "," << fixed << setprecision(2) << record.total;
+        return ss.str();
+    }
+
+    static bool parseRecord(const string& line, OrderRecord& record) {
+        size_t fieldStart[6] = {0, 0, 0, 0, 0, 0};
+        size_t fieldEnd[6] = {0, 0, 0, 0, 0, 0};
+        int fieldCount = 0;
+        size_t pos = 0;
+        while (fieldCount < 6) {
+            size_t comma = line.find(',', pos);
+            fieldStart[fieldCount] = pos;
+            fieldEnd[fieldCount] = (comma == string::npos) ? line.length() : comma;
+            fieldCount++;
+            if (comma == string::npos) break;
+            pos = comma + 1;
+        }
+        if (fieldCount < 6) return false;
+
+        char* parseEnd = nullptr;
+        record.orderID = static_cast<int>(strtol(line.c_str(), &parseEnd, 10));
+        if (parseEnd == line.c_str()) return false;
+        record.userID = static_cast<int>(strtol(line.c_str() + fieldStart[1], nullptr, 10));
+        record.items.assign(line, fieldStart[2], fieldEnd[2] - fieldStart[2]);
+        record.timestamp = strtoll(line.c_str() + fieldStart[3], nullptr, 10);
+        record.status.assign(line, fieldStart[4], fieldEnd[4] - fieldStart[4]);
+        record.total = strtod(line.c_str() + fieldStart[5], nullptr);
+        return true;
+    }
+
+    // Period a timestamp falls into: "2025", "2025-05" or "2025-05-03".
+    string periodOf(long long seconds) const {
+        time_t value = static_cast<time_t>(seconds);
+        tm parts;
+        localtime_r(&value, &parts);
+        char buffer[16];
+        const char* format = (partition == OrderPartition::Daily) ? "%Y-%m-%d"
+                           : (partition == OrderPartition::Yearly) ? "%Y" : "%Y-%m";
+        strftime(buffer, sizeof(buffer), format, &parts);
+        return buffer;
+    }
+
+    // Only takes effect before the segment manifest has been created.
+    void setPartition(OrderPartition value) {
+        if (!fileExists(manifestPath())) partition = value;
+    }
+    OrderPartition getPartition() const { return partition; }
+
+    // Loads the manifest, creating the segment directory on first use and importing a
+    // legacy data/orders/orders.txt if there is one.
+    bool open() {
+        TRACE_SCOPE("segments", "OrderSegmentStore::open");
+        indexCache.clear();
+        segments.clear();
+        mkdir("data/orders", 0755);
+        mkdir(segmentDir().c_str(), 0755);
+        if (!loadManifest()) {
+            if (!saveManifest()) return false;
+        }
+        loadAmendments();
+        opened = true;
+        if (fileExists("data/orders/orders.txt")) {
+            return importLegacyFile("data/orders/orders.txt");
+        }
+        return true;
+    }
+
+    bool ensureOpen() {
+        return opened || open();
+    }
+
+    // Moves the lines of a single-file order log into segments, then renames the
+    // file to <name>.imported so the import runs once.
+    bool importLegacyFile(const string& path) {
+        TRACE_SCOPE("segments", "OrderSegmentStore::importLegacyFile");
+        TrackedIfstream in(IoStats::Orders, path);
+        if (!in) return false;
+
+        unordered_map<string, vector<OrderRecord>> byPeriod;
+        string line;
+        int imported = 0;
+        while (getline(in, line)) {
+            if (line.empty()) continue;
+            stringstream ss(line);
+            string oid, uid, items, date, status, total;
+            getline(ss, oid, ',');
+            getline(ss, uid, ',');
+            getline(ss, items, ',');
+            getline(ss, date, ',');
+            getline(ss, status, ',');
+            getline(ss, total, ',');
+
+            OrderRecord record;
+            char* parseEnd = nullptr;
+            record.orderID = static_cast<int>(strtol(oid.c_str(), &parseEnd, 10));
+            if (parseEnd == oid.c_str()) continue;
+            record.userID = atoi(uid.c_str());
+            record.items = items;
+            record.timestamp = toEpochSeconds(date.c_str());
+            record.status = status;
+            record.total = strtod(total.c_str(), nullptr);
+            byPeriod[periodOf(record.timestamp)].push_back(record);
+            imported++;
+        }
+        in.close();
+
+        for (auto& entry : byPeriod) {
+            vector<OrderRecord>& records = entry.second;
+            SegmentInfo* existing = findSegment(entry.first);
+            if (existing) {
+                vector<OrderRecord> current;
+                if (!readAllRecords(*existing, current)) return false; // Rewriting would drop its orders
+                records.insert(records.begin(), current.begin(), current.end());
+            } else {
+                SegmentInfo info = {entry.first, 0, 0, 0, 0, 0, false, false};
+                segments.push_back(info);
+                existing = &segments.back();
+            }
+            stable_sort(records.begin(), records.end(),
+                        [](const OrderRecord& a, const OrderRecord& b) { return a.orderID < b.orderID; });
+            if (existing->compressed) {
+                remove(dataPath(*existing).c_str());
+                existing->compressed = false; // Rewritten as a plain sealed segment
+            }
+            if (!writeSegment(*existing, records)) return false;
+        }
+        sort(segments.begin(), segments.end(),
+             [](const SegmentInfo& a, const SegmentInfo& b) { return a.period < b.period; });
+        if (!saveManifest()) return false;
+
+        string importedPath = path + ".imported";
+        remove(importedPath.c_str());
+        rename(path.c_str(), importedPath.c_str());
+        cout << "Imported " << imported << " order(s) into " << byPeriod.size() << " segment(s)." << endl;
+        return true;
+    }
+
+    // Appends to the segment for the record's period. A record for a period whose
+    // segment is already sealed goes to the newest open segment; the manifest ranges
+    // widen accordingly, so range pruning stays correct.
+    bool append(const OrderRecord& record) {
+        return appendBatch(vector<OrderRecord>(1, record));
+    }
+
+    // Appends many records with one write per segment and a single manifest update.
+    bool appendBatch(const vector<OrderRecord>& records) {
+        TRACE_SCOPE("segments", "OrderSegmentStore::appendBatch");
+        if (!ensureOpen()) return false;
+        size_t start = 0;
+        while (start < records.size()) {
+            string period = appendTarget(records[start].timestamp);
+            size_t end = start + 1;
+            while (end < records.size() && appendTarget(records[end].timestamp) == period) end++;
+
+            SegmentInfo* info = findSegment(period);
+            string path = dataPath(*info);
+            long long offset = fileSize(path);
+            TrackedOfstream out(IoStats::Orders, path, ios::app);
+            if (!out) {
+                cerr << "Error: Could not open order segment " << period << " for appending." << endl;
+                return false;
+            }
+            vector<IndexBlock> blocks = indexFor(period);
+            string line;
+            for (size_t i = start; i < end; ++i) {
+                if (blocks.empty() || blocks.back().count == IndexStride) {
+                    IndexBlock block;
+                    block.offset = offset;
+                    block.count = 0;
+                    blocks.push_back(block);
+                }
+                line = formatRecord(records[i]);
+                out << line << "\n";
+                offset += static_cast<long long>(line.length()) + 1;
+                widen(blocks.back(), records[i]);
+                widen(*info, records[i]);
+            }
+            out.close();
+            if (!out || !saveIndex(period, blocks)) return false;
+            start = end;
+        }
+        return saveManifest();
+    }
+
+    // Visits orders with fromTime <= timestamp <= toTime (0 leaves a bound open),
+    // opening only the segments and index blocks whose time range overlaps. Returns
+    // false if a segment could not be read; the orders visited before it stand.
+    bool forEachInRange(long long fromTime, long long toTime, const RecordVisitor& visit) {
+        TRACE_SCOPE("segments", "OrderSegmentStore::forEachInRange");
+        if (!ensureOpen()) return false;
+        auto overlaps = [fromTime, toTime](long long minTime, long long maxTime) {
+            return (fromTime == 0 || maxTime >= fromTime) && (toTime == 0 || minTime <= toTime);
+        };
+        for (size_t i = 0; i < segments.size(); ++i) {
+            if (segments[i].count == 0 || !overlaps(segments[i].minTime, segments[i].maxTime)) continue;
+            ScanResult result = scanSegment(segments[i],
+                [&overlaps](const IndexBlock& block) { return overlaps(block.minTime, block.maxTime); },
+                [&](const OrderRecord& record) {
+                    if (fromTime != 0 && record.timestamp < fromTime) return true;
+                    if (toTime != 0 && record.timestamp > toTime) return true;
+                    return visit(record);
+                });
+            if (result == ScanStopped) return true;
+            if (result == ScanFailed) return false;
+        }
+        return true;
+    }
+
+    bool forEach(const RecordVisitor& visit) {
+        return forEachInRange(0, 0, visit);
+    }
+
+    bool findOrder(int orderID, OrderRecord& result) {
+        TRACE_SCOPE("segments", "OrderSegmentStore::findOrder");
+        return ensureOpen() && locateOrder(orderID, result) != nullptr;
+    }
+
+    int maxOrderID() {
+        if (!ensureOpen()) return 0;
+        int maxID = 0;
+        for (size_t i = 0; i < segments.size(); ++i) {
+            if (segments[i].count > 0) maxID = max(maxID, segments[i].maxOrderID);
+        }
+        return maxID;
+    }
+
+    // Rewrites only the order's own segment, or records an amendment if it is sealed.
+    bool updateStatus(int orderID, const string& status) {
+        TRACE_SCOPE("segments", "OrderSegmentStore::updateStatus");
+        if (!ensureOpen()) return false;
+        OrderRecord record;
+        SegmentInfo* info = locateOrder(orderID, record);
+        if (!info) return false;
+
+        if (info->sealed) {
+            TrackedOfstream out(IoStats::Orders, amendmentsPath(), ios::app);
+            if (!out) return false;
+            out << orderID << "," << status << "\n";
+            statusAmendments[orderID] = status;
+            return true;
+        }
+
+        vector<OrderRecord> records;
+        if (!readAllRecords(*info, records)) return false;
+        for (size_t i = 0; i < records.size(); ++i) {
+            if (records[i].orderID == orderID) records[i].status = status;
+        }
+        return writeSegment(*info, records) && saveManifest();
+    }
+
+    // Marks a segment read-only. The current period's segment stays open.
+    bool seal(const string& period) {
+        TRACE_SCOPE("segments", "OrderSegmentStore::seal");
+        if (!ensureOpen()) return false;
+        SegmentInfo* info = findSegment(period);
+        if (!info) return false;
+        if (info->sealed) return true;
+        info->sealed = true;
+        return saveManifest();
+    }
+
+    // Compresses a sealed segment into orders_<period>.seg.z (raw size header + zlib stream).
+    bool compress(const string& period) {
+        TRACE_SCOPE("segments", "OrderSegmentStore::compress");
+        if (!ensureOpen()) return false;
+        SegmentInfo* info = findSegment(period);
+        if (!info || !info->sealed) return false;
+        if (info->compressed) return true;
+
+        string plainPath = dataPath(*info);
+        TrackedIfstream in(IoStats::Orders, plainPath, ios::binary);
+        if (!in) return false;
+        string raw((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+        in.close();
+
+        uLongf packedLength = compressBound(raw.size());
+        string packed(packedLength, '\0');
+        if (compress2(reinterpret_cast<Bytef*>(&packed[0]), &packedLength,
+                      reinterpret_cast<const Bytef*>(raw.data()), raw.size(), Z_BEST_COMPRESSION) != Z_OK) {
+            cerr << "Error: Could not compress order segment " << period << "." << endl;
+            return false;
+        }
+
+        info->compressed = true;
+        string packedPath = dataPath(*info);
+        TrackedOfstream out(IoStats::Orders, packedPath, ios::binary);
+        unsigned long long rawSize = raw.size();
+        out.write(reinterpret_cast<const char*>(&rawSize), sizeof(rawSize));
+        out.write(packed.data(), packedLength);
+        out.close();
+        if (!out || !saveManifest()) {
+            info->compressed = false;
+            remove(packedPath.c_str());
+            return false;
+        }
+        remove(plainPath.c_str());
+        return true;
+    }
+
+    // Seals (and optionally compresses) every segment for a period before the current one.
+    int sealCompletedPeriods(bool compressSealed) {
+        TRACE_SCOPE("segments", "OrderSegmentStore::sealCompletedPeriods");
+        if (!ensureOpen()) return 0;
+        string current = periodOf(static_cast<long long>(time(nullptr)));
+        int sealedCount = 0;
+        for (size_t i = 0; i < segments.size(); ++i) {
+            string period = segments[i].period;
+            if (period.compare(0, current.length(), current) >= 0) continue;
+            if (!segments[i].sealed && seal(period)) sealedCount++;
+            if (compressSealed) compress(period);
+        }
+        return sealedCount;
+    }
+
+    int segmentCount() const { return static_cast<int>(segments.size()); }
+};
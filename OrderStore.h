@@ -0,0 +1,491 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <mutex>
+#include <shared_mutex>
+
+#include "OrderSegments.h"
+#include "IoStats.h"
+#include "Trace.h"
+
+using namespace std;
+
+enum class OrderSortKey {
+    ById,
+    ByUser,
+    ByDate,
+    ByTotal,
+    ByStatus
+};
+
+// Keyset cursor: the sort key and order ID of the last row handed out.
+// Stays valid across inserts and status changes, unlike a row offset.
+struct OrderCursor {
+    bool valid;
+    double key;
+    int orderID;
+
+    OrderCursor() : valid(false), key(0.0), orderID(0) {}
+};
+
+// Empty status, userID 0 and a zero time bound mean "do not filter on it".
+// Time bounds are inclusive, in epoch seconds (OrderSegmentStore::toEpochSeconds).
+struct OrderQuery {
+    string status;
+    int userID;
+    long long fromTime;
+    long long toTime;
+    OrderSortKey sortKey;
+    bool descending;
+    OrderCursor after;
+    int limit;
+
+    OrderQuery() : userID(0), fromTime(0), toTime(0), sortKey(OrderSortKey::ById),
+                   descending(false), limit(100) {}
+};
+
+struct OrderPage {
+    vector<int> rows;   // Store rows, in query order
+    OrderCursor next;   // Pass back as OrderQuery::after for the following page
+    bool hasMore;
+
+    OrderPage() : hasMore(false) {}
+};
+
+// In-memory, column-oriented index of the order segments for list views.
+// Holds only what an order list shows (IDs, user, timestamp, status, total, item count);
+// line items stay on disk. Rows are kept in ascending order-ID order and are never removed, so a
+// row number stays valid for the lifetime of a load.
+// Secondary indexes map each status and each user to their rows (also in ID order), so
+// a filtered page costs O(log n + page) instead of a file scan.
+// Writes made through the Order statics are applied in place.
+//
+// Thread-safe: every call takes the store's own reader/writer lock, so list views and
+// pool tasks can query while the checkout pipeline appends. A row number read from one
+// call stays valid for the next until a load(). Loading reads the order segments, so
+// call load() and ensureLoaded() with the Orders store lock held (see StoreLocks.h);
+// Shared is enough. That lock is always taken before this one, never inside it.
+class OrderStore {
+private:
+    mutable shared_mutex lock;  // Guards everything below except sortedCache
+    mutable mutex cacheLock;    // Guards sortedCache; taken with lock held shared
+
+    vector<int> orderIDs;
+    vector<int> userIDs;
+    vector<long long> timestamps;
+    vector<double> totals;
+    vector<int> itemCounts;
+    vector<unsigned short> statusCodes;
+    vector<string> statusNames;
+    unordered_map<string, unsigned short> statusLookup;
+    vector<vector<int>> rowsByStatus;
+    unordered_map<int, vector<int>> rowsByUser;
+    unordered_map<int, int> rowByID;
+    bool loaded;
+    unsigned long long version; // Bumped on every change; invalidates sortedCache
+
+    // Rows of the last non-ID-ordered query, so paging through it does not re-sort
+    struct SortedCache {
+        string status;
+        int userID;
+        long long fromTime;
+        long long toTime;
+        OrderSortKey sortKey;
+        unsigned long long version;
+        bool valid;
+        vector<int> rows; // Ascending by (key, orderID)
+
+        SortedCache() : userID(0), fromTime(0), toTime(0), sortKey(OrderSortKey::ById), version(0), valid(false) {}
+    };
+    mutable SortedCache sortedCache;
+
+    OrderStore() : loaded(false), version(0) {}
+
+    unsigned short internStatus(const string& status) {
+        auto it = statusLookup.find(status);
+        if (it != statusLookup.end()) {
+            return it->second;
+        }
+        unsigned short code = static_cast<unsigned short>(statusNames.size());
+        statusNames.push_back(status);
+        statusLookup[status] = code;
+        rowsByStatus.push_back(vector<int>());
+        return code;
+    }
+
+    void appendRow(int orderID, int userID, long long timestamp, const string& status, double total, int itemCount) {
+        int row = static_cast<int>(orderIDs.size());
+        rowByID[orderID] = row;
+        orderIDs.push_back(orderID);
+        userIDs.push_back(userID);
+        timestamps.push_back(timestamp);
+        totals.push_back(total);
+        itemCounts.push_back(itemCount);
+        unsigned short code = internStatus(status);
+        statusCodes.push_back(code);
+        rowsByStatus[code].push_back(row);
+        rowsByUser[userID].push_back(row);
+    }
+
+    // Total quantity across "productID:qty@price|..." entries
+    static int countItems(const string& items) {
+        int quantity = 0;
+        size_t pos = 0;
+        while ((pos = items.find(':', pos)) != string::npos) {
+            quantity += atoi(items.c_str() + pos + 1);
+            pos++;
+        }
+        return quantity;
+    }
+
+    double sortValue(int row, OrderSortKey key) const {
+        switch (key) {
+        case OrderSortKey::ByUser: return userIDs[row];
+        case OrderSortKey::ByDate: return static_cast<double>(timestamps[row]);
+        case OrderSortKey::ByTotal: return totals[row];
+        case OrderSortKey::ByStatus: return statusRank(statusCodes[row]);
+        default: return orderIDs[row];
+        }
+    }
+
+    // Alphabetical position of a status, so ByStatus sorts by name rather than first appearance
+    int statusRank(unsigned short code) const {
+        int rank = 0;
+        for (size_t i = 0; i < statusNames.size(); ++i) {
+            if (statusNames[i] < statusNames[code]) rank++;
+        }
+        return rank;
+    }
+
+    bool rowPasses(int row, int statusCode, const OrderQuery& query) const {
+        if (statusCode >= 0 && statusCodes[row] != statusCode) return false;
+        if (query.userID > 0 && userIDs[row] != query.userID) return false;
+        if (query.fromTime > 0 && timestamps[row] < query.fromTime) return false;
+        if (query.toTime > 0 && timestamps[row] > query.toTime) return false;
+        return true;
+    }
+
+    // Smallest index that covers the query; nullptr means "every row".
+    const vector<int>* candidateRows(int statusCode, const OrderQuery& query) const {
+        const vector<int>* candidates = nullptr;
+        if (statusCode >= 0) {
+            candidates = &rowsByStatus[statusCode];
+        }
+        if (query.userID > 0) {
+            auto it = rowsByUser.find(query.userID);
+            static const vector<int> noRows;
+            const vector<int>* userRows = (it == rowsByUser.end()) ? &noRows : &it->second;
+            if (!candidates || userRows->size() < candidates->size()) {
+                candidates = userRows;
+            }
+        }
+        return candidates;
+    }
+
+    OrderPage queryById(int statusCode, const OrderQuery& query) const {
+        OrderPage page;
+        const vector<int>* candidates = candidateRows(statusCode, query);
+        int count = candidates ? static_cast<int>(candidates->size()) : static_cast<int>(orderIDs.size());
+        auto rowAt = [candidates](int i) { return candidates ? (*candidates)[i] : i; };
+
+        // Rows and every index are in ascending ID order: binary search the cursor position
+        int lo = 0, hi = count;
+        if (query.after.valid) {
+            while (lo < hi) {
+                int mid = lo + (hi - lo) / 2;
+                bool beforeCursor = query.descending ? orderIDs[rowAt(mid)] < query.after.orderID
+                                                     : orderIDs[rowAt(mid)] <= query.after.orderID;
+                if (beforeCursor) lo = mid + 1; else hi = mid;
+            }
+        }
+        int limit = query.limit > 0 ? query.limit : count;
+
+        if (query.descending) {
+            for (int i = (query.after.valid ? lo : count) - 1; i >= 0; --i) {
+                int row = rowAt(i);
+                if (!rowPasses(row, statusCode, query)) continue;
+                if (static_cast<int>(page.rows.size()) == limit) { page.hasMore = true; break; }
+                page.rows.push_back(row);
+            }
+        } else {
+            for (int i = lo; i < count; ++i) {
+                int row = rowAt(i);
+                if (!rowPasses(row, statusCode, query)) continue;
+                if (static_cast<int>(page.rows.size()) == limit) { page.hasMore = true; break; }
+                page.rows.push_back(row);
+            }
+        }
+        return page;
+    }
+
+    OrderPage querySorted(int statusCode, const OrderQuery& query) const {
+        // Readers share the store, but filling the cache is one thread's job
+        lock_guard<mutex> cacheGuard(cacheLock);
+        SortedCache& cache = sortedCache;
+        bool stale = !cache.valid || cache.version != version || cache.sortKey != query.sortKey ||
+                     cache.status != query.status || cache.userID != query.userID ||
+                     cache.fromTime != query.fromTime || cache.toTime != query.toTime;
+        IoStats::cacheLookup(IoStats::Orders, !stale);
+        if (stale) {
+            cache.rows.clear();
+            const vector<int>* candidates = candidateRows(statusCode, query);
+            int count = candidates ? static_cast<int>(candidates->size()) : static_cast<int>(orderIDs.size());
+            for (int i = 0; i < count; ++i) {
+                int row = candidates ? (*candidates)[i] : i;
+                if (rowPasses(row, statusCode, query)) cache.rows.push_back(row);
+            }
+            OrderSortKey key = query.sortKey;
+            stable_sort(cache.rows.begin(), cache.rows.end(), [this, key](int a, int b) {
+                double ka = sortValue(a, key), kb = sortValue(b, key);
+                return ka != kb ? ka < kb : orderIDs[a] < orderIDs[b];
+            });
+            cache.status = query.status;
+            cache.userID = query.userID;
+            cache.fromTime = query.fromTime;
+            cache.toTime = query.toTime;
+            cache.sortKey = query.sortKey;
+            cache.version = version;
+            cache.valid = true;
+        }
+
+        OrderPage page;
+        const vector<int>& rows = cache.rows;
+        int count = static_cast<int>(rows.size());
+        int lo = 0, hi = count;
+        if (query.after.valid) {
+            // Ascending resumes at the first row past the cursor; descending at the last row before it
+            while (lo < hi) {
+                int mid = lo + (hi - lo) / 2;
+                double key = sortValue(rows[mid], query.sortKey);
+                int id = orderIDs[rows[mid]];
+                bool beforeCursor = key < query.after.key ||
+                                    (key == query.after.key && (query.descending ? id < query.after.orderID
+                                                                                 : id <= query.after.orderID));
+                if (beforeCursor) lo = mid + 1; else hi = mid;
+            }
+        }
+        int limit = query.limit > 0 ? query.limit : count;
+        if (query.descending) {
+            for (int i = (query.after.valid ? lo : count) - 1; i >= 0; --i) {
+                if (static_cast<int>(page.rows.size()) == limit) { page.hasMore = true; break; }
+                page.rows.push_back(rows[i]);
+            }
+        } else {
+            for (int i = lo; i < count; ++i) {
+                if (static_cast<int>(page.rows.size()) == limit) { page.hasMore = true; break; }
+                page.rows.push_back(rows[i]);
+            }
+        }
+        return page;
+    }
+
+    int rowOf(int orderID) const {
+        auto it = rowByID.find(orderID);
+        return (it == rowByID.end()) ? -1 : it->second;
+    }
+
+    OrderCursor cursorAtLocked(int row, OrderSortKey key) const {
+        OrderCursor cursor;
+        cursor.valid = true;
+        cursor.key = sortValue(row, key);
+        cursor.orderID = orderIDs[row];
+        return cursor;
+    }
+
+    void clearLocked() {
+        orderIDs.clear();
+        userIDs.clear();
+        timestamps.clear();
+        totals.clear();
+        itemCounts.clear();
+        statusCodes.clear();
+        statusNames.clear();
+        statusLookup.clear();
+        rowsByStatus.clear();
+        rowsByUser.clear();
+        rowByID.clear();
+        loaded = false;
+        version++;  // Leaves sortedCache stale
+    }
+
+    bool loadLocked() {
+        TRACE_SCOPE("order", "OrderStore::load");
+        clearLocked();
+        OrderSegmentStore& segmentStore = OrderSegmentStore::getInstance();
+        if (!segmentStore.ensureOpen()) {
+            return false;
+        }
+        loaded = true;
+
+        struct PendingRow { int orderID; int userID; long long timestamp; string status; double total; int itemCount; };
+        vector<PendingRow> pending;
+        bool inIdOrder = true;
+        bool read = segmentStore.forEach([&pending, &inIdOrder](const OrderRecord& record) {
+            if (!pending.empty() && pending.back().orderID >= record.orderID) inIdOrder = false;
+            PendingRow row = {record.orderID, record.userID, record.timestamp, record.status,
+                              record.total, countItems(record.items)};
+            pending.push_back(row);
+            return true;
+        });
+        if (!read) {
+            clearLocked(); // An index missing a segment's orders would pass for a complete one
+            return false;
+        }
+
+        // Segments are visited in period order and IDs increase with time, so this
+        // only sorts after late or hand-edited records
+        if (!inIdOrder) {
+            stable_sort(pending.begin(), pending.end(),
+                        [](const PendingRow& a, const PendingRow& b) { return a.orderID < b.orderID; });
+        }
+        orderIDs.reserve(pending.size());
+        userIDs.reserve(pending.size());
+        timestamps.reserve(pending.size());
+        totals.reserve(pending.size());
+        itemCounts.reserve(pending.size());
+        statusCodes.reserve(pending.size());
+        for (size_t i = 0; i < pending.size(); ++i) {
+            const PendingRow& row = pending[i];
+            appendRow(row.orderID, row.userID, row.timestamp, row.status, row.total, row.itemCount);
+        }
+        version++;
+        return true;
+    }
+
+public:
+    OrderStore(const OrderStore&) = delete;
+    OrderStore& operator=(const OrderStore&) = delete;
+
+    static OrderStore& getInstance() {
+        static OrderStore instance;
+        return instance;
+    }
+
+    void clear() {
+        unique_lock<shared_mutex> guard(lock);
+        clearLocked();
+    }
+
+    // Reads every order segment once; no segments yet is an empty store.
+    bool load() {
+        unique_lock<shared_mutex> guard(lock);
+        return loadLocked();
+    }
+
+    bool ensureLoaded() {
+        {
+            shared_lock<shared_mutex> guard(lock);
+            if (loaded) {
+                IoStats::cacheLookup(IoStats::Orders, true);
+                return true;
+            }
+        }
+        unique_lock<shared_mutex> guard(lock);
+        IoStats::cacheLookup(IoStats::Orders, loaded);
+        return loaded || loadLocked(); // Another thread may have loaded it meanwhile
+    }
+
+    bool isLoaded() const { shared_lock<shared_mutex> guard(lock); return loaded; }
+    int size() const { shared_lock<shared_mutex> guard(lock); return static_cast<int>(orderIDs.size()); }
+    unsigned long long getVersion() const { shared_lock<shared_mutex> guard(lock); return version; }
+
+    int findRow(int orderID) const {
+        shared_lock<shared_mutex> guard(lock);
+        return rowOf(orderID);
+    }
+
+    int getOrderID(int row) const { shared_lock<shared_mutex> guard(lock); return orderIDs[row]; }
+    int getUserID(int row) const { shared_lock<shared_mutex> guard(lock); return userIDs[row]; }
+    long long getTimestamp(int row) const { shared_lock<shared_mutex> guard(lock); return timestamps[row]; }
+    double getTotal(int row) const { shared_lock<shared_mutex> guard(lock); return totals[row]; }
+    int getItemCount(int row) const { shared_lock<shared_mutex> guard(lock); return itemCounts[row]; }
+    // By value: a new status may move the names
+    string getStatus(int row) const { shared_lock<shared_mutex> guard(lock); return statusNames[statusCodes[row]]; }
+    int maxOrderID() const {
+        shared_lock<shared_mutex> guard(lock);
+        return orderIDs.empty() ? 0 : orderIDs.back();
+    }
+
+    vector<string> getStatuses() const {
+        shared_lock<shared_mutex> guard(lock);
+        return statusNames;
+    }
+
+    // Applies an order that has already been appended to the order segments.
+    // A store that has never been loaded ignores writes; its first load() reads them from disk.
+    void appendOrder(const OrderRecord& record) {
+        unique_lock<shared_mutex> guard(lock);
+        if (!loaded) return;
+        if (rowOf(record.orderID) >= 0) return;
+        if (!orderIDs.empty() && record.orderID < orderIDs.back()) {
+            loadLocked(); // Out of ID order: rebuild rather than shift every index
+            return;
+        }
+        appendRow(record.orderID, record.userID, record.timestamp, record.status, record.total,
+                  countItems(record.items));
+        version++;
+    }
+
+    bool setStatus(int orderID, const char* status) {
+        unique_lock<shared_mutex> guard(lock);
+        int row = rowOf(orderID);
+        if (row < 0) return false;
+        unsigned short newCode = internStatus(status ? status : "");
+        unsigned short oldCode = statusCodes[row];
+        if (newCode == oldCode) return true;
+
+        vector<int>& oldRows = rowsByStatus[oldCode];
+        auto it = lower_bound(oldRows.begin(), oldRows.end(), row);
+        if (it != oldRows.end() && *it == row) oldRows.erase(it);
+        vector<int>& newRows = rowsByStatus[newCode];
+        newRows.insert(lower_bound(newRows.begin(), newRows.end(), row), row);
+        statusCodes[row] = newCode;
+        version++;
+        return true;
+    }
+
+    // Number of orders with this status; the whole store for an empty status.
+    int countWithStatus(const string& status) const {
+        shared_lock<shared_mutex> guard(lock);
+        if (status.empty()) return static_cast<int>(orderIDs.size());
+        auto it = statusLookup.find(status);
+        return (it == statusLookup.end()) ? 0 : static_cast<int>(rowsByStatus[it->second].size());
+    }
+
+    OrderCursor cursorAt(int row, OrderSortKey key) const {
+        shared_lock<shared_mutex> guard(lock);
+        return cursorAtLocked(row, key);
+    }
+
+    // Returns up to query.limit rows following query.after.
+    // ID order walks an index directly; other orders sort the matching rows once and
+    // reuse that until the store changes.
+    OrderPage query(const OrderQuery& query) const {
+        TRACE_SCOPE("order", "OrderStore::query");
+        shared_lock<shared_mutex> guard(lock);
+        OrderPage page;
+        int statusCode = -1;
+        if (!query.status.empty()) {
+            auto it = statusLookup.find(query.status);
+            if (it == statusLookup.end()) return page;
+            statusCode = it->second;
+        }
+
+        page = (query.sortKey == OrderSortKey::ById) ? queryById(statusCode, query)
+                                                     : querySorted(statusCode, query);
+        if (!page.rows.empty()) {
+            page.next = cursorAtLocked(page.rows.back(), query.sortKey);
+        } else {
+            page.next = query.after;
+        }
+        return page;
+    }
+};
@@ -10,6 +10,7 @@
 #include <QMessageBox>
 #include <vector>
 #include <QString>
+#include <QPointer>
 // Removed include of CartTypes.h
 
 // Direct implementation of PlaceholderCartItem instead of forward declaration
@@ -42,6 +43,13 @@ public:
 #include "PaymentDialog.h" // Include the new PaymentDialog
 #include "../../include/Order.h" // Include Order class for placeOrder()
 #include "../../include/ShoppingCart.h" // Include ShoppingCart class for cart operations
+#include "../../include/CheckoutPipeline.h"
+#include "../../include/IdempotencyIndex.h"
+#include "../../include/StockReservations.h"
+#include "../../include/StoreLocks.h"
+#include "../../include/SessionRecorder.h"
+#include "../../include/AsyncStorage.h"
+#include "../../include/Async.h"
 
 class OrderSummaryDialog : public QDialog
 {
@@ -56,21 +64,36 @@ signals:
     void orderPlaced(int orderId);  // Signal emitted when an order is successfully placed
     void orderStatusUpdated(int orderId, const QString& newStatus); // Signal emitted when an order status is updated
 
+public slots:
+    // Stays open until a submitted checkout has finished
+    inline void reject() override;
+
 private slots:
     inline void handleProceedToPayment();
 
 private:
+    inline AsyncAction proceedToPayment();
+    inline void showCheckoutProgress(const CheckoutProgress& progress);
+    inline void finishCheckout(const CheckoutProgress& progress);
+    inline bool holdsForCheckout() const;
+
     QListWidget *itemsListWidget; // To display item summaries
     QLabel *totalLabel;
+    QLabel *progressLabel;
     QPushButton *proceedButton;
     QPushButton *cancelButton;
     double currentOrderTotal; // Member to store the total
     std::vector<PlaceholderCartItem> currentOrderItems; // Store items
     int currentUserId; // Store the user ID for order placement
+    long long checkoutTicket; // Checkout in the pipeline, or 0
+    std::string checkoutKey; // Idempotency key, the same for every attempt from this dialog
+    int progressToken; // CheckoutPipeline listener
+    CancellationSource checkoutWait; // Drops the outcome if the dialog goes away first
 };
 
 inline OrderSummaryDialog::OrderSummaryDialog(const std::vector<PlaceholderCartItem>& items, double total, int userId, QWidget *parent)
-    : QDialog(parent), currentOrderTotal(total), currentOrderItems(items), currentUserId(userId)
+    : QDialog(parent), currentOrderTotal(total), currentOrderItems(items), currentUserId(userId), checkoutTicket(0),
+      checkoutKey(IdempotencyIndex::generateKey())
 {
     setWindowTitle("Order Summary & Confirmation");
     setMinimumWidth(450);
@@ -96,6 +119,11 @@ inline OrderSummaryDialog::OrderSummaryDialog(const std::vector<PlaceholderCartI
     totalLabel->setAlignment(Qt::AlignRight);
     mainLayout->addWidget(totalLabel);
 
+    progressLabel = new QLabel(this);
+    progressLabel->setAlignment(Qt::AlignRight);
+    progressLabel->hide();
+    mainLayout->addWidget(progressLabel);
+
     QHBoxLayout *buttonLayout = new QHBoxLayout();
     cancelButton = new QPushButton("Back to Cart / Cancel", this);
     proceedButton = new QPushButton("Confirm & Proceed to Payment", this);
@@ -107,49 +135,108 @@ inline OrderSummaryDialog::OrderSummaryDialog(const std::vector<PlaceholderCartI
     setLayout(mainLayout);
 
     connect(proceedButton, &QPushButton::clicked, this, &OrderSummaryDialog::handleProceedToPayment);
-    connect(cancelButton, &QPushButton::clicked, this, &QDialog::reject); // User cancels order confirmation
+    connect(cancelButton, &QPushButton::clicked, this, &OrderSummaryDialog::reject); // User cancels order confirmation
+
+    // Set the cart's stock aside while the user confirms and pays (see StockReservations.h)
+    if (holdsForCheckout()) {
+        StoreLockSet locks;
+        locks.add(IoStats::Products, StoreLocks::Shared);
+        locks.addUser(IoStats::Carts, currentUserId);
+        locks.acquire();
+        ShoppingCart cart(currentUserId);
+        if (!cart.holdForCheckout()) {
+            progressLabel->setText("Some items are selling out and could not be held for you.");
+            progressLabel->show();
+        }
+    }
+
+    // Stage changes arrive on the pipeline's threads; show them on this one
+    progressToken = CheckoutPipeline::getInstance().subscribe([this](const CheckoutProgress& progress) {
+        QMetaObject::invokeMethod(this, [this, progress]() { showCheckoutProgress(progress); }, Qt::QueuedConnection);
+    });
+}
+
+inline OrderSummaryDialog::~OrderSummaryDialog() {
+    CheckoutPipeline::getInstance().unsubscribe(progressToken);
+}
+
+inline void OrderSummaryDialog::reject()
+{
+    if (checkoutTicket != 0) return;
+    if (holdsForCheckout()) StockReservations::getInstance().releaseAll(currentUserId);
+    QDialog::reject();
+}
+
+inline bool OrderSummaryDialog::holdsForCheckout() const
+{
+    return StockReservations::getInstance().mode() == StockReservations::OnCheckout;
 }
 
-inline OrderSummaryDialog::~OrderSummaryDialog() {}
+inline void OrderSummaryDialog::showCheckoutProgress(const CheckoutProgress& progress)
+{
+    if (progress.ticket != checkoutTicket || checkoutTicket == 0) return;
+    progressLabel->setText(QString("%1...").arg(checkoutStageName(progress.stage)));
+}
 
 inline void OrderSummaryDialog::handleProceedToPayment()
 {
-    PaymentDialog paymentDialog(currentOrderTotal, this->parentWidget()); 
-    if (paymentDialog.exec() == QDialog::Accepted) {
-        // Payment was simulated successfully
-        // Get ShoppingCart for current user
-        ShoppingCart cart(currentUserId);
-        
-        // Create an Order object with the user ID directly in the constructor
-        Order order(0, currentUserId, "", nullptr, "Pending");
-        
-        // Place the order using the Order::placeOrder method
-        int orderId = order.placeOrder(cart);
-        
-        if (orderId > 0) {
-            // Order was placed successfully (orderId is the new order ID)
-            QMessageBox::information(this, "Order Successful", 
-                QString("Your order has been placed successfully!\nOrder ID: %1\nOrder Total: $%2")
-                .arg(orderId)
-                .arg(currentOrderTotal, 0, 'f', 2));
-                
-            // Clear the cart (it was already cleared by placeOrder, but just to be safe)
-            cart.clearCart();
-            
-            // Emit the orderPlaced signal
-            emit orderPlaced(orderId);
-            
-            accept(); // Close OrderSummary, signaling to cart to also close as checkout is complete
-        } else {
-            QMessageBox::critical(this, "Order Failed", 
-                "There was an issue placing your order. Please try again later.\n"
-                "Possible reasons:\n"
-                "- Some items may be out of stock\n"
-                "- Technical error in processing the order");
+    proceedToPayment();
+}
+
+inline AsyncAction OrderSummaryDialog::proceedToPayment()
+{
+    std::string paymentMethod;
+    {
+        PaymentDialog paymentDialog(currentOrderTotal, this->parentWidget()); 
+        if (paymentDialog.exec() != QDialog::Accepted) {
+            // Payment was cancelled
+            QMessageBox::warning(this, "Payment Cancelled", "Payment was cancelled. Your order has not been placed.");
+            co_return;
         }
+        paymentMethod = paymentDialog.getPaymentMethod().toStdString();
+    }
+
+    // Payment details were accepted; stock, payment, order and cart are handled by the
+    // checkout pipeline while this dialog keeps the event loop running. A second
+    // confirmation of the same order carries the same key, so it cannot order twice.
+    CheckoutSubmission checkout = AsyncStorage::placeOrder(currentUserId, paymentMethod, checkoutKey);
+    if (checkout.ticket == 0) {
+        QMessageBox::warning(this, "Checkout Busy",
+            "Checkout is not available right now. Please try again in a moment.");
+        co_return;
+    }
+    checkoutTicket = checkout.ticket;
+    proceedButton->setEnabled(false);
+    cancelButton->setEnabled(false);
+    progressLabel->setText(QString("%1...").arg(checkoutStageName(CheckoutStage::Queued)));
+    progressLabel->show();
+
+    CheckoutProgress outcome = co_await withCancellation(checkout.outcome, checkoutWait.restart());
+    finishCheckout(outcome);
+}
+
+inline void OrderSummaryDialog::finishCheckout(const CheckoutProgress& progress)
+{
+    checkoutTicket = 0;
+    progressLabel->hide();
+    bool placed = (progress.stage == CheckoutStage::Completed);
+    SessionRecorder::getInstance().record("checkout", std::to_string(placed ? progress.orderID : 0));
+
+    if (placed) {
+        QMessageBox::information(this, "Order Successful", 
+            QString("Your order has been placed successfully!\nOrder ID: %1\nOrder Total: $%2")
+            .arg(progress.orderID)
+            .arg(progress.total, 0, 'f', 2));
+
+        // Emit the orderPlaced signal
+        emit orderPlaced(progress.orderID);
+
+        accept(); // Close OrderSummary, signaling to cart to also close as checkout is complete
     } else {
-        // Payment was cancelled
-        QMessageBox::warning(this, "Payment Cancelled", "Payment was cancelled. Your order has not been placed.");
+        proceedButton->setEnabled(true);
+        cancelButton->setEnabled(true);
+        QMessageBox::critical(this, "Order Failed", 
+            QString("There was an issue placing your order:\n%1").arg(QString::fromStdString(progress.error)));
     }
 }
 
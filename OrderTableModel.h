@@ -0,0 +1,350 @@
+#ifndef ORDERTABLEMODEL_H
+#define ORDERTABLEMODEL_H
+
+#include <QAbstractTableModel>
+#include <QPointer>
+#include <QString>
+#include <vector>
+#include <algorithm>
+#include "../../include/OrderStore.h"
+#include "../../include/ChangeFeed.h"
+#include "../../include/StoreLocks.h"
+#include "../../include/TaskScheduler.h"
+
+// Table model over OrderStore query pages.
+// Only the pages the view has scrolled to are held (one int per row); each fetchMore()
+// asks the store for the next page after a keyset cursor, and the page after that is
+// queried on the task pool right away so scrolling rarely waits on a query.
+// Status filtering is served by the store's status index rather than a scan.
+class OrderTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum Column {
+        IdColumn,
+        UserColumn,
+        DateColumn,
+        TotalColumn,
+        StatusColumn,
+        ColumnCount
+    };
+
+    inline explicit OrderTableModel(QObject *parent = nullptr);
+    inline ~OrderTableModel();
+
+    inline int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    inline int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    inline QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    inline QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    inline bool canFetchMore(const QModelIndex &parent) const override;
+    inline void fetchMore(const QModelIndex &parent) override;
+    inline void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
+
+    // Filters; each one restarts paging from the first page.
+    inline void setStatusFilter(const QString &status);
+    inline void setUserFilter(int userId);
+    inline void setDateRange(long long fromTime, long long toTime);
+    // Re-runs the current query, e.g. after OrderStore::load().
+    inline void reload();
+
+    inline int orderIdAt(int viewRow) const;
+    inline QString statusAt(int viewRow) const;
+    // Size of the full result when the index can answer it without a scan, otherwise -1.
+    inline int matchingOrderCount() const;
+
+    static constexpr int PageSize = 200;
+
+private:
+    inline void schedulePrefetch();
+    inline void prefetch();
+    inline void appendPage(const OrderPage &page);
+    inline void applyDelta(const EntityDelta &delta);
+    inline bool rowMatchesQuery(int storeRow) const;
+    inline void rebuildViewIndex(int fromViewRow);
+    inline int viewRowOfStoreRow(int storeRow) const;
+    inline void insertViewRow(int storeRow);
+    inline void removeViewRow(int viewRow);
+
+    OrderQuery query;               // Filters and sort; query.after is the cursor of the last loaded row
+    std::vector<int> rows;          // Store rows loaded so far, in query order
+    std::vector<int> viewRowByStoreRow;
+    OrderPage prefetched;
+    bool hasPrefetched;
+    bool prefetchScheduled;
+    int prefetchGeneration;         // Bumped whenever the cursor or the buffered page goes stale
+    bool moreOnServer;              // The store has rows past query.after
+    int feedToken;
+};
+
+inline OrderTableModel::OrderTableModel(QObject *parent)
+    : QAbstractTableModel(parent), hasPrefetched(false), prefetchScheduled(false), prefetchGeneration(0), moreOnServer(false), feedToken(0)
+{
+    query.limit = PageSize;
+
+    // Storage may publish from any thread; apply on this model's thread.
+    feedToken = ChangeFeed::getInstance().subscribe([this](const EntityDelta &delta) {
+        if (delta.entity != EntityType::Order) return;
+        QMetaObject::invokeMethod(this, [this, delta]() { applyDelta(delta); }, Qt::QueuedConnection);
+    });
+}
+
+inline OrderTableModel::~OrderTableModel() {
+    ChangeFeed::getInstance().unsubscribe(feedToken);
+}
+
+inline int OrderTableModel::rowCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : static_cast<int>(rows.size());
+}
+
+inline int OrderTableModel::columnCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+inline QVariant OrderTableModel::data(const QModelIndex &index, int role) const {
+    if (!index.isValid() || index.row() >= static_cast<int>(rows.size())) {
+        return QVariant();
+    }
+
+    const OrderStore &store = OrderStore::getInstance();
+    int row = rows[index.row()];
+
+    if (role == Qt::DisplayRole) {
+        switch (index.column()) {
+        case IdColumn: return store.getOrderID(row);
+        case UserColumn: return store.getUserID(row);
+        case DateColumn: return QString::fromStdString(OrderSegmentStore::formatEpochSeconds(store.getTimestamp(row)));
+        case TotalColumn: return QString::number(store.getTotal(row), 'f', 2);
+        case StatusColumn: return QString::fromStdString(store.getStatus(row));
+        }
+    } else if (role == Qt::TextAlignmentRole && index.column() != DateColumn && index.column() != StatusColumn) {
+        return int(Qt::AlignRight | Qt::AlignVCenter);
+    }
+    return QVariant();
+}
+
+inline QVariant OrderTableModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (role != Qt::DisplayRole || orientation != Qt::Horizontal) {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+    switch (section) {
+    case IdColumn: return QString("Order ID");
+    case UserColumn: return QString("User ID");
+    case DateColumn: return QString("Date");
+    case TotalColumn: return QString("Total");
+    case StatusColumn: return QString("Status");
+    }
+    return QVariant();
+}
+
+inline bool OrderTableModel::canFetchMore(const QModelIndex &parent) const {
+    return !parent.isValid() && (hasPrefetched ? !prefetched.rows.empty() : moreOnServer);
+}
+
+inline void OrderTableModel::fetchMore(const QModelIndex &parent) {
+    if (parent.isValid()) return;
+    if (!hasPrefetched) {
+        prefetch();
+    }
+    OrderPage page;
+    std::swap(page, prefetched);
+    hasPrefetched = false;
+    appendPage(page);
+    schedulePrefetch();
+}
+
+inline void OrderTableModel::appendPage(const OrderPage &page) {
+    ++prefetchGeneration;
+    moreOnServer = page.hasMore;
+    if (page.rows.empty()) return;
+    int first = static_cast<int>(rows.size());
+    beginInsertRows(QModelIndex(), first, first + static_cast<int>(page.rows.size()) - 1);
+    rows.insert(rows.end(), page.rows.begin(), page.rows.end());
+    query.after = page.next;
+    rebuildViewIndex(first);
+    endInsertRows();
+}
+
+// Queries the page after the last loaded row and keeps it until the view asks for it.
+inline void OrderTableModel::prefetch() {
+    prefetchScheduled = false;
+    if (hasPrefetched) return;
+    OrderStore &store = OrderStore::getInstance();
+    if (!store.isLoaded()) {
+        // Only the first load reads the order segments
+        StoreLockSet locks;
+        locks.add(IoStats::Orders, StoreLocks::Shared);
+        locks.acquire();
+        store.ensureLoaded();
+    }
+    prefetched = store.query(query);
+    hasPrefetched = true;
+}
+
+// Queries the next page on the task pool at background priority. A page that arrives
+// after the view has moved on (another page appended, a reload, a delta) is dropped.
+inline void OrderTableModel::schedulePrefetch() {
+    if (prefetchScheduled || hasPrefetched || !moreOnServer) return;
+    prefetchScheduled = true;
+    int generation = prefetchGeneration;
+    OrderQuery next = query;
+    QPointer<OrderTableModel> model(this);
+    TaskScheduler::getInstance().run([next]() {
+        OrderStore &store = OrderStore::getInstance();
+        {
+            // Checkouts append to the order segments on their own threads
+            StoreLockSet locks;
+            locks.add(IoStats::Orders, StoreLocks::Shared);
+            locks.acquire();
+            store.ensureLoaded();
+        }
+        return store.query(next);
+    }, TaskPriority::Background).deliver([model, generation](const OrderPage &page) {
+        if (!model || generation != model->prefetchGeneration) return;
+        model->prefetchScheduled = false;
+        if (model->hasPrefetched) return;
+        model->prefetched = page;
+        model->hasPrefetched = true;
+    });
+}
+
+inline void OrderTableModel::reload() {
+    beginResetModel();
+    ++prefetchGeneration;
+    rows.clear();
+    viewRowByStoreRow.clear();
+    query.after = OrderCursor();
+    hasPrefetched = false;
+    prefetchScheduled = false;
+    prefetch();
+    OrderPage page;
+    std::swap(page, prefetched);
+    hasPrefetched = false;
+    moreOnServer = page.hasMore;
+    rows = page.rows;
+    if (!page.rows.empty()) query.after = page.next;
+    rebuildViewIndex(0);
+    endResetModel();
+    schedulePrefetch();
+}
+
+inline void OrderTableModel::sort(int column, Qt::SortOrder order) {
+    switch (column) {
+    case UserColumn: query.sortKey = OrderSortKey::ByUser; break;
+    case DateColumn: query.sortKey = OrderSortKey::ByDate; break;
+    case TotalColumn: query.sortKey = OrderSortKey::ByTotal; break;
+    case StatusColumn: query.sortKey = OrderSortKey::ByStatus; break;
+    default: query.sortKey = OrderSortKey::ById; break;
+    }
+    query.descending = (order == Qt::DescendingOrder);
+    reload();
+}
+
+inline void OrderTableModel::setStatusFilter(const QString &status) {
+    query.status = status.toStdString();
+    reload();
+}
+
+inline void OrderTableModel::setUserFilter(int userId) {
+    query.userID = userId;
+    reload();
+}
+
+inline void OrderTableModel::setDateRange(long long fromTime, long long toTime) {
+    query.fromTime = fromTime;
+    query.toTime = toTime;
+    reload();
+}
+
+inline int OrderTableModel::orderIdAt(int viewRow) const {
+    if (viewRow < 0 || viewRow >= static_cast<int>(rows.size())) return -1;
+    return OrderStore::getInstance().getOrderID(rows[viewRow]);
+}
+
+inline QString OrderTableModel::statusAt(int viewRow) const {
+    if (viewRow < 0 || viewRow >= static_cast<int>(rows.size())) return QString();
+    return QString::fromStdString(OrderStore::getInstance().getStatus(rows[viewRow]));
+}
+
+inline int OrderTableModel::matchingOrderCount() const {
+    if (query.userID > 0 || query.fromTime > 0 || query.toTime > 0) return -1;
+    return OrderStore::getInstance().countWithStatus(query.status);
+}
+
+inline bool OrderTableModel::rowMatchesQuery(int storeRow) const {
+    const OrderStore &store = OrderStore::getInstance();
+    if (!query.status.empty() && store.getStatus(storeRow) != query.status) return false;
+    if (query.userID > 0 && store.getUserID(storeRow) != query.userID) return false;
+    if (query.fromTime > 0 && store.getTimestamp(storeRow) < query.fromTime) return false;
+    if (query.toTime > 0 && store.getTimestamp(storeRow) > query.toTime) return false;
+    return true;
+}
+
+inline int OrderTableModel::viewRowOfStoreRow(int storeRow) const {
+    if (storeRow < 0 || storeRow >= static_cast<int>(viewRowByStoreRow.size())) return -1;
+    return viewRowByStoreRow[storeRow];
+}
+
+inline void OrderTableModel::rebuildViewIndex(int fromViewRow) {
+    for (int i = fromViewRow; i < static_cast<int>(rows.size()); ++i) {
+        if (rows[i] >= static_cast<int>(viewRowByStoreRow.size())) {
+            viewRowByStoreRow.resize(rows[i] + 1, -1);
+        }
+        viewRowByStoreRow[rows[i]] = i;
+    }
+}
+
+// Places a newly matching order among the loaded rows. Only ID order can be patched
+// in place; under other sorts the order shows up on the next reload.
+inline void OrderTableModel::insertViewRow(int storeRow) {
+    if (query.sortKey != OrderSortKey::ById) return;
+    const OrderStore &store = OrderStore::getInstance();
+    int orderId = store.getOrderID(storeRow);
+    bool descending = query.descending;
+    auto position = std::lower_bound(rows.begin(), rows.end(), orderId, [&store, descending](int row, int id) {
+        return descending ? store.getOrderID(row) > id : store.getOrderID(row) < id;
+    });
+    if (position == rows.end() && moreOnServer) return; // Belongs to a page not fetched yet
+
+    int viewRow = static_cast<int>(position - rows.begin());
+    beginInsertRows(QModelIndex(), viewRow, viewRow);
+    rows.insert(position, storeRow);
+    if (viewRow == static_cast<int>(rows.size()) - 1) {
+        query.after = store.cursorAt(storeRow, query.sortKey);
+    }
+    rebuildViewIndex(viewRow);
+    endInsertRows();
+}
+
+inline void OrderTableModel::removeViewRow(int viewRow) {
+    beginRemoveRows(QModelIndex(), viewRow, viewRow);
+    viewRowByStoreRow[rows[viewRow]] = -1;
+    rows.erase(rows.begin() + viewRow);
+    rebuildViewIndex(viewRow);
+    endRemoveRows();
+}
+
+inline void OrderTableModel::applyDelta(const EntityDelta &delta) {
+    const OrderStore &store = OrderStore::getInstance();
+    int storeRow = store.findRow(delta.entityID);
+    if (storeRow < 0) return;
+
+    // The buffered page may now miss or duplicate this order; the cursor itself stays valid
+    hasPrefetched = false;
+    prefetched = OrderPage();
+    prefetchScheduled = false;
+    ++prefetchGeneration;
+
+    bool belongs = rowMatchesQuery(storeRow);
+    int viewRow = viewRowOfStoreRow(storeRow);
+    if (viewRow < 0) {
+        if (belongs) insertViewRow(storeRow);
+    } else if (!belongs) {
+        removeViewRow(viewRow);
+    } else {
+        emit dataChanged(index(viewRow, 0), index(viewRow, ColumnCount - 1));
+    }
+    schedulePrefetch();
+}
+
+#endif // ORDERTABLEMODEL_H
@@ -9,6 +9,10 @@
 #include <ctime>
 #include <limits>
 #include <iomanip>
+#include <vector>
+
+#include "IoStats.h"
+#include "Trace.h"
 
 using namespace std;
 
@@ -32,7 +36,8 @@ private:
     }
 
     static int getNextPaymentID() {
-        ifstream inFile("data/payments.txt");
+        TRACE_SCOPE("payment", "Payment::getNextPaymentID");
+        TrackedIfstream inFile(IoStats::Payments, "data/payments.txt");
         string line;
         int maxID = 0;
         int currentID = 0;
@@ -111,16 +116,9 @@ public:
             cerr << "Error: Invalid user or amount details for payment simulation." << endl;
             return false;
         }
-        
-        this->orderID = oid;
-        this->userID = uid;
-        this->amount = amt;
-        this->paymentID = getNextPaymentID();
-        delete[] method; method = nullptr;
-        delete[] status; status = nullptr;
 
-        cout << "\n--- Payment Simulation --- Order ID: " << orderID << " Amount: $" 
-             << fixed << setprecision(2) << amount << endl;
+        cout << "\n--- Payment Simulation --- Order ID: " << oid << " Amount: $" 
+             << fixed << setprecision(2) << amt << endl;
 
         int choice;
         string selectedMethod;
@@ -149,8 +147,6 @@ public:
                 break;
             }
         }
-        allocateAndCopy(this->method, selectedMethod.c_str());
-
         string cardNumber, expiryDate, cvv, holderName, accountNumber, pin;
 
         if (choice == 1 || choice == 2 || choice == 5) {
@@ -169,6 +165,23 @@ public:
             getline(cin, pin);
         }
 
+        return simulatePayment(oid, uid, amt, selectedMethod);
+    }
+
+    // Non-interactive payment: records a completed payment by the given method.
+    bool simulatePayment(int oid, int uid, double amt, const string& paymentMethod) {
+        TRACE_SCOPE("payment", "Payment::simulatePayment");
+        if (oid <= 0 || uid <= 0 || amt <= 0 || paymentMethod.empty()) {
+            cerr << "Error: Invalid payment details." << endl;
+            return false;
+        }
+        this->orderID = oid;
+        this->userID = uid;
+        this->amount = amt;
+        this->paymentID = getNextPaymentID();
+        allocateAndCopy(this->method, paymentMethod.c_str());
+        delete[] status; status = nullptr;
+
         cout << "\nProcessing payment..." << endl;
         bool success = true;
 
@@ -180,7 +193,7 @@ public:
             allocateAndCopy(this->status, "Failed");
         }
 
-        ofstream logFile("data/payments.txt", ios::app);
+        TrackedOfstream logFile(IoStats::Payments, "data/payments.txt", ios::app);
         if (!logFile) {
             cerr << "Error: Could not open payments.txt to log transaction." << endl;
              cerr << "Warning: Payment log failed. Status was: " << this->status << endl;
@@ -197,4 +210,30 @@ public:
         return success;
     }
 
+    // Records a completed payment for each entry (order, user, amount and method set)
+    // with one ID scan and one append, assigning consecutive payment IDs in order.
+    static bool recordPayments(vector<Payment>& payments) {
+        TRACE_SCOPE("payment", "Payment::recordPayments");
+        if (payments.empty()) return true;
+        int nextID = getNextPaymentID();
+        TrackedOfstream logFile(IoStats::Payments, "data/payments.txt", ios::app);
+        if (!logFile) {
+            cerr << "Error: Could not open payments.txt to log transactions." << endl;
+            return false;
+        }
+        for (size_t i = 0; i < payments.size(); ++i) {
+            Payment& payment = payments[i];
+            payment.paymentID = nextID++;
+            payment.allocateAndCopy(payment.status, "Completed");
+            logFile << payment.paymentID << ","
+                    << payment.orderID << ","
+                    << payment.userID << ","
+                    << fixed << setprecision(2) << payment.amount << ","
+                    << (payment.method ? payment.method : "") << ","
+                    << payment.status << endl;
+        }
+        logFile.close();
+        return static_cast<bool>(logFile);
+    }
+
 }; 
\ No newline at end of file
@@ -24,6 +24,8 @@ public:
     inline PaymentDialog(double amount, QWidget *parent = nullptr);
     inline ~PaymentDialog();
 
+    QString getPaymentMethod() const { return paymentMethodComboBox->currentText(); }
+
 private slots:
     inline void handleSimulatePayment();
     inline void handlePaymentMethodChange(int index);
@@ -7,6 +7,14 @@
 #include <sstream>   
 #include <iomanip>   
 #include <limits>    
+#include <cmath>
+#include <memory>
+
+#include "ProductCatalog.h"
+#include "ShardedStockCounter.h"
+#include "ChangeFeed.h"
+#include "IoStats.h"
+#include "Trace.h"
 
 using namespace std;
 
@@ -19,6 +27,7 @@ private:
     double price;
     double rating; 
     int stock;
+    unsigned long long version; // Catalog version the fields were read at; 0 if not from the catalog
 
     void allocateAndCopy(char*& dest, const char* src) {
         delete[] dest; 
@@ -31,7 +40,8 @@ private:
     }
 
     static int getNextProductID() {
-        ifstream inFile("data/products.txt");
+        TRACE_SCOPE("product", "Product::getNextProductID");
+        TrackedIfstream inFile(IoStats::Products, "data/products.txt");
         string line;
         int maxID = 0;
         int currentID = 0;
@@ -92,24 +102,24 @@ private:
     }
 
 public:
-    Product() : productID(0), name(nullptr), category(nullptr), description(nullptr), price(0.0), rating(0.0), stock(0) {}
+    Product() : productID(0), name(nullptr), category(nullptr), description(nullptr), price(0.0), rating(0.0), stock(0), version(0) {}
 
     Product(int id, const char* n, const char* cat, const char* desc, double p, double r, int s) :
-        productID(id), name(nullptr), category(nullptr), description(nullptr), price(p), rating(r), stock(s) {
+        productID(id), name(nullptr), category(nullptr), description(nullptr), price(p), rating(r), stock(s), version(0) {
         allocateAndCopy(name, n);
         allocateAndCopy(category, cat);
         allocateAndCopy(description, desc);
     }
 
     Product(int id, const char* n, const char* cat, double p, double r, int s) :
-        productID(id), name(nullptr), category(nullptr), description(nullptr), price(p), rating(r), stock(s) {
+        productID(id), name(nullptr), category(nullptr), description(nullptr), price(p), rating(r), stock(s), version(0) {
         allocateAndCopy(name, n);
         allocateAndCopy(category, cat);
     }
 
     Product(const Product& other) :
         productID(other.productID), name(nullptr), category(nullptr), description(nullptr),
-        price(other.price), rating(other.rating), stock(other.stock) {
+        price(other.price), rating(other.rating), stock(other.stock), version(other.version) {
         allocateAndCopy(name, other.name);
         allocateAndCopy(category, other.category);
         allocateAndCopy(description, other.description);
@@ -121,6 +131,7 @@ public:
             price = other.price;
             rating = other.rating;
             stock = other.stock;
+            version = other.version;
             allocateAndCopy(name, other.name);
             allocateAndCopy(category, other.category);
             allocateAndCopy(description, other.description);
@@ -141,6 +152,7 @@ public:
     double getPrice() const { return price; }
     double getRating() const { return rating; }
     int getStock() const { return stock; }
+    unsigned long long getVersion() const { return version; }
 
     void setName(const char* n) { allocateAndCopy(name, n); }
     void setCategory(const char* cat) { allocateAndCopy(category, cat); }
@@ -148,9 +160,11 @@ public:
     void setPrice(double p) { price = p; }
     void setRating(double r) { rating = r; }
     void setStock(int s) { stock = s; }
+    void setVersion(unsigned long long v) { version = v; }
 
     static Product* getProductByID(int productID) {
-        ifstream inFile("data/products.txt");
+        TRACE_SCOPE("product", "Product::getProductByID");
+        TrackedIfstream inFile(IoStats::Products, "data/products.txt");
         if (!inFile) {
             return nullptr;
         }
@@ -223,6 +237,7 @@ public:
     static bool addProduct();
     static Product* loadAllProducts(int& outCount);
     static void searchByName(const string& query) {
+        TRACE_SCOPE("product", "Product::searchByName");
         if (query.empty()) {
             cout << "Search query cannot be empty." << endl;
              loadAllProductsAndDisplay("All Products (Empty Search)");
@@ -234,7 +249,7 @@ public:
              lowerQuery[i] = tolower(lowerQuery[i]);
         }
         
-        ifstream inFile("data/products.txt");
+        TrackedIfstream inFile(IoStats::Products, "data/products.txt");
         if (!inFile) {
             cerr << "Error: Cannot open products.txt for searching." << endl;
             return;
@@ -303,6 +318,7 @@ public:
     }
 
     static void filterByCategory(const string& categoryQuery) {
+        TRACE_SCOPE("product", "Product::filterByCategory");
          if (categoryQuery.empty()) {
             cout << "Category filter cannot be empty." << endl;
              loadAllProductsAndDisplay("All Products (Empty Filter)");
@@ -311,7 +327,7 @@ public:
         string lowerQuery = categoryQuery;
         for (int i = 0; i < lowerQuery.length(); ++i) { lowerQuery[i] = tolower(lowerQuery[i]); }
 
-        ifstream inFile("data/products.txt");
+        TrackedIfstream inFile(IoStats::Products, "data/products.txt");
         if (!inFile) { cerr << "Error: Cannot open products.txt." << endl; return; }
         
         string line;
@@ -374,10 +390,11 @@ public:
     }
 
     static void filterByPriceRange(double minPrice, double maxPrice) {
+        TRACE_SCOPE("product", "Product::filterByPriceRange");
          if (minPrice < 0 || maxPrice < 0 || minPrice > maxPrice) {
              cout << "Invalid price range specified." << endl; return;
          }
-         ifstream inFile("data/products.txt");
+         TrackedIfstream inFile(IoStats::Products, "data/products.txt");
          if (!inFile) { cerr << "Error: Cannot open products.txt." << endl; return; }
         
         string line;
@@ -438,10 +455,11 @@ public:
     }
 
     static void filterByRating(double minRating) {
+        TRACE_SCOPE("product", "Product::filterByRating");
          if (minRating < 0.0 || minRating > 5.0) {
              cout << "Invalid minimum rating specified (must be 0.0-5.0)." << endl; return;
          }
-         ifstream inFile("data/products.txt");
+         TrackedIfstream inFile(IoStats::Products, "data/products.txt");
          if (!inFile) { cerr << "Error: Cannot open products.txt." << endl; return; }
         
         string line;
@@ -503,22 +521,44 @@ public:
     }
 
     static void loadAllProductsAndDisplay(const string& title = "All Products") {
+        TRACE_SCOPE("product", "Product::loadAllProductsAndDisplay");
          int count = 0;
          Product* all = loadAllProducts(count);
          displayProductList(all, count, title);
          delete[] all;
     }
 
+    // Outcome of an edit based on an earlier read; see editProduct(int, const Product&, const Product&, string&).
+    enum EditResult {
+        EditSaved,      // Nothing changed since the read; saved as given
+        EditMerged,     // Changed since, but not in the fields edited; both sets of changes kept
+        EditConflict,   // A field was edited here and changed differently since; nothing saved
+        EditFailed      // Unknown product or a write error
+    };
+
+    // The product as the catalog holds it now, stamped with its version, as the starting
+    // point of an edit. Reads a snapshot, so it needs no store lock. Null if unknown.
+    static Product* getProductForEdit(int productID);
+
     static bool addProduct(const Product& productData);
+    // Overwrites every edited field with productData, whatever changed since it was read.
     static bool editProduct(int productId, const Product& productData);
+    // Saves an edit of `original` (from getProductForEdit) as compare-and-set: if the
+    // product's catalog version is still original's, productData is saved as is;
+    // otherwise each field keeps whichever side changed it, and stock applies the edit as
+    // a difference on top of the current stock, so units sold meanwhile stay sold.
+    // Fields changed differently on both sides are listed in `conflicts`. Call with the
+    // products lock held exclusively; the lock is not needed while the edit is being made.
+    static EditResult editProduct(int productId, const Product& original, const Product& productData, string& conflicts);
     static bool removeProduct(int productId);
 
 };
 
 inline bool Product::addProduct(const Product& productData) {
+    TRACE_SCOPE("product", "Product::addProduct");
     int newID = getNextProductID();
     
-    std::ofstream outFile("data/products.txt", std::ios::app);
+    TrackedOfstream outFile(IoStats::Products, "data/products.txt", std::ios::app);
     if (!outFile) {
         std::cerr << "Error: Could not open products.txt for writing in Product::addProduct." << std::endl;
         return false;
@@ -532,19 +572,91 @@ inline bool Product::addProduct(const Product& productData) {
             << productData.getStock() << std::endl;
     
     outFile.close();
+    ProductCatalog::getInstance().upsertProduct(newID, productData.getName(), productData.getCategory(),
+                                                productData.getPrice(), 0.0, productData.getStock());
+    ChangeFeed::getInstance().publish(EntityType::Product, ChangeKind::Inserted, newID, ProductField::All);
     std::cout << "Product '" << (productData.getName() ? productData.getName() : "N/A") 
               << "' added successfully with ID: " << newID << std::endl;
     return true;
 }
 
+inline Product* Product::getProductForEdit(int productID) {
+    ProductCatalog& catalog = ProductCatalog::getInstance();
+    if (!catalog.ensureLoaded()) return nullptr;
+    shared_ptr<const CatalogSnapshot> snapshot = catalog.snapshot();
+    int row = snapshot->findRow(productID);
+    if (row < 0) return nullptr;
+    Product* product = new Product(productID, snapshot->getName(row), snapshot->getCategory(row).c_str(),
+                                   snapshot->getPrice(row), snapshot->getRating(row), snapshot->getStock(row));
+    product->setVersion(snapshot->getVersion(row));
+    return product;
+}
+
+inline Product::EditResult Product::editProduct(int productId, const Product& original, const Product& productData,
+                                                string& conflicts) {
+    TRACE_SCOPE("product", "Product::editProduct(merge)");
+    conflicts.clear();
+    // Every write to products.txt reaches the catalog before the products lock is
+    // released, so under the lock the catalog row is what the file holds now
+    ProductCatalog& catalog = ProductCatalog::getInstance();
+    int row = catalog.ensureLoaded() ? catalog.findRow(productId) : -1;
+    if (row < 0) {
+        std::cerr << "Error: Product ID " << productId << " not found for editing." << std::endl;
+        return EditFailed;
+    }
+    // Compare-and-set: the row version is bumped by every change to the product
+    if (original.getVersion() != 0 && catalog.getVersion(row) == original.getVersion()) {
+        return editProduct(productId, productData) ? EditSaved : EditFailed;
+    }
+
+    // Three-way merge of what was read, what was edited and what is there now
+    std::string base[2] = {original.getName() ? original.getName() : "", original.getCategory() ? original.getCategory() : ""};
+    std::string mine[2] = {productData.getName() ? productData.getName() : "", productData.getCategory() ? productData.getCategory() : ""};
+    std::string theirs[2] = {catalog.getName(row), catalog.getCategory(row)};
+    static const char* textFields[2] = {"name", "category"};
+    std::string merged[2];
+    bool changedSince = false;
+    for (int i = 0; i < 2; ++i) {
+        if (theirs[i] != base[i]) changedSince = true;
+        if (mine[i] == base[i] || mine[i] == theirs[i]) merged[i] = theirs[i];
+        else if (theirs[i] == base[i]) merged[i] = mine[i];
+        else conflicts += (conflicts.empty() ? "" : ", ") + std::string(textFields[i]);
+    }
+
+    double mergedPrice = catalog.getPrice(row);
+    bool priceEdited = std::fabs(productData.getPrice() - original.getPrice()) >= 0.005;
+    bool priceChanged = std::fabs(mergedPrice - original.getPrice()) >= 0.005;
+    if (priceChanged) changedSince = true;
+    if (priceEdited && priceChanged && std::fabs(productData.getPrice() - mergedPrice) >= 0.005) {
+        conflicts += (conflicts.empty() ? "" : ", ") + std::string("price");
+    } else if (priceEdited) {
+        mergedPrice = productData.getPrice();
+    }
+
+    int currentStock = catalog.getStock(row);
+    if (currentStock != original.getStock()) changedSince = true;
+    int mergedStock = currentStock + (productData.getStock() - original.getStock());
+    if (mergedStock < 0) conflicts += (conflicts.empty() ? "" : ", ") + std::string("stock");
+
+    if (!conflicts.empty()) {
+        std::cerr << "Error: Product ID " << productId << " was changed since it was read (" << conflicts << ")." << std::endl;
+        return EditConflict;
+    }
+    if (!changedSince) return editProduct(productId, productData) ? EditSaved : EditFailed;
+    Product mergedData(productId, merged[0].c_str(), merged[1].c_str(), productData.getDescription(),
+                       mergedPrice, catalog.getRating(row), mergedStock);
+    return editProduct(productId, mergedData) ? EditMerged : EditFailed;
+}
+
 inline bool Product::editProduct(int productId, const Product& productData) {
-    std::ifstream inFile("data/products.txt");
+    TRACE_SCOPE("product", "Product::editProduct");
+    TrackedIfstream inFile(IoStats::Products, "data/products.txt");
     if (!inFile) {
         std::cerr << "Error: Could not open products.txt for reading." << std::endl;
         return false;
     }
 
-    std::ofstream tempFile("data/products_temp.txt");
+    TrackedOfstream tempFile(IoStats::Products, "data/products_temp.txt");
     if (!tempFile) {
         std::cerr << "Error: Could not create temporary file for product update." << std::endl;
         inFile.close();
@@ -553,6 +665,8 @@ inline bool Product::editProduct(int productId, const Product& productData) {
 
     std::string line;
     bool productFound = false;
+    double originalRating = 0.0;
+    int originalStock = 0;
     
     while (std::getline(inFile, line)) {
         if (line.empty()) {
@@ -574,7 +688,6 @@ inline bool Product::editProduct(int productId, const Product& productData) {
         
         if (currentId == productId) {
             productFound = true;
-            double originalRating = 0.0;
             std::getline(ss, segment, ',');
             std::getline(ss, segment, ',');
             std::getline(ss, segment, ',');
@@ -584,6 +697,7 @@ inline bool Product::editProduct(int productId, const Product& productData) {
                 } catch (...) {
                 }
             }
+            if (std::getline(ss, segment, ',')) originalStock = std::atoi(segment.c_str());
             
             tempFile << productId << ","
                      << (productData.getName() ? productData.getName() : "") << ","
@@ -614,19 +728,31 @@ inline bool Product::editProduct(int productId, const Product& productData) {
         std::cerr << "Error: Could not rename temporary file to products.txt." << std::endl;
         return false;
     }
+    IoStats::add(IoStats::Products, IoStats::TempRewrites);
+    HotStockCounters::getInstance().adjust(productId, productData.getStock() - originalStock);
     
+    ProductCatalog& catalog = ProductCatalog::getInstance();
+    unsigned int changedFields = catalog.isLoaded()
+        ? catalog.upsertProduct(productId, productData.getName(), productData.getCategory(),
+                                productData.getPrice(), originalRating, productData.getStock())
+        : ProductField::All;
+    if (changedFields != 0) {
+        ChangeFeed::getInstance().publish(EntityType::Product, ChangeKind::Updated, productId, changedFields);
+    }
+
     std::cout << "Product ID " << productId << " updated successfully." << std::endl;
     return true;
 }
 
 inline bool Product::removeProduct(int productId) {
-    std::ifstream inFile("data/products.txt");
+    TRACE_SCOPE("product", "Product::removeProduct");
+    TrackedIfstream inFile(IoStats::Products, "data/products.txt");
     if (!inFile) {
         std::cerr << "Error: Could not open products.txt for reading." << std::endl;
         return false;
     }
 
-    std::ofstream tempFile("data/products_temp.txt");
+    TrackedOfstream tempFile(IoStats::Products, "data/products_temp.txt");
     if (!tempFile) {
         std::cerr << "Error: Could not create temporary file for product removal." << std::endl;
         inFile.close();
@@ -679,14 +805,20 @@ inline bool Product::removeProduct(int productId) {
         std::cerr << "Error: Could not rename temporary file to products.txt." << std::endl;
         return false;
     }
+    IoStats::add(IoStats::Products, IoStats::TempRewrites);
     
+    ProductCatalog::getInstance().removeProduct(productId);
+    HotStockCounters::getInstance().untrack(productId);
+    ChangeFeed::getInstance().publish(EntityType::Product, ChangeKind::Removed, productId, ProductField::All);
+
     std::cout << "Product ID " << productId << " removed successfully." << std::endl;
     return true;
 }
 
 inline Product* Product::loadAllProducts(int& outCount) {
+    TRACE_SCOPE("product", "Product::loadAllProducts");
     outCount = 0;
-    ifstream inFile("data/products.txt");
+    TrackedIfstream inFile(IoStats::Products, "data/products.txt");
     
     if (!inFile) {
         cerr << "Error: Could not open products.txt file." << endl;
@@ -786,6 +918,7 @@ inline Product* Product::loadAllProducts(int& outCount) {
 }
 
 inline bool Product::addProduct() {
+    TRACE_SCOPE("product", "Product::addProduct");
     string name_str, category_str, description_str;
     double price_val, rating_val = 0.0;
     int stock_val;
@@ -819,7 +952,7 @@ inline bool Product::addProduct() {
     }
     cin.ignore(numeric_limits<streamsize>::max(), '\n');
 
-    ofstream outFile("data/products.txt", ios::app);
+    TrackedOfstream outFile(IoStats::Products, "data/products.txt", ios::app);
     if (!outFile) {
         cerr << "Error: Could not open products.txt for writing." << endl;
         return false;
@@ -833,6 +966,8 @@ inline bool Product::addProduct() {
             << stock_val << endl;
 
     outFile.close();
+    ProductCatalog::getInstance().upsertProduct(nextID, name_str.c_str(), category_str.c_str(), price_val, rating_val, stock_val);
+    ChangeFeed::getInstance().publish(EntityType::Product, ChangeKind::Inserted, nextID, ProductField::All);
     cout << "Product '" << name_str << "' added successfully!" << endl;
     return true;
 }
@@ -0,0 +1,565 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <cctype>
+
+#include "ChangeFeed.h"
+#include "IoStats.h"
+#include "Trace.h"
+
+using namespace std;
+
+// One published version of the catalog, column-oriented: every field lives in its own
+// flat array indexed by catalog row, so views can read one cell without materialising
+// Product objects (or any per-row allocation). Names are packed into NUL-separated
+// character arenas and categories are dictionary encoded, because both repeat heavily
+// across a large catalog. A lower-case copy of the name arena lets searches use strstr.
+//
+// A version never changes once published, so a reader holding one sees the same
+// products however long it keeps it. Rows are stored in chunks of ChunkRows and a new
+// version shares every chunk it did not touch with the one before, so a stock change
+// copies one chunk rather than the catalog. Rows are append-only and removals leave a
+// tombstone, so a row number means the same product in every version of a load.
+//
+// Each row also records the catalog version that last changed it. Versions only grow,
+// across reloads too, so a reader holding an earlier version can tell which rows changed
+// since (see changedRows).
+class CatalogSnapshot {
+public:
+    static const int ChunkShift = 10;
+    static const int ChunkRows = 1 << ChunkShift;
+
+private:
+    friend class ProductCatalog;
+
+    struct Chunk {
+        vector<int> productIDs;
+        vector<double> prices;
+        vector<double> ratings;
+        vector<int> stocks;
+        vector<unsigned char> alive;
+        vector<unsigned int> nameOffsets;
+        vector<char> nameArena;
+        vector<char> lowerNameArena;    // The names in lower case, at the same offsets, for search
+        vector<unsigned int> categoryCodes;     // Into categoryNames; 16 bits would wrap past 65,535 categories
+        vector<unsigned long long> versions;
+    };
+
+    vector<shared_ptr<Chunk> > chunks;
+    shared_ptr<vector<string> > categoryNames;
+    shared_ptr<unordered_map<int, int> > rowByID;
+    int rowCount;
+    int liveCount;
+    unsigned long long versionNumber;
+    bool loaded;
+
+    const Chunk& chunkOf(int row) const { return *chunks[static_cast<size_t>(row >> ChunkShift)]; }
+    static size_t slotOf(int row) { return static_cast<size_t>(row & (ChunkRows - 1)); }
+
+    static bool nameContains(const Chunk& chunk, size_t slot, const string& lowerNeedle) {
+        return strstr(&chunk.lowerNameArena[chunk.nameOffsets[slot]], lowerNeedle.c_str()) != nullptr;
+    }
+
+    static bool equalsIgnoreCase(const string& a, const string& lowerB) {
+        if (a.length() != lowerB.length()) return false;
+        for (size_t i = 0; i < a.length(); ++i) {
+            if (tolower(static_cast<unsigned char>(a[i])) != lowerB[i]) return false;
+        }
+        return true;
+    }
+
+public:
+    // An empty catalog that has not been loaded
+    CatalogSnapshot()
+        : categoryNames(make_shared<vector<string> >()), rowByID(make_shared<unordered_map<int, int> >()),
+          rowCount(0), liveCount(0), versionNumber(0), loaded(false) {}
+
+    static string toLower(const string& text) {
+        string lower = text;
+        for (size_t i = 0; i < lower.length(); ++i) {
+            lower[i] = static_cast<char>(tolower(static_cast<unsigned char>(lower[i])));
+        }
+        return lower;
+    }
+
+    // Increases with every published change; a new load starts from the last one.
+    unsigned long long version() const { return versionNumber; }
+    bool isLoaded() const { return loaded; }
+    // Number of row slots, including removed ones; iterate [0, size()) and skip !isAlive(row).
+    int size() const { return rowCount; }
+    int liveSize() const { return liveCount; }
+    bool isAlive(int row) const { return chunkOf(row).alive[slotOf(row)] != 0; }
+
+    int findRow(int productID) const {
+        int row = findSlot(productID);
+        return (row < 0 || !isAlive(row)) ? -1 : row;
+    }
+
+    // Like findRow but also returns the tombstoned row of a removed product,
+    // so views can locate the row they have to drop.
+    int findSlot(int productID) const {
+        auto it = rowByID->find(productID);
+        return (it == rowByID->end()) ? -1 : it->second;
+    }
+
+    int getProductID(int row) const { return chunkOf(row).productIDs[slotOf(row)]; }
+    const char* getName(int row) const {
+        const Chunk& chunk = chunkOf(row);
+        return &chunk.nameArena[chunk.nameOffsets[slotOf(row)]];
+    }
+    const string& getCategory(int row) const { return (*categoryNames)[chunkOf(row).categoryCodes[slotOf(row)]]; }
+    double getPrice(int row) const { return chunkOf(row).prices[slotOf(row)]; }
+    double getRating(int row) const { return chunkOf(row).ratings[slotOf(row)]; }
+    int getStock(int row) const { return chunkOf(row).stocks[slotOf(row)]; }
+    // The catalog version in which the row last changed
+    unsigned long long getVersion(int row) const { return chunkOf(row).versions[slotOf(row)]; }
+
+    const vector<string>& getCategories() const { return *categoryNames; }
+
+    // True if a live row passes the listing filters. Name/category must already be lower-case.
+    bool rowMatches(int row, const string& lowerName, const string& lowerCategory,
+                    double minPrice, double maxPrice, double minRating) const {
+        if (row < 0 || row >= rowCount || !isAlive(row)) return false;
+        if (!lowerCategory.empty() && !equalsIgnoreCase(getCategory(row), lowerCategory)) return false;
+        if (getPrice(row) < minPrice || getPrice(row) > maxPrice) return false;
+        if (getRating(row) < minRating) return false;
+        return nameContains(chunkOf(row), slotOf(row), lowerName);
+    }
+
+    // The name test of rowMatches() alone, for rows known to pass the other filters
+    bool nameMatches(int row, const string& lowerName) const {
+        return nameContains(chunkOf(row), slotOf(row), lowerName);
+    }
+
+    // Row storage is split into this many chunks; a scan can be split along them.
+    size_t chunkCount() const { return chunks.size(); }
+
+    // Returns the catalog rows that pass every filter, in file order.
+    // An empty name or category means "do not filter on it".
+    vector<int> filterRows(const string& nameQuery, const string& categoryQuery,
+                           double minPrice, double maxPrice, double minRating) const {
+        return filterRows(nameQuery, categoryQuery, minPrice, maxPrice, minRating, 0, chunks.size());
+    }
+
+    // The same, over the rows of chunks [firstChunk, endChunk) only.
+    vector<int> filterRows(const string& nameQuery, const string& categoryQuery, double minPrice,
+                           double maxPrice, double minRating, size_t firstChunk, size_t endChunk) const {
+        string lowerName = toLower(nameQuery);
+        string lowerCategory = toLower(categoryQuery);
+
+        vector<bool> categoryMatches(categoryNames->size(), lowerCategory.empty());
+        if (!lowerCategory.empty()) {
+            for (size_t i = 0; i < categoryNames->size(); ++i) {
+                categoryMatches[i] = equalsIgnoreCase((*categoryNames)[i], lowerCategory);
+            }
+        }
+
+        vector<int> rows;
+        for (size_t c = firstChunk; c < endChunk && c < chunks.size(); ++c) {
+            const Chunk& chunk = *chunks[c];
+            for (size_t i = 0; i < chunk.productIDs.size(); ++i) {
+                if (!chunk.alive[i]) continue;
+                if (!categoryMatches[chunk.categoryCodes[i]]) continue;
+                if (chunk.prices[i] < minPrice || chunk.prices[i] > maxPrice) continue;
+                if (chunk.ratings[i] < minRating) continue;
+                if (!nameContains(chunk, i, lowerName)) continue;
+                rows.push_back(static_cast<int>((c << ChunkShift) + i));
+            }
+        }
+        return rows;
+    }
+
+    vector<int> allRows() const {
+        vector<int> rows;
+        rows.reserve(static_cast<size_t>(liveCount));
+        for (size_t c = 0; c < chunks.size(); ++c) {
+            const Chunk& chunk = *chunks[c];
+            for (size_t i = 0; i < chunk.alive.size(); ++i) {
+                if (chunk.alive[i]) rows.push_back(static_cast<int>((c << ChunkShift) + i));
+            }
+        }
+        return rows;
+    }
+
+    // Rows changed, added or removed after catalog version `since`, in row order. Reads
+    // only the version column, so it is much cheaper than a filterRows() pass.
+    vector<int> changedRows(unsigned long long since) const {
+        vector<int> rows;
+        for (size_t c = 0; c < chunks.size(); ++c) {
+            const vector<unsigned long long>& versions = chunks[c]->versions;
+            for (size_t i = 0; i < versions.size(); ++i) {
+                if (versions[i] > since) rows.push_back(static_cast<int>((c << ChunkShift) + i));
+            }
+        }
+        return rows;
+    }
+};
+
+// In-memory copy of data/products.txt, published as a series of CatalogSnapshot versions
+// (read-copy-update). Readers call snapshot() and never wait for a writer: a writer
+// builds the next version beside the current one and swaps the pointer when it is done,
+// and an old version is freed when its last reader lets go of it. Writes made through
+// the Product/Order/Review statics are applied here after they reach products.txt; a
+// WriteBatch publishes several of them as one version.
+//
+// The accessors on this class read the newest version, including writes of a batch still
+// open, without pinning it. They are for callers holding the products store lock (see
+// StoreLocks.h), which keeps writers out; views and reports that read without it take a
+// snapshot() instead.
+class ProductCatalog {
+private:
+    typedef CatalogSnapshot::Chunk Chunk;
+
+    shared_ptr<const CatalogSnapshot> published;
+
+    // Writer side, guarded by writeLock
+    recursive_mutex writeLock;
+    unique_ptr<CatalogSnapshot> draft;          // Next version while a write is open, or null
+    vector<bool> ownedChunks;                   // Draft chunks no published version shares
+    bool ownsCategories;
+    bool ownsIndex;
+    unordered_map<string, unsigned int> categoryLookup;
+    int batchDepth;
+
+    ProductCatalog()
+        : published(make_shared<CatalogSnapshot>()), ownsCategories(false), ownsIndex(false), batchDepth(0) {}
+
+    const CatalogSnapshot& latest() const { return draft ? *draft : *published; }
+
+    CatalogSnapshot& draftLocked() {
+        if (!draft) {
+            draft.reset(new CatalogSnapshot(*published));
+            ownedChunks.assign(draft->chunks.size(), false);
+            ownsCategories = false;
+            ownsIndex = false;
+        }
+        return *draft;
+    }
+
+    // Starts the next version from nothing, e.g. for a reload.
+    void resetDraftLocked() {
+        unsigned long long lastVersion = published->versionNumber;
+        draft.reset(new CatalogSnapshot());
+        draft->versionNumber = lastVersion;
+        ownedChunks.clear();
+        ownsCategories = true;
+        ownsIndex = true;
+        categoryLookup.clear();
+    }
+
+    void publishLocked() {
+        if (!draft) return;
+        draft->versionNumber = published->versionNumber + 1;
+        atomic_store(&published, shared_ptr<const CatalogSnapshot>(draft.release()));
+        ownedChunks.clear();
+    }
+
+    void commitLocked() {
+        if (batchDepth == 0) publishLocked();
+    }
+
+    // The version the open draft will be published as
+    unsigned long long nextVersion() const { return published->versionNumber + 1; }
+
+    // The chunk holding a row, copied first if a published version still shares it.
+    // The row is stamped with the next version, since the caller is about to change it.
+    Chunk& writableChunk(int row) {
+        CatalogSnapshot& next = draftLocked();
+        size_t index = static_cast<size_t>(row >> CatalogSnapshot::ChunkShift);
+        if (!ownedChunks[index]) {
+            next.chunks[index] = make_shared<Chunk>(*next.chunks[index]);
+            ownedChunks[index] = true;
+        }
+        Chunk& chunk = *next.chunks[index];
+        size_t slot = CatalogSnapshot::slotOf(row);
+        if (slot < chunk.versions.size()) chunk.versions[slot] = nextVersion();
+        return chunk;
+    }
+
+    void appendRow(int id, const char* name, size_t nameLength, const string& category,
+                   double price, double rating, int stock) {
+        CatalogSnapshot& next = draftLocked();
+        int row = next.rowCount;
+        if (static_cast<size_t>(row >> CatalogSnapshot::ChunkShift) >= next.chunks.size()) {
+            shared_ptr<Chunk> chunk = make_shared<Chunk>();
+            chunk->productIDs.reserve(CatalogSnapshot::ChunkRows);
+            chunk->prices.reserve(CatalogSnapshot::ChunkRows);
+            chunk->ratings.reserve(CatalogSnapshot::ChunkRows);
+            chunk->stocks.reserve(CatalogSnapshot::ChunkRows);
+            chunk->alive.reserve(CatalogSnapshot::ChunkRows);
+            chunk->nameOffsets.reserve(CatalogSnapshot::ChunkRows);
+            chunk->categoryCodes.reserve(CatalogSnapshot::ChunkRows);
+            chunk->versions.reserve(CatalogSnapshot::ChunkRows);
+            next.chunks.push_back(chunk);
+            ownedChunks.push_back(true);
+        }
+        unsigned int code = internCategory(category);
+        Chunk& chunk = writableChunk(row);
+        chunk.productIDs.push_back(id);
+        chunk.nameOffsets.push_back(appendName(chunk, name, nameLength));
+        chunk.categoryCodes.push_back(code);
+        chunk.prices.push_back(price);
+        chunk.ratings.push_back(rating);
+        chunk.stocks.push_back(stock);
+        chunk.alive.push_back(1);
+        chunk.versions.push_back(nextVersion());
+        if (!ownsIndex) {
+            next.rowByID = make_shared<unordered_map<int, int> >(*next.rowByID);
+            ownsIndex = true;
+        }
+        (*next.rowByID)[id] = row;
+        next.rowCount++;
+        next.liveCount++;
+    }
+
+    static unsigned int appendName(Chunk& chunk, const char* text, size_t length) {
+        unsigned int offset = static_cast<unsigned int>(chunk.nameArena.size());
+        chunk.nameArena.insert(chunk.nameArena.end(), text, text + length);
+        chunk.nameArena.push_back('\0');
+        for (size_t i = 0; i < length; ++i) {
+            chunk.lowerNameArena.push_back(static_cast<char>(tolower(static_cast<unsigned char>(text[i]))));
+        }
+        chunk.lowerNameArena.push_back('\0');
+        return offset;
+    }
+
+    unsigned int internCategory(const string& category) {
+        auto it = categoryLookup.find(category);
+        if (it != categoryLookup.end()) {
+            return it->second;
+        }
+        CatalogSnapshot& next = draftLocked();
+        if (!ownsCategories) {
+            next.categoryNames = make_shared<vector<string> >(*next.categoryNames);
+            ownsCategories = true;
+        }
+        unsigned int code = static_cast<unsigned int>(next.categoryNames->size());
+        next.categoryNames->push_back(category);
+        categoryLookup[category] = code;
+        return code;
+    }
+
+    bool loadLocked() {
+        TRACE_SCOPE("catalog", "ProductCatalog::load");
+        resetDraftLocked();
+        TrackedIfstream inFile(IoStats::Products, "data/products.txt");
+        if (!inFile) {
+            cerr << "Error: Could not open products.txt file." << endl;
+            commitLocked();
+            return false;
+        }
+
+        string line;
+        string category;
+        while (getline(inFile, line)) {
+            if (line.empty()) continue;
+
+            size_t fieldStart[6] = {0, 0, 0, 0, 0, 0};
+            size_t fieldEnd[6] = {0, 0, 0, 0, 0, 0};
+            int fieldCount = 0;
+            size_t pos = 0;
+            while (fieldCount < 6) {
+                size_t comma = line.find(',', pos);
+                fieldStart[fieldCount] = pos;
+                fieldEnd[fieldCount] = (comma == string::npos) ? line.length() : comma;
+                fieldCount++;
+                if (comma == string::npos) break;
+                pos = comma + 1;
+            }
+
+            char* parseEnd = nullptr;
+            long id = strtol(line.c_str() + fieldStart[0], &parseEnd, 10);
+            if (parseEnd == line.c_str() + fieldStart[0]) continue;
+
+            const char* name = line.c_str() + fieldStart[1];
+            size_t nameLength = (fieldCount > 1) ? fieldEnd[1] - fieldStart[1] : 0;
+            category.assign(fieldCount > 2 ? line.substr(fieldStart[2], fieldEnd[2] - fieldStart[2]) : "");
+            double price = (fieldCount > 3) ? strtod(line.c_str() + fieldStart[3], nullptr) : 0.0;
+            double rating = (fieldCount > 4) ? strtod(line.c_str() + fieldStart[4], nullptr) : 0.0;
+            int stock = (fieldCount > 5) ? static_cast<int>(strtol(line.c_str() + fieldStart[5], nullptr, 10)) : 0;
+
+            appendRow(static_cast<int>(id), fieldCount > 1 ? name : "", nameLength, category, price, rating, stock);
+        }
+        inFile.close();
+        draft->loaded = true;
+        commitLocked();
+        return true;
+    }
+
+    void beginBatch() {
+        writeLock.lock();
+        batchDepth++;
+    }
+
+    void endBatch() {
+        if (--batchDepth == 0) publishLocked();
+        writeLock.unlock();
+    }
+
+public:
+    static string toLower(const string& text) { return CatalogSnapshot::toLower(text); }
+
+    ProductCatalog(const ProductCatalog&) = delete;
+    ProductCatalog& operator=(const ProductCatalog&) = delete;
+
+    static ProductCatalog& getInstance() {
+        static ProductCatalog instance;
+        return instance;
+    }
+
+    // Groups writes into one version, so no snapshot sees part of them (e.g. some of the
+    // stock changes of an order). Other writers wait until it closes.
+    class WriteBatch {
+    private:
+        ProductCatalog& catalog;
+
+    public:
+        explicit WriteBatch(ProductCatalog& target) : catalog(target) { catalog.beginBatch(); }
+        ~WriteBatch() { catalog.endBatch(); }
+
+        WriteBatch(const WriteBatch&) = delete;
+        WriteBatch& operator=(const WriteBatch&) = delete;
+    };
+
+    // The current version, kept alive for as long as the caller holds it. Never waits
+    // for a writer.
+    shared_ptr<const CatalogSnapshot> snapshot() const {
+        return atomic_load(&published);
+    }
+
+    void clear() {
+        lock_guard<recursive_mutex> guard(writeLock);
+        resetDraftLocked();
+        commitLocked();
+    }
+
+    // Reads data/products.txt in a single pass. Same line format and the same
+    // lenient field handling as Product::loadAllProducts.
+    bool load() {
+        lock_guard<recursive_mutex> guard(writeLock);
+        return loadLocked();
+    }
+
+    bool ensureLoaded() {
+        bool loaded = snapshot()->isLoaded();
+        IoStats::cacheLookup(IoStats::Products, loaded);
+        if (loaded) return true;
+        lock_guard<recursive_mutex> guard(writeLock);
+        return latest().isLoaded() || loadLocked(); // Another thread may have loaded it meanwhile
+    }
+
+    unsigned long long version() const { return latest().version(); }
+    bool isLoaded() const { return latest().isLoaded(); }
+    int size() const { return latest().size(); }
+    int liveSize() const { return latest().liveSize(); }
+    bool isAlive(int row) const { return latest().isAlive(row); }
+    int findRow(int productID) const { return latest().findRow(productID); }
+    int findSlot(int productID) const { return latest().findSlot(productID); }
+
+    int getProductID(int row) const { return latest().getProductID(row); }
+    const char* getName(int row) const { return latest().getName(row); }
+    const string& getCategory(int row) const { return latest().getCategory(row); }
+    double getPrice(int row) const { return latest().getPrice(row); }
+    double getRating(int row) const { return latest().getRating(row); }
+    int getStock(int row) const { return latest().getStock(row); }
+    unsigned long long getVersion(int row) const { return latest().getVersion(row); }
+
+    const vector<string>& getCategories() const { return latest().getCategories(); }
+
+    // Applies an add or edit that has already been written to products.txt.
+    // Returns the ProductField bits that actually changed (ProductField::All for a new row).
+    // A catalog that has never been loaded ignores writes; its first load() reads them from disk.
+    unsigned int upsertProduct(int productID, const char* name, const char* category,
+                               double price, double rating, int stock) {
+        lock_guard<recursive_mutex> guard(writeLock);
+        if (!latest().isLoaded()) return 0;
+        string categoryText = category ? category : "";
+        int row = latest().findRow(productID);
+        if (row < 0) {
+            appendRow(productID, name ? name : "", name ? strlen(name) : 0, categoryText, price, rating, stock);
+            commitLocked();
+            return ProductField::All;
+        }
+
+        const CatalogSnapshot& current = latest();
+        const char* nameText = name ? name : "";
+        unsigned int code = internCategory(categoryText);
+        bool nameChanged = strcmp(current.getName(row), nameText) != 0;
+        bool categoryChanged = current.chunkOf(row).categoryCodes[CatalogSnapshot::slotOf(row)] != code;
+        bool priceChanged = current.getPrice(row) != price;
+        bool ratingChanged = current.getRating(row) != rating;
+        bool stockChanged = current.getStock(row) != stock;
+        if (!nameChanged && !categoryChanged && !priceChanged && !ratingChanged && !stockChanged) {
+            commitLocked(); // internCategory may have started a version with a new category
+            return 0;
+        }
+
+        unsigned int changed = 0;
+        Chunk& chunk = writableChunk(row);
+        size_t slot = CatalogSnapshot::slotOf(row);
+        if (nameChanged) {
+            chunk.nameOffsets[slot] = appendName(chunk, nameText, strlen(nameText));
+            changed |= ProductField::Name;
+        }
+        if (categoryChanged) { chunk.categoryCodes[slot] = code; changed |= ProductField::Category; }
+        if (priceChanged) { chunk.prices[slot] = price; changed |= ProductField::Price; }
+        if (ratingChanged) { chunk.ratings[slot] = rating; changed |= ProductField::Rating; }
+        if (stockChanged) { chunk.stocks[slot] = stock; changed |= ProductField::Stock; }
+        commitLocked();
+        return changed;
+    }
+
+    bool setStock(int productID, int stock) {
+        lock_guard<recursive_mutex> guard(writeLock);
+        int row = latest().findRow(productID);
+        if (row < 0) return false;
+        writableChunk(row).stocks[CatalogSnapshot::slotOf(row)] = stock;
+        commitLocked();
+        return true;
+    }
+
+    bool setRating(int productID, double rating) {
+        lock_guard<recursive_mutex> guard(writeLock);
+        int row = latest().findRow(productID);
+        if (row < 0) return false;
+        writableChunk(row).ratings[CatalogSnapshot::slotOf(row)] = rating;
+        commitLocked();
+        return true;
+    }
+
+    // Leaves a tombstone so that row numbers held by views stay valid.
+    bool removeProduct(int productID) {
+        lock_guard<recursive_mutex> guard(writeLock);
+        int row = latest().findRow(productID);
+        if (row < 0) return false;
+        writableChunk(row).alive[CatalogSnapshot::slotOf(row)] = 0;
+        draftLocked().liveCount--;
+        commitLocked();
+        return true;
+    }
+
+    // True if a live row passes the listing filters. Name/category must already be lower-case.
+    bool rowMatches(int row, const string& lowerName, const string& lowerCategory,
+                    double minPrice, double maxPrice, double minRating) const {
+        return latest().rowMatches(row, lowerName, lowerCategory, minPrice, maxPrice, minRating);
+    }
+
+    // Returns the catalog rows that pass every filter, in file order.
+    // An empty name or category means "do not filter on it".
+    vector<int> filterRows(const string& nameQuery, const string& categoryQuery,
+                           double minPrice, double maxPrice, double minRating) const {
+        return latest().filterRows(nameQuery, categoryQuery, minPrice, maxPrice, minRating);
+    }
+
+    vector<int> allRows() const { return latest().allRows(); }
+};
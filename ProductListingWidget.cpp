@@ -0,0 +1,354 @@
+#include "../include/ProductListingWidget.h"
+#include <QStringList>
+#include <QAbstractItemView>
+#include <algorithm>
+#include "../../include/AsyncStorage.h"
+#include "../../include/Trace.h"
+#include "../../include/SessionRecorder.h"
+
+ProductListingWidget::ProductListingWidget(QWidget *parent)
+    : QWidget(parent),
+      productTableView(nullptr),
+      productModel(nullptr),
+      searchCompleter(nullptr),
+      suggestionModel(nullptr),
+      currentMinPrice(0.0),
+      currentMaxPrice(10000.0),
+      currentMinRating(0.0)
+{
+    // Typing searches once the user pauses; Enter or the button searches at once
+    searchDebounce = new QTimer(this);
+    searchDebounce->setSingleShot(true);
+    searchDebounce->setInterval(SearchDebounceMs);
+
+    setupUI();
+    setupConnections();
+
+    if (!ProductCatalog::getInstance().ensureLoaded()) {
+        QMessageBox::warning(this, "Products", "Could not load the product catalog.");
+    }
+    populateCategories();
+    ProductSuggestions::getInstance().refresh(); // Builds the type-ahead trie in the background
+    loadProducts();
+}
+
+ProductListingWidget::~ProductListingWidget()
+{
+    // Qt handles deleting child widgets and the model
+}
+
+void ProductListingWidget::setupUI()
+{
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+
+    // Search
+    QGroupBox *searchGroup = new QGroupBox("Search", this);
+    QHBoxLayout *searchLayout = new QHBoxLayout(searchGroup);
+    searchLineEdit = new QLineEdit(this);
+    searchLineEdit->setPlaceholderText("Search products by name...");
+    searchButton = new QPushButton("Search", this);
+    searchLayout->addWidget(searchLineEdit);
+    searchLayout->addWidget(searchButton);
+    mainLayout->addWidget(searchGroup);
+
+    // The suggestions are ranked already, so the completer shows them as they are
+    // instead of filtering a list of its own
+    suggestionModel = new QStringListModel(this);
+    searchCompleter = new QCompleter(suggestionModel, this);
+    searchCompleter->setWidget(searchLineEdit);
+    searchCompleter->setCompletionMode(QCompleter::UnfilteredPopupCompletion);
+    searchCompleter->setMaxVisibleItems(static_cast<int>(ProductSuggestions::MaxSuggestions));
+
+    // Filters
+    QGroupBox *filterGroup = new QGroupBox("Filters", this);
+    QHBoxLayout *filterLayout = new QHBoxLayout(filterGroup);
+
+    categoryComboBox = new QComboBox(this);
+
+    minPriceSpinBox = new QDoubleSpinBox(this);
+    minPriceSpinBox->setRange(0.0, 1000000.0);
+    minPriceSpinBox->setPrefix("$");
+    minPriceSpinBox->setValue(currentMinPrice);
+
+    maxPriceSpinBox = new QDoubleSpinBox(this);
+    maxPriceSpinBox->setRange(0.0, 1000000.0);
+    maxPriceSpinBox->setPrefix("$");
+    maxPriceSpinBox->setValue(currentMaxPrice);
+
+    minRatingSpinBox = new QDoubleSpinBox(this);
+    minRatingSpinBox->setRange(0.0, 5.0);
+    minRatingSpinBox->setSingleStep(0.5);
+    minRatingSpinBox->setDecimals(1);
+    minRatingSpinBox->setValue(currentMinRating);
+
+    applyFilterButton = new QPushButton("Apply Filters", this);
+    resetFilterButton = new QPushButton("Reset", this);
+
+    filterLayout->addWidget(new QLabel("Category:", this));
+    filterLayout->addWidget(categoryComboBox);
+    filterLayout->addWidget(new QLabel("Price:", this));
+    filterLayout->addWidget(minPriceSpinBox);
+    filterLayout->addWidget(new QLabel("to", this));
+    filterLayout->addWidget(maxPriceSpinBox);
+    filterLayout->addWidget(new QLabel("Min Rating:", this));
+    filterLayout->addWidget(minRatingSpinBox);
+    filterLayout->addWidget(applyFilterButton);
+    filterLayout->addWidget(resetFilterButton);
+    mainLayout->addWidget(filterGroup);
+
+    // Product table: a virtual model over the catalog, paged in as the user scrolls
+    productModel = new ProductTableModel({ProductTableModel::IdColumn, ProductTableModel::NameColumn,
+                                          ProductTableModel::CategoryColumn, ProductTableModel::PriceColumn,
+                                          ProductTableModel::RatingColumn, ProductTableModel::StockColumn}, this);
+    productTableView = new QTableView(this);
+    productTableView->setModel(productModel);
+    productTableView->setSelectionBehavior(QAbstractItemView::SelectRows);
+    productTableView->setSelectionMode(QAbstractItemView::SingleSelection);
+    productTableView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    productTableView->setAlternatingRowColors(true);
+    productTableView->setSortingEnabled(true);
+    productTableView->sortByColumn(0, Qt::AscendingOrder);
+    productTableView->verticalHeader()->setVisible(false);
+    productTableView->horizontalHeader()->setSectionResizeMode(QHeaderView::Interactive);
+    productTableView->horizontalHeader()->setSectionResizeMode(1, QHeaderView::Stretch);
+    mainLayout->addWidget(productTableView);
+
+    setLayout(mainLayout);
+}
+
+void ProductListingWidget::setupConnections()
+{
+    connect(searchButton, &QPushButton::clicked, this, &ProductListingWidget::handleSearch);
+    connect(searchLineEdit, &QLineEdit::returnPressed, this, &ProductListingWidget::handleSearch);
+    connect(searchLineEdit, &QLineEdit::textEdited, searchDebounce, QOverload<>::of(&QTimer::start));
+    connect(searchDebounce, &QTimer::timeout, this, &ProductListingWidget::handleSearch);
+    connect(searchLineEdit, &QLineEdit::textEdited, this, &ProductListingWidget::showSuggestions);
+    connect(searchCompleter, QOverload<const QString &>::of(&QCompleter::activated), this, &ProductListingWidget::applySuggestion);
+    connect(categoryComboBox, QOverload<int>::of(&QComboBox::activated), this, &ProductListingWidget::handleFilterCategory);
+    connect(applyFilterButton, &QPushButton::clicked, this, &ProductListingWidget::handleFilterPrice);
+    connect(applyFilterButton, &QPushButton::clicked, this, &ProductListingWidget::handleFilterRating);
+    connect(resetFilterButton, &QPushButton::clicked, this, &ProductListingWidget::handleResetFilters);
+    connect(productTableView, &QTableView::doubleClicked, this, &ProductListingWidget::handleRowDoubleClicked);
+}
+
+void ProductListingWidget::populateCategories()
+{
+    QString previous = categoryComboBox->currentText();
+
+    QStringList categories;
+    std::shared_ptr<const CatalogSnapshot> catalog = ProductCatalog::getInstance().snapshot();
+    for (const std::string &category : catalog->getCategories()) {
+        if (!category.empty()) {
+            categories << QString::fromStdString(category);
+        }
+    }
+    categories.sort(Qt::CaseInsensitive);
+
+    categoryComboBox->blockSignals(true);
+    categoryComboBox->clear();
+    categoryComboBox->addItem("All Categories");
+    categoryComboBox->addItems(categories);
+    int previousIndex = categoryComboBox->findText(previous);
+    categoryComboBox->setCurrentIndex(previousIndex >= 0 ? previousIndex : 0);
+    categoryComboBox->blockSignals(false);
+}
+
+AsyncAction ProductListingWidget::loadProducts(QString nameFilter,
+                                               QString categoryFilter,
+                                               double minPrice,
+                                               double maxPrice,
+                                               double minRating)
+{
+    CancellationToken token = listingLoads.restart();
+    if (!ProductCatalog::getInstance().ensureLoaded()) {
+        productModel->setRows(std::vector<int>());
+        co_return;
+    }
+
+    ProductQuery query(nameFilter.toStdString(), categoryFilter.toStdString(), minPrice, maxPrice, minRating);
+    std::shared_ptr<const CatalogSnapshot> catalog = ProductCatalog::getInstance().snapshot();
+
+    // The search runs on the task pool; the view keeps showing the previous result until
+    // it is done, and a newer query cancels this one, in the pool as well as here
+    std::vector<int> rows = co_await withCancellation(AsyncStorage::searchProducts(catalog, query, token), token);
+    TRACE_SCOPE("ui", "ProductListingWidget::loadProducts");
+    productModel->setRows(rows);
+
+    // Products added or edited later are kept in or out of the view by the same filter
+    productModel->setRowFilter([query](int catalogRow) {
+        return query.matches(*ProductCatalog::getInstance().snapshot(), catalogRow);
+    });
+
+    // Keep the user's column sort across filter changes
+    QHeaderView *header = productTableView->horizontalHeader();
+    productModel->sort(header->sortIndicatorSection(), header->sortIndicatorOrder());
+}
+
+void ProductListingWidget::refreshProductList()
+{
+    // The shared catalog already follows every write; reloading it would renumber the
+    // rows other views and the suggestion index hold
+    ProductCatalog::getInstance().ensureLoaded();
+    populateCategories();
+    ProductSuggestions::getInstance().refresh();
+    loadProducts(currentNameFilter, currentCategoryFilter, currentMinPrice, currentMaxPrice, currentMinRating);
+}
+
+void ProductListingWidget::handleSearch()
+{
+    searchDebounce->stop();
+    QString text = searchLineEdit->text().trimmed();
+    if (text == currentNameFilter && sender() == searchDebounce) return; // e.g. only a space was typed
+    currentNameFilter = text;
+    SessionRecorder::getInstance().record("search", currentNameFilter.toStdString());
+    loadProducts(currentNameFilter, currentCategoryFilter, currentMinPrice, currentMaxPrice, currentMinRating);
+}
+
+static QString suggestionLabel(const ProductSuggestion &suggestion)
+{
+    QString text = QString::fromStdString(suggestion.text);
+    return suggestion.isCategory ? text + " (category)" : text;
+}
+
+void ProductListingWidget::showSuggestions(const QString &text)
+{
+    QString prefix = text.trimmed();
+    shownSuggestions = prefix.isEmpty() ? std::vector<ProductSuggestion>()
+                                        : ProductSuggestions::getInstance().suggest(prefix.toStdString());
+    QStringList labels;
+    for (const ProductSuggestion &suggestion : shownSuggestions) {
+        labels << suggestionLabel(suggestion);
+    }
+    suggestionModel->setStringList(labels);
+    if (labels.isEmpty()) {
+        searchCompleter->popup()->hide();
+    } else {
+        searchCompleter->complete();
+    }
+}
+
+void ProductListingWidget::applySuggestion(const QString &text)
+{
+    for (const ProductSuggestion &suggestion : shownSuggestions) {
+        if (suggestionLabel(suggestion) != text) continue;
+        if (!suggestion.isCategory) {
+            searchLineEdit->setText(QString::fromStdString(suggestion.text));
+            handleSearch();
+            return;
+        }
+
+        // A category filters the listing rather than searching the names for it
+        QString category = QString::fromStdString(suggestion.text);
+        int index = categoryComboBox->findText(category, Qt::MatchFixedString);
+        if (index < 0) {
+            populateCategories();
+            index = categoryComboBox->findText(category, Qt::MatchFixedString);
+        }
+        if (index <= 0) return;
+        searchDebounce->stop();
+        searchLineEdit->clear();
+        if (!currentNameFilter.isEmpty()) {
+            currentNameFilter.clear();
+            SessionRecorder::getInstance().record("search");
+        }
+        categoryComboBox->setCurrentIndex(index);
+        handleFilterCategory();
+        return;
+    }
+}
+
+void ProductListingWidget::handleFilterCategory()
+{
+    currentCategoryFilter = (categoryComboBox->currentIndex() <= 0) ? QString() : categoryComboBox->currentText();
+    recordFilterChange();
+    loadProducts(currentNameFilter, currentCategoryFilter, currentMinPrice, currentMaxPrice, currentMinRating);
+}
+
+void ProductListingWidget::handleFilterPrice()
+{
+    double minPrice = minPriceSpinBox->value();
+    double maxPrice = maxPriceSpinBox->value();
+    if (minPrice > maxPrice) {
+        QMessageBox::warning(this, "Invalid Price Range", "Minimum price cannot be greater than maximum price.");
+        return;
+    }
+    currentMinPrice = minPrice;
+    currentMaxPrice = maxPrice;
+    recordFilterChange();
+    loadProducts(currentNameFilter, currentCategoryFilter, currentMinPrice, currentMaxPrice, currentMinRating);
+}
+
+void ProductListingWidget::handleFilterRating()
+{
+    currentMinRating = minRatingSpinBox->value();
+    recordFilterChange();
+    loadProducts(currentNameFilter, currentCategoryFilter, currentMinPrice, currentMaxPrice, currentMinRating);
+}
+
+void ProductListingWidget::handleResetFilters()
+{
+    currentNameFilter.clear();
+    currentCategoryFilter.clear();
+    currentMinPrice = 0.0;
+    currentMaxPrice = 10000.0;
+    currentMinRating = 0.0;
+    SessionRecorder::getInstance().record("reset-filters");
+
+    searchLineEdit->clear();
+    categoryComboBox->setCurrentIndex(0);
+    minPriceSpinBox->setValue(currentMinPrice);
+    maxPriceSpinBox->setValue(currentMaxPrice);
+    minRatingSpinBox->setValue(currentMinRating);
+
+    loadProducts();
+}
+
+void ProductListingWidget::recordFilterChange()
+{
+    SessionRecorder &recorder = SessionRecorder::getInstance();
+    if (!recorder.isRecording()) return;
+    // The category goes last: it may contain spaces
+    recorder.record("filter", QString("%1 %2 %3 %4").arg(currentMinPrice, 0, 'f', 2).arg(currentMaxPrice, 0, 'f', 2)
+                                  .arg(currentMinRating, 0, 'f', 1).arg(currentCategoryFilter).trimmed().toStdString());
+}
+
+void ProductListingWidget::handleRowDoubleClicked(const QModelIndex &index)
+{
+    if (!index.isValid()) return;
+    int productId = productModel->productIdAt(index.row());
+    if (productId > 0) {
+        emit productSelected(productId);
+    }
+}
+
+// Row-level changes reach productModel directly through the change feed; these slots
+// only keep the category list in step with what the catalog now contains.
+void ProductListingWidget::onProductAdded(int productId)
+{
+    Q_UNUSED(productId);
+    populateCategories();
+}
+
+void ProductListingWidget::onProductUpdated(int productId)
+{
+    Q_UNUSED(productId);
+    populateCategories();
+}
+
+void ProductListingWidget::onProductRemoved(int productId)
+{
+    Q_UNUSED(productId);
+}
+
+int ProductListingWidget::findRowByProductId(int productId)
+{
+    return productModel->viewRowOf(productId);
+}
+
+void ProductListingWidget::updateProductRow(int productId)
+{
+    int row = findRowByProductId(productId);
+    if (row >= 0) {
+        productModel->notifyRowChanged(row);
+    }
+}
@@ -3,7 +3,6 @@
 
 #include <QWidget>
 #include <QTableView>
-#include <QStandardItemModel>
 #include <QLineEdit>
 #include <QComboBox>
 #include <QDoubleSpinBox>
@@ -14,7 +13,15 @@
 #include <QGroupBox>
 #include <QHeaderView>
 #include <QMessageBox>
+#include <QTimer>
+#include <QCompleter>
+#include <QStringListModel>
+#include <vector>
 #include "../../include/Product.h" // Backend Product class
+#include "../../include/ProductCatalog.h" // In-memory catalog the table reads from
+#include "../../include/Async.h"
+#include "../../include/ProductSuggestions.h"
+#include "ProductTableModel.h"
 
 class ProductListingWidget : public QWidget
 {
@@ -44,11 +51,16 @@ private slots:
 private:
     // UI Components
     QTableView *productTableView;
-    QStandardItemModel *productModel;
+    ProductTableModel *productModel;
     
     // Search components
+    static const int SearchDebounceMs = 150;
     QLineEdit *searchLineEdit;
     QPushButton *searchButton;
+    QTimer *searchDebounce; // Restarted by every keystroke; searches when it runs out
+    QCompleter *searchCompleter; // Type-ahead names and categories, from ProductSuggestions
+    QStringListModel *suggestionModel;
+    std::vector<ProductSuggestion> shownSuggestions; // What the completer popup lists
     
     // Filter components
     QComboBox *categoryComboBox;
@@ -64,15 +76,20 @@ private:
     double currentMinPrice;
     double currentMaxPrice;
     double currentMinRating;
+    CancellationSource listingLoads; // The latest query; a newer one cancels it
 
     // Helper methods
     void setupUI();
     void setupConnections();
     void populateCategories(); // Load unique categories into combobox
+    void recordFilterChange(); // Log the filter tuple to a recorded session
+    void showSuggestions(const QString &text); // Completions for the text typed so far
+    void applySuggestion(const QString &text); // Search for a picked name, or filter by a picked category
     
-    // Helper to load products based on filters
-    void loadProducts(const QString &nameFilter = QString(), 
-                      const QString &categoryFilter = QString(),
+    // Helper to load products based on filters. Arguments are by value, as the
+    // coroutine outlives the call.
+    AsyncAction loadProducts(QString nameFilter = QString(), 
+                      QString categoryFilter = QString(),
                       double minPrice = 0.0, 
                       double maxPrice = 10000.0, 
                       double minRating = 0.0);
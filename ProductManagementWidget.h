@@ -2,7 +2,8 @@
 #define PRODUCTMANAGEMENTWIDGET_H
 
 #include <QWidget>
-#include <QTableWidget>
+#include <QTableView>
+#include <QItemSelectionModel>
 #include <QPushButton>
 #include <QVBoxLayout>
 #include <QHBoxLayout>
@@ -14,8 +15,11 @@
 #include <cstring> // For strncpy
 
 #include "AddEditProductDialog.h"
+#include "ProductTableModel.h"
 #include "../../include/Product.h"          // Assuming backend Product struct
 #include "../../include/Admin.h"            // Assuming backend Admin class with static methods
+#include "../../include/Trace.h"
+#include "../../include/StoreLocks.h"
 
 // Placeholder for Product data structure (This comment can remain or be removed)
 // struct AdminProductViewItem { ... };
@@ -43,8 +47,10 @@ private slots:
 private:
     inline void loadProducts();
     inline void setupUi();
+    inline int selectedProductId() const; // -1 when nothing is selected
 
-    QTableWidget *productsTable;
+    QTableView *productsTable;
+    ProductTableModel *productsModel;
     QPushButton *addProductButton;
     QPushButton *editProductButton;
     QPushButton *removeProductButton;
@@ -63,9 +69,11 @@ inline ProductManagementWidget::~ProductManagementWidget() {}
 inline void ProductManagementWidget::setupUi() {
     QVBoxLayout *mainLayout = new QVBoxLayout(this);
 
-    productsTable = new QTableWidget(this);
-    productsTable->setColumnCount(6); // ID, Name, Category, Price, Stock, Description (Order changed for consistency)
-    productsTable->setHorizontalHeaderLabels({"ID", "Name", "Category", "Price", "Stock", "Description"});
+    productsModel = new ProductTableModel({ProductTableModel::IdColumn, ProductTableModel::NameColumn,
+                                           ProductTableModel::CategoryColumn, ProductTableModel::PriceColumn,
+                                           ProductTableModel::StockColumn, ProductTableModel::DescriptionColumn}, this);
+    productsTable = new QTableView(this);
+    productsTable->setModel(productsModel);
     productsTable->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
     productsTable->setSelectionBehavior(QAbstractItemView::SelectRows);
     productsTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
@@ -89,28 +97,23 @@ inline void ProductManagementWidget::setupUi() {
 }
 
 inline void ProductManagementWidget::loadProducts() {
-    productsTable->setRowCount(0);
-    // displayedProductDetails.clear(); // This list might not be needed if we fetch fresh for editing
-
-    int productCount = 0;
-    Product* backendProducts = Product::loadAllProducts(productCount); // Changed getAllProducts to loadAllProducts
-
-    if (!backendProducts) {
+    TRACE_SCOPE("ui", "ProductManagementWidget::loadProducts");
+    // The model reads straight from the shared catalog, so no per-cell items are created.
+    // The catalog follows every write, so it is loaded once and never reloaded here.
+    if (!ProductCatalog::getInstance().ensureLoaded()) {
+        productsModel->setRows(std::vector<int>());
         QMessageBox::critical(this, "Error Loading Products", "Could not fetch products from backend.");
         return;
     }
+    productsModel->showAllRows();
+}
 
-    productsTable->setRowCount(productCount);
-    for (int i = 0; i < productCount; ++i) {
-        productsTable->setItem(i, 0, new QTableWidgetItem(QString::number(backendProducts[i].getProductID()))); // Used getter
-        productsTable->setItem(i, 1, new QTableWidgetItem(QString::fromUtf8(backendProducts[i].getName() ? backendProducts[i].getName() : "N/A"))); // Used getter
-        productsTable->setItem(i, 2, new QTableWidgetItem(QString::fromUtf8(backendProducts[i].getCategory() ? backendProducts[i].getCategory() : "N/A"))); // Used getter
-        productsTable->setItem(i, 3, new QTableWidgetItem(QString::number(backendProducts[i].getPrice(), 'f', 2))); // Used getter
-        productsTable->setItem(i, 4, new QTableWidgetItem(QString::number(backendProducts[i].getStock()))); // Used getter
-        const char* desc = backendProducts[i].getDescription();
-        productsTable->setItem(i, 5, new QTableWidgetItem(QString::fromUtf8(desc ? desc : "N/A"))); // Used getter for description
+inline int ProductManagementWidget::selectedProductId() const {
+    QModelIndexList selectedRows = productsTable->selectionModel()->selectedRows();
+    if (selectedRows.isEmpty()) {
+        return -1;
     }
-    delete[] backendProducts; // Crucial: free memory allocated by backend
+    return productsModel->productIdAt(selectedRows.first().row());
 }
 
 inline void ProductManagementWidget::handleAddProduct() {
@@ -129,14 +132,23 @@ inline void ProductManagementWidget::handleAddProduct() {
         // Rating is often handled by backend or based on reviews, not set directly here.
         // backendProduct.setRating(0); // Or some default if needed by Admin::addProduct
 
-        // Call the static Product::addProduct with the Product object
-        if (Product::addProduct(backendProduct)) { 
+        // Call the static Product::addProduct with the Product object. Checkouts rewrite
+        // products.txt on their own threads, so take the products lock first
+        bool added;
+        {
+            StoreLockSet locks;
+            locks.add(IoStats::Products, StoreLocks::Exclusive);
+            locks.acquire();
+            added = Product::addProduct(backendProduct);
+        }
+        if (added) { 
             QMessageBox::information(this, "Add Product", "Product added successfully.");
-            loadProducts(); // Refresh table
+            // The table picks the new row up from the change feed; no reload needed
             
-            // Try to get the ID of the newly added product (assuming it's the last one in the table)
-            if (productsTable->rowCount() > 0) {
-                int newProductId = productsTable->item(productsTable->rowCount() - 1, 0)->text().toInt();
+            // New products are appended to products.txt, so the new ID is the last catalog row
+            std::shared_ptr<const CatalogSnapshot> catalog = ProductCatalog::getInstance().snapshot();
+            if (catalog->size() > 0) {
+                int newProductId = catalog->getProductID(catalog->size() - 1);
                 emit productAdded(newProductId);
             }
         } else {
@@ -146,17 +158,15 @@ inline void ProductManagementWidget::handleAddProduct() {
 }
 
 inline void ProductManagementWidget::handleEditProduct() {
-    QList<QTableWidgetItem*> selectedItems = productsTable->selectedItems();
-    if (selectedItems.isEmpty()) {
+    int productId = selectedProductId();
+    if (productId < 0) {
         QMessageBox::warning(this, "Edit Product", "Please select a product to edit.");
         return;
     }
 
-    int selectedRow = selectedItems.first()->row();
-    int productId = productsTable->item(selectedRow, 0)->text().toInt();
-
-    // Fetch the full product details from backend to ensure data is fresh and complete
-    Product* productToEdit = Product::getProductByID(productId);
+    // Read from a catalog snapshot and stamped with the row's version, which the save
+    // compares under the products lock; no lock is held while the dialog is open
+    Product* productToEdit = Product::getProductForEdit(productId);
 
     if (!productToEdit) {
         QMessageBox::critical(this, "Edit Product", "Could not fetch product details for editing.");
@@ -189,29 +199,43 @@ inline void ProductManagementWidget::handleEditProduct() {
         // Note: updatedProductData.getProductID() will be 0 here. 
         // The actual product ID for update is `productId`.
         // Call the static Product::editProduct with productId and the Product object containing new data
-        if (Product::editProduct(productId, updatedProductData)) { 
-            QMessageBox::information(this, "Edit Product", "Product updated successfully.");
-            loadProducts(); // Refresh table
+        // Saved as a merge with whatever changed meanwhile (e.g. stock sold by checkouts)
+        Product::EditResult result;
+        std::string conflicts;
+        {
+            StoreLockSet locks;
+            locks.add(IoStats::Products, StoreLocks::Exclusive);
+            locks.acquire();
+            result = Product::editProduct(productId, *productToEdit, updatedProductData, conflicts);
+        }
+        if (result == Product::EditSaved || result == Product::EditMerged) { 
+            QMessageBox::information(this, "Edit Product", result == Product::EditSaved
+                ? QString("Product updated successfully.")
+                : QString("Product updated. It had changed since you opened it; those changes were kept."));
             
             // Emit the signal that a product was updated
             emit productUpdated(productId);
+        } else if (result == Product::EditConflict) {
+            QMessageBox::warning(this, "Edit Product",
+                QString("The product was changed by someone else while you were editing it (%1).\n"
+                        "Nothing was saved; open it again to see the current values.").arg(QString::fromStdString(conflicts)));
         } else {
             QMessageBox::critical(this, "Edit Product", "Failed to update product (backend error).");
         }
     }
-    delete productToEdit; // Clean up the product fetched by getProductByID
+    delete productToEdit; // Clean up the product fetched by getProductForEdit
 }
 
 inline void ProductManagementWidget::handleRemoveProduct() {
-    QList<QTableWidgetItem*> selectedItems = productsTable->selectedItems();
-    if (selectedItems.isEmpty()) {
+    int productId = selectedProductId();
+    if (productId < 0) {
         QMessageBox::warning(this, "Remove Product", "Please select a product to remove.");
         return;
     }
 
-    int selectedRow = selectedItems.first()->row();
-    int productId = productsTable->item(selectedRow, 0)->text().toInt();
-    QString productName = productsTable->item(selectedRow, 1)->text();
+    std::shared_ptr<const CatalogSnapshot> catalog = ProductCatalog::getInstance().snapshot();
+    int catalogRow = catalog->findRow(productId);
+    QString productName = (catalogRow >= 0) ? QString::fromUtf8(catalog->getName(catalogRow)) : QString::number(productId);
 
     QMessageBox::StandardButton reply;
     reply = QMessageBox::question(this, "Remove Product", 
@@ -220,9 +244,15 @@ inline void ProductManagementWidget::handleRemoveProduct() {
 
     if (reply == QMessageBox::Yes) {
         // Call the static Product::removeProduct with productId
-        if (Product::removeProduct(productId)) { 
+        bool removed;
+        {
+            StoreLockSet locks;
+            locks.add(IoStats::Products, StoreLocks::Exclusive);
+            locks.acquire();
+            removed = Product::removeProduct(productId);
+        }
+        if (removed) { 
             QMessageBox::information(this, "Remove Product", QString("Product '%1' removed successfully.").arg(productName));
-            loadProducts(); // Refresh table
             
             // Emit the signal that a product was removed
             emit productRemoved(productId);
@@ -0,0 +1,252 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+
+#include "ProductCatalog.h"
+#include "TaskScheduler.h"
+#include "IoStats.h"
+#include "Trace.h"
+
+using namespace std;
+
+// The filters of a product listing. Name and category are kept lower-case; an empty one
+// does not filter.
+struct ProductQuery {
+    string name;
+    string category;
+    double minPrice;
+    double maxPrice;
+    double minRating;
+
+    ProductQuery() : minPrice(0.0), maxPrice(10000.0), minRating(0.0) {}
+
+    ProductQuery(const string& nameText, const string& categoryText, double minimumPrice, double maximumPrice,
+                 double minimumRating)
+        : name(CatalogSnapshot::toLower(nameText)), category(CatalogSnapshot::toLower(categoryText)),
+          minPrice(minimumPrice), maxPrice(maximumPrice), minRating(minimumRating) {}
+
+    // Everything but the name text is the same
+    bool sameFilters(const ProductQuery& other) const {
+        return category == other.category && minPrice == other.minPrice && maxPrice == other.maxPrice &&
+               minRating == other.minRating;
+    }
+
+    bool operator==(const ProductQuery& other) const { return name == other.name && sameFilters(other); }
+
+    // True if every product matching this query also matches `broader`: names match by
+    // substring, so typing more onto a search only ever drops products.
+    bool narrows(const ProductQuery& broader) const {
+        return sameFilters(broader) && name.find(broader.name) != string::npos;
+    }
+
+    bool matches(const CatalogSnapshot& snapshot, int row) const {
+        return snapshot.rowMatches(row, name, category, minPrice, maxPrice, minRating);
+    }
+};
+
+// Product listing searches, for search-as-you-type.
+//
+// Recent results are cached per query together with the catalog version they were
+// computed on. A search starts from the cached result of the same query or, failing
+// that, of a broader one - the previous keystroke's, usually - instead of scanning the
+// catalog:
+//   - rows the catalog has not touched since that version keep their verdict, and only
+//     need the name test again when the query is narrower;
+//   - rows changed, added or removed since are tested afresh (CatalogSnapshot::changedRows).
+// So a stock change from a checkout does not throw the cache away. Only when there is
+// nothing to start from, or the starting set is most of the catalog anyway, is the
+// catalog scanned, split by chunk across the task pool.
+//
+// A search polls its CancellationToken between pieces of work and gives up once it is
+// cancelled; the partial result is returned but not cached.
+class ProductSearch {
+public:
+    static const size_t CacheCapacity = 32;
+    static const size_t ScanStep = 16;      // Chunks scanned between cancellation checks
+
+    struct Stats {
+        long long searches;
+        long long cacheHits;    // The same query was cached
+        long long refined;      // Started from a broader query's result
+        long long scans;        // Scanned the catalog
+        long long cancelled;
+    };
+
+private:
+    struct Entry {
+        ProductQuery query;
+        unsigned long long version;
+        shared_ptr<const vector<int> > rows;
+
+        Entry() : version(0) {}
+    };
+
+    mutex lock;
+    list<Entry> recent;                     // Most recently used first
+    atomic<long long> searches;
+    atomic<long long> cacheHits;
+    atomic<long long> refined;
+    atomic<long long> scans;
+    atomic<long long> cancelled;
+
+    ProductSearch() : searches(0), cacheHits(0), refined(0), scans(0), cancelled(0) {}
+
+    // The cached result to start from: the same query if cached, otherwise the smallest
+    // result of a broader one. Results newer than the snapshot cannot be used.
+    bool findBase(const ProductQuery& query, unsigned long long version, Entry& base) {
+        lock_guard<mutex> guard(lock);
+        list<Entry>::iterator best = recent.end();
+        for (list<Entry>::iterator it = recent.begin(); it != recent.end(); ++it) {
+            if (it->version > version) continue;
+            if (it->query == query) {
+                best = it;
+                break;
+            }
+            if (query.narrows(it->query) && (best == recent.end() || it->rows->size() < best->rows->size())) {
+                best = it;
+            }
+        }
+        if (best == recent.end()) return false;
+        recent.splice(recent.begin(), recent, best);
+        base = recent.front();
+        return true;
+    }
+
+    void remember(const ProductQuery& query, unsigned long long version, const vector<int>& rows) {
+        lock_guard<mutex> guard(lock);
+        for (list<Entry>::iterator it = recent.begin(); it != recent.end(); ++it) {
+            if (it->query == query) {
+                if (it->version > version) return;
+                recent.erase(it);
+                break;
+            }
+        }
+        Entry entry;
+        entry.query = query;
+        entry.version = version;
+        entry.rows = make_shared<const vector<int> >(rows);
+        recent.push_front(entry);
+        if (recent.size() > CacheCapacity) recent.pop_back();
+    }
+
+    // Brings base's result up to the snapshot and narrows it to query (see above).
+    static vector<int> refine(const CatalogSnapshot& snapshot, const ProductQuery& query, const Entry& base,
+                              const CancellationToken& token) {
+        bool narrower = !(base.query == query);
+        vector<int> changed;
+        if (snapshot.version() != base.version) changed = snapshot.changedRows(base.version);
+
+        const vector<int>& previous = *base.rows;
+        vector<int> rows;
+        rows.reserve(previous.size());
+        size_t next = 0;
+        for (size_t i = 0; i < previous.size(); ++i) {
+            if ((i & 4095) == 0 && token.isCancelled()) return rows;
+            int row = previous[i];
+            for (; next < changed.size() && changed[next] < row; ++next) {
+                if (query.matches(snapshot, changed[next])) rows.push_back(changed[next]);
+            }
+            if (next < changed.size() && changed[next] == row) {
+                if (query.matches(snapshot, row)) rows.push_back(row);
+                ++next;
+            } else if (row < snapshot.size() && (!narrower || snapshot.nameMatches(row, query.name))) {
+                // Untouched since: only the name can rule it out now
+                rows.push_back(row);
+            }
+        }
+        for (; next < changed.size(); ++next) {
+            if (query.matches(snapshot, changed[next])) rows.push_back(changed[next]);
+        }
+        return rows;
+    }
+
+    static vector<int> scanSlice(const CatalogSnapshot& snapshot, const ProductQuery& query, size_t firstChunk,
+                                 size_t endChunk, const CancellationToken& token) {
+        vector<int> rows;
+        for (size_t chunk = firstChunk; chunk < endChunk && !token.isCancelled(); chunk += ScanStep) {
+            vector<int> part = snapshot.filterRows(query.name, query.category, query.minPrice, query.maxPrice,
+                                                   query.minRating, chunk, min(endChunk, chunk + ScanStep));
+            rows.insert(rows.end(), part.begin(), part.end());
+        }
+        return rows;
+    }
+
+    // One slice of chunks per worker; this thread takes the first and joins the rest in order.
+    static vector<int> scan(shared_ptr<const CatalogSnapshot> snapshot, const ProductQuery& query,
+                            const CancellationToken& token) {
+        TaskScheduler& scheduler = TaskScheduler::getInstance();
+        size_t chunks = snapshot->chunkCount();
+        size_t slices = max<size_t>(1, min<size_t>(chunks, static_cast<size_t>(scheduler.threadCount())));
+        vector<TaskFuture<vector<int> > > parts;
+        for (size_t slice = 1; slice < slices; ++slice) {
+            size_t first = chunks * slice / slices;
+            size_t end = chunks * (slice + 1) / slices;
+            parts.push_back(scheduler.run([snapshot, query, first, end, token]() {
+                return scanSlice(*snapshot, query, first, end, token);
+            }));
+        }
+        vector<int> rows = scanSlice(*snapshot, query, 0, chunks / slices, token);
+        for (size_t i = 0; i < parts.size(); ++i) {
+            vector<int> part = parts[i].get();
+            rows.insert(rows.end(), part.begin(), part.end());
+        }
+        return rows;
+    }
+
+public:
+    ProductSearch(const ProductSearch&) = delete;
+    ProductSearch& operator=(const ProductSearch&) = delete;
+
+    static ProductSearch& getInstance() {
+        static ProductSearch instance;
+        return instance;
+    }
+
+    // The rows of the snapshot that match the query, in row order.
+    vector<int> search(shared_ptr<const CatalogSnapshot> snapshot, const ProductQuery& query,
+                       const CancellationToken& token = CancellationToken()) {
+        TRACE_SCOPE("catalog", "ProductSearch::search");
+        searches.fetch_add(1, memory_order_relaxed);
+        Entry base;
+        bool found = findBase(query, snapshot->version(), base);
+        bool hit = found && base.query == query;
+        IoStats::cacheLookup(IoStats::Products, hit);
+
+        vector<int> rows;
+        if (hit || (found && base.rows->size() <= static_cast<size_t>(snapshot->liveSize()) / 2)) {
+            (hit ? cacheHits : refined).fetch_add(1, memory_order_relaxed);
+            rows = refine(*snapshot, query, base, token);
+        } else {
+            scans.fetch_add(1, memory_order_relaxed);
+            rows = scan(snapshot, query, token);
+        }
+
+        if (token.isCancelled()) {
+            cancelled.fetch_add(1, memory_order_relaxed);
+            return rows;
+        }
+        remember(query, snapshot->version(), rows);
+        return rows;
+    }
+
+    void clear() {
+        lock_guard<mutex> guard(lock);
+        recent.clear();
+    }
+
+    Stats stats() const {
+        Stats result;
+        result.searches = searches.load(memory_order_relaxed);
+        result.cacheHits = cacheHits.load(memory_order_relaxed);
+        result.refined = refined.load(memory_order_relaxed);
+        result.scans = scans.load(memory_order_relaxed);
+        result.cancelled = cancelled.load(memory_order_relaxed);
+        return result;
+    }
+};
@@ -0,0 +1,536 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+#include <utility>
+#include <cctype>
+
+#include "ProductCatalog.h"
+#include "ChangeFeed.h"
+#include "TaskScheduler.h"
+#include "Trace.h"
+
+using namespace std;
+
+// One completion offered under the search box
+struct ProductSuggestion {
+    string text;
+    bool isCategory;    // A category name rather than a product name
+    int products;       // Live products with this name, or in this category
+
+    ProductSuggestion() : isCategory(false), products(0) {}
+};
+
+// Type-ahead completions for the product search box: product and category names that
+// start with what was typed, ignoring case.
+//
+// The names live in a compressed prefix trie (a radix tree), where an edge is labelled
+// with a run of characters, so a chain of single-child nodes takes one node. Each node
+// also keeps the best MaxSuggestions names of its subtree, ranked by how many products
+// carry the name and then by their mean rating. A completion is therefore one walk down
+// the prefix, with nothing to search below it.
+//
+// refresh() builds the trie on the task pool once the catalog has loaded. After that,
+// product adds, edits, rating changes and removals reach it through the ChangeFeed one
+// product at a time, and only the nodes on the paths of the names that changed are
+// ranked again. A reload, which renumbers the rows, builds it afresh beside the old one.
+// suggest() returns nothing until the first build is done.
+class ProductSuggestions {
+public:
+    static const size_t MaxSuggestions = 8;
+
+private:
+    // The trie itself; ProductSuggestions guards it.
+    class Index {
+    private:
+        struct Node {
+            unsigned int labelStart;    // Edge label: keyArena[labelStart, labelStart + labelLength)
+            unsigned int labelLength;
+            int nameTerm;               // The name ending at this node, or -1
+            int categoryTerm;
+            int bestSlot;               // The subtree's best terms, best first, in bestPool; -1 for a leaf
+            unsigned int bestCount;
+            int firstChild;             // Children are linked in order of their labels' first characters
+            int nextSibling;
+
+            Node()
+                : labelStart(0), labelLength(0), nameTerm(-1), categoryTerm(-1), bestSlot(-1), bestCount(0),
+                  firstChild(-1), nextSibling(-1) {}
+        };
+
+        struct Term {
+            unsigned int textStart;     // As first seen: textArena[textStart, textStart + textLength)
+            unsigned int textLength;
+            bool isCategory;
+            int products;
+            double ratingSum;
+
+            Term() : textStart(0), textLength(0), isCategory(false), products(0), ratingSum(0.0) {}
+        };
+
+        // What a catalog row adds to the trie
+        struct RowEntry {
+            int nameTerm;
+            int categoryTerm;
+            double rating;
+
+            RowEntry() : nameTerm(-1), categoryTerm(-1), rating(0.0) {}
+        };
+
+        vector<Node> nodes;             // nodes[0] is the root
+        vector<int> freeNodes;
+        vector<int> bestPool;           // MaxSuggestions entries per slot; leaves, most nodes, need none
+        vector<int> freeBestSlots;
+        vector<Term> terms;
+        vector<int> freeTerms;
+        vector<char> keyArena;          // Lower-case labels; edits only append, a rebuild compacts
+        vector<char> textArena;
+        vector<RowEntry> rows;          // By catalog row
+        vector<int> candidates;         // Scratch space for rank()
+        vector<int> path;               // Scratch space for the walks
+
+        unsigned char firstChar(int node) const {
+            return static_cast<unsigned char>(keyArena[nodes[node].labelStart]);
+        }
+
+        int childStartingWith(int node, char c) const {
+            unsigned char wanted = static_cast<unsigned char>(c);
+            for (int child = nodes[node].firstChild; child >= 0; child = nodes[child].nextSibling) {
+                unsigned char first = firstChar(child);
+                if (first == wanted) return child;
+                if (first > wanted) break;
+            }
+            return -1;
+        }
+
+        // The link pointing at child, which must be one of node's children
+        int& linkTo(int node, int child) {
+            int* link = &nodes[node].firstChild;
+            while (*link != child) link = &nodes[*link].nextSibling;
+            return *link;
+        }
+
+        void addChild(int node, int child) {
+            unsigned char first = firstChar(child);
+            int* link = &nodes[node].firstChild;
+            while (*link >= 0 && firstChar(*link) < first) link = &nodes[*link].nextSibling;
+            nodes[child].nextSibling = *link;
+            *link = child;
+        }
+
+        int newNode() {
+            if (freeNodes.empty()) {
+                nodes.push_back(Node());
+                return static_cast<int>(nodes.size() - 1);
+            }
+            int node = freeNodes.back();
+            freeNodes.pop_back();
+            nodes[node] = Node();
+            return node;
+        }
+
+        void freeNode(int node) {
+            if (nodes[node].bestSlot >= 0) freeBestSlots.push_back(nodes[node].bestSlot);
+            freeNodes.push_back(node);
+        }
+
+        unsigned int appendKey(const char* text, size_t length) {
+            unsigned int start = static_cast<unsigned int>(keyArena.size());
+            keyArena.insert(keyArena.end(), text, text + length);
+            return start;
+        }
+
+        string labelOf(int node) const {
+            const Node& n = nodes[node];
+            return string(&keyArena[n.labelStart], n.labelLength);
+        }
+
+        string keyOf(int term) const {
+            const Term& t = terms[term];
+            return CatalogSnapshot::toLower(string(&textArena[t.textStart], t.textLength));
+        }
+
+        // True if term is text, ignoring case
+        bool termIs(int term, const char* text) const {
+            const Term& t = terms[term];
+            for (unsigned int i = 0; i < t.textLength; ++i, ++text) {
+                if (*text == '\0') return false;
+                if (tolower(static_cast<unsigned char>(textArena[t.textStart + i])) !=
+                    tolower(static_cast<unsigned char>(*text))) return false;
+            }
+            return *text == '\0';
+        }
+
+        // Walks down to the node for key, leaving the nodes passed, root first, in path.
+        // With insert, missing nodes are created and edges split as needed; otherwise a
+        // key not in the trie gives -1.
+        int walk(const string& key, bool insert) {
+            path.clear();
+            path.push_back(0);
+            int node = 0;
+            size_t pos = 0;
+            while (pos < key.length()) {
+                int child = childStartingWith(node, key[pos]);
+                if (child < 0) {
+                    if (!insert) return -1;
+                    int leaf = newNode();
+                    nodes[leaf].labelStart = appendKey(key.c_str() + pos, key.length() - pos);
+                    nodes[leaf].labelLength = static_cast<unsigned int>(key.length() - pos);
+                    addChild(node, leaf);
+                    path.push_back(leaf);
+                    return leaf;
+                }
+
+                unsigned int length = nodes[child].labelLength;
+                unsigned int common = 1;
+                while (common < length && pos + common < key.length() &&
+                       keyArena[nodes[child].labelStart + common] == key[pos + common]) {
+                    ++common;
+                }
+                if (common < length) {
+                    if (!insert) return -1;
+                    // The key leaves the edge part way: a new node takes the shared part
+                    int middle = newNode();
+                    nodes[middle].labelStart = nodes[child].labelStart;
+                    nodes[middle].labelLength = common;
+                    nodes[child].labelStart += common;
+                    nodes[child].labelLength -= common;
+                    linkTo(node, child) = middle;
+                    nodes[middle].nextSibling = nodes[child].nextSibling;
+                    nodes[middle].firstChild = child;
+                    nodes[child].nextSibling = -1;
+                    child = middle;
+                }
+                path.push_back(child);
+                node = child;
+                pos += common;
+            }
+            return node;
+        }
+
+        // Drops the nodes at the end of path that no longer lead to any term, and folds a
+        // node left with one child and no term of its own into that child.
+        void prune() {
+            while (path.size() > 1) {
+                int node = path.back();
+                Node& n = nodes[node];
+                if (n.nameTerm >= 0 || n.categoryTerm >= 0) return;
+                if (n.firstChild < 0) {
+                    linkTo(path[path.size() - 2], node) = n.nextSibling;
+                    freeNode(node);
+                    path.pop_back();
+                    continue;
+                }
+                int child = n.firstChild;
+                if (nodes[child].nextSibling >= 0) return;
+                string label = labelOf(node) + labelOf(child);
+                n.labelStart = appendKey(label.c_str(), label.length());
+                n.labelLength = static_cast<unsigned int>(label.length());
+                n.nameTerm = nodes[child].nameTerm;
+                n.categoryTerm = nodes[child].categoryTerm;
+                n.firstChild = nodes[child].firstChild;
+                freeNode(child);
+                return;
+            }
+        }
+
+        bool ranksAbove(int a, int b) const {
+            const Term& x = terms[a];
+            const Term& y = terms[b];
+            if (x.products != y.products) return x.products > y.products;
+            double xRating = x.ratingSum / x.products;
+            double yRating = y.ratingSum / y.products;
+            if (xRating != yRating) return xRating > yRating;
+            return a < b;
+        }
+
+        // Appends the best terms of node's subtree: a leaf's are its own, unordered
+        void collectBest(int node, vector<int>& out) const {
+            const Node& n = nodes[node];
+            if (n.bestSlot >= 0) {
+                const int* best = &bestPool[static_cast<size_t>(n.bestSlot) * MaxSuggestions];
+                out.insert(out.end(), best, best + n.bestCount);
+                return;
+            }
+            if (n.nameTerm >= 0) out.push_back(n.nameTerm);
+            if (n.categoryTerm >= 0) out.push_back(n.categoryTerm);
+        }
+
+        // A node's best terms: its own and the best of each child's subtree
+        void rank(int node) {
+            Node& n = nodes[node];
+            if (n.firstChild < 0) {
+                if (n.bestSlot >= 0) freeBestSlots.push_back(n.bestSlot);
+                n.bestSlot = -1;
+                return;
+            }
+            if (n.bestSlot < 0) {
+                if (freeBestSlots.empty()) {
+                    n.bestSlot = static_cast<int>(bestPool.size() / MaxSuggestions);
+                    bestPool.resize(bestPool.size() + MaxSuggestions);
+                } else {
+                    n.bestSlot = freeBestSlots.back();
+                    freeBestSlots.pop_back();
+                }
+            }
+
+            candidates.clear();
+            if (n.nameTerm >= 0) candidates.push_back(n.nameTerm);
+            if (n.categoryTerm >= 0) candidates.push_back(n.categoryTerm);
+            for (int child = n.firstChild; child >= 0; child = nodes[child].nextSibling) collectBest(child, candidates);
+            size_t count = candidates.size() < MaxSuggestions ? candidates.size() : MaxSuggestions;
+            partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(),
+                         [this](int a, int b) { return ranksAbove(a, b); });
+            copy(candidates.begin(), candidates.begin() + count, bestPool.begin() + n.bestSlot * MaxSuggestions);
+            n.bestCount = static_cast<unsigned int>(count);
+        }
+
+        void rankPath() {
+            for (size_t i = path.size(); i > 0; --i) rank(path[i - 1]);
+        }
+
+        // Every node, children before parents, e.g. after a build
+        void rankAll() {
+            // Pairs of a node and the child to visit next, -1 once all have been
+            vector<pair<int, int> > stack;
+            stack.push_back(make_pair(0, nodes[0].firstChild));
+            while (!stack.empty()) {
+                int node = stack.back().first;
+                int child = stack.back().second;
+                if (child >= 0) {
+                    stack.back().second = nodes[child].nextSibling;
+                    stack.push_back(make_pair(child, nodes[child].firstChild));
+                } else {
+                    rank(node);
+                    stack.pop_back();
+                }
+            }
+        }
+
+        int addTerm(const char* text, bool isCategory, double rating, bool ranked) {
+            string key = CatalogSnapshot::toLower(text);
+            int node = walk(key, true);
+            int term = isCategory ? nodes[node].categoryTerm : nodes[node].nameTerm;
+            if (term < 0) {
+                if (freeTerms.empty()) {
+                    terms.push_back(Term());
+                    term = static_cast<int>(terms.size() - 1);
+                } else {
+                    term = freeTerms.back();
+                    freeTerms.pop_back();
+                    terms[term] = Term();
+                }
+                terms[term].textStart = static_cast<unsigned int>(textArena.size());
+                terms[term].textLength = static_cast<unsigned int>(key.length());
+                terms[term].isCategory = isCategory;
+                textArena.insert(textArena.end(), text, text + key.length());
+                (isCategory ? nodes[node].categoryTerm : nodes[node].nameTerm) = term;
+            }
+            terms[term].products++;
+            terms[term].ratingSum += rating;
+            if (ranked) rankPath();
+            return term;
+        }
+
+        void dropTerm(int term, double rating, bool ranked) {
+            Term& t = terms[term];
+            t.products--;
+            t.ratingSum -= rating;
+            int node = walk(keyOf(term), false);
+            if (t.products == 0) {
+                (t.isCategory ? nodes[node].categoryTerm : nodes[node].nameTerm) = -1;
+                freeTerms.push_back(term);
+                prune();
+            }
+            if (ranked) rankPath();
+        }
+
+        // Points one of a row's terms at text, which may be empty for none
+        void setTerm(int& term, double oldRating, const char* text, bool isCategory, double rating, bool ranked) {
+            if (term >= 0 && termIs(term, text)) {
+                if (rating == oldRating) return;
+                terms[term].ratingSum += rating - oldRating;
+                if (ranked) {
+                    walk(keyOf(term), false);
+                    rankPath();
+                }
+                return;
+            }
+            if (term >= 0) dropTerm(term, oldRating, ranked);
+            term = (*text != '\0') ? addTerm(text, isCategory, rating, ranked) : -1;
+        }
+
+        void setRow(const CatalogSnapshot& snapshot, int row, bool ranked) {
+            if (static_cast<size_t>(row) >= rows.size()) rows.resize(static_cast<size_t>(row) + 1);
+            bool alive = row < snapshot.size() && snapshot.isAlive(row);
+            const char* name = alive ? snapshot.getName(row) : "";
+            const char* category = alive ? snapshot.getCategory(row).c_str() : "";
+            double rating = alive ? snapshot.getRating(row) : 0.0;
+            RowEntry& entry = rows[static_cast<size_t>(row)];
+            setTerm(entry.nameTerm, entry.rating, name, false, rating, ranked);
+            setTerm(entry.categoryTerm, entry.rating, category, true, rating, ranked);
+            entry.rating = rating;
+        }
+
+    public:
+        Index() : nodes(1) {}
+
+        void build(const CatalogSnapshot& snapshot) {
+            // A name adds at most a leaf and the node splitting an edge for it
+            nodes.reserve(2 * static_cast<size_t>(snapshot.liveSize()) + 1);
+            rows.reserve(static_cast<size_t>(snapshot.size()));
+            for (int row = 0; row < snapshot.size(); ++row) setRow(snapshot, row, false);
+            rankAll();
+        }
+
+        // Brings one row in line with the snapshot. A row it already matches costs nothing,
+        // so a stock change can be applied freely.
+        void update(const CatalogSnapshot& snapshot, int row) {
+            setRow(snapshot, row, true);
+        }
+
+        // Drops rows past the end of the snapshot, e.g. after a reload of a smaller file
+        void truncate(const CatalogSnapshot& snapshot) {
+            for (size_t row = static_cast<size_t>(snapshot.size()); row < rows.size(); ++row) {
+                setRow(snapshot, static_cast<int>(row), true);
+            }
+            if (rows.size() > static_cast<size_t>(snapshot.size())) rows.resize(static_cast<size_t>(snapshot.size()));
+        }
+
+        vector<ProductSuggestion> complete(const string& lowerPrefix, size_t limit) const {
+            vector<ProductSuggestion> suggestions;
+            int node = 0;
+            size_t pos = 0;
+            while (pos < lowerPrefix.length()) {
+                int child = childStartingWith(node, lowerPrefix[pos]);
+                if (child < 0) return suggestions;
+                const Node& n = nodes[child];
+                for (unsigned int i = 0; i < n.labelLength && pos < lowerPrefix.length(); ++i, ++pos) {
+                    if (keyArena[n.labelStart + i] != lowerPrefix[pos]) return suggestions;
+                }
+                node = child;
+            }
+
+            vector<int> best;
+            collectBest(node, best);
+            sort(best.begin(), best.end(), [this](int a, int b) { return ranksAbove(a, b); });
+            for (size_t i = 0; i < best.size() && suggestions.size() < limit; ++i) {
+                const Term& term = terms[best[i]];
+                ProductSuggestion suggestion;
+                suggestion.text.assign(&textArena[term.textStart], term.textLength);
+                suggestion.isCategory = term.isCategory;
+                suggestion.products = term.products;
+                suggestions.push_back(suggestion);
+            }
+            return suggestions;
+        }
+
+        size_t termCount() const { return terms.size() - freeTerms.size(); }
+        size_t nodeCount() const { return nodes.size() - freeNodes.size(); }
+    };
+
+    mutable mutex lock;
+    unique_ptr<Index> index;                // Null until the first build is done
+    unsigned long long indexedVersion;      // The catalog version the last catch-up reached
+    mutex syncLock;                         // One catch-up at a time
+    int feedToken;
+
+    ProductSuggestions() : indexedVersion(0), feedToken(0) {
+        // Applied on the writer's thread, so a product is suggested as soon as it is listed
+        feedToken = ChangeFeed::getInstance().subscribe([this](const EntityDelta& delta) {
+            if (delta.entity != EntityType::Product) return;
+            if (!(delta.changedFields & (ProductField::Name | ProductField::Category | ProductField::Rating))) return;
+            applyProduct(delta.entityID);
+        });
+    }
+
+    ~ProductSuggestions() {
+        ChangeFeed::getInstance().unsubscribe(feedToken);
+    }
+
+    void applyProduct(int productID) {
+        lock_guard<mutex> guard(lock);
+        if (!index) return;
+        // Read under the lock, so two writers' rows are applied in catalog order
+        shared_ptr<const CatalogSnapshot> snapshot = ProductCatalog::getInstance().snapshot();
+        int row = snapshot->findSlot(productID);
+        if (row >= 0) index->update(*snapshot, row);
+    }
+
+public:
+    ProductSuggestions(const ProductSuggestions&) = delete;
+    ProductSuggestions& operator=(const ProductSuggestions&) = delete;
+
+    static ProductSuggestions& getInstance() {
+        static ProductSuggestions instance;
+        return instance;
+    }
+
+    // Brings the trie up to date with the catalog in the background, e.g. after a load.
+    void refresh() {
+        TaskScheduler::getInstance().post([this]() { sync(); }, TaskPriority::Background);
+    }
+
+    // refresh() on the calling thread. Builds the trie the first time and whenever most
+    // rows changed since the last catch-up (a reload); otherwise applies the changed rows.
+    void sync() {
+        lock_guard<mutex> syncGuard(syncLock);
+        ProductCatalog& catalog = ProductCatalog::getInstance();
+        if (!catalog.ensureLoaded()) return;
+        TRACE_SCOPE("catalog", "ProductSuggestions::sync");
+        for (;;) {
+            shared_ptr<const CatalogSnapshot> snapshot = catalog.snapshot();
+            unsigned long long since = 0;
+            bool built = false;
+            {
+                lock_guard<mutex> guard(lock);
+                since = indexedVersion;
+                built = (index != nullptr);
+            }
+            if (built && snapshot->version() == since) return;
+
+            vector<int> changed;
+            if (built) changed = snapshot->changedRows(since);
+            if (!built || changed.size() > static_cast<size_t>(snapshot->liveSize()) / 2) {
+                // Built beside the current trie, which keeps answering meanwhile; the loop
+                // then catches up with what changed during the build
+                unique_ptr<Index> fresh(new Index());
+                fresh->build(*snapshot);
+                lock_guard<mutex> guard(lock);
+                index.swap(fresh);
+                indexedVersion = snapshot->version();
+                continue;
+            }
+
+            // A few rows per lock, so suggest() is never kept waiting long
+            for (size_t first = 0; first < changed.size(); first += 256) {
+                lock_guard<mutex> guard(lock);
+                for (size_t i = first; i < changed.size() && i < first + 256; ++i) index->update(*snapshot, changed[i]);
+            }
+            lock_guard<mutex> guard(lock);
+            index->truncate(*snapshot);
+            indexedVersion = snapshot->version();
+        }
+    }
+
+    bool isReady() const {
+        lock_guard<mutex> guard(lock);
+        return index != nullptr;
+    }
+
+    // The best names and categories starting with prefix, best first
+    vector<ProductSuggestion> suggest(const string& prefix, size_t limit = MaxSuggestions) const {
+        TRACE_SCOPE("catalog", "ProductSuggestions::suggest");
+        string lowerPrefix = CatalogSnapshot::toLower(prefix);
+        lock_guard<mutex> guard(lock);
+        return index ? index->complete(lowerPrefix, limit) : vector<ProductSuggestion>();
+    }
+
+    size_t size() const {
+        lock_guard<mutex> guard(lock);
+        return index ? index->termCount() : 0;
+    }
+};
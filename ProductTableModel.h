@@ -0,0 +1,386 @@
+#ifndef PRODUCTTABLEMODEL_H
+#define PRODUCTTABLEMODEL_H
+
+#include <QAbstractTableModel>
+#include <QColor>
+#include <QString>
+#include <QVector>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include "../../include/ProductCatalog.h"
+#include "../../include/ChangeFeed.h"
+#include "../../include/StockReservations.h"
+
+// Table model that reads cells straight out of a ProductCatalog snapshot, so painting
+// never waits for (or sees half of) a write on another thread.
+// The per-row state is a few ints for rows that pass the current filter; rows are
+// handed to the view in pages through canFetchMore()/fetchMore(), so the view only
+// ever lays out what the user has scrolled to.
+// Product deltas from ChangeFeed are applied as single-row dataChanged/insert/remove
+// notifications, so an edit elsewhere never forces a reset of this model; each delta
+// moves the model on to the newest snapshot. A removal leaves a tombstone rather than
+// shifting the rows after it, and a Fenwick tree over the live rows maps view rows to
+// positions, so a delta costs O(log n); tombstones are compacted once they outnumber
+// the live rows.
+class ProductTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum Column {
+        IdColumn,
+        NameColumn,
+        CategoryColumn,
+        PriceColumn,
+        RatingColumn,
+        StockColumn,
+        DescriptionColumn
+    };
+
+    inline explicit ProductTableModel(const QVector<Column> &columns, QObject *parent = nullptr);
+    inline ~ProductTableModel();
+
+    inline int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    inline int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    inline QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    inline QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    inline bool canFetchMore(const QModelIndex &parent) const override;
+    inline void fetchMore(const QModelIndex &parent) override;
+    inline void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
+
+    // Replaces the visible row set (catalog rows, in display order) and restarts paging.
+    inline void setRows(std::vector<int> catalogRows);
+    inline void showAllRows();
+
+    inline int productIdAt(int viewRow) const;
+    inline int viewRowOf(int productId) const; // -1 if the product is filtered out or not fetched yet
+    inline void notifyRowChanged(int viewRow);
+    inline int matchingRowCount() const { return liveRows; }
+
+    // Predicate deciding whether an inserted or edited catalog row belongs in this view.
+    // Without one every live product is shown.
+    inline void setRowFilter(std::function<bool(int)> filter) { rowFilter = std::move(filter); }
+
+    // Inventory styling: currency prefix on prices and colour-coded stock levels.
+    inline void setInventoryStyle(bool enabled);
+
+    static constexpr int PageSize = 256;
+    static constexpr int LowStockThreshold = 5;
+
+private:
+    inline QString formatStock(int stock) const;
+    inline int shownStock(const CatalogSnapshot &catalog, int row) const;
+    inline void applyDelta(const EntityDelta &delta);
+    inline void rebuildViewIndex();
+    inline int positionOfViewRow(int viewRow) const;
+    inline int liveBefore(int position) const;
+    inline int viewRowOfSlot(int catalogRow) const;
+    inline void appendViewRow(int catalogRow);
+    inline void removeViewRow(int viewRow);
+
+    QVector<Column> columns;
+    std::shared_ptr<const CatalogSnapshot> snapshot; // Version the rows and cells come from
+    std::vector<int> rows;           // Catalog rows in display order; -1 where one was removed
+    std::vector<int> positionBySlot; // catalog row -> position in rows, or -1
+    std::vector<int> liveTree;       // Fenwick tree (1-based) counting the live entries of rows
+    int liveRows;
+    std::function<bool(int)> rowFilter;
+    int fetchedRows;
+    bool inventoryStyle;
+    int feedToken;
+};
+
+inline ProductTableModel::ProductTableModel(const QVector<Column> &columns, QObject *parent)
+    : QAbstractTableModel(parent), columns(columns), snapshot(ProductCatalog::getInstance().snapshot()), liveRows(0), fetchedRows(0), inventoryStyle(false), feedToken(0)
+{
+    // Storage may publish from any thread; apply on this model's thread.
+    feedToken = ChangeFeed::getInstance().subscribe([this](const EntityDelta &delta) {
+        if (delta.entity != EntityType::Product) return;
+        QMetaObject::invokeMethod(this, [this, delta]() { applyDelta(delta); }, Qt::QueuedConnection);
+    });
+}
+
+inline ProductTableModel::~ProductTableModel() {
+    ChangeFeed::getInstance().unsubscribe(feedToken);
+}
+
+inline int ProductTableModel::rowCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : fetchedRows;
+}
+
+inline int ProductTableModel::columnCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : columns.size();
+}
+
+inline QString ProductTableModel::formatStock(int stock) const {
+    if (!inventoryStyle) {
+        return QString::number(stock);
+    }
+    if (stock == 0) {
+        return QString("%1 - OUT OF STOCK!").arg(stock);
+    }
+    if (stock < LowStockThreshold) {
+        return QString("%1 - LOW STOCK!").arg(stock);
+    }
+    return QString::number(stock);
+}
+
+// Shoppers see what they can still buy; the inventory view shows what is on the shelf.
+inline int ProductTableModel::shownStock(const CatalogSnapshot &catalog, int row) const {
+    if (inventoryStyle) return catalog.getStock(row);
+    return StockReservations::getInstance().available(catalog.getProductID(row), catalog.getStock(row));
+}
+
+inline QVariant ProductTableModel::data(const QModelIndex &index, int role) const {
+    if (!index.isValid() || index.row() >= fetchedRows || index.column() >= columns.size()) {
+        return QVariant();
+    }
+
+    const CatalogSnapshot &catalog = *snapshot;
+    int row = rows[positionOfViewRow(index.row())];
+    if (row >= catalog.size()) return QVariant();
+    Column column = columns[index.column()];
+
+    if (role == Qt::DisplayRole) {
+        switch (column) {
+        case IdColumn:
+            return catalog.getProductID(row);
+        case NameColumn:
+            return QString::fromUtf8(catalog.getName(row));
+        case CategoryColumn:
+            return QString::fromStdString(catalog.getCategory(row));
+        case PriceColumn:
+            return inventoryStyle ? QString("$%1").arg(catalog.getPrice(row), 0, 'f', 2)
+                                  : QString::number(catalog.getPrice(row), 'f', 2);
+        case RatingColumn:
+            return QString::number(catalog.getRating(row), 'f', 1);
+        case StockColumn:
+            return formatStock(shownStock(catalog, row));
+        case DescriptionColumn:
+            return QString("N/A"); // products.txt does not persist descriptions
+        }
+    } else if (inventoryStyle && column == StockColumn) {
+        int stock = catalog.getStock(row);
+        if (role == Qt::BackgroundRole) {
+            if (stock == 0) return QColor(255, 200, 200); // Light red for out of stock
+            if (stock < LowStockThreshold) return QColor(255, 255, 200); // Light yellow for low stock
+        } else if (role == Qt::ForegroundRole) {
+            if (stock == 0) return QColor(255, 0, 0);
+            if (stock < LowStockThreshold) return QColor(255, 140, 0);
+        }
+    } else if (role == Qt::TextAlignmentRole && column != NameColumn && column != CategoryColumn && column != DescriptionColumn) {
+        return int(Qt::AlignRight | Qt::AlignVCenter);
+    }
+    return QVariant();
+}
+
+inline QVariant ProductTableModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (role != Qt::DisplayRole || orientation != Qt::Horizontal || section < 0 || section >= columns.size()) {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+    switch (columns[section]) {
+    case IdColumn: return QString("ID");
+    case NameColumn: return QString("Name");
+    case CategoryColumn: return QString("Category");
+    case PriceColumn: return QString("Price");
+    case RatingColumn: return QString("Rating");
+    case StockColumn: return QString("Stock");
+    case DescriptionColumn: return QString("Description");
+    }
+    return QVariant();
+}
+
+inline bool ProductTableModel::canFetchMore(const QModelIndex &parent) const {
+    return !parent.isValid() && fetchedRows < liveRows;
+}
+
+inline void ProductTableModel::fetchMore(const QModelIndex &parent) {
+    if (parent.isValid()) return;
+    int remaining = liveRows - fetchedRows;
+    int toFetch = std::min(PageSize, remaining);
+    if (toFetch <= 0) return;
+    beginInsertRows(QModelIndex(), fetchedRows, fetchedRows + toFetch - 1);
+    fetchedRows += toFetch;
+    endInsertRows();
+}
+
+inline void ProductTableModel::sort(int column, Qt::SortOrder order) {
+    if (column < 0 || column >= columns.size()) return;
+    const CatalogSnapshot &catalog = *snapshot;
+    Column key = columns[column];
+    bool ascending = (order == Qt::AscendingOrder);
+    rebuildViewIndex(); // Drop tombstones before they are sorted among the rows
+
+    // Sorted by the stock the column shows. Holds change under the sort, so each row's
+    // value is read once up front rather than in every comparison.
+    std::vector<int> stockByRow;
+    if (key == StockColumn) {
+        stockByRow.assign(catalog.size(), 0);
+        for (size_t i = 0; i < rows.size(); ++i) stockByRow[rows[i]] = shownStock(catalog, rows[i]);
+    }
+
+    beginResetModel();
+    std::stable_sort(rows.begin(), rows.end(), [&catalog, &stockByRow, key, ascending](int a, int b) {
+        int cmp = 0;
+        switch (key) {
+        case NameColumn: cmp = strcmp(catalog.getName(a), catalog.getName(b)); break;
+        case CategoryColumn: cmp = catalog.getCategory(a).compare(catalog.getCategory(b)); break;
+        case PriceColumn: cmp = (catalog.getPrice(a) < catalog.getPrice(b)) ? -1 : (catalog.getPrice(a) > catalog.getPrice(b)); break;
+        case RatingColumn: cmp = (catalog.getRating(a) < catalog.getRating(b)) ? -1 : (catalog.getRating(a) > catalog.getRating(b)); break;
+        case StockColumn: cmp = stockByRow[a] - stockByRow[b]; break;
+        default: cmp = catalog.getProductID(a) - catalog.getProductID(b); break;
+        }
+        return ascending ? cmp < 0 : cmp > 0;
+    });
+    fetchedRows = std::min(PageSize, liveRows);
+    rebuildViewIndex();
+    endResetModel();
+}
+
+inline void ProductTableModel::setRows(std::vector<int> catalogRows) {
+    beginResetModel();
+    rows.swap(catalogRows);
+    snapshot = ProductCatalog::getInstance().snapshot(); // At least as new as the version the rows came from
+    positionBySlot.assign(snapshot->size(), -1);
+    rebuildViewIndex();
+    fetchedRows = std::min(PageSize, liveRows);
+    endResetModel();
+}
+
+inline void ProductTableModel::showAllRows() {
+    setRows(ProductCatalog::getInstance().snapshot()->allRows());
+}
+
+inline int ProductTableModel::productIdAt(int viewRow) const {
+    if (viewRow < 0 || viewRow >= fetchedRows) return -1;
+    return snapshot->getProductID(rows[positionOfViewRow(viewRow)]);
+}
+
+inline int ProductTableModel::viewRowOf(int productId) const {
+    int viewRow = viewRowOfSlot(snapshot->findRow(productId));
+    return (viewRow < fetchedRows) ? viewRow : -1;
+}
+
+inline int ProductTableModel::viewRowOfSlot(int catalogRow) const {
+    if (catalogRow < 0 || catalogRow >= static_cast<int>(positionBySlot.size())) return -1;
+    int position = positionBySlot[catalogRow];
+    return position < 0 ? -1 : liveBefore(position);
+}
+
+// Live entries of rows before `position`.
+inline int ProductTableModel::liveBefore(int position) const {
+    if (liveRows == static_cast<int>(rows.size())) return position; // No tombstones
+    int count = 0;
+    for (int i = position; i > 0; i -= i & -i) count += liveTree[i];
+    return count;
+}
+
+// Position in rows of the viewRow-th live entry.
+inline int ProductTableModel::positionOfViewRow(int viewRow) const {
+    if (liveRows == static_cast<int>(rows.size())) return viewRow;
+    int step = 1;
+    while (step * 2 < static_cast<int>(liveTree.size())) step *= 2;
+    int position = 0;
+    for (; step > 0; step >>= 1) {
+        int next = position + step;
+        if (next < static_cast<int>(liveTree.size()) && liveTree[next] <= viewRow) {
+            position = next;
+            viewRow -= liveTree[next];
+        }
+    }
+    return position;
+}
+
+// Drops the tombstones and rebuilds the position index and the live-row tree.
+inline void ProductTableModel::rebuildViewIndex() {
+    rows.erase(std::remove(rows.begin(), rows.end(), -1), rows.end());
+    int count = static_cast<int>(rows.size());
+    liveRows = count;
+    liveTree.assign(count + 1, 0);
+    for (int i = 1; i <= count; ++i) {
+        liveTree[i] += 1;
+        int parent = i + (i & -i);
+        if (parent <= count) liveTree[parent] += liveTree[i];
+    }
+    for (int i = 0; i < count; ++i) {
+        if (rows[i] >= static_cast<int>(positionBySlot.size())) {
+            positionBySlot.resize(rows[i] + 1, -1);
+        }
+        positionBySlot[rows[i]] = i;
+    }
+}
+
+inline void ProductTableModel::appendViewRow(int catalogRow) {
+    int viewRow = liveRows;
+    bool visibleNow = (fetchedRows == viewRow); // Already paged to the end: show it immediately
+    if (visibleNow) beginInsertRows(QModelIndex(), viewRow, viewRow);
+    int position = static_cast<int>(rows.size());
+    rows.push_back(catalogRow);
+    if (catalogRow >= static_cast<int>(positionBySlot.size())) {
+        positionBySlot.resize(catalogRow + 1, -1);
+    }
+    positionBySlot[catalogRow] = position;
+    // The new node covers the entries (i - lowbit(i), i]
+    int i = position + 1;
+    liveTree.push_back(1 + viewRow - liveBefore(i - (i & -i)));
+    liveRows++;
+    if (visibleNow) {
+        fetchedRows++;
+        endInsertRows();
+    }
+}
+
+inline void ProductTableModel::removeViewRow(int viewRow) {
+    bool visibleNow = (viewRow < fetchedRows);
+    if (visibleNow) beginRemoveRows(QModelIndex(), viewRow, viewRow);
+    int position = positionOfViewRow(viewRow);
+    positionBySlot[rows[position]] = -1;
+    rows[position] = -1;
+    for (int i = position + 1; i < static_cast<int>(liveTree.size()); i += i & -i) liveTree[i]--;
+    liveRows--;
+    if (static_cast<int>(rows.size()) - liveRows > std::max(liveRows, PageSize)) rebuildViewIndex();
+    if (visibleNow) {
+        fetchedRows--;
+        endRemoveRows();
+    }
+}
+
+inline void ProductTableModel::applyDelta(const EntityDelta &delta) {
+    snapshot = ProductCatalog::getInstance().snapshot();
+    const CatalogSnapshot &catalog = *snapshot;
+
+    if (delta.kind == ChangeKind::Removed) {
+        int viewRow = viewRowOfSlot(catalog.findSlot(delta.entityID));
+        if (viewRow >= 0) removeViewRow(viewRow);
+        return;
+    }
+
+    int catalogRow = catalog.findRow(delta.entityID);
+    if (catalogRow < 0) return;
+    bool belongs = !rowFilter || rowFilter(catalogRow);
+    int viewRow = viewRowOfSlot(catalogRow);
+
+    if (viewRow < 0) {
+        if (belongs) appendViewRow(catalogRow);
+    } else if (!belongs) {
+        removeViewRow(viewRow);
+    } else {
+        notifyRowChanged(viewRow);
+    }
+}
+
+inline void ProductTableModel::notifyRowChanged(int viewRow) {
+    if (viewRow < 0 || viewRow >= fetchedRows) return;
+    emit dataChanged(index(viewRow, 0), index(viewRow, columns.size() - 1));
+}
+
+inline void ProductTableModel::setInventoryStyle(bool enabled) {
+    beginResetModel();
+    inventoryStyle = enabled;
+    endResetModel();
+}
+
+#endif // PRODUCTTABLEMODEL_H
@@ -11,6 +11,8 @@
 #include <cstdio>
 
 #include "Product.h"
+#include "IoStats.h"
+#include "Trace.h"
 
 using namespace std;
 
@@ -32,7 +34,8 @@ private:
     }
 
      static bool updateProductAverageRating(int productIDToUpdate) {
-        ifstream reviewFile("data/reviews/reviews.txt");
+         TRACE_SCOPE("review", "Review::updateProductAverageRating");
+        TrackedIfstream reviewFile(IoStats::Reviews, "data/reviews/reviews.txt");
         if (!reviewFile) {
             cerr << "Warning: Cannot open reviews.txt to calculate average rating." << endl;
             return false;
@@ -62,8 +65,8 @@ private:
         double averageRating = (ratingCount > 0) ? (totalRatingSum / ratingCount) : 0.0;
         averageRating = round(averageRating * 10.0) / 10.0;
 
-        ifstream productInFile("data/products.txt");
-        ofstream productTempFile("data/temp_products.txt");
+        TrackedIfstream productInFile(IoStats::Products, "data/products.txt");
+        TrackedOfstream productTempFile(IoStats::Products, "data/temp_products.txt");
         if (!productInFile || !productTempFile) {
             cerr << "Error: Could not open product files for rating update." << endl;
              productInFile.close(); productTempFile.close(); remove("data/temp_products.txt");
@@ -107,6 +110,9 @@ private:
             cerr << "Error: Failed to update products.txt with new average rating." << endl;
             return false;
         }
+        IoStats::add(IoStats::Products, IoStats::TempRewrites);
+        ProductCatalog::getInstance().setRating(productIDToUpdate, averageRating);
+        ChangeFeed::getInstance().publish(EntityType::Product, ChangeKind::Updated, productIDToUpdate, ProductField::Rating);
         cout << "Updated average rating for Product ID " << productIDToUpdate << " to: " << fixed << setprecision(1) << averageRating << endl;
         return true;
      }
@@ -144,6 +150,7 @@ public:
     const char* getComment() const { return comment; }
 
     static bool addReview(int productID, int userID, int rating, const char* commentText) {
+        TRACE_SCOPE("review", "Review::addReview");
         if (userID <= 0 || productID <= 0) {
             cerr << "Error: Invalid user ID or product ID provided for review." << endl;
             return false;
@@ -162,7 +169,7 @@ public:
              return false;
         }
         delete tempProd;
-         ifstream checkFile("data/reviews/reviews.txt");
+         TrackedIfstream checkFile(IoStats::Reviews, "data/reviews/reviews.txt");
          bool alreadyReviewed = false;
          if (checkFile) {
              string line;
@@ -197,7 +204,7 @@ public:
              safeComment = new char[1];
              safeComment[0] = '\0';
          }
-        ofstream outFile("data/reviews/reviews.txt", ios::app);
+        TrackedOfstream outFile(IoStats::Reviews, "data/reviews/reviews.txt", ios::app);
         if (!outFile) {
             cerr << "Error: Could not open reviews.txt for writing." << endl;
             delete[] safeComment;
@@ -215,7 +222,8 @@ public:
     }
 
      static void getReviewsForProduct(int productIDToView) {
-         ifstream inFile("data/reviews/reviews.txt");
+         TRACE_SCOPE("review", "Review::getReviewsForProduct");
+         TrackedIfstream inFile(IoStats::Reviews, "data/reviews/reviews.txt");
          if (!inFile) {
              cerr << "Error: Could not open reviews.txt." << endl;
              return;
@@ -14,6 +14,10 @@
 #include <iostream>
 #include "../../include/User.h"
 #include "../../include/Order.h"
+#include "../../include/IoStats.h"
+#include "../../include/Trace.h"
+#include "../../include/StoreLocks.h"
+#include "../../include/AsyncStorage.h"
 
 ReviewWidget::ReviewWidget(int productId, int userId, QWidget *parent)
     : QWidget(parent), productId(productId), userId(userId)
@@ -87,58 +91,26 @@ void ReviewWidget::setupUI()
     }
 }
 
-void ReviewWidget::loadReviews()
+AsyncAction ReviewWidget::loadReviews()
 {
+    // A reload after a submit supersedes a read still under way
+    std::vector<ReviewRecord> reviews = co_await withCancellation(AsyncStorage::getReviews(productId), reviewLoads.restart());
+    TRACE_SCOPE("ui", "ReviewWidget::loadReviews");
+
     reviewsListWidget->clear();
-    
-    // Instead of trying to use Review::getReviewsForProduct which returns void,
-    // read the reviews directly from the file
-    ifstream reviewFile("data/reviews/reviews.txt");
-    if (!reviewFile) {
-        reviewsListWidget->addItem("No reviews yet for this product.");
-        return;
-    }
-    
-    int reviewCount = 0;
-    string line;
-    
-    while (getline(reviewFile, line)) {
-        if (line.empty()) continue;
-        
-        stringstream ss(line);
-        string segment;
-        int currentProdID, reviewUserId, rating;
-        string commentStr;
-        
-        getline(ss, segment, ','); 
-        try { currentProdID = stoi(segment); } catch(...) { continue; }
-        
-        if (currentProdID != productId) continue;
-        
-        getline(ss, segment, ','); 
-        try { reviewUserId = stoi(segment); } catch(...) { continue; }
-        
-        getline(ss, segment, ','); 
-        try { rating = stoi(segment); } catch(...) { continue; }
-        
-        getline(ss, commentStr); // Rest is comment
-        
-        reviewCount++;
-        
-        // Get user's email/name for display
-        string userEmail;
-        bool foundUser = User::getUserEmailById(reviewUserId, userEmail);
-        QString userDisplayName = foundUser ? QString::fromStdString(userEmail) : QString("User #%1").arg(reviewUserId);
+    for (const ReviewRecord &review : reviews) {
+        QString userDisplayName = !review.author.empty() ? QString::fromStdString(review.author)
+                                                         : QString("User #%1").arg(review.userID);
         
         // Format the review item
         QListWidgetItem *item = new QListWidgetItem();
-        item->setData(Qt::UserRole, reviewUserId); // Store user ID for potential later use
+        item->setData(Qt::UserRole, review.userID); // Store user ID for potential later use
         
         // Create formatted review text
         QString reviewText = QString("<b>%1</b> - <span style='color: goldenrod;'>%2★</span><br>%3")
             .arg(userDisplayName)
-            .arg(rating)
-            .arg(QString::fromStdString(commentStr));
+            .arg(review.rating)
+            .arg(QString::fromStdString(review.comment));
         
         // Use a QLabel to render HTML
         QLabel *reviewLabel = new QLabel(reviewText);
@@ -151,76 +123,24 @@ void ReviewWidget::loadReviews()
         item->setSizeHint(reviewLabel->sizeHint()); // Ensure item size is updated
     }
     
-    reviewFile.close();
-    
     // Show message if no reviews
-    if (reviewCount == 0) {
+    if (reviews.empty()) {
         reviewsListWidget->addItem("No reviews yet for this product.");
     }
 }
 
-void ReviewWidget::updateReviewEligibility()
+AsyncAction ReviewWidget::updateReviewEligibility()
 {
-    // Check if user has purchased this product
-    bool hasPurchased = false;
-    
-    // Get orders for this user
-    int count = 0;
-    int* productIds = nullptr;
-    
-    // Find all orders for this user
-    ifstream orderFile("data/orders/orders.txt");
-    if (orderFile) {
-        string line;
-        while (getline(orderFile, line)) {
-            if (line.empty()) continue;
-            
-            stringstream ss(line);
-            string segment;
-            
-            getline(ss, segment, ','); // Order ID
-            getline(ss, segment, ','); // User ID
-            
-            int orderUserId = 0;
-            try {
-                orderUserId = stoi(segment);
-            } catch (...) {
-                continue;
-            }
-            
-            if (orderUserId == userId) {
-                // Found an order for this user, get product IDs
-                int orderID = 0;
-                try {
-                    ss.clear();
-                    ss.str(line);
-                    getline(ss, segment, ','); // Order ID
-                    orderID = stoi(segment);
-                } catch (...) {
-                    continue;
-                }
-                
-                int productCount = 0;
-                int* orderProductIds = Order::getProductIDsForOrder(orderID, productCount);
-                
-                if (orderProductIds) {
-                    // Check if this product is in the order
-                    for (int i = 0; i < productCount; i++) {
-                        if (orderProductIds[i] == productId) {
-                            hasPurchased = true;
-                            delete[] orderProductIds;
-                            orderFile.close();
-                            goto eligibilityCheckEnd; // Break out of nested loops
-                        }
-                    }
-                    delete[] orderProductIds;
-                }
-            }
-        }
-        orderFile.close();
-    }
-    
-eligibilityCheckEnd:
+    // Check if user has purchased this product; reviewing stays off until the answer is in
+    submitButton->setEnabled(false);
+    bool purchased = co_await withCancellation(AsyncStorage::hasPurchased(userId, productId), eligibilityCheck.restart());
+    showReviewEligibility(purchased);
+}
+
+void ReviewWidget::showReviewEligibility(bool hasPurchased)
+{
+    submitButton->setEnabled(true);
+
     // Find the "Add Your Review" group box
     QList<QGroupBox*> groupBoxes = findChildren<QGroupBox*>();
     QGroupBox* addReviewGroup = nullptr;
@@ -284,8 +204,16 @@ void ReviewWidget::onSubmitReview()
     std::string commentStr = commentQStr.toStdString();
     const char* commentCStr = commentStr.c_str();
     
-    // Submit the review using Review's static method
-    bool success = Review::addReview(productId, userId, rating, commentCStr);
+    // Submit the review using Review's static method; the new average rating rewrites
+    // products.txt, which checkouts also rewrite
+    bool success;
+    {
+        StoreLockSet locks;
+        locks.add(IoStats::Products, StoreLocks::Exclusive);
+        locks.add(IoStats::Reviews, StoreLocks::Exclusive);
+        locks.acquire();
+        success = Review::addReview(productId, userId, rating, commentCStr);
+    }
     
     if (success) {
         QMessageBox::information(this, "Review Submitted", "Thank you for your review!");
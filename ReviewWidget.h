@@ -12,6 +12,7 @@
 #include <sstream>
 #include <QDir>
 #include "../../include/Review.h"
+#include "../../include/Async.h"
 
 class ReviewWidget : public QWidget
 {
@@ -29,11 +30,14 @@ private slots:
 
 private:
     void setupUI();
-    void loadReviews();
-    void updateReviewEligibility();
+    AsyncAction loadReviews();
+    AsyncAction updateReviewEligibility();
+    void showReviewEligibility(bool hasPurchased);
 
     int productId;
     int userId;
+    CancellationSource reviewLoads;      // The latest load; cancelled by the next one
+    CancellationSource eligibilityCheck;
     
     QListWidget *reviewsListWidget;
     QComboBox *ratingComboBox;
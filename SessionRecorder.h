@@ -0,0 +1,113 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <cstdlib>
+
+using namespace std;
+
+// Opt-in log of what a user does in the GUI, for replaying real sessions against the
+// backend (see SessionReplay.h and ecomcli --replay).
+//
+// A session file starts with a "# ecom-session 1" header; every other line is
+//
+//   <ms since the previous action> <action> [arguments]
+//
+// e.g. "1520 view 104", "310 search desk lamp", "95 filter 0.00 200.00 4.0 Home".
+// Actions are what the user asked for, recorded whether or not the backend agreed, so a
+// replay repeats the same requests. Arguments that may contain spaces (search text,
+// category names) come last. Lines are flushed as they are written, so a crash loses
+// nothing. While recording is off, record() costs one relaxed atomic load.
+//
+// ECOM_SESSION=<path> starts recording at launch; the admin menu can also toggle it.
+class SessionRecorder {
+private:
+    typedef chrono::steady_clock Clock;
+
+    mutable mutex lock;            // Guards the file and the clock
+    ofstream out;
+    atomic<bool> recording;
+    Clock::time_point lastAction;
+    string path;
+    long long actions;
+
+    SessionRecorder() : recording(false), actions(0) {}
+
+    // One line per action: newlines inside arguments would split it
+    static string flatten(const string& text) {
+        string result = text;
+        for (size_t i = 0; i < result.length(); ++i) {
+            if (result[i] == '\n' || result[i] == '\r') result[i] = ' ';
+        }
+        return result;
+    }
+
+public:
+    SessionRecorder(const SessionRecorder&) = delete;
+    SessionRecorder& operator=(const SessionRecorder&) = delete;
+
+    static SessionRecorder& getInstance() {
+        static SessionRecorder instance;
+        return instance;
+    }
+
+    bool isRecording() const { return recording.load(memory_order_relaxed); }
+
+    // Starts a new session file, replacing any existing one at that path.
+    bool start(const string& filePath) {
+        lock_guard<mutex> guard(lock);
+        if (out.is_open()) out.close();
+        out.open(filePath, ios::trunc);
+        if (!out) {
+            recording.store(false, memory_order_relaxed);
+            return false;
+        }
+        time_t now = time(nullptr);
+        char stamp[32];
+        strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", localtime(&now));
+        out << "# ecom-session 1 " << stamp << "\n" << flush;
+        path = filePath;
+        actions = 0;
+        lastAction = Clock::now();
+        recording.store(true, memory_order_relaxed);
+        return true;
+    }
+
+    void stop() {
+        lock_guard<mutex> guard(lock);
+        recording.store(false, memory_order_relaxed);
+        if (out.is_open()) out.close();
+    }
+
+    void enableFromEnvironment() {
+        const char* setting = getenv("ECOM_SESSION");
+        if (setting && *setting) start(setting);
+    }
+
+    void record(const string& action, const string& arguments = string()) {
+        if (!recording.load(memory_order_relaxed)) return;
+        lock_guard<mutex> guard(lock);
+        if (!out.is_open()) return;
+        Clock::time_point now = Clock::now();
+        long long delta = chrono::duration_cast<chrono::milliseconds>(now - lastAction).count();
+        lastAction = now;
+        out << delta << " " << action;
+        if (!arguments.empty()) out << " " << flatten(arguments);
+        out << "\n" << flush;
+        actions++;
+    }
+
+    string currentPath() const {
+        lock_guard<mutex> guard(lock);
+        return path;
+    }
+
+    long long actionCount() const {
+        lock_guard<mutex> guard(lock);
+        return actions;
+    }
+};
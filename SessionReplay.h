@@ -0,0 +1,253 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <thread>
+#include <cstdlib>
+
+#include "LatencyHistogram.h"
+#include "ProductCatalog.h"
+#include "ProductSearch.h"
+#include "Product.h"
+#include "Review.h"
+#include "ShoppingCart.h"
+#include "Wishlist.h"
+#include "Order.h"
+
+using namespace std;
+
+// Drives the backend through a session recorded by SessionRecorder, making the same calls
+// the GUI makes for each action.
+//
+// At speed 1 actions are issued at their recorded times, at speed 10 ten times faster,
+// and at speed 0 back to back. Latency is measured from each action's scheduled time,
+// so a backend that falls behind the recording shows it in the numbers. Order IDs in the
+// recording are mapped to the IDs the replayed checkouts produce, so later status
+// updates hit the right orders. Logins switch the acting user without a password.
+class SessionReplayer {
+public:
+    struct Action {
+        long long offsetMs;      // From the start of the session
+        string name;
+        string arguments;
+    };
+
+    struct ActionStats {
+        LatencyHistogram latency;
+        long long failures;
+
+        ActionStats() : failures(0) {}
+    };
+
+private:
+    typedef chrono::steady_clock Clock;
+
+    vector<Action> actions;
+    map<string, ActionStats> stats;
+    map<int, int> orderIDs;          // Recorded order ID -> replayed order ID
+    int userID;
+    string nameFilter;
+    string categoryFilter;
+    double minPrice;
+    double maxPrice;
+    double minRating;
+    double elapsedSeconds;
+    long long maxLagNs;
+
+    static bool parseInt(const string& text, int& value) {
+        char* end = nullptr;
+        long parsed = strtol(text.c_str(), &end, 10);
+        if (text.empty() || *end != '\0') return false;
+        value = static_cast<int>(parsed);
+        return true;
+    }
+
+    // The same query the product list runs whenever a filter changes
+    bool runFilter() {
+        ProductCatalog& catalog = ProductCatalog::getInstance();
+        if (!catalog.ensureLoaded()) return false;
+        // The same path as the listing, so replays see its result cache
+        ProductSearch::getInstance().search(catalog.snapshot(),
+                                            ProductQuery(nameFilter, categoryFilter, minPrice, maxPrice, minRating));
+        return true;
+    }
+
+    int mappedOrderID(int recorded) const {
+        auto found = orderIDs.find(recorded);
+        return found == orderIDs.end() ? recorded : found->second;
+    }
+
+    bool perform(const Action& action) {
+        stringstream args(action.arguments);
+        string first, second;
+        int productID = 0, quantity = 0;
+
+        if (action.name == "login") {
+            return parseInt(action.arguments, userID) && userID > 0;
+        } else if (action.name == "logout") {
+            userID = 0;
+            return true;
+        } else if (action.name == "view") {
+            if (!parseInt(action.arguments, productID)) return false;
+            Product* product = Product::getProductByID(productID);
+            bool found = (product != nullptr);
+            delete product;
+            Review::getReviewsForProduct(productID);
+            return found;
+        } else if (action.name == "search") {
+            nameFilter = action.arguments;
+            return runFilter();
+        } else if (action.name == "filter") {
+            if (!(args >> minPrice >> maxPrice >> minRating)) return false;
+            getline(args >> ws, categoryFilter);
+            return runFilter();
+        } else if (action.name == "reset-filters") {
+            nameFilter.clear();
+            categoryFilter.clear();
+            minPrice = 0.0;
+            maxPrice = 10000.0;
+            minRating = 0.0;
+            return runFilter();
+        }
+
+        // Everything below acts for the logged-in user
+        if (userID <= 0) return false;
+        ShoppingCart cart(userID);
+        if (action.name == "cart") {
+            cart.viewCart();
+            return true;
+        } else if (action.name == "cart-add" || action.name == "cart-update") {
+            args >> first >> second;
+            if (!parseInt(first, productID) || !parseInt(second, quantity)) return false;
+            // The cart dialog changes a quantity by removing the line and adding it again
+            if (action.name == "cart-update" && !cart.removeFromCart(productID)) return false;
+            return cart.addToCart(productID, quantity);
+        } else if (action.name == "cart-remove") {
+            return parseInt(action.arguments, productID) && cart.removeFromCart(productID);
+        } else if (action.name == "wishlist-add" || action.name == "wishlist-remove") {
+            Wishlist wishlist(userID);
+            if (!parseInt(action.arguments, productID)) return false;
+            return action.name == "wishlist-add" ? wishlist.addToWishlist(productID) : wishlist.removeFromWishlist(productID);
+        } else if (action.name == "wishlist-move") {
+            // Moving to the cart takes the item off the wishlist only if the cart accepted it
+            Wishlist wishlist(userID);
+            if (!parseInt(action.arguments, productID) || !cart.addToCart(productID, 1)) return false;
+            wishlist.removeFromWishlist(productID);
+            return true;
+        } else if (action.name == "checkout") {
+            int recordedID = 0;
+            parseInt(action.arguments, recordedID);
+            Order order(0, userID, "", nullptr, "Pending");
+            int orderID = order.placeOrder(cart);
+            if (orderID > 0 && recordedID > 0) orderIDs[recordedID] = orderID;
+            // A checkout that failed in the recording should fail here too
+            return (orderID > 0) == (recordedID > 0);
+        } else if (action.name == "order-status") {
+            args >> first;
+            getline(args >> ws, second);
+            int orderID;
+            if (!parseInt(first, orderID) || second.empty()) return false;
+            return Order::updateStatus(mappedOrderID(orderID), second.c_str());
+        }
+        return false;
+    }
+
+public:
+    SessionReplayer() : userID(0), minPrice(0.0), maxPrice(10000.0), minRating(0.0), elapsedSeconds(0.0), maxLagNs(0) {}
+
+    // Reads a session file; on failure error says which line was bad.
+    bool load(const string& path, string& error) {
+        ifstream in(path);
+        if (!in) {
+            error = "Cannot open " + path;
+            return false;
+        }
+        actions.clear();
+        string line;
+        long long offset = 0;
+        int lineNumber = 0;
+        while (getline(in, line)) {
+            lineNumber++;
+            if (line.empty() || line[0] == '#') continue;
+            stringstream ss(line);
+            long long delta;
+            Action action;
+            if (!(ss >> delta >> action.name) || delta < 0) {
+                error = path + ":" + to_string(lineNumber) + ": expected '<ms> <action> [arguments]'";
+                return false;
+            }
+            getline(ss >> ws, action.arguments);
+            offset += delta;
+            action.offsetMs = offset;
+            actions.push_back(action);
+        }
+        return true;
+    }
+
+    size_t actionCount() const { return actions.size(); }
+    long long durationMs() const { return actions.empty() ? 0 : actions.back().offsetMs; }
+
+    // Replays every action once; returns the number that failed.
+    long long run(double speed) {
+        stats.clear();
+        orderIDs.clear();
+        userID = 0;
+        nameFilter.clear();
+        categoryFilter.clear();
+        minPrice = 0.0;
+        maxPrice = 10000.0;
+        minRating = 0.0;
+        maxLagNs = 0;
+        long long failures = 0;
+        Clock::time_point start = Clock::now();
+        for (size_t i = 0; i < actions.size(); ++i) {
+            const Action& action = actions[i];
+            Clock::time_point scheduled = start;
+            if (speed > 0.0) {
+                scheduled += chrono::nanoseconds(static_cast<long long>(action.offsetMs * 1e6 / speed));
+                this_thread::sleep_until(scheduled);
+            }
+            Clock::time_point started = Clock::now();
+            if (speed > 0.0) {
+                maxLagNs = max(maxLagNs, static_cast<long long>(chrono::duration_cast<chrono::nanoseconds>(started - scheduled).count()));
+            } else {
+                scheduled = started;
+            }
+
+            bool ok = perform(action);
+            ActionStats& entry = stats[action.name];
+            entry.latency.record(chrono::duration_cast<chrono::nanoseconds>(Clock::now() - scheduled).count());
+            if (!ok) {
+                entry.failures++;
+                failures++;
+            }
+        }
+        elapsedSeconds = chrono::duration<double>(Clock::now() - start).count();
+        return failures;
+    }
+
+    void printReport(ostream& out) const {
+        long long count = 0, failures = 0;
+        out << left << setw(15) << "Action" << right << setw(8) << "Count" << setw(8) << "Failed"
+            << setw(11) << "p50" << setw(11) << "p99" << setw(11) << "Max" << setw(11) << "Mean" << "\n";
+        for (auto it = stats.begin(); it != stats.end(); ++it) {
+            const LatencyHistogram& latency = it->second.latency;
+            count += latency.count();
+            failures += it->second.failures;
+            out << left << setw(15) << it->first << right << setw(8) << latency.count() << setw(8) << it->second.failures
+                << setw(11) << LatencyHistogram::formatNs(static_cast<double>(latency.valueAtPercentile(50.0)))
+                << setw(11) << LatencyHistogram::formatNs(static_cast<double>(latency.valueAtPercentile(99.0)))
+                << setw(11) << LatencyHistogram::formatNs(static_cast<double>(latency.max()))
+                << setw(11) << LatencyHistogram::formatNs(latency.mean()) << "\n";
+        }
+        out << count << " actions, " << failures << " failed, in " << fixed << setprecision(2) << elapsedSeconds
+            << " s (recorded " << durationMs() / 1000.0 << " s); furthest behind schedule "
+            << LatencyHistogram::formatNs(static_cast<double>(maxLagNs)) << "\n";
+    }
+};
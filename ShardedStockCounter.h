@@ -0,0 +1,230 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <memory>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <unordered_map>
+#include <cstdlib>
+
+#include "ProductCatalog.h"
+
+using namespace std;
+
+// Stock of one product split across cache-line sized shards, so threads selling the same
+// hot product mostly touch different memory. A take first tries the calling thread's own
+// shard with a compare-and-swap; only when that shard cannot cover it does the thread
+// take the rebalance lock, gather every shard, serve itself from the sum and spread the
+// rest evenly again. Units are never created or lost, so a take fails only when the
+// whole counter is short. While the counter is nearly dry most takes go through the
+// lock, which is the same serialisation a single counter has all the time.
+class ShardedStockCounter {
+public:
+    static const int ShardCount = 32;
+
+private:
+    struct alignas(64) Shard {
+        atomic<long long> units;
+    };
+
+    Shard shards[ShardCount];
+    mutex rebalanceLock;
+    atomic<long long> rebalances;
+
+    static int homeShard() {
+        static atomic<int> nextShard{0};
+        thread_local int index = -1;
+        if (index < 0) index = nextShard.fetch_add(1, memory_order_relaxed) % ShardCount;
+        return index;
+    }
+
+    // Empties every shard; call with rebalanceLock held.
+    long long gatherLocked() {
+        long long sum = 0;
+        for (int i = 0; i < ShardCount; ++i) sum += shards[i].units.exchange(0, memory_order_acq_rel);
+        return sum;
+    }
+
+    void spreadLocked(long long units) {
+        if (units <= 0) {
+            shards[0].units.fetch_add(units, memory_order_acq_rel); // A deficit stays in one place
+            return;
+        }
+        long long each = units / ShardCount;
+        long long extra = units % ShardCount;
+        for (int i = 0; i < ShardCount; ++i) {
+            shards[i].units.fetch_add(each + (i < extra ? 1 : 0), memory_order_acq_rel);
+        }
+    }
+
+public:
+    explicit ShardedStockCounter(long long units = 0) : rebalances(0) {
+        for (int i = 0; i < ShardCount; ++i) shards[i].units.store(0, memory_order_relaxed);
+        spreadLocked(units);
+    }
+
+    ShardedStockCounter(const ShardedStockCounter&) = delete;
+    ShardedStockCounter& operator=(const ShardedStockCounter&) = delete;
+
+    // Takes units if the counter holds that many; false (changing nothing) otherwise.
+    bool tryTake(long long units) {
+        if (units <= 0) return true;
+        atomic<long long>& own = shards[homeShard()].units;
+        long long current = own.load(memory_order_relaxed);
+        while (current >= units) {
+            if (own.compare_exchange_weak(current, current - units, memory_order_acq_rel)) return true;
+        }
+        lock_guard<mutex> guard(rebalanceLock);
+        rebalances.fetch_add(1, memory_order_relaxed);
+        long long sum = gatherLocked();
+        bool taken = (sum >= units);
+        spreadLocked(taken ? sum - units : sum);
+        return taken;
+    }
+
+    // Returns units, e.g. from a checkout that failed after taking them.
+    void put(long long units) {
+        if (units > 0) shards[homeShard()].units.fetch_add(units, memory_order_acq_rel);
+    }
+
+    // Applies a change made elsewhere; a decrease may leave the counter in deficit.
+    void adjust(long long delta) {
+        if (delta >= 0) {
+            put(delta);
+            return;
+        }
+        lock_guard<mutex> guard(rebalanceLock);
+        spreadLocked(gatherLocked() + delta);
+    }
+
+    void set(long long units) {
+        lock_guard<mutex> guard(rebalanceLock);
+        gatherLocked();
+        spreadLocked(units);
+    }
+
+    // Exact when nothing is changing it; a snapshot otherwise.
+    long long total() const {
+        long long sum = 0;
+        for (int i = 0; i < ShardCount; ++i) sum += shards[i].units.load(memory_order_acquire);
+        return sum;
+    }
+
+    long long rebalanceCount() const { return rebalances.load(memory_order_relaxed); }
+};
+
+// Sharded counters for the products expected to sell out under heavy contention (a
+// drop, a flash sale). The checkout pipeline admits a checkout only if it can take its
+// units of every tracked product, so once one sells out further buyers are turned away
+// without waiting for the stock rewrite; products.txt stays the authority and the
+// reserve stage still checks it.
+//
+// A counter holds the stock of products.txt less the units admitted but not yet
+// reserved, and nothing of its own is stored: it starts from the file, which every
+// order changes before its record is appended to the order log, and checkouts that
+// fail after admission put their units back. Writers outside the pipeline
+// (Product::editProduct, Order::placeOrder) report their stock changes through adjust().
+//
+// ECOM_HOT_PRODUCTS=101,102 tracks those products from startup. Thread-safe.
+class HotStockCounters {
+private:
+    mutable shared_mutex lock;
+    unordered_map<int, unique_ptr<ShardedStockCounter> > counters;
+    // Counters of untracked products. Callers use a counter without holding the lock, so
+    // one is only freed with the instance; tracking the product again reuses it.
+    unordered_map<int, unique_ptr<ShardedStockCounter> > retired;
+
+    HotStockCounters() {}
+
+    ShardedStockCounter* find(int productID) const {
+        shared_lock<shared_mutex> guard(lock);
+        auto found = counters.find(productID);
+        return found == counters.end() ? nullptr : found->second.get();
+    }
+
+public:
+    HotStockCounters(const HotStockCounters&) = delete;
+    HotStockCounters& operator=(const HotStockCounters&) = delete;
+
+    static HotStockCounters& getInstance() {
+        static HotStockCounters instance;
+        return instance;
+    }
+
+    // Starts (or restarts) tracking a product from its stock in the catalog.
+    bool track(int productID) {
+        ProductCatalog& catalog = ProductCatalog::getInstance();
+        if (!catalog.ensureLoaded()) return false;
+        int row = catalog.findRow(productID);
+        if (row < 0 || !catalog.isAlive(row)) return false;
+        unique_lock<shared_mutex> guard(lock);
+        unique_ptr<ShardedStockCounter>& counter = counters[productID];
+        if (!counter) {
+            auto found = retired.find(productID);
+            if (found != retired.end()) {
+                counter = std::move(found->second);
+                retired.erase(found);
+            } else {
+                counter.reset(new ShardedStockCounter());
+            }
+        }
+        counter->set(catalog.getStock(row));
+        return true;
+    }
+
+    // The counter is retired rather than freed, so a take racing with this cannot touch
+    // freed memory; the product simply stops being gated.
+    void untrack(int productID) {
+        unique_lock<shared_mutex> guard(lock);
+        auto found = counters.find(productID);
+        if (found == counters.end()) return;
+        retired[productID] = std::move(found->second);
+        counters.erase(found);
+    }
+
+    bool isTracked(int productID) const {
+        return find(productID) != nullptr;
+    }
+
+    void configureFromEnvironment() {
+        const char* setting = getenv("ECOM_HOT_PRODUCTS");
+        if (!setting || !*setting) return;
+        stringstream ss(setting);
+        string part;
+        while (getline(ss, part, ',')) {
+            if (!part.empty()) track(atoi(part.c_str()));
+        }
+    }
+
+    // Takes the units if the product is untracked or has them.
+    bool tryTake(int productID, int units) {
+        ShardedStockCounter* counter = find(productID);
+        return !counter || counter->tryTake(units);
+    }
+
+    void put(int productID, int units) {
+        ShardedStockCounter* counter = find(productID);
+        if (counter) counter->put(units);
+    }
+
+    void adjust(int productID, int delta) {
+        ShardedStockCounter* counter = find(productID);
+        if (counter && delta != 0) counter->adjust(delta);
+    }
+
+    // Units left for admission, or -1 if the product is not tracked.
+    long long remaining(int productID) const {
+        ShardedStockCounter* counter = find(productID);
+        return counter ? counter->total() : -1;
+    }
+
+    vector<int> trackedProducts() const {
+        shared_lock<shared_mutex> guard(lock);
+        vector<int> productIDs;
+        for (auto it = counters.begin(); it != counters.end(); ++it) productIDs.push_back(it->first);
+        return productIDs;
+    }
+};
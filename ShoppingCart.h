@@ -7,9 +7,14 @@
 #include <cstring>
 #include <cstdio>
 #include <limits>
+#include <vector>
+#include <utility>
 
 #include "Product.h"
 #include "User.h"
+#include "StockReservations.h"
+#include "IoStats.h"
+#include "Trace.h"
 
 using namespace std;
 
@@ -45,7 +50,7 @@ public:
              return;
         }
         generateCartFilename(userID);
-        ofstream outFile(cartFilename, ios::app);
+        TrackedOfstream outFile(IoStats::Carts, cartFilename, ios::app);
         if (!outFile) {
             cerr << "Error: Could not create or open cart file: " << cartFilename << endl;
         }
@@ -69,6 +74,7 @@ public:
     }
 
     bool addToCart(int productID, int quantity) {
+        TRACE_SCOPE("cart", "ShoppingCart::addToCart");
         if (quantity <= 0) {
             cerr << "Error: Quantity must be positive." << endl;
             return false;
@@ -86,7 +92,7 @@ public:
         delete product;
         product = nullptr;
         int quantityAlreadyInCart = 0;
-        ifstream checkFile(cartFilename);
+        TrackedIfstream checkFile(IoStats::Carts, cartFilename);
         if (checkFile) {
             string line;
             while(getline(checkFile, line)) {
@@ -105,16 +111,18 @@ public:
             }
             checkFile.close();
         }
-        if (quantity + quantityAlreadyInCart > currentStock) {
+        // Units other shoppers hold are not for sale (see StockReservations.h)
+        int availableStock = currentStock - StockReservations::getInstance().heldByOthers(userID, productID);
+        if (quantity + quantityAlreadyInCart > availableStock) {
              cerr << "Error: Not enough stock for Product ID " << productID 
-                  << ". Available: " << currentStock 
+                  << ". Available: " << availableStock 
                   << ", In Cart: " << quantityAlreadyInCart
                   << ", Requested to Add: " << quantity << endl;
             return false;
         }
-        ifstream inFile(cartFilename);
+        TrackedIfstream inFile(IoStats::Carts, cartFilename);
         string tempFilename = string(cartFilename) + ".tmp";
-        ofstream tempFile(tempFilename);
+        TrackedOfstream tempFile(IoStats::Carts, tempFilename);
         if (!inFile || !tempFile) {
             cerr << "Error: Could not open cart files for update." << endl;
             inFile.close();
@@ -156,17 +164,23 @@ public:
             cerr << "Error: Could not rename temp cart file." << endl;
             return false;
         }
+        IoStats::add(IoStats::Carts, IoStats::TempRewrites);
+        StockReservations& reservations = StockReservations::getInstance();
+        if (reservations.mode() == StockReservations::OnCart) {
+            reservations.hold(userID, productID, quantity + quantityAlreadyInCart, currentStock);
+        }
         return true;
     }
 
     bool removeFromCart(int productID) {
+        TRACE_SCOPE("cart", "ShoppingCart::removeFromCart");
          if (!cartFilename) {
              cerr << "Error: Cart is not associated with a user (invalid filename)." << endl;
              return false;
          }
-        ifstream inFile(cartFilename);
+        TrackedIfstream inFile(IoStats::Carts, cartFilename);
         string tempFilename = string(cartFilename) + ".tmp";
-        ofstream tempFile(tempFilename);
+        TrackedOfstream tempFile(IoStats::Carts, tempFilename);
         if (!inFile || !tempFile) {
             cerr << "Error: Could not open cart files for removal." << endl;
              inFile.close();
@@ -206,15 +220,18 @@ public:
             cerr << "Error: Could not rename temp cart file." << endl;
             return false;
         }
+        IoStats::add(IoStats::Carts, IoStats::TempRewrites);
+        StockReservations::getInstance().release(userID, productID);
         return true;
     }
 
     void viewCart() {
+        TRACE_SCOPE("cart", "ShoppingCart::viewCart");
         if (!cartFilename) {
              cerr << "Error: Cart is not associated with a user (invalid filename)." << endl;
              return;
          }
-        ifstream inFile(cartFilename);
+        TrackedIfstream inFile(IoStats::Carts, cartFilename);
         if (!inFile) {
             cerr << "Error: Could not open cart file: " << cartFilename << endl;
             return;
@@ -268,11 +285,12 @@ public:
     }
 
     double calculateTotal() {
+        TRACE_SCOPE("cart", "ShoppingCart::calculateTotal");
         if (!cartFilename) {
              cerr << "Error: Cart is not associated with a user (invalid filename)." << endl;
              return 0.0;
          }
-        ifstream inFile(cartFilename);
+        TrackedIfstream inFile(IoStats::Carts, cartFilename);
         if (!inFile) {
             return 0.0;
         }
@@ -295,26 +313,74 @@ public:
         return total;
     }
     
+    // The cart's lines as (productID, quantity), in file order.
+    vector<pair<int, int> > getItems() {
+        TRACE_SCOPE("cart", "ShoppingCart::getItems");
+        vector<pair<int, int> > items;
+        if (!cartFilename) return items;
+        TrackedIfstream inFile(IoStats::Carts, cartFilename);
+        string line;
+        while (getline(inFile, line)) {
+            if (line.empty()) continue;
+            stringstream ss(line);
+            string segment;
+            int prodID, quantity;
+            getline(ss, segment, ','); try { prodID = stoi(segment); } catch (...) { continue; }
+            getline(ss, segment, ','); try { quantity = stoi(segment); } catch (...) { continue; }
+            items.push_back(make_pair(prodID, quantity));
+        }
+        return items;
+    }
+
     bool clearCart() {
+        TRACE_SCOPE("cart", "ShoppingCart::clearCart");
          if (!cartFilename) {
              cerr << "Error: Cart is not associated with a user (invalid filename)." << endl;
              return false;
          }
-         ofstream outFile(cartFilename, ios::trunc);
+         TrackedOfstream outFile(IoStats::Carts, cartFilename, ios::trunc);
           if (!outFile) {
             cerr << "Error: Could not open cart file to clear: " << cartFilename << endl;
             return false;
         }
         outFile.close();
+        StockReservations::getInstance().releaseAll(userID);
         cout << "Cart for user " << userID << " cleared." << endl;
         return true;
     }
+
+    // Holds stock for everything in the cart while the user checks out. All or nothing:
+    // if any line cannot be held, the user's holds are released and false is returned.
+    // Call with the products lock held; stock is read from the catalog, which matches
+    // products.txt under that lock.
+    bool holdForCheckout() {
+        TRACE_SCOPE("cart", "ShoppingCart::holdForCheckout");
+        StockReservations& reservations = StockReservations::getInstance();
+        ProductCatalog& catalog = ProductCatalog::getInstance();
+        if (!catalog.ensureLoaded()) {
+            cerr << "Error: Could not load the product catalog." << endl;
+            return false;
+        }
+        vector<pair<int, int> > items = getItems();
+        for (size_t i = 0; i < items.size(); ++i) {
+            int row = catalog.findRow(items[i].first);
+            int stock = row >= 0 ? catalog.getStock(row) : 0;
+            if (!reservations.hold(userID, items[i].first, items[i].second, stock)) {
+                cerr << "Error: Only " << reservations.available(items[i].first, stock) + reservations.heldBy(userID, items[i].first)
+                     << " of Product ID " << items[i].first << " can be held for checkout." << endl;
+                reservations.releaseAll(userID);
+                return false;
+            }
+        }
+        return true;
+    }
     
     bool isEmpty() {
+        TRACE_SCOPE("cart", "ShoppingCart::isEmpty");
          if (!cartFilename) {
              return true;
          }
-         ifstream inFile(cartFilename);
+         TrackedIfstream inFile(IoStats::Carts, cartFilename);
          if (!inFile) {
              return true;
          }
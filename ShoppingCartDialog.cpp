@@ -5,6 +5,9 @@
 #include <QString>
 #include <QFileInfo>
 #include <QDir>
+#include "../../include/IoStats.h"
+#include "../../include/Trace.h"
+#include "../../include/SessionRecorder.h"
 
 ShoppingCartDialog::ShoppingCartDialog(int userId, QWidget *parent)
     : QDialog(parent), userId(userId)
@@ -93,6 +96,7 @@ void ShoppingCartDialog::setupUI()
 
 void ShoppingCartDialog::loadCartItems()
 {
+    TRACE_SCOPE("ui", "ShoppingCartDialog::loadCartItems");
     // Clear current items
     currentCartItems.clear();
     
@@ -109,7 +113,7 @@ void ShoppingCartDialog::loadCartItems()
     }
     
     // Read cart data from file
-    std::ifstream cartFileStream(cartFilePath);
+    TrackedIfstream cartFileStream(IoStats::Carts, cartFilePath);
     if (!cartFileStream.is_open()) {
         QMessageBox::warning(this, "Error", "Failed to open cart file.");
         return;
@@ -214,6 +218,7 @@ void ShoppingCartDialog::handleRemoveItem()
     int productId = item->data(Qt::UserRole).toInt();
     
     // Use the backend ShoppingCart class to remove the item
+    SessionRecorder::getInstance().record("cart-remove", std::to_string(productId));
     ShoppingCart cart(userId);
     if (cart.removeFromCart(productId)) {
         QMessageBox::information(this, "Remove Item", "Item removed from cart.");
@@ -238,6 +243,7 @@ void ShoppingCartDialog::handleUpdateQuantity()
     QTableWidgetItem* item = cartTableWidget->item(currentRow, 0);
     int productId = item->data(Qt::UserRole).toInt();
     int newQuantity = quantitySpinBox->value();
+    SessionRecorder::getInstance().record("cart-update", std::to_string(productId) + " " + std::to_string(newQuantity));
     
     // Check stock availability
     Product* product = Product::getProductByID(productId);
@@ -0,0 +1,241 @@
+#ifndef STALLWATCHDOG_H
+#define STALLWATCHDOG_H
+
+#include <QObject>
+#include <QMetaObject>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include "../../include/Trace.h"
+
+// Detects event-loop stalls on the GUI thread and attributes them to trace spans.
+//
+// A background thread posts a ping to the event loop every PingIntervalMs and waits for
+// the loop to run it. Once a ping has waited longer than the threshold, the thread
+// samples the spans open on the GUI thread every SampleIntervalMs until the ping is
+// answered; the stall is charged to the span path seen in most samples. Stalls are
+// appended to data/stall_log.txt (rotated to data/stall_log.1.txt past MaxLogBytes)
+// and aggregated per span for report(). A stall that begins between two pings is
+// measured from the later ping, so durations can be short by up to PingIntervalMs.
+//
+// The threshold is ECOM_STALL_MS if set, otherwise DefaultThresholdMs.
+class StallWatchdog : public QObject
+{
+public:
+    static constexpr int DefaultThresholdMs = 16;
+    static constexpr int PingIntervalMs = 10;
+    static constexpr int SampleIntervalMs = 2;
+    static constexpr long long MaxLogBytes = 1024 * 1024;
+
+    struct SpanTotals {
+        string span;
+        int count;
+        double totalMs;
+        double maxMs;
+
+        SpanTotals() : count(0), totalMs(0.0), maxMs(0.0) {}
+    };
+
+    static StallWatchdog& getInstance() {
+        static StallWatchdog instance;
+        return instance;
+    }
+
+    // Must be called on the GUI thread, whose spans are the ones sampled.
+    inline void start();
+    inline void stop();
+
+    void setThresholdMs(int milliseconds) { thresholdMs.store(max(1, milliseconds), memory_order_relaxed); }
+    int getThresholdMs() const { return thresholdMs.load(memory_order_relaxed); }
+
+    // Spans sorted by total stalled time, longest first.
+    inline vector<SpanTotals> topStalls(size_t limit) const;
+    inline string report(size_t limit) const;
+    inline void resetTotals();
+
+    static string logPath() { return "data/stall_log.txt"; }
+
+private:
+    typedef chrono::steady_clock Clock;
+
+    StallWatchdog() : QObject(nullptr), guiSpans(nullptr), running(false), answeredPing(0), answeredAtNs(0),
+                      thresholdMs(DefaultThresholdMs), stallCount(0) {
+        const char* setting = getenv("ECOM_STALL_MS");
+        if (setting && atoi(setting) > 0) thresholdMs.store(atoi(setting), memory_order_relaxed);
+    }
+    ~StallWatchdog() { stop(); }
+
+    static long long nowNs() {
+        return chrono::duration_cast<chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+    }
+
+    inline void run();
+    inline string sampleGuiSpans() const;
+    inline void recordStall(long long startNs, double durationMs, const string& path);
+    inline void appendToLog(const string& line);
+
+    const Trace::OpenSpans* guiSpans;
+    thread worker;
+    atomic<bool> running;
+    mutable mutex stateLock;       // Guards totals and the log file
+    condition_variable wakeUp;
+    mutex wakeLock;
+    atomic<unsigned long long> answeredPing;
+    atomic<long long> answeredAtNs;
+    atomic<int> thresholdMs;
+    unordered_map<string, SpanTotals> totals;
+    long long stallCount;
+};
+
+inline void StallWatchdog::start() {
+    if (running.load()) return;
+    guiSpans = &Trace::openSpans();
+    Trace::getInstance().setTrackingOpenSpans(true);
+    running.store(true);
+    worker = thread(&StallWatchdog::run, this);
+}
+
+inline void StallWatchdog::stop() {
+    if (!running.exchange(false)) return;
+    {
+        lock_guard<mutex> guard(wakeLock);
+    }
+    wakeUp.notify_all();
+    if (worker.joinable()) worker.join();
+    Trace::getInstance().setTrackingOpenSpans(false);
+}
+
+inline void StallWatchdog::run() {
+    unsigned long long ping = 0;
+    while (running.load()) {
+        ++ping;
+        long long sentNs = nowNs();
+        QMetaObject::invokeMethod(this, [this, ping]() {
+            answeredAtNs.store(nowNs(), memory_order_relaxed);
+            answeredPing.store(ping, memory_order_release);
+        }, Qt::QueuedConnection);
+
+        map<string, int> samples;
+        while (running.load() && answeredPing.load(memory_order_acquire) != ping) {
+            this_thread::sleep_for(chrono::milliseconds(SampleIntervalMs));
+            if (nowNs() - sentNs >= static_cast<long long>(thresholdMs.load(memory_order_relaxed)) * 1000000LL) {
+                samples[sampleGuiSpans()]++;
+            }
+        }
+        if (!running.load()) break;
+
+        double waitedMs = (answeredAtNs.load(memory_order_relaxed) - sentNs) / 1e6;
+        if (!samples.empty() && waitedMs >= thresholdMs.load(memory_order_relaxed)) {
+            auto busiest = max_element(samples.begin(), samples.end(),
+                                       [](const pair<const string, int>& a, const pair<const string, int>& b) {
+                                           return a.second < b.second;
+                                       });
+            recordStall(sentNs, waitedMs, busiest->first);
+        }
+
+        unique_lock<mutex> lock(wakeLock);
+        wakeUp.wait_for(lock, chrono::milliseconds(PingIntervalMs), [this]() { return !running.load(); });
+    }
+}
+
+inline string StallWatchdog::sampleGuiSpans() const {
+    int depth = guiSpans->depth.load(memory_order_acquire);
+    depth = min(depth, static_cast<int>(Trace::MaxOpenDepth));
+    if (depth <= 0) return "(no open span)";
+    string path;
+    for (int i = 0; i < depth; ++i) {
+        const char* name = guiSpans->names[i].load(memory_order_relaxed);
+        if (!name) continue;
+        if (!path.empty()) path += " > ";
+        path += name;
+    }
+    return path.empty() ? "(no open span)" : path;
+}
+
+inline void StallWatchdog::recordStall(long long startNs, double durationMs, const string& path) {
+    // Charge the innermost span; the full path goes to the log
+    size_t lastSeparator = path.rfind(" > ");
+    string span = (lastSeparator == string::npos) ? path : path.substr(lastSeparator + 3);
+
+    time_t wallClock = time(nullptr) - static_cast<time_t>((nowNs() - startNs) / 1000000000LL);
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", localtime(&wallClock));
+    ostringstream line;
+    line << stamp << "," << fixed << setprecision(1) << durationMs << "," << span << "," << path;
+
+    lock_guard<mutex> guard(stateLock);
+    SpanTotals& entry = totals[span];
+    entry.span = span;
+    entry.count++;
+    entry.totalMs += durationMs;
+    entry.maxMs = max(entry.maxMs, durationMs);
+    stallCount++;
+    appendToLog(line.str());
+}
+
+inline void StallWatchdog::appendToLog(const string& line) {
+    ifstream existing(logPath(), ios::binary | ios::ate);
+    if (existing && static_cast<long long>(existing.tellg()) >= MaxLogBytes) {
+        existing.close();
+        string previous = "data/stall_log.1.txt";
+        remove(previous.c_str());
+        rename(logPath().c_str(), previous.c_str());
+    }
+    ofstream out(logPath(), ios::app);
+    if (!out) return;
+    out << line << "\n";
+}
+
+inline vector<StallWatchdog::SpanTotals> StallWatchdog::topStalls(size_t limit) const {
+    vector<SpanTotals> sorted;
+    {
+        lock_guard<mutex> guard(stateLock);
+        for (auto it = totals.begin(); it != totals.end(); ++it) sorted.push_back(it->second);
+    }
+    sort(sorted.begin(), sorted.end(), [](const SpanTotals& a, const SpanTotals& b) {
+        return a.totalMs > b.totalMs;
+    });
+    if (sorted.size() > limit) sorted.resize(limit);
+    return sorted;
+}
+
+inline string StallWatchdog::report(size_t limit) const {
+    vector<SpanTotals> top = topStalls(limit);
+    long long count;
+    {
+        lock_guard<mutex> guard(stateLock);
+        count = stallCount;
+    }
+    ostringstream out;
+    out << count << " stall(s) over " << getThresholdMs() << " ms this session (log: " << logPath() << ")\n\n";
+    if (top.empty()) return out.str();
+    out << left << setw(48) << "Span" << right << setw(8) << "Stalls" << setw(12) << "Total ms"
+        << setw(10) << "Max ms" << "\n";
+    for (size_t i = 0; i < top.size(); ++i) {
+        string span = top[i].span.length() > 47 ? top[i].span.substr(0, 44) + "..." : top[i].span;
+        out << left << setw(48) << span << right << setw(8) << top[i].count << fixed << setprecision(1)
+            << setw(12) << top[i].totalMs << setw(10) << top[i].maxMs << "\n";
+    }
+    return out.str();
+}
+
+inline void StallWatchdog::resetTotals() {
+    lock_guard<mutex> guard(stateLock);
+    totals.clear();
+    stallCount = 0;
+}
+
+#endif // STALLWATCHDOG_H
@@ -0,0 +1,273 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <ctime>
+#include <cstdlib>
+
+#include "ChangeFeed.h"
+#include "Trace.h"
+
+using namespace std;
+
+// Time-limited stock holds, so a shopper who has started checking out is not told at the
+// very end that somebody else bought the last units first.
+//
+// A hold sets aside some units of one product for one user until it expires, is released
+// or is converted into an order. Listings show available = stock - held, and every
+// stock check (ShoppingCart::addToCart, Order::placeOrder, the checkout pipeline) counts
+// the units other users hold as gone. The stock in products.txt only changes when an
+// order is placed.
+//
+// When holds are taken is a policy: OnCheckout (the default) when the order summary is
+// shown, OnCart as soon as an item goes into the cart, or Off. ECOM_STOCK_HOLDS picks it
+// as off, checkout or cart, optionally followed by :seconds for the lifetime (default 600).
+//
+// Holds live in memory only. Expiry uses a hashed timer wheel with one-second slots: each
+// hold is filed under the slot of its expiry time and advancing the clock visits only the
+// slots that have come due, so expiring costs O(1) per hold however many are active. A
+// refreshed hold is filed again; its stale wheel entry is recognised by the expiry time
+// and dropped. The wheel advances on every hold and stock check and on expire(), which the
+// GUI and ecomserver run every second. available() only reads: listings call it while
+// painting, so it neither advances the wheel nor publishes, and an expired hold leaves a
+// listing at the next expire().
+//
+// Thread-safe. ChangeFeed deltas (Product, Stock) for products whose held count changed
+// are published after the internal lock is released.
+class StockReservations {
+public:
+    enum Mode { Off, OnCheckout, OnCart };
+
+    static const int DefaultTtlSeconds = 600;
+    static const size_t WheelSlots = 1024;
+
+private:
+    struct Hold {
+        int quantity;
+        long long expiresAt;
+    };
+
+    struct WheelEntry {
+        unsigned long long key;
+        long long expiresAt;
+    };
+
+    mutable mutex lock;
+    Mode policy;
+    int ttlSeconds;
+    unordered_map<unsigned long long, Hold> holds;   // (userID, productID) -> hold
+    unordered_map<int, int> heldTotals;              // productID -> units held by everyone
+    vector<vector<WheelEntry> > wheel;
+    long long wheelTime;                             // Last second the wheel has processed
+
+    StockReservations() : policy(OnCheckout), ttlSeconds(DefaultTtlSeconds), wheel(WheelSlots), wheelTime(0) {}
+
+    static unsigned long long holdKey(int userID, int productID) {
+        return (static_cast<unsigned long long>(static_cast<unsigned int>(userID)) << 32) |
+               static_cast<unsigned int>(productID);
+    }
+
+    static int keyUser(unsigned long long key) { return static_cast<int>(key >> 32); }
+    static int keyProduct(unsigned long long key) { return static_cast<int>(key & 0xFFFFFFFFull); }
+
+    static long long now() { return static_cast<long long>(time(nullptr)); }
+
+    static void publish(const vector<int>& productIDs) {
+        for (size_t i = 0; i < productIDs.size(); ++i) {
+            ChangeFeed::getInstance().publish(EntityType::Product, ChangeKind::Updated, productIDs[i], ProductField::Stock);
+        }
+    }
+
+    void schedule(unsigned long long key, long long expiresAt) {
+        WheelEntry entry;
+        entry.key = key;
+        entry.expiresAt = expiresAt;
+        wheel[static_cast<size_t>(expiresAt) % WheelSlots].push_back(entry);
+    }
+
+    // Removes a hold; returns the units it held.
+    int dropLocked(unsigned long long key) {
+        auto found = holds.find(key);
+        if (found == holds.end()) return 0;
+        int quantity = found->second.quantity;
+        holds.erase(found);
+        auto total = heldTotals.find(keyProduct(key));
+        if (total != heldTotals.end()) {
+            total->second -= quantity;
+            if (total->second <= 0) heldTotals.erase(total);
+        }
+        return quantity;
+    }
+
+    // Visits each slot that came due since the last call, at most one full turn.
+    void advanceLocked(long long currentTime, vector<int>& changed) {
+        if (wheelTime == 0) wheelTime = currentTime;
+        long long steps = currentTime - wheelTime;
+        if (steps <= 0) return;
+        if (steps > static_cast<long long>(WheelSlots)) steps = static_cast<long long>(WheelSlots);
+        for (long long step = 1; step <= steps; ++step) {
+            vector<WheelEntry>& slot = wheel[static_cast<size_t>(wheelTime + step) % WheelSlots];
+            size_t kept = 0;
+            for (size_t i = 0; i < slot.size(); ++i) {
+                auto found = holds.find(slot[i].key);
+                if (found == holds.end() || found->second.expiresAt != slot[i].expiresAt) continue; // Released or refreshed
+                if (slot[i].expiresAt > currentTime) {
+                    slot[kept++] = slot[i]; // Due on a later turn of the wheel
+                    continue;
+                }
+                dropLocked(slot[i].key);
+                changed.push_back(keyProduct(slot[i].key));
+            }
+            slot.resize(kept);
+        }
+        wheelTime = currentTime;
+    }
+
+    int heldByOthersLocked(int userID, int productID) const {
+        auto total = heldTotals.find(productID);
+        if (total == heldTotals.end()) return 0;
+        auto own = holds.find(holdKey(userID, productID));
+        return total->second - (own == holds.end() ? 0 : own->second.quantity);
+    }
+
+public:
+    StockReservations(const StockReservations&) = delete;
+    StockReservations& operator=(const StockReservations&) = delete;
+
+    static StockReservations& getInstance() {
+        static StockReservations instance;
+        return instance;
+    }
+
+    // Changing the policy keeps existing holds; they run out on their own.
+    void configure(Mode mode, int holdSeconds = DefaultTtlSeconds) {
+        lock_guard<mutex> guard(lock);
+        policy = mode;
+        ttlSeconds = holdSeconds > 0 ? holdSeconds : DefaultTtlSeconds;
+    }
+
+    void configureFromEnvironment() {
+        const char* setting = getenv("ECOM_STOCK_HOLDS");
+        if (!setting || !*setting) return;
+        string value = setting;
+        string name = value.substr(0, value.find(':'));
+        int seconds = (value.find(':') == string::npos) ? DefaultTtlSeconds : atoi(value.c_str() + value.find(':') + 1);
+        if (name == "off") configure(Off, seconds);
+        else if (name == "cart") configure(OnCart, seconds);
+        else if (name == "checkout") configure(OnCheckout, seconds);
+    }
+
+    Mode mode() const {
+        lock_guard<mutex> guard(lock);
+        return policy;
+    }
+
+    int holdSeconds() const {
+        lock_guard<mutex> guard(lock);
+        return ttlSeconds;
+    }
+
+    // Sets the user's hold on a product to quantity units (0 releases it) and restarts its
+    // lifetime. Fails, changing nothing, if stock less what others hold cannot cover it.
+    bool hold(int userID, int productID, int quantity, int stock) {
+        TRACE_SCOPE("holds", "StockReservations::hold");
+        vector<int> changed;
+        bool held = true;
+        {
+            lock_guard<mutex> guard(lock);
+            advanceLocked(now(), changed);
+            unsigned long long key = holdKey(userID, productID);
+            auto found = holds.find(key);
+            int previous = (found == holds.end()) ? 0 : found->second.quantity;
+            if (quantity <= 0) {
+                if (dropLocked(key) > 0) changed.push_back(productID);
+            } else if (quantity > stock - heldByOthersLocked(userID, productID)) {
+                held = false;
+            } else {
+                Hold entry;
+                entry.quantity = quantity;
+                entry.expiresAt = now() + ttlSeconds;
+                holds[key] = entry;
+                heldTotals[productID] += quantity - previous;
+                schedule(key, entry.expiresAt);
+                if (quantity != previous) changed.push_back(productID);
+            }
+        }
+        publish(changed);
+        return held;
+    }
+
+    // Ends the user's hold on a product, e.g. when it leaves the cart or was ordered.
+    void release(int userID, int productID) {
+        vector<int> changed;
+        {
+            lock_guard<mutex> guard(lock);
+            if (dropLocked(holdKey(userID, productID)) > 0) changed.push_back(productID);
+        }
+        publish(changed);
+    }
+
+    void releaseAll(int userID) {
+        vector<int> changed;
+        {
+            lock_guard<mutex> guard(lock);
+            vector<unsigned long long> keys;
+            for (auto it = holds.begin(); it != holds.end(); ++it) {
+                if (keyUser(it->first) == userID) keys.push_back(it->first);
+            }
+            for (size_t i = 0; i < keys.size(); ++i) {
+                dropLocked(keys[i]);
+                changed.push_back(keyProduct(keys[i]));
+            }
+        }
+        publish(changed);
+    }
+
+    // Units of the product held by anyone but this user; these are not for sale to them.
+    int heldByOthers(int userID, int productID) {
+        vector<int> changed;
+        int units;
+        {
+            lock_guard<mutex> guard(lock);
+            advanceLocked(now(), changed);
+            units = heldByOthersLocked(userID, productID);
+        }
+        publish(changed);
+        return units;
+    }
+
+    int heldBy(int userID, int productID) {
+        lock_guard<mutex> guard(lock);
+        auto found = holds.find(holdKey(userID, productID));
+        return found == holds.end() ? 0 : found->second.quantity;
+    }
+
+    // What a listing shows as in stock.
+    int available(int productID, int stock) const {
+        int units;
+        {
+            lock_guard<mutex> guard(lock);
+            auto total = heldTotals.find(productID);
+            units = stock - (total == heldTotals.end() ? 0 : total->second);
+        }
+        return units > 0 ? units : 0;
+    }
+
+    // Drops the holds that have run out; returns how many products were affected.
+    size_t expire() {
+        vector<int> changed;
+        {
+            lock_guard<mutex> guard(lock);
+            advanceLocked(now(), changed);
+        }
+        publish(changed);
+        return changed.size();
+    }
+
+    size_t holdCount() const {
+        lock_guard<mutex> guard(lock);
+        return holds.size();
+    }
+};
@@ -0,0 +1,207 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+#include <algorithm>
+
+#include "IoStats.h"
+
+using namespace std;
+
+// Reader/writer locks over the file-backed stores, for callers that drive the backend
+// from several threads (the backend itself assumes one thread).
+//
+// A StoreLockSet takes every lock an operation needs up front, in store order, so two
+// sets can never deadlock. Per-user files (carts, wishlists) are guarded by a shared
+// store lock plus one of UserStripes exclusive stripes keyed by user ID, so different
+// users' carts do not serialise against each other. Each lock records how often it was
+// taken, how often a caller had to wait, and for how long.
+class StoreLocks {
+public:
+    static const int UserStripes = 64;
+
+    enum Mode { Shared, Exclusive };
+
+    struct LockStats {
+        atomic<long long> sharedAcquisitions;
+        atomic<long long> exclusiveAcquisitions;
+        atomic<long long> contended;     // Acquisitions that could not be had immediately
+        atomic<long long> waitNs;
+        atomic<long long> maxWaitNs;
+    };
+
+    struct StatsSnapshot {
+        long long sharedAcquisitions;
+        long long exclusiveAcquisitions;
+        long long contended;
+        long long waitNs;
+        long long maxWaitNs;
+    };
+
+private:
+    shared_mutex storeLocks[IoStats::StoreCount];
+    mutex userStripes[IoStats::StoreCount][UserStripes];
+    LockStats stats[IoStats::StoreCount];
+
+    StoreLocks() {
+        resetStats();
+    }
+
+    static long long nowNs() {
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void noteWait(IoStats::Store store, long long waitedNs) {
+        LockStats& entry = stats[store];
+        entry.contended.fetch_add(1, memory_order_relaxed);
+        entry.waitNs.fetch_add(waitedNs, memory_order_relaxed);
+        long long seen = entry.maxWaitNs.load(memory_order_relaxed);
+        while (waitedNs > seen && !entry.maxWaitNs.compare_exchange_weak(seen, waitedNs, memory_order_relaxed)) {
+        }
+    }
+
+public:
+    StoreLocks(const StoreLocks&) = delete;
+    StoreLocks& operator=(const StoreLocks&) = delete;
+
+    static StoreLocks& getInstance() {
+        static StoreLocks instance;
+        return instance;
+    }
+
+    void lockStore(IoStats::Store store, Mode mode) {
+        shared_mutex& lock = storeLocks[store];
+        if (mode == Exclusive) {
+            stats[store].exclusiveAcquisitions.fetch_add(1, memory_order_relaxed);
+            if (lock.try_lock()) return;
+            long long started = nowNs();
+            lock.lock();
+            noteWait(store, nowNs() - started);
+        } else {
+            stats[store].sharedAcquisitions.fetch_add(1, memory_order_relaxed);
+            if (lock.try_lock_shared()) return;
+            long long started = nowNs();
+            lock.lock_shared();
+            noteWait(store, nowNs() - started);
+        }
+    }
+
+    void unlockStore(IoStats::Store store, Mode mode) {
+        if (mode == Exclusive) storeLocks[store].unlock();
+        else storeLocks[store].unlock_shared();
+    }
+
+    void lockUser(IoStats::Store store, int userID) {
+        mutex& stripe = userStripes[store][static_cast<unsigned>(userID) % UserStripes];
+        if (stripe.try_lock()) return;
+        long long started = nowNs();
+        stripe.lock();
+        noteWait(store, nowNs() - started);
+    }
+
+    void unlockUser(IoStats::Store store, int userID) {
+        userStripes[store][static_cast<unsigned>(userID) % UserStripes].unlock();
+    }
+
+    StatsSnapshot snapshot(IoStats::Store store) const {
+        const LockStats& entry = stats[store];
+        StatsSnapshot result;
+        result.sharedAcquisitions = entry.sharedAcquisitions.load(memory_order_relaxed);
+        result.exclusiveAcquisitions = entry.exclusiveAcquisitions.load(memory_order_relaxed);
+        result.contended = entry.contended.load(memory_order_relaxed);
+        result.waitNs = entry.waitNs.load(memory_order_relaxed);
+        result.maxWaitNs = entry.maxWaitNs.load(memory_order_relaxed);
+        return result;
+    }
+
+    void resetStats() {
+        for (int store = 0; store < IoStats::StoreCount; ++store) {
+            stats[store].sharedAcquisitions.store(0, memory_order_relaxed);
+            stats[store].exclusiveAcquisitions.store(0, memory_order_relaxed);
+            stats[store].contended.store(0, memory_order_relaxed);
+            stats[store].waitNs.store(0, memory_order_relaxed);
+            stats[store].maxWaitNs.store(0, memory_order_relaxed);
+        }
+    }
+};
+
+// The locks one operation holds; acquired together, released on destruction.
+//
+//   StoreLockSet locks;
+//   locks.add(IoStats::Products, StoreLocks::Exclusive);
+//   locks.addUser(IoStats::Carts, userID);
+//   locks.acquire();
+class StoreLockSet {
+private:
+    struct Entry {
+        IoStats::Store store;
+        StoreLocks::Mode mode;
+        int userID;        // >= 0: also take this user's stripe of a per-user store
+    };
+
+    vector<Entry> entries;
+    bool held;
+
+public:
+    StoreLockSet() : held(false) {}
+    ~StoreLockSet() { release(); }
+
+    StoreLockSet(const StoreLockSet&) = delete;
+    StoreLockSet& operator=(const StoreLockSet&) = delete;
+
+    StoreLockSet& add(IoStats::Store store, StoreLocks::Mode mode) {
+        Entry entry = {store, mode, -1};
+        entries.push_back(entry);
+        return *this;
+    }
+
+    // One user's files in a per-user store: shared on the store, exclusive on the user.
+    StoreLockSet& addUser(IoStats::Store store, int userID) {
+        Entry entry = {store, StoreLocks::Shared, userID};
+        entries.push_back(entry);
+        return *this;
+    }
+
+    void acquire() {
+        if (held) return;
+        // Store order, exclusive before shared for the same store, so duplicates merge
+        sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+            if (a.store != b.store) return a.store < b.store;
+            return a.mode > b.mode;
+        });
+        vector<Entry> merged;
+        for (size_t i = 0; i < entries.size(); ++i) {
+            if (!merged.empty() && merged.back().store == entries[i].store) {
+                if (merged.back().userID < 0) merged.back().userID = entries[i].userID;
+                continue;
+            }
+            merged.push_back(entries[i]);
+        }
+        entries.swap(merged);
+
+        StoreLocks& locks = StoreLocks::getInstance();
+        for (size_t i = 0; i < entries.size(); ++i) {
+            locks.lockStore(entries[i].store, entries[i].mode);
+            // An exclusive store lock already excludes every user of that store
+            if (entries[i].userID >= 0 && entries[i].mode == StoreLocks::Shared) {
+                locks.lockUser(entries[i].store, entries[i].userID);
+            }
+        }
+        held = true;
+    }
+
+    void release() {
+        if (!held) return;
+        StoreLocks& locks = StoreLocks::getInstance();
+        for (size_t i = entries.size(); i-- > 0;) {
+            if (entries[i].userID >= 0 && entries[i].mode == StoreLocks::Shared) {
+                locks.unlockUser(entries[i].store, entries[i].userID);
+            }
+            locks.unlockStore(entries[i].store, entries[i].mode);
+        }
+        held = false;
+    }
+};
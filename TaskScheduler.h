@@ -0,0 +1,433 @@
+#pragma once
+
+#include <iostream>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <utility>
+#include <cstdlib>
+
+using namespace std;
+
+enum class TaskPriority {
+    Interactive,    // Someone is waiting for it: a listing, a page, a dialog
+    Background      // Runs only when no interactive work is queued: compaction, prefetching
+};
+
+// Set once by whoever no longer wants a task's result; shared by copies. Long tasks may
+// poll it and stop early; Async.h uses it to drop a coroutine waiting for the result.
+class CancellationToken {
+private:
+    shared_ptr<atomic<bool> > cancelled;
+
+public:
+    CancellationToken() : cancelled(make_shared<atomic<bool> >(false)) {}
+
+    void cancel() const { cancelled->store(true); }
+    bool isCancelled() const { return cancelled->load(); }
+};
+
+// Owns the token of the operation currently under way, e.g. a widget's latest load.
+// Starting the next one, or destroying the source, cancels it.
+class CancellationSource {
+private:
+    CancellationToken current;
+
+public:
+    CancellationSource() {}
+    ~CancellationSource() { current.cancel(); }
+
+    CancellationSource(const CancellationSource&) = delete;
+    CancellationSource& operator=(const CancellationSource&) = delete;
+
+    // Cancels the operation under way and returns a token for the next one.
+    CancellationToken restart() {
+        current.cancel();
+        current = CancellationToken();
+        return current;
+    }
+
+    CancellationToken token() const { return current; }
+    void cancel() { current.cancel(); }
+};
+
+// Result slot shared by a task and the TaskFutures that refer to it.
+template <typename T>
+struct TaskState {
+    mutex lock;
+    condition_variable done;
+    bool ready;
+    T value;
+    exception_ptr error;
+    vector<function<void()> > continuations;  // Run once, by whoever finishes the task
+
+    TaskState() : ready(false), value() {}
+
+    template <typename F>
+    void run(F& work) {
+        try {
+            T result = work();
+            finish(&result, nullptr);
+        } catch (...) {
+            finish(nullptr, current_exception());
+        }
+    }
+
+    void finish(T* result, exception_ptr failure) {
+        vector<function<void()> > waiting;
+        {
+            lock_guard<mutex> guard(lock);
+            if (result) value = std::move(*result);
+            error = failure;
+            ready = true;
+            waiting.swap(continuations);
+        }
+        done.notify_all();
+        for (size_t i = 0; i < waiting.size(); ++i) waiting[i]();
+    }
+
+    // Runs next now if the task has finished, otherwise when it does.
+    void whenDone(function<void()> next) {
+        {
+            lock_guard<mutex> guard(lock);
+            if (!ready) {
+                continuations.push_back(std::move(next));
+                return;
+            }
+        }
+        next();
+    }
+};
+
+// The eventual result of a task started with TaskScheduler::run. Tasks return a value;
+// work done only for its effect returns bool, like the store functions do.
+template <typename T>
+class TaskFuture {
+private:
+    shared_ptr<TaskState<T> > state;
+
+public:
+    TaskFuture() {}
+    explicit TaskFuture(shared_ptr<TaskState<T> > shared) : state(shared) {}
+
+    bool valid() const { return state != nullptr; }
+
+    bool isReady() const {
+        lock_guard<mutex> guard(state->lock);
+        return state->ready;
+    }
+
+    // Waits for the result, running queued tasks meanwhile, so a task may wait for the
+    // tasks it started without tying up its thread. Rethrows what the task threw.
+    T get() const;
+
+    // Starts next(result) as a new task once this one has finished. If this task threw,
+    // next is skipped and the returned future rethrows the same exception.
+    template <typename F>
+    TaskFuture<decltype(declval<F&>()(declval<const T&>()))> then(F next, TaskPriority priority = TaskPriority::Interactive) const;
+
+    // Runs next once the task has finished, on whichever thread finishes it (at once if it
+    // already has). next reads the outcome with get(), which no longer waits.
+    void whenDone(function<void()> next) const { state->whenDone(std::move(next)); }
+
+    // Hands the result to onResult through the scheduler's dispatcher, e.g. on the GUI
+    // thread. A task that threw is reported on cerr instead.
+    template <typename F>
+    void deliver(F onResult) const;
+};
+
+// Work-stealing thread pool shared by the backend and the widgets.
+//
+// Every worker has its own deque per priority. Work a task starts goes to the back of
+// its worker's deque and the worker takes from the back, so related work runs on a warm
+// cache; an idle worker steals from the front of the others' deques, taking the oldest
+// (usually largest) piece. Work submitted from outside the pool, such as the GUI
+// thread, goes to a shared queue that is served first in, first out. A worker looks for
+// interactive work in its own deque, the shared queue and the other deques before it
+// touches any background work.
+//
+// Idle workers sleep on a condition variable; a submission only takes the shared lock
+// to wake one if some worker is actually asleep.
+//
+// The pool starts on first use with one worker per hardware thread, or ECOM_TASK_THREADS.
+// Results go back to the widgets through a dispatcher, installed by the GUI the same way
+// as for the checkout pipeline; without one, deliver() runs on the worker.
+class TaskScheduler {
+public:
+    typedef function<void()> Work;
+    typedef function<void(function<void()>)> Dispatcher;
+
+    struct Stats {
+        int threads;
+        long long executed;
+        long long stolen;       // Taken from another worker's deque
+        long long queued;       // Waiting right now
+    };
+
+private:
+    static const int PriorityCount = 2;
+
+    struct Worker {
+        mutex lock;
+        deque<Work> queues[PriorityCount];
+    };
+
+    vector<unique_ptr<Worker> > workers;
+    vector<thread> threads;
+    mutex sharedLock;                       // Guards sharedQueues and stopping; idle workers sleep on it
+    condition_variable wake;
+    deque<Work> sharedQueues[PriorityCount];
+    bool stopping;
+    atomic<long long> queued;               // Tasks in any queue
+    atomic<int> sleepers;
+    atomic<long long> executed;
+    atomic<long long> stolen;
+    mutex dispatcherLock;
+    Dispatcher dispatcher;
+
+    // Index of the calling thread's worker in this pool, or -1
+    static int& currentWorker() {
+        thread_local int index = -1;
+        return index;
+    }
+
+    TaskScheduler() : stopping(false), queued(0), sleepers(0), executed(0), stolen(0) {
+        int count = static_cast<int>(thread::hardware_concurrency());
+        const char* setting = getenv("ECOM_TASK_THREADS");
+        if (setting && atoi(setting) > 0) count = atoi(setting);
+        if (count < 1) count = 1;
+        for (int i = 0; i < count; ++i) workers.push_back(unique_ptr<Worker>(new Worker()));
+        for (int i = 0; i < count; ++i) threads.push_back(thread(&TaskScheduler::workerLoop, this, i));
+    }
+
+    ~TaskScheduler() {
+        shutdown();
+    }
+
+    void wakeOne() {
+        if (sleepers.load() == 0) return;
+        lock_guard<mutex> guard(sharedLock);
+        wake.notify_one();
+    }
+
+    bool popOwn(int self, int priority, Work& work) {
+        Worker& worker = *workers[static_cast<size_t>(self)];
+        lock_guard<mutex> guard(worker.lock);
+        deque<Work>& queue = worker.queues[priority];
+        if (queue.empty()) return false;
+        work = std::move(queue.back());
+        queue.pop_back();
+        return true;
+    }
+
+    bool popShared(int priority, Work& work) {
+        lock_guard<mutex> guard(sharedLock);
+        deque<Work>& queue = sharedQueues[priority];
+        if (queue.empty()) return false;
+        work = std::move(queue.front());
+        queue.pop_front();
+        return true;
+    }
+
+    bool steal(int self, int priority, Work& work) {
+        size_t count = workers.size();
+        size_t start = (self >= 0) ? static_cast<size_t>(self) + 1 : 0;
+        for (size_t i = 0; i < count; ++i) {
+            size_t victim = (start + i) % count;
+            if (static_cast<int>(victim) == self) continue;
+            Worker& worker = *workers[victim];
+            lock_guard<mutex> guard(worker.lock);
+            deque<Work>& queue = worker.queues[priority];
+            if (queue.empty()) continue;
+            work = std::move(queue.front());
+            queue.pop_front();
+            stolen.fetch_add(1, memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    bool takeWork(int self, Work& work) {
+        if (queued.load() == 0) return false;
+        for (int priority = 0; priority < PriorityCount; ++priority) {
+            if ((self >= 0 && popOwn(self, priority, work)) || popShared(priority, work) || steal(self, priority, work)) {
+                queued.fetch_sub(1);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void execute(Work& work) {
+        try {
+            work();
+        } catch (const exception& e) {
+            cerr << "Error: Task failed: " << e.what() << endl;
+        } catch (...) {
+            cerr << "Error: Task failed." << endl;
+        }
+        executed.fetch_add(1, memory_order_relaxed);
+    }
+
+    void workerLoop(int self) {
+        currentWorker() = self;
+        Work work;
+        while (true) {
+            if (takeWork(self, work)) {
+                execute(work);
+                work = nullptr;
+                continue;
+            }
+            unique_lock<mutex> guard(sharedLock);
+            sleepers.fetch_add(1);
+            wake.wait(guard, [this]() { return stopping || queued.load() > 0; });
+            sleepers.fetch_sub(1);
+            if (stopping && queued.load() == 0) return;
+        }
+    }
+
+public:
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    static TaskScheduler& getInstance() {
+        static TaskScheduler instance;
+        return instance;
+    }
+
+    // Queues work without a result. After shutdown() it runs on the calling thread.
+    void post(Work work, TaskPriority priority = TaskPriority::Interactive) {
+        int p = static_cast<int>(priority);
+        int self = currentWorker();
+        if (self >= 0 && self < static_cast<int>(workers.size())) {
+            Worker& worker = *workers[static_cast<size_t>(self)];
+            lock_guard<mutex> guard(worker.lock);
+            worker.queues[p].push_back(std::move(work));
+        } else {
+            unique_lock<mutex> guard(sharedLock);
+            if (stopping) {
+                guard.unlock();
+                execute(work);
+                return;
+            }
+            sharedQueues[p].push_back(std::move(work));
+        }
+        queued.fetch_add(1);
+        wakeOne();
+    }
+
+    // Starts work() as a task; its result arrives through the returned future.
+    template <typename F>
+    TaskFuture<decltype(declval<F&>()())> run(F work, TaskPriority priority = TaskPriority::Interactive) {
+        typedef decltype(declval<F&>()()) Result;
+        shared_ptr<TaskState<Result> > state = make_shared<TaskState<Result> >();
+        post([state, work]() mutable { state->run(work); }, priority);
+        return TaskFuture<Result>(state);
+    }
+
+    // Runs one queued task on the calling thread, if there is one.
+    bool runPending() {
+        Work work;
+        if (!takeWork(currentWorker(), work)) return false;
+        execute(work);
+        return true;
+    }
+
+    void setDispatcher(Dispatcher runner) {
+        lock_guard<mutex> guard(dispatcherLock);
+        dispatcher = runner;
+    }
+
+    void dispatch(Work work) {
+        Dispatcher runner;
+        {
+            lock_guard<mutex> guard(dispatcherLock);
+            runner = dispatcher;
+        }
+        if (runner) runner(std::move(work));
+        else work();
+    }
+
+    // Finishes the queued work, then stops the workers. Called at exit.
+    void shutdown() {
+        {
+            lock_guard<mutex> guard(sharedLock);
+            if (stopping) return;
+            stopping = true;
+        }
+        wake.notify_all();
+        for (size_t i = 0; i < threads.size(); ++i) {
+            if (threads[i].joinable()) threads[i].join();
+        }
+        setDispatcher(Dispatcher());
+    }
+
+    int threadCount() const { return static_cast<int>(workers.size()); }
+
+    Stats stats() const {
+        Stats result;
+        result.threads = threadCount();
+        result.executed = executed.load(memory_order_relaxed);
+        result.stolen = stolen.load(memory_order_relaxed);
+        result.queued = queued.load();
+        return result;
+    }
+};
+
+template <typename T>
+T TaskFuture<T>::get() const {
+    TaskScheduler& scheduler = TaskScheduler::getInstance();
+    while (!isReady()) {
+        if (scheduler.runPending()) continue;
+        unique_lock<mutex> guard(state->lock);
+        state->done.wait_for(guard, chrono::milliseconds(1), [this]() { return state->ready; });
+    }
+    lock_guard<mutex> guard(state->lock);
+    if (state->error) rethrow_exception(state->error);
+    return state->value;
+}
+
+template <typename T>
+template <typename F>
+TaskFuture<decltype(declval<F&>()(declval<const T&>()))> TaskFuture<T>::then(F next, TaskPriority priority) const {
+    typedef decltype(declval<F&>()(declval<const T&>())) Result;
+    shared_ptr<TaskState<T> > parent = state;
+    shared_ptr<TaskState<Result> > child = make_shared<TaskState<Result> >();
+    parent->whenDone([parent, child, next, priority]() {
+        TaskScheduler::getInstance().post([parent, child, next]() mutable {
+            if (parent->error) {
+                child->finish(nullptr, parent->error);
+                return;
+            }
+            auto step = [&]() { return next(parent->value); };
+            child->run(step);
+        }, priority);
+    });
+    return TaskFuture<Result>(child);
+}
+
+template <typename T>
+template <typename F>
+void TaskFuture<T>::deliver(F onResult) const {
+    shared_ptr<TaskState<T> > shared = state;
+    shared->whenDone([shared, onResult]() {
+        if (shared->error) {
+            try {
+                rethrow_exception(shared->error);
+            } catch (const exception& e) {
+                cerr << "Error: Task failed: " << e.what() << endl;
+            } catch (...) {
+                cerr << "Error: Task failed." << endl;
+            }
+            return;
+        }
+        TaskScheduler::getInstance().dispatch([shared, onResult]() mutable { onResult(shared->value); });
+    });
+}
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+using namespace std;
+
+// Lightweight tracing of scoped spans.
+//
+//   TRACE_SCOPE("product", "Product::getProductByID");
+//
+// records the enclosing scope as one complete event. Each thread appends to its own
+// fixed-size ring buffer (the oldest events are overwritten), so recording never
+// allocates after a thread's first span. While tracing is off a span costs one relaxed
+// atomic load. exportChromeJson() writes the Chrome trace-event format, which opens in
+// Perfetto (ui.perfetto.dev) or chrome://tracing.
+//
+// Tracing starts on from the environment: ECOM_TRACE=1 records to trace.json,
+// ECOM_TRACE=<path> to that file; the file is written at exit. The admin menu can also
+// switch it on and save a trace. Independently of recording, spans can keep a per-thread
+// list of the spans currently open, which the stall watchdog reads to attribute stalls.
+class Trace {
+public:
+    static constexpr size_t RingCapacity = 1 << 16; // Events kept per thread
+
+    enum Mode : unsigned { Recording = 1, TrackingOpenSpans = 2 };
+    static constexpr int MaxOpenDepth = 32;
+
+    // Names of the spans currently open on one thread, outermost first. Written only by
+    // its own thread; another thread (the stall watchdog) may read it at any time.
+    struct OpenSpans {
+        atomic<int> depth;
+        atomic<const char*> names[MaxOpenDepth];
+    };
+
+    struct Event {
+        const char* category;  // String literals only; stored by pointer
+        const char* name;
+        long long startNs;
+        long long durationNs;
+    };
+
+private:
+    struct ThreadBuffer {
+        mutex lock;            // Uncontended except while exporting
+        vector<Event> events;
+        size_t next;
+        bool wrapped;
+        int threadID;
+
+        explicit ThreadBuffer(int id) : events(RingCapacity), next(0), wrapped(false), threadID(id) {}
+    };
+
+    mutex registryLock;
+    vector<shared_ptr<ThreadBuffer>> buffers; // Outlive their threads so their events still export
+    atomic<unsigned> mode; // Mode bits; one relaxed load decides what a span does
+    atomic<int> nextThreadID;
+    chrono::steady_clock::time_point epoch;
+    string exitPath;
+
+    Trace() : mode(0), nextThreadID(1), epoch(chrono::steady_clock::now()) {}
+
+    void setMode(unsigned bit, bool on) {
+        if (on) mode.fetch_or(bit, memory_order_relaxed);
+        else mode.fetch_and(~bit, memory_order_relaxed);
+    }
+
+    ThreadBuffer& threadBuffer() {
+        thread_local ThreadBuffer* buffer = nullptr;
+        if (!buffer) {
+            shared_ptr<ThreadBuffer> created = make_shared<ThreadBuffer>(nextThreadID.fetch_add(1));
+            lock_guard<mutex> guard(registryLock);
+            buffers.push_back(created);
+            buffer = created.get();
+        }
+        return *buffer;
+    }
+
+    static void writeAtExit() {
+        Trace& trace = getInstance();
+        if (!trace.exitPath.empty() && trace.exportChromeJson(trace.exitPath)) {
+            cerr << "Trace written to " << trace.exitPath << endl;
+        }
+    }
+
+    static void writeJsonString(ostream& out, const char* text) {
+        out << '"';
+        for (const char* c = text; c && *c; ++c) {
+            if (*c == '"' || *c == '\\') out << '\\';
+            out << *c;
+        }
+        out << '"';
+    }
+
+public:
+    static Trace& getInstance() {
+        static Trace instance;
+        return instance;
+    }
+
+    static unsigned currentMode() { return getInstance().mode.load(memory_order_relaxed); }
+    static bool isEnabled() { return (currentMode() & Recording) != 0; }
+
+    void setEnabled(bool on) { setMode(Recording, on); }
+
+    // Keeps each thread's OpenSpans up to date, independently of recording.
+    void setTrackingOpenSpans(bool on) { setMode(TrackingOpenSpans, on); }
+
+    // Thread-local storage is zero-initialised, so a fresh thread starts at depth 0.
+    static OpenSpans& openSpans() {
+        thread_local OpenSpans spans;
+        return spans;
+    }
+
+    // Reads ECOM_TRACE once at startup.
+    void enableFromEnvironment() {
+        const char* setting = getenv("ECOM_TRACE");
+        if (!setting || !*setting || strcmp(setting, "0") == 0) return;
+        exitPath = (strcmp(setting, "1") == 0) ? "trace.json" : setting;
+        setEnabled(true);
+        atexit(writeAtExit);
+    }
+
+    long long nowNs() const {
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - epoch).count();
+    }
+
+    void record(const char* category, const char* name, long long startNs, long long durationNs) {
+        ThreadBuffer& buffer = threadBuffer();
+        lock_guard<mutex> guard(buffer.lock);
+        Event& event = buffer.events[buffer.next];
+        event.category = category;
+        event.name = name;
+        event.startNs = startNs;
+        event.durationNs = durationNs;
+        if (++buffer.next == RingCapacity) {
+            buffer.next = 0;
+            buffer.wrapped = true;
+        }
+    }
+
+    // Drops every recorded event; the buffers themselves are kept.
+    void clear() {
+        lock_guard<mutex> guard(registryLock);
+        for (size_t i = 0; i < buffers.size(); ++i) {
+            lock_guard<mutex> bufferGuard(buffers[i]->lock);
+            buffers[i]->next = 0;
+            buffers[i]->wrapped = false;
+        }
+    }
+
+    bool exportChromeJson(const string& path) {
+        ofstream out(path, ios::trunc);
+        if (!out) {
+            cerr << "Error: Could not open " << path << " for writing the trace." << endl;
+            return false;
+        }
+        int pid = static_cast<int>(getpid());
+        out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+        bool first = true;
+        lock_guard<mutex> guard(registryLock);
+        for (size_t b = 0; b < buffers.size(); ++b) {
+            ThreadBuffer& buffer = *buffers[b];
+            lock_guard<mutex> bufferGuard(buffer.lock);
+            size_t count = buffer.wrapped ? RingCapacity : buffer.next;
+            size_t start = buffer.wrapped ? buffer.next : 0;
+            for (size_t i = 0; i < count; ++i) {
+                const Event& event = buffer.events[(start + i) % RingCapacity];
+                out << (first ? "\n" : ",\n") << "{\"name\":";
+                writeJsonString(out, event.name);
+                out << ",\"cat\":";
+                writeJsonString(out, event.category);
+                // Trace-event times are microseconds; keep the nanoseconds as decimals
+                out << ",\"ph\":\"X\",\"ts\":" << event.startNs / 1000 << "." << (event.startNs % 1000) / 100
+                    << ((event.startNs % 100) / 10) << (event.startNs % 10) << ",\"dur\":" << event.durationNs / 1000
+                    << "." << (event.durationNs % 1000) / 100 << ((event.durationNs % 100) / 10)
+                    << (event.durationNs % 10) << ",\"pid\":" << pid << ",\"tid\":" << buffer.threadID << "}";
+                first = false;
+            }
+        }
+        out << "\n]}\n";
+        return static_cast<bool>(out);
+    }
+};
+
+// Records the enclosing scope as one span when tracing is on.
+class TraceSpan {
+private:
+    const char* category;
+    const char* name;
+    long long startNs;
+    bool tracked;
+
+public:
+    TraceSpan(const char* spanCategory, const char* spanName)
+        : category(spanCategory), name(spanName), startNs(-1), tracked(false) {
+        unsigned mode = Trace::currentMode();
+        if (mode == 0) return;
+        if (mode & Trace::TrackingOpenSpans) {
+            Trace::OpenSpans& open = Trace::openSpans();
+            int depth = open.depth.load(memory_order_relaxed);
+            if (depth < Trace::MaxOpenDepth) open.names[depth].store(name, memory_order_relaxed);
+            open.depth.store(depth + 1, memory_order_release);
+            tracked = true;
+        }
+        if (mode & Trace::Recording) startNs = Trace::getInstance().nowNs();
+    }
+
+    ~TraceSpan() {
+        if (tracked) {
+            Trace::OpenSpans& open = Trace::openSpans();
+            open.depth.store(open.depth.load(memory_order_relaxed) - 1, memory_order_release);
+        }
+        if (startNs < 0) return;
+        Trace& trace = Trace::getInstance();
+        trace.record(category, name, startNs, trace.nowNs() - startNs);
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(category, name) TraceSpan TRACE_CONCAT(traceSpan_, __LINE__)(category, name)
@@ -8,6 +8,9 @@
 #include <limits>
 #include <iomanip>
 
+#include "IoStats.h"
+#include "Trace.h"
+
 using namespace std;
 
 class User {
@@ -29,7 +32,8 @@ private:
     }
     
     int getNextUserID() {
-        ifstream inFile("data/users.txt");
+        TRACE_SCOPE("user", "User::getNextUserID");
+        TrackedIfstream inFile(IoStats::Users, "data/users.txt");
         string line;
         int maxID = 0;
         if (!inFile) {
@@ -69,6 +73,8 @@ private:
         return (maxID == 0) ? 1 : maxID + 1; 
     }
 
+public:
+    // Stored password form; also used by tools that write users.txt directly.
     static char substituteChar(char c) {
         if (c >= 'a' && c <= 'z') {
             return 'a' + (c - 'a' + 3) % 26;
@@ -92,8 +98,11 @@ private:
         return hashedPassword;
     }
 
+private:
+
     static bool usernameExists(const char* usernameToCheck) {
-        ifstream inFile("data/users.txt");
+        TRACE_SCOPE("user", "User::usernameExists");
+        TrackedIfstream inFile(IoStats::Users, "data/users.txt");
         string line;
         while (getline(inFile, line)) {
             if (line.empty()) continue;
@@ -164,12 +173,18 @@ public:
         cout << "Enter Password: ";
         cin >> pwd_str;
         cin.ignore(numeric_limits<streamsize>::max(), '\n'); 
+        return registerUser(uname_str, email_str, pwd_str);
+    }
+
+    // Non-interactive registration, for callers that already have the details.
+    bool registerUser(const string& uname_str, const string& email_str, const string& pwd_str) {
+        TRACE_SCOPE("user", "User::registerUser");
         char* hashedPwd = hashPassword(pwd_str.c_str());
         if (!hashedPwd) {
              cerr << "Error: Password processing failed." << endl;
              return false;
         }
-        ifstream inFile("data/users.txt");
+        TrackedIfstream inFile(IoStats::Users, "data/users.txt");
         string line;
         bool exists = false;
         while (getline(inFile, line)) {
@@ -194,7 +209,7 @@ public:
         allocateAndCopy(this->password, hashedPwd);
         allocateAndCopy(this->email, email_str.c_str());
         this->isAdmin = false;
-        ofstream outFile("data/users.txt", ios::app);
+        TrackedOfstream outFile(IoStats::Users, "data/users.txt", ios::app);
         if (!outFile) {
             cerr << "Error: Could not open users.txt for writing." << endl;
             delete[] this->username; this->username = nullptr;
@@ -224,12 +239,18 @@ public:
         cout << "Enter Password: ";
         cin >> pwd_str;
         cin.ignore(numeric_limits<streamsize>::max(), '\n'); 
+        return loginUser(uname_str, pwd_str);
+    }
+
+    // Non-interactive login, for callers that already have the credentials.
+    bool loginUser(const string& uname_str, const string& pwd_str) {
+        TRACE_SCOPE("user", "User::loginUser");
         char* inputHashed = hashPassword(pwd_str.c_str());
         if (!inputHashed) {
             cerr << "Error processing login password." << endl;
             return false;
         }
-        ifstream inFile("data/users.txt");
+        TrackedIfstream inFile(IoStats::Users, "data/users.txt");
         if (!inFile) {
             cerr << "Error: Could not open users.txt for reading." << endl;
             delete[] inputHashed;
@@ -306,7 +327,8 @@ public:
     }
 
     static void viewAllUsers() {
-        ifstream inFile("data/users.txt");
+        TRACE_SCOPE("user", "User::viewAllUsers");
+        TrackedIfstream inFile(IoStats::Users, "data/users.txt");
         if (!inFile) {
             cerr << "Error: Could not open users.txt for viewing." << endl;
             return;
@@ -345,6 +367,7 @@ public:
     }
 
     static bool editUser() {
+        TRACE_SCOPE("user", "User::editUser");
          cout << "\n--- Edit User ---" << endl;
          int userIDToEdit;
          cout << "Enter the User ID to edit (or 0 to cancel): ";
@@ -362,8 +385,8 @@ public:
               cout << "Error: Cannot edit the primary admin account (User ID 1)." << endl;
               return false;
          }
-        ifstream inFile("data/users.txt");
-        ofstream tempFile("data/temp_users.txt"); 
+        TrackedIfstream inFile(IoStats::Users, "data/users.txt");
+        TrackedOfstream tempFile(IoStats::Users, "data/temp_users.txt"); 
         if (!inFile || !tempFile) {
             cerr << "Error: Could not open user files for editing." << endl;
             inFile.close(); tempFile.close(); remove("data/temp_users.txt");
@@ -432,6 +455,7 @@ public:
             cerr << "Error: Failed to update users.txt." << endl;
             return false;
         }
+        IoStats::add(IoStats::Users, IoStats::TempRewrites);
         return true;
     }
 
@@ -449,6 +473,12 @@ public:
              cout << "Remove operation cancelled." << endl;
              return true;
          }
+         return removeUser(currentAdminUserID, userIDToRemove);
+    }
+
+    // Non-interactive removal of one user by an admin.
+    static bool removeUser(int currentAdminUserID, int userIDToRemove) {
+        TRACE_SCOPE("user", "User::removeUser");
          if (userIDToRemove == currentAdminUserID) {
              cout << "Error: You cannot remove your own admin account." << endl;
              return false;
@@ -457,8 +487,8 @@ public:
               cout << "Error: Cannot remove the primary admin account (User ID 1)." << endl;
               return false;
          }
-        ifstream inFile("data/users.txt");
-        ofstream tempFile("data/temp_users.txt");
+        TrackedIfstream inFile(IoStats::Users, "data/users.txt");
+        TrackedOfstream tempFile(IoStats::Users, "data/temp_users.txt");
         if (!inFile || !tempFile) {
             cerr << "Error: Could not open user files for removal." << endl;
             inFile.close(); tempFile.close(); remove("data/temp_users.txt");
@@ -500,13 +530,15 @@ public:
             cerr << "Error: Failed to update users.txt." << endl;
             return false;
         }
+        IoStats::add(IoStats::Users, IoStats::TempRewrites);
         cout << "User '" << removedUsername << "' (ID: " << userIDToRemove << ") removed successfully." << endl;
         return true;
     }
 
     static int getUserIdByUsername(const char* username) {
+        TRACE_SCOPE("user", "User::getUserIdByUsername");
         if (!username) return -1;
-        ifstream inFile("data/users.txt");
+        TrackedIfstream inFile(IoStats::Users, "data/users.txt");
         if (!inFile) {
             cerr << "Error: Could not open users.txt to get user ID." << endl;
             return -1;
@@ -529,8 +561,9 @@ public:
     }
     
     static bool getUserEmailById(int userId, std::string& email) {
+        TRACE_SCOPE("user", "User::getUserEmailById");
         if (userId <= 0) return false;
-        ifstream inFile("data/users.txt");
+        TrackedIfstream inFile(IoStats::Users, "data/users.txt");
         if (!inFile) {
             cerr << "Error: Could not open users.txt to get user email." << endl;
             return false;
@@ -556,8 +589,9 @@ public:
     }
 
     static User* getUserByID(int userId) {
+        TRACE_SCOPE("user", "User::getUserByID");
         if (userId <= 0) return nullptr;
-        ifstream inFile("data/users.txt");
+        TrackedIfstream inFile(IoStats::Users, "data/users.txt");
         if (!inFile) {
             cerr << "Error: Could not open users.txt to get user." << endl;
             return nullptr;
@@ -585,9 +619,10 @@ public:
     }
     
     static bool updateUserInFile(User& user) {
+        TRACE_SCOPE("user", "User::updateUserInFile");
         if (user.getUserID() <= 0) return false;
-        ifstream inFile("data/users.txt");
-        ofstream tempFile("data/temp_users.txt");
+        TrackedIfstream inFile(IoStats::Users, "data/users.txt");
+        TrackedOfstream tempFile(IoStats::Users, "data/temp_users.txt");
         if (!inFile || !tempFile) {
             cerr << "Error: Could not open user files for updating." << endl;
             inFile.close(); tempFile.close(); remove("data/temp_users.txt");
@@ -638,6 +673,7 @@ public:
             cerr << "Error: Failed to update users.txt." << endl;
             return false;
         }
+        IoStats::add(IoStats::Users, IoStats::TempRewrites);
         return true;
     }
     
@@ -16,6 +16,8 @@
 #include <QString>
 
 #include "../../include/User.h"
+#include "../../include/IoStats.h"
+#include "../../include/Trace.h"
 
 // Simple data structure for the GUI
 // This is only for the GUI and doesn't affect the backend
@@ -117,11 +119,12 @@ inline void UserManagementWidget::setupUi() {
 }
 
 inline void UserManagementWidget::loadUsers() {
+    TRACE_SCOPE("ui", "UserManagementWidget::loadUsers");
     usersTable->setRowCount(0);
     displayedUserDetails.clear();
 
     // Read users directly from the file
-    std::ifstream inFile("data/users.txt");
+    TrackedIfstream inFile(IoStats::Users, "data/users.txt");
     if (!inFile.is_open()) {
         QMessageBox::warning(this, "User Management", "No users found or could not open users file.");
         return;
@@ -254,7 +257,8 @@ inline void UserManagementWidget::handleRemoveUser() {
                                   QMessageBox::Yes | QMessageBox::No);
 
     if (reply == QMessageBox::Yes) {
-        if (User::removeUser(userId)) {
+        // No session admin ID reaches this widget; removeUser still refuses user 1, the primary admin
+        if (User::removeUser(0, userId)) {
             QMessageBox::information(this, "Remove User", QString("User '%1' removed successfully.").arg(username));
             loadUsers(); // Refresh the table
             emit userRemoved(userId);
@@ -2,6 +2,8 @@
 #include <fstream>
 #include <sstream>
 #include "../../include/User.h"
+#include "../../include/IoStats.h"
+#include "../../include/Trace.h"
 
 UserProfileWidget::UserProfileWidget(int userId, const QString& username, QWidget *parent)
     : QWidget(parent), userId(userId), username(username)
@@ -74,6 +76,7 @@ void UserProfileWidget::setupUI()
 
 void UserProfileWidget::loadUserData()
 {
+    TRACE_SCOPE("ui", "UserProfileWidget::loadUserData");
     // Get user email for display
     std::string userEmail;
     bool emailFound = User::getUserEmailById(userId, userEmail);
@@ -90,8 +93,8 @@ void UserProfileWidget::handleUpdateEmail()
     }
     
     // Update the email in the users.txt file
-    std::ifstream inFile("data/users.txt");
-    std::ofstream tempFile("data/temp_users.txt");
+    TrackedIfstream inFile(IoStats::Users, "data/users.txt");
+    TrackedOfstream tempFile(IoStats::Users, "data/temp_users.txt");
     
     if (!inFile.is_open() || !tempFile.is_open()) {
         QMessageBox::warning(this, "Error", "Failed to open user files for update.");
@@ -152,6 +155,7 @@ void UserProfileWidget::handleUpdateEmail()
             std::remove("data/temp_users.txt"); // Clean up if rename fails
             return;
         }
+        IoStats::add(IoStats::Users, IoStats::TempRewrites);
         
         email = newEmail;
         emailLabel->setText(email);
@@ -180,7 +184,7 @@ void UserProfileWidget::handleUpdatePassword()
     }
     
     // First, verify current password
-    std::ifstream checkFile("data/users.txt");
+    TrackedIfstream checkFile(IoStats::Users, "data/users.txt");
     if (!checkFile.is_open()) {
         QMessageBox::warning(this, "Error", "Failed to open user file to verify password.");
         return;
@@ -259,8 +263,8 @@ void UserProfileWidget::handleUpdatePassword()
     }
     
     // Now update the password
-    std::ifstream inFile("data/users.txt");
-    std::ofstream tempFile("data/temp_users.txt");
+    TrackedIfstream inFile(IoStats::Users, "data/users.txt");
+    TrackedOfstream tempFile(IoStats::Users, "data/temp_users.txt");
     
     if (!inFile.is_open() || !tempFile.is_open()) {
         QMessageBox::warning(this, "Error", "Failed to open user files for update.");
@@ -319,6 +323,7 @@ void UserProfileWidget::handleUpdatePassword()
             std::remove("data/temp_users.txt"); // Clean up if rename fails
             return;
         }
+        IoStats::add(IoStats::Users, IoStats::TempRewrites);
         
         currentPasswordEdit->clear();
         newPasswordEdit->clear();
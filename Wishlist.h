@@ -10,6 +10,8 @@
 
 #include "Product.h"
 #include "ShoppingCart.h"
+#include "IoStats.h"
+#include "Trace.h"
 
 using namespace std;
 
@@ -46,7 +48,7 @@ public:
              return;
         }
         generateWishlistFilename(userID);
-        ofstream outFile(wishlistFilename, ios::app);
+        TrackedOfstream outFile(IoStats::Wishlists, wishlistFilename, ios::app);
         if (!outFile) {
             cerr << "Error: Could not create or open wishlist file: " << wishlistFilename << endl;
         }
@@ -70,6 +72,7 @@ public:
     }
 
     bool addToWishlist(int productID) {
+        TRACE_SCOPE("wishlist", "Wishlist::addToWishlist");
          if (!wishlistFilename) {
              cerr << "Error: Wishlist is not associated with a user." << endl;
              return false;
@@ -80,7 +83,7 @@ public:
             return false;
         }
         delete product;
-        ifstream checkFile(wishlistFilename);
+        TrackedIfstream checkFile(IoStats::Wishlists, wishlistFilename);
         bool alreadyExists = false;
         if (checkFile) {
             string line;
@@ -101,7 +104,7 @@ public:
             cout << "Product ID " << productID << " is already in your wishlist." << endl;
             return true;
         }
-        ofstream outFile(wishlistFilename, ios::app);
+        TrackedOfstream outFile(IoStats::Wishlists, wishlistFilename, ios::app);
         if (!outFile) {
             cerr << "Error: Could not open wishlist file for writing: " << wishlistFilename << endl;
             return false;
@@ -113,13 +116,14 @@ public:
     }
 
     bool removeFromWishlist(int productID) {
+        TRACE_SCOPE("wishlist", "Wishlist::removeFromWishlist");
         if (!wishlistFilename) {
              cerr << "Error: Wishlist is not associated with a user." << endl;
              return false;
          }
-        ifstream inFile(wishlistFilename);
+        TrackedIfstream inFile(IoStats::Wishlists, wishlistFilename);
         string tempFilename = string(wishlistFilename) + ".tmp";
-        ofstream tempFile(tempFilename);
+        TrackedOfstream tempFile(IoStats::Wishlists, tempFilename);
         if (!inFile || !tempFile) {
             cerr << "Error: Could not open wishlist files for removal." << endl;
              inFile.close(); tempFile.close(); remove(tempFilename.c_str());
@@ -153,15 +157,17 @@ public:
             cerr << "Error: Failed to update wishlist file." << endl;
             return false;
         }
+        IoStats::add(IoStats::Wishlists, IoStats::TempRewrites);
         return true;
     }
 
     void viewWishlist() {
+        TRACE_SCOPE("wishlist", "Wishlist::viewWishlist");
          if (!wishlistFilename) {
              cerr << "Error: Wishlist is not associated with a user." << endl;
              return;
          }
-        ifstream inFile(wishlistFilename);
+        TrackedIfstream inFile(IoStats::Wishlists, wishlistFilename);
         if (!inFile) {
             cerr << "Error: Could not open wishlist file: " << wishlistFilename << endl;
             return;
@@ -206,10 +212,11 @@ public:
     }
     
     bool isEmpty() {
+        TRACE_SCOPE("wishlist", "Wishlist::isEmpty");
          if (!wishlistFilename) {
              return true;
          }
-         ifstream inFile(wishlistFilename);
+         TrackedIfstream inFile(IoStats::Wishlists, wishlistFilename);
          if (!inFile) {
              return true;
          }
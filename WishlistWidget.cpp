@@ -1,6 +1,10 @@
 #include "../include/WishlistWidget.h"
 #include <QFileInfo>
 #include <QDir>
+#include "../../include/IoStats.h"
+#include "../../include/Trace.h"
+#include "../../include/SessionRecorder.h"
+#include "../../include/AsyncStorage.h"
 
 WishlistWidget::WishlistWidget(int userId, QWidget *parent)
     : QWidget(parent), userId(userId)
@@ -60,86 +64,50 @@ void WishlistWidget::setupUI()
     setLayout(mainLayout);
 }
 
-void WishlistWidget::loadWishlistItems()
+AsyncAction WishlistWidget::loadWishlistItems()
 {
+    // The list and its products are read on the task pool; the buttons stay off until
+    // they are in, and a reload supersedes a read still under way
+    removeButton->setEnabled(false);
+    moveToCartButton->setEnabled(false);
+    std::vector<std::shared_ptr<Product>> products =
+        co_await withCancellation(AsyncStorage::getWishlist(userId), wishlistLoads.restart());
+    TRACE_SCOPE("ui", "WishlistWidget::loadWishlistItems");
+
     // Clear existing table
+    wishlistTableWidget->clearSpans();
     wishlistTableWidget->setRowCount(0);
     
-    // Create wishlist object using user ID
-    Wishlist wishlist(userId);
-    
-    // Create the file path for the wishlist
-    std::string wishlistFilePath = "data/wishlist/wishlist_" + std::to_string(userId) + ".txt";
-    QFileInfo wishlistFile(QString::fromStdString(wishlistFilePath));
-    
-    // Check if wishlist file exists
-    if (!wishlistFile.exists() || wishlistFile.size() == 0) {
+    if (products.empty()) {
         // Show empty message in table
         wishlistTableWidget->setRowCount(1);
         QTableWidgetItem *emptyItem = new QTableWidgetItem("Your wishlist is empty");
         emptyItem->setTextAlignment(Qt::AlignCenter);
         wishlistTableWidget->setSpan(0, 0, 1, 3);
         wishlistTableWidget->setItem(0, 0, emptyItem);
-        
-        // Disable buttons
-        removeButton->setEnabled(false);
-        moveToCartButton->setEnabled(false);
-        
-        return;
-    }
-    
-    // Read wishlist data from file
-    std::ifstream wishlistFileStream(wishlistFilePath);
-    if (!wishlistFileStream.is_open()) {
-        QMessageBox::warning(this, "Error", "Failed to open wishlist file.");
-        return;
+        co_return;
     }
     
-    std::string line;
     int row = 0;
-    
-    while (std::getline(wishlistFileStream, line)) {
-        if (line.empty()) continue;
+    for (const std::shared_ptr<Product> &product : products) {
+        // Add a new row
+        wishlistTableWidget->insertRow(row);
         
-        // Parse product ID
-        int productId = 0;
-        try {
-            productId = std::stoi(line);
-        } catch (...) {
-            continue; // Skip invalid entries
-        }
+        // Create name item with hidden product ID
+        QTableWidgetItem *nameItem = new QTableWidgetItem(product->getName() ? QString(product->getName()) : "Unknown Product");
+        nameItem->setData(Qt::UserRole, product->getProductID()); // Store product ID for later use
         
-        if (productId <= 0) {
-            continue; // Skip invalid entries
-        }
+        // Create category and price items
+        QTableWidgetItem *categoryItem = new QTableWidgetItem(product->getCategory() ? QString(product->getCategory()) : "");
+        QTableWidgetItem *priceItem = new QTableWidgetItem(QString::asprintf("$%.2f", product->getPrice()));
         
-        // Get product details using the Product class
-        Product* product = Product::getProductByID(productId);
-        if (product) {
-            // Add a new row
-            wishlistTableWidget->insertRow(row);
-            
-            // Create name item with hidden product ID
-            QTableWidgetItem *nameItem = new QTableWidgetItem(product->getName() ? QString(product->getName()) : "Unknown Product");
-            nameItem->setData(Qt::UserRole, productId); // Store product ID for later use
-            
-            // Create category and price items
-            QTableWidgetItem *categoryItem = new QTableWidgetItem(product->getCategory() ? QString(product->getCategory()) : "");
-            QTableWidgetItem *priceItem = new QTableWidgetItem(QString::asprintf("$%.2f", product->getPrice()));
-            
-            // Add items to the row
-            wishlistTableWidget->setItem(row, 0, nameItem);
-            wishlistTableWidget->setItem(row, 1, categoryItem);
-            wishlistTableWidget->setItem(row, 2, priceItem);
-            
-            // Clean up
-            delete product;
-            row++;
-        }
+        // Add items to the row
+        wishlistTableWidget->setItem(row, 0, nameItem);
+        wishlistTableWidget->setItem(row, 1, categoryItem);
+        wishlistTableWidget->setItem(row, 2, priceItem);
+        row++;
     }
     
-    wishlistFileStream.close();
-    
     // Enable/disable buttons based on content
     bool hasItems = (wishlistTableWidget->rowCount() > 0);
     removeButton->setEnabled(hasItems);
@@ -167,6 +135,7 @@ void WishlistWidget::handleRemoveFromWishlist()
     int productId = item->data(Qt::UserRole).toInt();
     
     // Use the backend Wishlist class to remove the item
+    SessionRecorder::getInstance().record("wishlist-remove", std::to_string(productId));
     Wishlist wishlist(userId);
     if (wishlist.removeFromWishlist(productId)) {
         QMessageBox::information(this, "Remove Item", "Item removed from wishlist.");
@@ -191,6 +160,7 @@ void WishlistWidget::handleMoveToCart()
     int productId = item->data(Qt::UserRole).toInt();
     
     // Add to cart
+    SessionRecorder::getInstance().record("wishlist-move", std::to_string(productId));
     ShoppingCart cart(userId);
     if (cart.addToCart(productId, 1)) {
         // If successful, remove from wishlist
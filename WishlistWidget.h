@@ -12,6 +12,7 @@
 #include "../../include/Wishlist.h"
 #include "../../include/Product.h"
 #include "../../include/ShoppingCart.h"
+#include "../../include/Async.h"
 
 class WishlistWidget : public QWidget
 {
@@ -33,13 +34,14 @@ private slots:
 
 private:
     void setupUI();
-    void loadWishlistItems();
+    AsyncAction loadWishlistItems();
     
     QTableWidget *wishlistTableWidget;
     QPushButton *removeButton;
     QPushButton *moveToCartButton;
     
     int userId;
+    CancellationSource wishlistLoads;   // The latest load; cancelled by the next one
 };
 
 #endif // WISHLISTWIDGET_H 
\ No newline at end of file
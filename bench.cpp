@@ -0,0 +1,531 @@
+// Backend benchmark suite. Times the storage hot paths on generated data sets:
+//
+//   ./bench --scales small,medium --reps 30 --json bench_results.json
+//
+// Each scale gets its own data set under --data-root (generated on first use, see
+// DataGenerator.h). Benchmarks that write (placeOrder, updateStatus, addReview) change
+// that data set; pass --regenerate to start from a fresh copy.
+//
+// Regression gate (--regenerate on both runs so they see the same data):
+//   ./bench --regenerate --save-baseline bench_baseline.txt          (reference build)
+//   ./bench --regenerate --compare bench_baseline.txt --threshold 10 (exits 1 on regressions)
+//
+// Stock counter contention (no data set; one product sold from many threads at once):
+//   ./bench --contention 1,2,4,8,16,32 --contention-seconds 2
+#include "include/Benchmark.h"
+#include "include/DataGenerator.h"
+#include "include/Product.h"
+#include "include/ProductCatalog.h"
+#include "include/User.h"
+#include "include/ShoppingCart.h"
+#include "include/Order.h"
+#include "include/OrderStore.h"
+#include "include/Review.h"
+#include "include/ShardedStockCounter.h"
+#include "include/TaskScheduler.h"
+#include "include/ProductSearch.h"
+#include "include/ProductSuggestions.h"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <iomanip>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+// Count every heap allocation for the per-call "Allocs" column. The replacements are kept
+// out of line: inlined, GCC sees free() called on memory from operator new (and delete[]
+// on memory from operator new) at every delete site and warns (-Wmismatched-new-delete),
+// although each new/delete pair here matches.
+#define BENCH_ALLOCATOR __attribute__((noinline))
+BENCH_ALLOCATOR void* operator new(size_t size) {
+    AllocationTally::calls().fetch_add(1, memory_order_relaxed);
+    void* block = malloc(size ? size : 1);
+    if (!block) throw bad_alloc();
+    return block;
+}
+BENCH_ALLOCATOR void* operator new[](size_t size) { return operator new(size); }
+BENCH_ALLOCATOR void* operator new(size_t size, const nothrow_t&) noexcept {
+    AllocationTally::calls().fetch_add(1, memory_order_relaxed);
+    return malloc(size ? size : 1);
+}
+BENCH_ALLOCATOR void* operator new[](size_t size, const nothrow_t& tag) noexcept { return operator new(size, tag); }
+BENCH_ALLOCATOR void operator delete(void* block) noexcept { free(block); }
+BENCH_ALLOCATOR void operator delete[](void* block) noexcept { free(block); }
+BENCH_ALLOCATOR void operator delete(void* block, size_t) noexcept { operator delete(block); }
+BENCH_ALLOCATOR void operator delete[](void* block, size_t) noexcept { operator delete(block); }
+#undef BENCH_ALLOCATOR
+
+struct BenchConfig {
+    vector<string> scales;
+    string dataRoot;
+    string jsonPath;
+    string saveBaselinePath;
+    string comparePath;
+    double thresholdPercent;
+    double alpha;
+    unsigned long long seed;
+    bool regenerate;
+    vector<int> contentionThreads;
+    double contentionSeconds;
+    BenchmarkRunner::Options runner;
+
+    BenchConfig() : dataRoot("bench-data"), jsonPath("bench_results.json"), thresholdPercent(10.0), alpha(0.01),
+                    seed(42), regenerate(false), contentionSeconds(1.0) {
+        scales.push_back("small");
+        scales.push_back("medium");
+    }
+};
+
+static void printUsage(const char* program) {
+    cout << "Usage: " << program << " [options]\n"
+         << "  --scales LIST       Comma-separated datagen scales (default small,medium)\n"
+         << "  --reps N            Timed calls per benchmark (default 20)\n"
+         << "  --warmup N          Untimed calls first (default 3)\n"
+         << "  --max-seconds S     Time budget per benchmark (default 10)\n"
+         << "  --filter TEXT       Only benchmarks whose name contains TEXT\n"
+         << "  --json PATH         Results file (default bench_results.json)\n"
+         << "  --data-root DIR     Where per-scale data sets live (default bench-data)\n"
+         << "  --seed N            Data and workload seed (default 42)\n"
+         << "  --regenerate        Rebuild the data sets before running\n"
+         << "  --save-baseline PATH  Store this run as the baseline to compare against\n"
+         << "  --compare PATH      Compare with a stored baseline; exit 1 on regressions\n"
+         << "  --threshold PCT     Smallest slowdown or growth that counts (default 10)\n"
+         << "  --alpha P           Significance level for the timing test (default 0.01)\n"
+         << "  --contention LIST   Only time stock takes on one product from each thread count listed\n"
+         << "  --contention-seconds S  Time per contention run (default 1)\n";
+}
+
+static vector<string> splitList(const string& text) {
+    vector<string> parts;
+    stringstream ss(text);
+    string part;
+    while (getline(ss, part, ',')) {
+        if (!part.empty()) parts.push_back(part);
+    }
+    return parts;
+}
+
+static string absolutePath(const string& path, const string& base) {
+    return (!path.empty() && path[0] == '/') ? path : base + "/" + path;
+}
+
+static bool prepareDataSet(const GeneratorConfig& config, bool regenerate) {
+    if (DataGenerator::dataSetExists() && !regenerate) return true;
+    DataGenerator::removeDataSet();
+    DataGenerator generator(config);
+    return generator.generateAll();
+}
+
+static void writeCartFile(int userID, const vector<pair<int, int> >& lines) {
+    ofstream out("data/cart/cart_" + to_string(userID) + ".txt", ios::trunc);
+    for (size_t i = 0; i < lines.size(); ++i) {
+        out << lines[i].first << "," << lines[i].second << "\n";
+    }
+}
+
+// Highest user ID that has a review, so benchmark reviews never hit the duplicate check.
+static int maxReviewerID() {
+    ifstream in("data/reviews/reviews.txt");
+    string line;
+    int maxID = 0;
+    while (getline(in, line)) {
+        size_t comma = line.find(',');
+        if (comma == string::npos) continue;
+        maxID = max(maxID, atoi(line.c_str() + comma + 1));
+    }
+    return maxID;
+}
+
+// --- Stock counter contention ---
+
+// One unit per take, from every thread at once, for a fixed time; returns takes per second.
+template <typename TakeOne>
+static double timeTakes(int threads, double seconds, TakeOne takeOne) {
+    atomic<bool> go(false), stop(false);
+    vector<long long> takes(static_cast<size_t>(threads), 0);
+    vector<thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.push_back(thread([&, t]() {
+            while (!go.load(memory_order_acquire)) this_thread::yield();
+            long long local = 0;
+            while (!stop.load(memory_order_relaxed)) {
+                if (takeOne()) local++;
+            }
+            takes[static_cast<size_t>(t)] = local;
+        }));
+    }
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    go.store(true, memory_order_release);
+    this_thread::sleep_for(chrono::duration<double>(seconds));
+    stop.store(true, memory_order_relaxed);
+    for (size_t t = 0; t < workers.size(); ++t) workers[t].join();
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    long long total = 0;
+    for (size_t t = 0; t < takes.size(); ++t) total += takes[t];
+    return total / elapsed;
+}
+
+// Compares a mutex-guarded stock value, a single atomic and ShardedStockCounter, then
+// sells a small drop to the most threads and checks that exactly the stock was sold.
+static bool runContention(const vector<int>& threadCounts, double seconds) {
+    const long long plenty = 1000000000000LL;
+    cout << "Stock takes on one product, " << seconds << " s per run (" << thread::hardware_concurrency()
+         << " hardware threads)\n"
+         << right << setw(8) << "Threads" << setw(14) << "Mutex/s" << setw(14) << "Atomic/s" << setw(14) << "Sharded/s"
+         << setw(16) << "Sharded scaling" << "\n";
+    double shardedBase = 0.0;
+    for (size_t i = 0; i < threadCounts.size(); ++i) {
+        int threads = threadCounts[i];
+        mutex stockLock;
+        long long lockedStock = plenty;
+        double mutexRate = timeTakes(threads, seconds, [&]() {
+            lock_guard<mutex> guard(stockLock);
+            if (lockedStock <= 0) return false;
+            lockedStock--;
+            return true;
+        });
+        atomic<long long> atomicStock(plenty);
+        double atomicRate = timeTakes(threads, seconds, [&]() {
+            long long current = atomicStock.load(memory_order_relaxed);
+            while (current > 0) {
+                if (atomicStock.compare_exchange_weak(current, current - 1, memory_order_acq_rel)) return true;
+            }
+            return false;
+        });
+        ShardedStockCounter sharded(plenty);
+        double shardedRate = timeTakes(threads, seconds, [&]() { return sharded.tryTake(1); });
+        if (i == 0) shardedBase = shardedRate / threads;
+        cout << setw(8) << threads << fixed << setprecision(0) << setw(14) << mutexRate << setw(14) << atomicRate
+             << setw(14) << shardedRate << setprecision(2) << setw(15) << (shardedBase > 0 ? shardedRate / shardedBase : 0.0)
+             << "x\n";
+    }
+
+    // A drop that sells out: every unit goes exactly once
+    int threads = threadCounts.empty() ? 1 : threadCounts.back();
+    const long long dropUnits = 100000;
+    ShardedStockCounter drop(dropUnits);
+    atomic<long long> sold(0);
+    vector<thread> buyers;
+    for (int t = 0; t < threads; ++t) {
+        buyers.push_back(thread([&]() {
+            long long local = 0;
+            while (drop.tryTake(1)) local++;
+            sold.fetch_add(local);
+        }));
+    }
+    for (size_t t = 0; t < buyers.size(); ++t) buyers[t].join();
+    bool exact = (sold.load() == dropUnits && drop.total() == 0);
+    cout << "Sell-out of " << dropUnits << " units to " << threads << " threads: " << sold.load() << " sold, "
+         << drop.total() << " left, " << drop.rebalanceCount() << " rebalances" << (exact ? "" : "  MISMATCH") << "\n";
+    return exact;
+}
+
+// Seed for one benchmark's inputs, keyed by its name (FNV-1a), so adding, skipping or
+// reordering benchmarks leaves the inputs every other one draws unchanged.
+static uint64_t benchmarkSeed(unsigned long long seed, const string& name) {
+    uint64_t tag = 1469598103934665603ULL;
+    for (size_t i = 0; i < name.size(); ++i) tag = (tag ^ static_cast<unsigned char>(name[i])) * 1099511628211ULL;
+    return GeneratorRandom::derive(seed, 0xBE7C, tag);
+}
+
+static void runScale(BenchmarkRunner& runner, const GeneratorConfig& config, unsigned long long seed) {
+    GeneratorRandom random(benchmarkSeed(seed, ""));
+    runner.setStartHook([&random, seed](const string& name) { random = GeneratorRandom(benchmarkSeed(seed, name)); });
+    int firstProduct = DataGenerator::FirstProductID;
+    int productCount = config.products;
+    auto randomProduct = [&]() { return firstProduct + static_cast<int>(random.below(productCount)); };
+
+    // --- Startup loads; the GUI does these once, later benchmarks rely on them ---
+    runner.run("ProductCatalog::load", []() { return ProductCatalog::getInstance().load(); });
+    runner.run("OrderStore::load", []() { return OrderStore::getInstance().load(); });
+    ProductCatalog& catalog = ProductCatalog::getInstance();
+    catalog.ensureLoaded();
+    OrderStore::getInstance().ensureLoaded();
+
+    // --- Product reads ---
+    runner.run("Product::loadAllProducts", []() {
+        int count = 0;
+        Product* products = Product::loadAllProducts(count);
+        delete[] products;
+        return count > 0;
+    });
+
+    int productID = 0;
+    runner.run("Product::getProductByID", [&]() { productID = randomProduct(); }, [&]() {
+        Product* product = Product::getProductByID(productID);
+        bool found = (product != nullptr);
+        delete product;
+        return found;
+    });
+
+    // A reader pinning the current catalog version, and a writer publishing a new one
+    runner.run("ProductCatalog::snapshot", [&]() { return catalog.snapshot()->liveSize() > 0; });
+    runner.run("ProductCatalog::setStock", [&]() { productID = randomProduct(); }, [&]() {
+        int row = catalog.findRow(productID);
+        return row >= 0 && catalog.setStock(productID, catalog.getStock(row));
+    });
+
+    // A task handed to the pool and waited for, and the listing filter split across it
+    runner.run("TaskScheduler::run", []() { return TaskScheduler::getInstance().run([]() { return true; }).get(); });
+    runner.run("CatalogSnapshot::filterRows", [&]() {
+        shared_ptr<const CatalogSnapshot> snapshot = catalog.snapshot();
+        TaskScheduler& scheduler = TaskScheduler::getInstance();
+        size_t chunks = snapshot->chunkCount();
+        size_t slices = static_cast<size_t>(scheduler.threadCount());
+        vector<TaskFuture<vector<int> > > parts;
+        for (size_t slice = 0; slice < slices; ++slice) {
+            size_t first = chunks * slice / slices;
+            size_t end = chunks * (slice + 1) / slices;
+            parts.push_back(scheduler.run([snapshot, first, end]() {
+                return snapshot->filterRows("", "", 0.0, 1e9, 0.0, first, end);
+            }));
+        }
+        size_t matched = 0;
+        for (size_t i = 0; i < parts.size(); ++i) matched += parts[i].get().size();
+        return matched > 0;
+    });
+
+    static const char* searchTerms[] = {"lamp", "laptop", "novel", "pro", "yoga mat", "zen"};
+    string term;
+    // A listing search with nothing cached, and one more typed letter after the search
+    // for the text before it
+    ProductSearch& search = ProductSearch::getInstance();
+    runner.run("ProductSearch::scan", [&]() { term = searchTerms[random.below(6)]; search.clear(); }, [&]() {
+        search.search(catalog.snapshot(), ProductQuery(term, "", 0.0, 10000.0, 0.0));
+        return true;
+    });
+    runner.run("ProductSearch::keystroke", [&]() {
+        term = searchTerms[random.below(6)];
+        search.clear();
+        search.search(catalog.snapshot(), ProductQuery(term.substr(0, term.length() - 1), "", 0.0, 10000.0, 0.0));
+    }, [&]() {
+        search.search(catalog.snapshot(), ProductQuery(term, "", 0.0, 10000.0, 0.0));
+        return true;
+    });
+    // Type-ahead completions for the first letters of a search, from a trie built beforehand
+    ProductSuggestions& suggestions = ProductSuggestions::getInstance();
+    suggestions.sync();
+    runner.run("ProductSuggestions::suggest", [&]() {
+        term = searchTerms[random.below(6)];
+        term = term.substr(0, 1 + random.below(3));
+    }, [&]() {
+        suggestions.suggest(term);
+        return true;
+    });
+    runner.run("Product::searchByName", [&]() { term = searchTerms[random.below(6)]; }, [&]() {
+        Product::searchByName(term);
+        return true;
+    });
+    static const char* categories[] = {"Electronics", "Books", "Home", "Toys"};
+    string categoryName;
+    runner.run("Product::filterByCategory", [&]() { categoryName = categories[random.below(4)]; }, [&]() {
+        Product::filterByCategory(categoryName);
+        return true;
+    });
+    runner.run("Product::filterByPriceRange", []() {
+        Product::filterByPriceRange(50.0, 150.0);
+        return true;
+    });
+    runner.run("Product::filterByRating", []() {
+        Product::filterByRating(4.0);
+        return true;
+    });
+
+    // --- Users and carts ---
+    // Log in as a random generated user
+    string loginName, loginPassword;
+    User loginUser;
+    runner.run("User::loginUser",
+        [&]() {
+            int userID = 1 + static_cast<int>(random.below(config.users));
+            loginName = (userID == 1) ? "admin" : "user" + to_string(userID);
+            loginPassword = "pass" + to_string(userID);
+        },
+        [&]() { return loginUser.loginUser(loginName, loginPassword); });
+
+    int cartUser = min(config.users, 3);
+    vector<pair<int, int> > cartLines;
+    random = GeneratorRandom(benchmarkSeed(seed, "ShoppingCart::calculateTotal"));
+    for (int i = 0; i < 5; ++i) cartLines.push_back(make_pair(randomProduct(), 1 + static_cast<int>(random.below(3))));
+    writeCartFile(cartUser, cartLines);
+    ShoppingCart totalCart(cartUser);
+    runner.run("ShoppingCart::calculateTotal", [&]() { return totalCart.calculateTotal() > 0.0; });
+
+    // --- Writes ---
+    int buyer = min(config.users, 2);
+    ShoppingCart orderCart(buyer);
+    runner.run("Order::placeOrder",
+        [&]() {
+            // An in-stock product so the stock check can't cut the call short
+            int row = catalog.findSlot(randomProduct());
+            for (int tries = 0; tries < 100 && (row < 0 || catalog.getStock(row) <= 0); ++tries) {
+                row = catalog.findSlot(randomProduct());
+            }
+            vector<pair<int, int> > lines;
+            if (row >= 0) lines.push_back(make_pair(catalog.getProductID(row), 1));
+            writeCartFile(buyer, lines);
+        },
+        [&]() {
+            Order order(0, buyer, "", nullptr, "Pending");
+            return order.placeOrder(orderCart) > 0;
+        });
+
+    static const char* statuses[] = {"Processing", "Shipped", "Delivered", "Cancelled"};
+    int orderID = 0;
+    const char* status = statuses[0];
+    int maxOrder = OrderStore::getInstance().maxOrderID();
+    runner.run("Order::updateStatus",
+        [&]() {
+            orderID = DataGenerator::FirstOrderID + static_cast<int>(random.below(max(1, maxOrder - DataGenerator::FirstOrderID + 1)));
+            status = statuses[random.below(4)];
+        },
+        [&]() { return Order::updateStatus(orderID, status); });
+
+    int reviewer = max(config.users, maxReviewerID());
+    runner.run("Review::addReview",
+        [&]() {
+            reviewer++;
+            productID = randomProduct();
+        },
+        [&]() { return Review::addReview(productID, reviewer, 1 + static_cast<int>(random.below(5)), "Benchmark review"); });
+    runner.setStartHook(BenchmarkRunner::StartHook()); // It refers to this scale's stream
+}
+
+int main(int argc, char* argv[]) {
+    BenchConfig bench;
+    for (int i = 1; i < argc; ++i) {
+        string option = argv[i];
+        if (option == "--help" || option == "-h") {
+            printUsage(argv[0]);
+            return 0;
+        } else if (option == "--regenerate") {
+            bench.regenerate = true;
+        } else if (i + 1 >= argc) {
+            cerr << "Error: Missing value for " << option << "." << endl;
+            printUsage(argv[0]);
+            return 2;
+        } else {
+            string value = argv[++i];
+            if (option == "--scales") bench.scales = splitList(value);
+            else if (option == "--reps") bench.runner.repetitions = max(1, atoi(value.c_str()));
+            else if (option == "--warmup") bench.runner.warmup = max(0, atoi(value.c_str()));
+            else if (option == "--max-seconds") bench.runner.maxSeconds = atof(value.c_str());
+            else if (option == "--filter") bench.runner.filter = value;
+            else if (option == "--json") bench.jsonPath = value;
+            else if (option == "--data-root") bench.dataRoot = value;
+            else if (option == "--seed") bench.seed = strtoull(value.c_str(), nullptr, 10);
+            else if (option == "--save-baseline") bench.saveBaselinePath = value;
+            else if (option == "--compare") bench.comparePath = value;
+            else if (option == "--threshold") bench.thresholdPercent = atof(value.c_str());
+            else if (option == "--alpha") bench.alpha = atof(value.c_str());
+            else if (option == "--contention-seconds") bench.contentionSeconds = max(0.1, atof(value.c_str()));
+            else if (option == "--contention") {
+                vector<string> counts = splitList(value);
+                for (size_t c = 0; c < counts.size(); ++c) bench.contentionThreads.push_back(max(1, atoi(counts[c].c_str())));
+            }
+            else {
+                cerr << "Error: Unknown option " << option << "." << endl;
+                printUsage(argv[0]);
+                return 2;
+            }
+        }
+    }
+
+    if (!bench.contentionThreads.empty()) {
+        return runContention(bench.contentionThreads, bench.contentionSeconds) ? 0 : 1;
+    }
+
+    char cwd[4096];
+    if (!getcwd(cwd, sizeof(cwd))) {
+        cerr << "Error: Cannot determine the current directory." << endl;
+        return 1;
+    }
+    string base = cwd;
+    string dataRoot = absolutePath(bench.dataRoot, base);
+    mkdir(dataRoot.c_str(), 0755);
+
+    // Read the baseline up front so a bad path fails before a long run
+    vector<BenchmarkResult> baseline;
+    if (!bench.comparePath.empty() && !BenchmarkRunner::loadBaseline(absolutePath(bench.comparePath, base), baseline)) {
+        return 2;
+    }
+
+    BenchmarkRunner runner(bench.runner);
+    vector<pair<string, string> > context;
+    context.push_back(make_pair("compiler", string(__VERSION__)));
+    context.push_back(make_pair("seed", to_string(bench.seed)));
+    context.push_back(make_pair("repetitions", to_string(bench.runner.repetitions)));
+    context.push_back(make_pair("warmup", to_string(bench.runner.warmup)));
+    context.push_back(make_pair("started", OrderSegmentStore::formatEpochSeconds(static_cast<long long>(time(nullptr)))));
+
+    for (size_t s = 0; s < bench.scales.size(); ++s) {
+        const string& scale = bench.scales[s];
+        GeneratorConfig config;
+        if (!DataGenerator::applyScale(scale, config)) {
+            cerr << "Error: Unknown scale '" << scale << "'." << endl;
+            return 2;
+        }
+        config.seed = bench.seed;
+
+        string directory = dataRoot + "/" + scale;
+        mkdir(directory.c_str(), 0755);
+        if (chdir(directory.c_str()) != 0) {
+            cerr << "Error: Cannot change to " << directory << "." << endl;
+            return 1;
+        }
+        cout << "\n=== Scale " << scale << ": " << config.products << " products, " << config.users << " users, "
+             << config.orders << " orders, " << config.reviews << " reviews ===" << endl;
+        if (!prepareDataSet(config, bench.regenerate)) {
+            cerr << "Error: Could not generate the " << scale << " data set." << endl;
+            return 1;
+        }
+        // Same startup as the GUI: open the segments (singletons are reset per scale), seal old periods
+        OrderSegmentStore& segments = OrderSegmentStore::getInstance();
+        segments.open();
+        segments.sealCompletedPeriods(true);
+        context.push_back(make_pair("scale." + scale, to_string(config.products) + " products, " +
+                                    to_string(config.users) + " users, " + to_string(config.orders) + " orders, " +
+                                    to_string(config.reviews) + " reviews"));
+
+        runner.setScale(scale);
+        BenchmarkRunner::printHeader(cout);
+        runScale(runner, config, bench.seed);
+
+        if (chdir(base.c_str()) != 0) {
+            cerr << "Error: Cannot change back to " << base << "." << endl;
+            return 1;
+        }
+    }
+
+    string jsonPath = absolutePath(bench.jsonPath, base);
+    if (!runner.writeJson(jsonPath, context)) return 1;
+    cout << "\nResults written to " << jsonPath << endl;
+
+    if (!bench.saveBaselinePath.empty()) {
+        string baselinePath = absolutePath(bench.saveBaselinePath, base);
+        if (!runner.saveBaseline(baselinePath)) return 1;
+        cout << "Baseline saved to " << baselinePath << endl;
+    }
+    if (!bench.comparePath.empty()) {
+        // Earlier tables leave cout fixed at one decimal, which would print an alpha of 0.05 as 0.1
+        cout << "\n=== Compared with " << bench.comparePath << " (threshold " << fixed << setprecision(1)
+             << bench.thresholdPercent << "%, alpha " << defaultfloat << setprecision(3) << bench.alpha << ") ===" << endl;
+        int regressions = runner.compareWithBaseline(baseline, bench.thresholdPercent, bench.alpha, cout);
+        if (regressions > 0) {
+            cout << regressions << " benchmark(s) regressed." << endl;
+            return 1;
+        }
+        cout << "No regressions." << endl;
+    }
+    return 0;
+}
@@ -32,7 +32,7 @@ done
 
 # Compile the application using the commands from path.md
 echo "Compiling application..."
-g++ -std=c++17 -fPIC \
+g++ -std=c++20 -fPIC \
     -Igui/include \
     -Isrc \
     -I. \
@@ -44,6 +44,7 @@ g++ -std=c++17 -fPIC \
     -framework QtWidgets \
     -framework QtGui \
     -framework QtCore \
+    -lz \
     -Wl,-rpath,/Users/macbookpro/Qt/6.9.0/macos/lib \
     -o ECommerceApp_Qt
 
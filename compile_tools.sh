@@ -0,0 +1,108 @@
+#!/bin/bash
+
+# Builds the command-line tools and tests that only use the backend headers (no Qt needed).
+
+echo "Compiling datagen..."
+g++ -std=c++17 -O2 -pthread \
+    -Iinclude \
+    -I. \
+    datagen.cpp \
+    -lz \
+    -o datagen
+
+if [ $? -ne 0 ]; then
+    echo "Compilation failed."
+    exit 1
+fi
+
+echo "Compiling bench..."
+g++ -std=c++17 -O2 -pthread \
+    -Iinclude \
+    -I. \
+    bench.cpp \
+    -lz \
+    -o bench
+
+if [ $? -ne 0 ]; then
+    echo "Compilation failed."
+    exit 1
+fi
+
+echo "Compiling ecomcli..."
+g++ -std=c++17 -O2 -pthread \
+    -Iinclude \
+    -I. \
+    ecomcli.cpp \
+    -lz \
+    -o ecomcli
+
+if [ $? -ne 0 ]; then
+    echo "Compilation failed."
+    exit 1
+fi
+
+echo "Compiling loadsim..."
+g++ -std=c++17 -O2 -pthread \
+    -Iinclude \
+    -I. \
+    loadsim.cpp \
+    -lz \
+    -o loadsim
+
+if [ $? -ne 0 ]; then
+    echo "Compilation failed."
+    exit 1
+fi
+
+echo "Compiling editmergetest..."
+g++ -std=c++17 -O2 -pthread \
+    -Iinclude \
+    -I. \
+    editmergetest.cpp \
+    -lz \
+    -o editmergetest
+
+if [ $? -ne 0 ]; then
+    echo "Compilation failed."
+    exit 1
+fi
+
+echo "Compiling idempotencytest..."
+g++ -std=c++17 -O2 -pthread \
+    -Iinclude \
+    -I. \
+    idempotencytest.cpp \
+    -lz \
+    -o idempotencytest
+
+if [ $? -ne 0 ]; then
+    echo "Compilation failed."
+    exit 1
+fi
+
+echo "Compiling reservationtest..."
+g++ -std=c++17 -O2 -pthread \
+    -Iinclude \
+    -I. \
+    reservationtest.cpp \
+    -lz \
+    -o reservationtest
+
+if [ $? -ne 0 ]; then
+    echo "Compilation failed."
+    exit 1
+fi
+
+echo "Compiling ecomserver..."
+g++ -std=c++17 -O2 -pthread \
+    -Iinclude \
+    -I. \
+    ecomserver.cpp \
+    -lz \
+    -o ecomserver
+
+if [ $? -eq 0 ]; then
+    echo "Compilation successful! Run ./datagen --help, ./bench --help, ./ecomcli --help, ./loadsim --help or ./ecomserver --help for options; ./editmergetest, ./idempotencytest and ./reservationtest run the tests"
+else
+    echo "Compilation failed."
+fi
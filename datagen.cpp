@@ -0,0 +1,132 @@
+// Synthetic data generator for load and benchmark runs.
+//
+//   ./datagen --scale medium --dir /tmp/ecom --threads 8
+//   ./datagen --products 5000000 --users 2000000 --orders 50000000 --reviews 20000000 --force
+//
+// Writes data/ under --dir (default: the current directory) in the same formats the
+// application reads. The same options and seed always produce the same files.
+#include "include/DataGenerator.h"
+
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+static void printUsage(const char* program) {
+    cout << "Usage: " << program << " [options]\n"
+         << "  --scale small|medium|large|production  Preset sizes (individual options override)\n"
+         << "  --products N      Number of products\n"
+         << "  --users N         Number of users (user 1 is the admin)\n"
+         << "  --orders N        Number of orders\n"
+         << "  --reviews N       Number of reviews\n"
+         << "  --carts N         Users with a saved cart\n"
+         << "  --wishlists N     Users with a wishlist\n"
+         << "  --months N        Months of order history (default 24)\n"
+         << "  --end-date DATE   Last day of order history, YYYY-MM-DD (default today)\n"
+         << "  --partition daily|monthly|yearly  Order segment span (default monthly)\n"
+         << "  --zipf S          Popularity skew, 0 for uniform (default 1.0)\n"
+         << "  --seed N          Random seed (default 42)\n"
+         << "  --threads N       Worker threads (default: all cores)\n"
+         << "  --seal            Seal and compress segments for completed periods afterwards\n"
+         << "  --dir PATH        Directory to create data/ in\n"
+         << "  --force           Replace an existing data set\n";
+}
+
+int main(int argc, char* argv[]) {
+    GeneratorConfig config;
+    string directory;
+    bool force = false;
+    bool sealCompleted = false;
+    int months = 24;
+
+    for (int i = 1; i < argc; ++i) {
+        string option = argv[i];
+        bool hasValue = (i + 1 < argc);
+        if (option == "--help" || option == "-h") {
+            printUsage(argv[0]);
+            return 0;
+        } else if (option == "--force") {
+            force = true;
+        } else if (option == "--seal") {
+            sealCompleted = true;
+        } else if (!hasValue) {
+            cerr << "Error: Missing value for " << option << "." << endl;
+            printUsage(argv[0]);
+            return 2;
+        } else {
+            string value = argv[++i];
+            if (option == "--scale") {
+                if (!DataGenerator::applyScale(value, config)) {
+                    cerr << "Error: Unknown scale '" << value << "'." << endl;
+                    return 2;
+                }
+            } else if (option == "--products") config.products = atoi(value.c_str());
+            else if (option == "--users") config.users = atoi(value.c_str());
+            else if (option == "--orders") config.orders = atoll(value.c_str());
+            else if (option == "--reviews") config.reviews = atoll(value.c_str());
+            else if (option == "--carts") config.carts = atoi(value.c_str());
+            else if (option == "--wishlists") config.wishlists = atoi(value.c_str());
+            else if (option == "--months") months = atoi(value.c_str());
+            else if (option == "--end-date") {
+                long long endTime = OrderSegmentStore::toEpochSeconds((value + " 00:00:00").c_str());
+                if (endTime <= 0) {
+                    cerr << "Error: Invalid end date '" << value << "'." << endl;
+                    return 2;
+                }
+                config.endTime = endTime;
+            } else if (option == "--zipf") config.zipfExponent = atof(value.c_str());
+            else if (option == "--seed") config.seed = strtoull(value.c_str(), nullptr, 10);
+            else if (option == "--threads") config.threads = max(1, atoi(value.c_str()));
+            else if (option == "--dir") directory = value;
+            else if (option == "--partition") {
+                if (value == "daily") config.partition = OrderPartition::Daily;
+                else if (value == "monthly") config.partition = OrderPartition::Monthly;
+                else if (value == "yearly") config.partition = OrderPartition::Yearly;
+                else {
+                    cerr << "Error: Unknown partition '" << value << "'." << endl;
+                    return 2;
+                }
+            } else {
+                cerr << "Error: Unknown option " << option << "." << endl;
+                printUsage(argv[0]);
+                return 2;
+            }
+        }
+    }
+    config.startTime = config.endTime - static_cast<long long>(max(1, months)) * 30 * 24 * 3600;
+
+    if (!directory.empty()) {
+        mkdir(directory.c_str(), 0755);
+        if (chdir(directory.c_str()) != 0) {
+            cerr << "Error: Cannot change to directory " << directory << "." << endl;
+            return 1;
+        }
+    }
+
+    // Order segments are appended to, so an old set would mix with the new one
+    if (DataGenerator::dataSetExists()) {
+        if (!force) {
+            cerr << "Error: A data set already exists here. Use --force to replace it." << endl;
+            return 1;
+        }
+        DataGenerator::removeDataSet();
+    }
+
+    cout << "Generating " << config.products << " products, " << config.users << " users, " << config.orders
+         << " orders, " << config.reviews << " reviews (seed " << config.seed << ", " << config.threads
+         << " threads)" << endl;
+    DataGenerator generator(config);
+    if (!generator.generateAll()) {
+        cerr << "Data generation failed." << endl;
+        return 1;
+    }
+    if (sealCompleted) {
+        int sealed = OrderSegmentStore::getInstance().sealCompletedPeriods(true);
+        cout << "Sealed " << sealed << " order segments." << endl;
+    }
+    return 0;
+}
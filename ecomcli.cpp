@@ -0,0 +1,555 @@
+// Headless driver for the backend: runs the shop's operations without Qt or prompts.
+//
+//   ./ecomcli --dir /tmp/ecom -c "login user7 pass7" -c "cart-add 101 2" -c checkout
+//   ./ecomcli --dir /tmp/ecom --quiet --repeat 100 session.txt
+//   ./ecomcli --help-commands
+//   ./ecomcli --dir /tmp/ecom --quiet --replay session.txt --speed 10
+//
+// Commands come from -c options, from script files (one command per line, '#' starts a
+// comment, "-" reads standard input) or, if neither is given, from standard input.
+// Arguments are separated by spaces; use double quotes for values that contain them.
+// A summary of calls, failures and time per command is printed to stderr at the end.
+// --replay runs a session recorded in the GUI instead (see SessionReplay.h).
+#include "include/IoStats.h"
+#include "include/Trace.h"
+#include "include/Product.h"
+#include "include/User.h"
+#include "include/ShoppingCart.h"
+#include "include/Wishlist.h"
+#include "include/Order.h"
+#include "include/Payment.h"
+#include "include/Review.h"
+#include "include/SessionReplay.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include <chrono>
+#include <thread>
+#include <cstdlib>
+#include <cctype>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+struct CliSession {
+    User user;
+    bool loggedIn;
+    ostream& out; // The real standard output; cout may be silenced while commands run
+
+    explicit CliSession(ostream& output) : loggedIn(false), out(output) {}
+};
+
+struct CliCommand {
+    string usage;
+    string description;
+    size_t minArgs;
+    bool needsLogin;
+    bool needsAdmin;
+    function<bool(CliSession&, const vector<string>&)> run;
+
+    CliCommand() : minArgs(0), needsLogin(false), needsAdmin(false) {}
+    CliCommand(const string& u, const string& d, size_t args, bool login, bool admin,
+               function<bool(CliSession&, const vector<string>&)> handler)
+        : usage(u), description(d), minArgs(args), needsLogin(login), needsAdmin(admin), run(handler) {}
+};
+
+struct CommandStats {
+    long long calls;
+    long long failures;
+    double totalMs;
+    double maxMs;
+
+    CommandStats() : calls(0), failures(0), totalMs(0.0), maxMs(0.0) {}
+};
+
+// Splits a command line on spaces, keeping double-quoted text together.
+static vector<string> tokenize(const string& line) {
+    vector<string> tokens;
+    string current;
+    bool quoted = false, inToken = false;
+    for (size_t i = 0; i < line.length(); ++i) {
+        char c = line[i];
+        if (c == '"') {
+            quoted = !quoted;
+            inToken = true;
+        } else if (!quoted && isspace(static_cast<unsigned char>(c))) {
+            if (inToken) tokens.push_back(current);
+            current.clear();
+            inToken = false;
+        } else if (!quoted && c == '#' && !inToken) {
+            break;
+        } else {
+            current += c;
+            inToken = true;
+        }
+    }
+    if (inToken) tokens.push_back(current);
+    return tokens;
+}
+
+static bool parseInt(const string& text, int& value) {
+    char* end = nullptr;
+    long parsed = strtol(text.c_str(), &end, 10);
+    if (text.empty() || *end != '\0') return false;
+    value = static_cast<int>(parsed);
+    return true;
+}
+
+static bool parseDouble(const string& text, double& value) {
+    char* end = nullptr;
+    value = strtod(text.c_str(), &end);
+    return !text.empty() && *end == '\0';
+}
+
+static string joinFrom(const vector<string>& args, size_t first) {
+    string joined;
+    for (size_t i = first; i < args.size(); ++i) {
+        if (i > first) joined += " ";
+        joined += args[i];
+    }
+    return joined;
+}
+
+// Matches a payment method name case-insensitively against the ones Payment offers.
+static string canonicalPaymentMethod(const string& name) {
+    static const char* methods[] = {"VISA", "Mastercard", "JazzCash", "EasyPaisa", "PayPak"};
+    string lower = ProductCatalog::toLower(name);
+    for (size_t i = 0; i < sizeof(methods) / sizeof(methods[0]); ++i) {
+        if (ProductCatalog::toLower(methods[i]) == lower) return methods[i];
+    }
+    return "";
+}
+
+static map<string, CliCommand> buildCommands() {
+    map<string, CliCommand> commands;
+    typedef const vector<string>& Args;
+
+    // --- Accounts ---
+    commands["register"] = CliCommand("register <username> <email> <password>", "Create a customer account", 3, false, false,
+        [](CliSession&, Args a) { User account; return account.registerUser(a[0], a[1], a[2]); });
+    commands["login"] = CliCommand("login <username> <password>", "Log in; later commands act as this user", 2, false, false,
+        [](CliSession& s, Args a) {
+            s.loggedIn = s.user.loginUser(a[0], a[1]);
+            return s.loggedIn;
+        });
+    commands["logout"] = CliCommand("logout", "Log out", 0, true, false,
+        [](CliSession& s, Args) {
+            s.user.logoutUser();
+            s.loggedIn = false;
+            return true;
+        });
+    commands["whoami"] = CliCommand("whoami", "Show the logged-in user", 0, true, false,
+        [](CliSession& s, Args) {
+            s.out << s.user.getUserID() << "," << s.user.getUsername() << (s.user.getIsAdmin() ? ",admin" : "") << endl;
+            return true;
+        });
+
+    // --- Browsing ---
+    commands["products"] = CliCommand("products", "List all products", 0, false, false,
+        [](CliSession&, Args) { Product::loadAllProductsAndDisplay(); return true; });
+    commands["product"] = CliCommand("product <productID>", "Show one product", 1, false, false,
+        [](CliSession&, Args a) {
+            int id;
+            if (!parseInt(a[0], id)) return false;
+            Product* product = Product::getProductByID(id);
+            if (!product) return false;
+            product->displayProduct();
+            delete product;
+            return true;
+        });
+    commands["search"] = CliCommand("search <text>", "Search product names", 1, false, false,
+        [](CliSession&, Args a) { Product::searchByName(joinFrom(a, 0)); return true; });
+    commands["category"] = CliCommand("category <name>", "List products in a category", 1, false, false,
+        [](CliSession&, Args a) { Product::filterByCategory(joinFrom(a, 0)); return true; });
+    commands["price"] = CliCommand("price <min> <max>", "List products in a price range", 2, false, false,
+        [](CliSession&, Args a) {
+            double low, high;
+            if (!parseDouble(a[0], low) || !parseDouble(a[1], high)) return false;
+            Product::filterByPriceRange(low, high);
+            return true;
+        });
+    commands["rating"] = CliCommand("rating <min>", "List products rated at least <min>", 1, false, false,
+        [](CliSession&, Args a) {
+            double minimum;
+            if (!parseDouble(a[0], minimum)) return false;
+            Product::filterByRating(minimum);
+            return true;
+        });
+    commands["reviews"] = CliCommand("reviews <productID>", "Show a product's reviews", 1, false, false,
+        [](CliSession&, Args a) {
+            int id;
+            if (!parseInt(a[0], id)) return false;
+            Review::getReviewsForProduct(id);
+            return true;
+        });
+
+    // --- Cart, wishlist and checkout ---
+    commands["cart"] = CliCommand("cart", "Show the cart", 0, true, false,
+        [](CliSession& s, Args) { ShoppingCart cart(s.user.getUserID()); cart.viewCart(); return true; });
+    commands["cart-add"] = CliCommand("cart-add <productID> [quantity]", "Add a product to the cart", 1, true, false,
+        [](CliSession& s, Args a) {
+            int id, quantity = 1;
+            if (!parseInt(a[0], id) || (a.size() > 1 && !parseInt(a[1], quantity))) return false;
+            ShoppingCart cart(s.user.getUserID());
+            return cart.addToCart(id, quantity);
+        });
+    commands["cart-remove"] = CliCommand("cart-remove <productID>", "Remove a product from the cart", 1, true, false,
+        [](CliSession& s, Args a) {
+            int id;
+            if (!parseInt(a[0], id)) return false;
+            ShoppingCart cart(s.user.getUserID());
+            return cart.removeFromCart(id);
+        });
+    commands["cart-clear"] = CliCommand("cart-clear", "Empty the cart", 0, true, false,
+        [](CliSession& s, Args) { ShoppingCart cart(s.user.getUserID()); return cart.clearCart(); });
+    commands["cart-total"] = CliCommand("cart-total", "Print the cart total", 0, true, false,
+        [](CliSession& s, Args) {
+            ShoppingCart cart(s.user.getUserID());
+            s.out << fixed << setprecision(2) << cart.calculateTotal() << endl;
+            return true;
+        });
+    commands["wishlist"] = CliCommand("wishlist", "Show the wishlist", 0, true, false,
+        [](CliSession& s, Args) { Wishlist wishlist(s.user.getUserID()); wishlist.viewWishlist(); return true; });
+    commands["wishlist-add"] = CliCommand("wishlist-add <productID>", "Add a product to the wishlist", 1, true, false,
+        [](CliSession& s, Args a) {
+            int id;
+            if (!parseInt(a[0], id)) return false;
+            Wishlist wishlist(s.user.getUserID());
+            return wishlist.addToWishlist(id);
+        });
+    commands["wishlist-remove"] = CliCommand("wishlist-remove <productID>", "Remove a product from the wishlist", 1, true, false,
+        [](CliSession& s, Args a) {
+            int id;
+            if (!parseInt(a[0], id)) return false;
+            Wishlist wishlist(s.user.getUserID());
+            return wishlist.removeFromWishlist(id);
+        });
+    commands["checkout"] = CliCommand("checkout [VISA|Mastercard|JazzCash|EasyPaisa|PayPak]",
+                                      "Place an order for the cart and pay for it (default VISA)", 0, true, false,
+        [](CliSession& s, Args a) {
+            string method = canonicalPaymentMethod(a.empty() ? "VISA" : a[0]);
+            if (method.empty()) {
+                cerr << "Error: Unknown payment method '" << a[0] << "'." << endl;
+                return false;
+            }
+            ShoppingCart cart(s.user.getUserID());
+            Order order(0, s.user.getUserID(), "", nullptr, "Pending");
+            int orderID = order.placeOrder(cart);
+            if (orderID <= 0) return false;
+            Payment payment;
+            if (!payment.simulatePayment(orderID, s.user.getUserID(), order.getOrderTotal(), method)) return false;
+            s.out << orderID << endl;
+            return true;
+        });
+    commands["orders"] = CliCommand("orders", "List your orders", 0, true, false,
+        [](CliSession& s, Args) { Order::viewOrdersForUser(s.user.getUserID()); return true; });
+    commands["track"] = CliCommand("track <orderID>", "Show an order's status", 1, false, false,
+        [](CliSession&, Args a) {
+            int id;
+            if (!parseInt(a[0], id)) return false;
+            Order::trackOrder(id);
+            return true;
+        });
+    commands["review"] = CliCommand("review <productID> <rating 1-5> <comment>", "Review a product", 3, true, false,
+        [](CliSession& s, Args a) {
+            int id, rating;
+            if (!parseInt(a[0], id) || !parseInt(a[1], rating)) return false;
+            return Review::addReview(id, s.user.getUserID(), rating, joinFrom(a, 2).c_str());
+        });
+
+    // --- Administration ---
+    commands["product-add"] = CliCommand("product-add <name> <category> <price> <stock> [description]",
+                                         "Add a product", 4, true, true,
+        [](CliSession&, Args a) {
+            double price;
+            int stock;
+            if (!parseDouble(a[2], price) || !parseInt(a[3], stock) || price < 0 || stock < 0) return false;
+            string description = (a.size() > 4) ? joinFrom(a, 4) : "";
+            Product product(0, a[0].c_str(), a[1].c_str(), description.c_str(), price, 0.0, stock);
+            return Product::addProduct(product);
+        });
+    commands["product-edit"] = CliCommand("product-edit <productID> field=value...",
+                                          "Change name, category, description, price or stock", 2, true, true,
+        [](CliSession&, Args a) {
+            int id;
+            if (!parseInt(a[0], id)) return false;
+            Product* current = Product::getProductByID(id);
+            if (!current) return false;
+            string name = current->getName() ? current->getName() : "";
+            string category = current->getCategory() ? current->getCategory() : "";
+            string description = current->getDescription() ? current->getDescription() : "";
+            double price = current->getPrice(), rating = current->getRating();
+            int stock = current->getStock();
+            delete current;
+            for (size_t i = 1; i < a.size(); ++i) {
+                size_t equals = a[i].find('=');
+                string field = a[i].substr(0, equals), value = (equals == string::npos) ? "" : a[i].substr(equals + 1);
+                bool ok = (equals != string::npos);
+                if (field == "name") name = value;
+                else if (field == "category") category = value;
+                else if (field == "description") description = value;
+                else if (field == "price") ok = ok && parseDouble(value, price) && price >= 0;
+                else if (field == "stock") ok = ok && parseInt(value, stock) && stock >= 0;
+                else ok = false;
+                if (!ok) {
+                    cerr << "Error: Invalid field '" << a[i] << "'." << endl;
+                    return false;
+                }
+            }
+            Product updated(id, name.c_str(), category.c_str(), description.c_str(), price, rating, stock);
+            return Product::editProduct(id, updated);
+        });
+    commands["product-remove"] = CliCommand("product-remove <productID>", "Remove a product", 1, true, true,
+        [](CliSession&, Args a) {
+            int id;
+            return parseInt(a[0], id) && Product::removeProduct(id);
+        });
+    commands["order-status"] = CliCommand("order-status <orderID> <status>", "Change an order's status", 2, true, true,
+        [](CliSession&, Args a) {
+            int id;
+            return parseInt(a[0], id) && Order::updateStatus(id, joinFrom(a, 1).c_str());
+        });
+    commands["all-orders"] = CliCommand("all-orders", "List every order", 0, true, true,
+        [](CliSession&, Args) { Order::viewAllOrders(); return true; });
+    commands["users"] = CliCommand("users", "List every user", 0, true, true,
+        [](CliSession&, Args) { User::viewAllUsers(); return true; });
+    commands["user-edit"] = CliCommand("user-edit <userID> field=value...", "Change a user's username or email", 2, true, true,
+        [](CliSession&, Args a) {
+            int id;
+            if (!parseInt(a[0], id)) return false;
+            User* account = User::getUserByID(id);
+            if (!account) return false;
+            bool ok = true;
+            for (size_t i = 1; i < a.size() && ok; ++i) {
+                size_t equals = a[i].find('=');
+                string field = a[i].substr(0, equals), value = (equals == string::npos) ? "" : a[i].substr(equals + 1);
+                if (equals == string::npos || value.empty()) ok = false;
+                else if (field == "username") ok = (value == account->getUsername() || User::getUserIdByUsername(value.c_str()) < 0);
+                else if (field != "email") ok = false;
+                if (!ok) cerr << "Error: Invalid or taken value '" << a[i] << "'." << endl;
+                else if (field == "username") account->setUsername(value.c_str());
+                else account->setEmail(value.c_str());
+            }
+            ok = ok && User::updateUserInFile(*account);
+            delete account;
+            return ok;
+        });
+    commands["user-remove"] = CliCommand("user-remove <userID>", "Remove a user", 1, true, true,
+        [](CliSession& s, Args a) {
+            int id;
+            return parseInt(a[0], id) && User::removeUser(s.user.getUserID(), id);
+        });
+
+    // --- Scripting ---
+    commands["sleep"] = CliCommand("sleep <milliseconds>", "Pause between commands", 1, false, false,
+        [](CliSession&, Args a) {
+            int milliseconds;
+            if (!parseInt(a[0], milliseconds) || milliseconds < 0) return false;
+            this_thread::sleep_for(chrono::milliseconds(milliseconds));
+            return true;
+        });
+    return commands;
+}
+
+static void printUsage(const char* program) {
+    cout << "Usage: " << program << " [options] [script ...]\n"
+         << "  -c, --command CMD   Run CMD (repeatable; runs before any scripts)\n"
+         << "  --dir PATH          Directory holding data/ (default: the current directory)\n"
+         << "  --repeat N          Run the whole command list N times\n"
+         << "  --quiet             Hide the backend's console output\n"
+         << "  --timing            Print each command's elapsed time\n"
+         << "  --stop-on-error     Stop at the first failed command\n"
+         << "  --trace PATH        Record trace spans and write them to PATH (Chrome trace JSON)\n"
+         << "  --io-stats PATH     Write the I/O counters to PATH (CSV) at the end\n"
+         << "  --replay PATH       Replay a recorded GUI session instead of running commands\n"
+         << "  --speed X           Replay at X times the recorded pace; 0 runs flat out (default 1)\n"
+         << "  --help-commands     List the commands\n";
+}
+
+static void printCommands(const map<string, CliCommand>& commands) {
+    for (auto it = commands.begin(); it != commands.end(); ++it) {
+        const CliCommand& command = it->second;
+        cout << "  " << left << setw(58) << command.usage << command.description
+             << (command.needsAdmin ? " (admin)" : "") << "\n";
+    }
+}
+
+static bool readScript(istream& in, vector<string>& lines) {
+    string line;
+    while (getline(in, line)) {
+        if (!tokenize(line).empty()) lines.push_back(line);
+    }
+    return true;
+}
+
+// Same layout the GUI creates on startup.
+static void initDataDirectories() {
+    const char* directories[] = {"data", "data/cart", "data/wishlist", "data/orders", "data/reviews"};
+    for (size_t i = 0; i < sizeof(directories) / sizeof(directories[0]); ++i) mkdir(directories[i], 0755);
+}
+
+int main(int argc, char* argv[]) {
+    vector<string> commandLines;
+    vector<string> scripts;
+    string directory, tracePath, ioStatsPath, replayPath;
+    int repeat = 1;
+    double replaySpeed = 1.0;
+    bool quiet = false, timing = false, stopOnError = false;
+    map<string, CliCommand> commands = buildCommands();
+
+    for (int i = 1; i < argc; ++i) {
+        string option = argv[i];
+        bool hasValue = (i + 1 < argc);
+        if (option == "--help" || option == "-h") {
+            printUsage(argv[0]);
+            return 0;
+        } else if (option == "--help-commands") {
+            printCommands(commands);
+            return 0;
+        } else if (option == "--quiet") {
+            quiet = true;
+        } else if (option == "--timing") {
+            timing = true;
+        } else if (option == "--stop-on-error") {
+            stopOnError = true;
+        } else if (option == "-" || option.compare(0, 1, "-") != 0) {
+            scripts.push_back(option);
+        } else if (!hasValue) {
+            cerr << "Error: Missing value for " << option << "." << endl;
+            printUsage(argv[0]);
+            return 2;
+        } else {
+            string value = argv[++i];
+            if (option == "-c" || option == "--command") commandLines.push_back(value);
+            else if (option == "--dir") directory = value;
+            else if (option == "--repeat") repeat = max(1, atoi(value.c_str()));
+            else if (option == "--trace") tracePath = value;
+            else if (option == "--io-stats") ioStatsPath = value;
+            else if (option == "--replay") replayPath = value;
+            else if (option == "--speed") replaySpeed = max(0.0, atof(value.c_str()));
+            else {
+                cerr << "Error: Unknown option " << option << "." << endl;
+                printUsage(argv[0]);
+                return 2;
+            }
+        }
+    }
+    if (commandLines.empty() && scripts.empty() && replayPath.empty()) scripts.push_back("-");
+
+    SessionReplayer replayer;
+    string replayError;
+    if (!replayPath.empty() && !replayer.load(replayPath, replayError)) {
+        cerr << "Error: " << replayError << "." << endl;
+        return 2;
+    }
+
+    for (size_t i = 0; i < scripts.size(); ++i) {
+        if (scripts[i] == "-") {
+            readScript(cin, commandLines);
+            continue;
+        }
+        ifstream script(scripts[i]);
+        if (!script) {
+            cerr << "Error: Cannot open script " << scripts[i] << "." << endl;
+            return 2;
+        }
+        readScript(script, commandLines);
+    }
+
+    if (!directory.empty() && chdir(directory.c_str()) != 0) {
+        cerr << "Error: Cannot change to directory " << directory << "." << endl;
+        return 1;
+    }
+    initDataDirectories();
+    if (!Order::migrateLegacyOrders()) {
+        cerr << "Error: Could not migrate existing orders." << endl;
+        return 1;
+    }
+
+    if (!tracePath.empty()) Trace::getInstance().setEnabled(true);
+    IoStats::reset();
+
+    // Commands never read stdin (scripts were read up front), so nothing can block on a prompt
+    ostream out(cout.rdbuf());
+    ofstream discard("/dev/null");
+    streambuf* savedOutput = cout.rdbuf();
+    CliSession session(out);
+    map<string, CommandStats> stats;
+    long long failures = 0;
+    bool stopped = false;
+
+    for (int round = 0; round < repeat && !replayPath.empty(); ++round) {
+        if (quiet) cout.rdbuf(discard.rdbuf());
+        failures += replayer.run(replaySpeed);
+        cout.rdbuf(savedOutput);
+        cerr << "\nReplay of " << replayPath << (repeat > 1 ? " (round " + to_string(round + 1) + ")" : string()) << endl;
+        replayer.printReport(cerr);
+    }
+
+    for (int round = 0; round < repeat && !stopped; ++round) {
+        for (size_t i = 0; i < commandLines.size() && !stopped; ++i) {
+            vector<string> tokens = tokenize(commandLines[i]);
+            string name = tokens[0];
+            tokens.erase(tokens.begin());
+
+            auto found = commands.find(name);
+            bool ok = false;
+            double elapsedMs = 0.0;
+            if (found == commands.end()) {
+                cerr << "Error: Unknown command '" << name << "'. See --help-commands." << endl;
+            } else if (tokens.size() < found->second.minArgs) {
+                cerr << "Error: Usage: " << found->second.usage << endl;
+            } else if (found->second.needsLogin && !session.loggedIn) {
+                cerr << "Error: '" << name << "' needs a logged-in user." << endl;
+            } else if (found->second.needsAdmin && !session.user.getIsAdmin()) {
+                cerr << "Error: '" << name << "' needs an admin user." << endl;
+            } else {
+                if (quiet) cout.rdbuf(discard.rdbuf());
+                auto started = chrono::steady_clock::now();
+                ok = found->second.run(session, tokens);
+                elapsedMs = chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
+                cout.rdbuf(savedOutput);
+            }
+
+            CommandStats& entry = stats[name];
+            entry.calls++;
+            entry.totalMs += elapsedMs;
+            entry.maxMs = max(entry.maxMs, elapsedMs);
+            if (!ok) {
+                entry.failures++;
+                failures++;
+                if (stopOnError) stopped = true;
+            }
+            if (timing) {
+                out << "[" << fixed << setprecision(3) << elapsedMs << " ms] " << (ok ? "ok   " : "FAIL ")
+                    << commandLines[i] << endl;
+            }
+        }
+    }
+
+    if (!stats.empty()) {
+        cerr << "\n" << left << setw(18) << "Command" << right << setw(8) << "Calls" << setw(8) << "Failed"
+             << setw(12) << "Total ms" << setw(10) << "Mean ms" << setw(10) << "Max ms" << endl;
+    }
+    for (auto it = stats.begin(); it != stats.end(); ++it) {
+        const CommandStats& entry = it->second;
+        cerr << left << setw(18) << it->first << right << setw(8) << entry.calls << setw(8) << entry.failures
+             << fixed << setprecision(2) << setw(12) << entry.totalMs << setw(10) << entry.totalMs / entry.calls
+             << setw(10) << entry.maxMs << endl;
+    }
+
+    if (!tracePath.empty() && Trace::getInstance().exportChromeJson(tracePath)) {
+        cerr << "Trace written to " << tracePath << endl;
+    }
+    if (!ioStatsPath.empty() && IoStats::writeSnapshot(ioStatsPath, IoStats::snapshot())) {
+        cerr << "I/O counters written to " << ioStatsPath << endl;
+    }
+    return failures > 0 ? 1 : 0;
+}
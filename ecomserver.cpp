@@ -0,0 +1,976 @@
+// Local HTTP/JSON service over the backend, for clients other than the desktop GUI.
+//
+//   ./ecomserver --dir /tmp/ecom --port 8080 --threads 8
+//   curl 'http://127.0.0.1:8080/products?q=lamp&min_rating=4&limit=5'
+//   curl -X POST 'http://127.0.0.1:8080/cart/items?user=7&product=104&quantity=2'
+//   curl -X POST 'http://127.0.0.1:8080/checkout?user=7&method=VISA'
+//
+// Endpoints (all answer JSON; parameters come from the query string or a form body):
+//   GET    /products/<id>                       One product
+//   GET    /products?q=&category=&min_price=&max_price=&min_rating=&offset=&limit=
+//   GET    /cart?user=<id>                      Cart lines and total
+//   POST   /cart/items?user=&product=&quantity= Add to the cart (quantity defaults to 1)
+//   DELETE /cart/items/<productID>?user=<id>    Remove a line
+//   POST   /checkout/hold?user=<id>             Hold the cart's stock while the client pays
+//   DELETE /checkout/hold?user=<id>             Give the held stock back
+//   POST   /checkout?user=&method=&key=         Place the order and record the payment
+//   GET    /orders/<id>                         Order status and total
+//   GET    /stats                               Requests, rates and latency per route
+//
+// A fixed pool of worker threads each runs its own epoll loop over the connections the
+// acceptor hands it, so connections are kept alive and several requests pipelined on one
+// connection are answered in order. Product reads come from the in-memory ProductCatalog
+// shared by all workers; cart, order and payment calls go through the storage headers
+// under the store locks from StoreLocks.h, since those headers assume a single thread.
+// There is no authentication: the server listens on the loopback interface by default
+// and trusts the user ID it is given.
+//
+// A checkout may carry an Idempotency-Key header (or a key parameter). Retrying it with
+// the same key returns the order the first attempt placed, marked "replayed", instead of
+// placing and charging a second one (see IdempotencyIndex.h).
+//
+// ECOM_STOCK_HOLDS sets when stock is held for a shopper (see StockReservations.h);
+// product JSON carries both the stock and what is available after holds.
+//
+// Every --report seconds, and on exit (Ctrl-C), requests/s and p50/p99 latency per route
+// are printed to stderr.
+#include "include/IoStats.h"
+#include "include/StoreLocks.h"
+#include "include/LatencyHistogram.h"
+#include "include/ProductCatalog.h"
+#include "include/ProductSearch.h"
+#include "include/OrderStore.h"
+#include "include/Product.h"
+#include "include/User.h"
+#include "include/ShoppingCart.h"
+#include "include/Order.h"
+#include "include/IdempotencyIndex.h"
+#include "include/StockReservations.h"
+#include "include/Payment.h"
+
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+using namespace std;
+
+static const size_t MaxHeaderBytes = 16 * 1024;
+static const size_t MaxBodyBytes = 64 * 1024;
+static const size_t MaxPendingOutput = 1024 * 1024;   // Stop reading a pipelining client past this
+static const size_t MaxPendingInput = MaxHeaderBytes + MaxBodyBytes + 16 * 1024; // Read no further ahead than one request
+
+enum Route { RouteProduct, RouteProducts, RouteCart, RouteCartAdd, RouteCartRemove, RouteHold, RouteCheckout,
+             RouteOrder, RouteStats, RouteOther, RouteCount };
+
+static const char* routeName(int route) {
+    static const char* names[] = {"GET /products/<id>", "GET /products", "GET /cart", "POST /cart/items",
+                                  "DELETE /cart/items", "/checkout/hold", "POST /checkout", "GET /orders/<id>", "GET /stats", "other"};
+    return names[route];
+}
+
+struct HttpRequest {
+    string method;
+    string path;
+    map<string, string> params;
+    string idempotencyKey;
+    bool keepAlive;
+
+    HttpRequest() : keepAlive(true) {}
+
+    string param(const string& name) const {
+        auto found = params.find(name);
+        return found == params.end() ? string() : found->second;
+    }
+};
+
+struct HttpResponse {
+    int status;
+    string body;
+
+    HttpResponse() : status(200) {}
+    HttpResponse(int code, const string& json) : status(code), body(json) {}
+};
+
+// Latency and error counts for one worker; the lock is only contended while reporting.
+struct WorkerStats {
+    mutex lock;
+    LatencyHistogram latency[RouteCount];
+    long long errors[RouteCount];
+
+    WorkerStats() {
+        for (int i = 0; i < RouteCount; ++i) errors[i] = 0;
+    }
+};
+
+static atomic<bool> stopRequested(false);
+
+static void handleStopSignal(int) {
+    stopRequested.store(true);
+}
+
+// Swallows the backend's console chatter without touching shared stream state.
+class NullBuffer : public streambuf {
+protected:
+    int overflow(int c) override { return traits_type::not_eof(c); }
+    streamsize xsputn(const char*, streamsize count) override { return count; }
+};
+
+// --- JSON and HTTP helpers ---
+
+static string jsonString(const string& text) {
+    string out = "\"";
+    for (size_t i = 0; i < text.length(); ++i) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += static_cast<char>(c);
+        } else if (c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += static_cast<char>(c);
+        }
+    }
+    return out + "\"";
+}
+
+static string jsonNumber(double value, int decimals) {
+    ostringstream out;
+    out << fixed << setprecision(decimals) << value;
+    return out.str();
+}
+
+static HttpResponse jsonError(int status, const string& message) {
+    return HttpResponse(status, "{\"error\":" + jsonString(message) + "}");
+}
+
+static const char* statusText(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 409: return "Conflict";
+        case 413: return "Payload Too Large";
+        case 431: return "Request Header Fields Too Large";
+        default: return "Internal Server Error";
+    }
+}
+
+static string urlDecode(const string& text) {
+    string out;
+    for (size_t i = 0; i < text.length(); ++i) {
+        if (text[i] == '+') {
+            out += ' ';
+        } else if (text[i] == '%' && i + 2 < text.length() && isxdigit(static_cast<unsigned char>(text[i + 1])) &&
+                   isxdigit(static_cast<unsigned char>(text[i + 2]))) {
+            out += static_cast<char>(strtol(text.substr(i + 1, 2).c_str(), nullptr, 16));
+            i += 2;
+        } else {
+            out += text[i];
+        }
+    }
+    return out;
+}
+
+static void parseParams(const string& text, map<string, string>& params) {
+    stringstream ss(text);
+    string pair;
+    while (getline(ss, pair, '&')) {
+        if (pair.empty()) continue;
+        size_t equals = pair.find('=');
+        if (equals == string::npos) params[urlDecode(pair)] = "";
+        else params[urlDecode(pair.substr(0, equals))] = urlDecode(pair.substr(equals + 1));
+    }
+}
+
+static bool parseInt(const string& text, int& value) {
+    char* end = nullptr;
+    long parsed = strtol(text.c_str(), &end, 10);
+    if (text.empty() || *end != '\0') return false;
+    value = static_cast<int>(parsed);
+    return true;
+}
+
+static double paramDouble(const HttpRequest& request, const string& name, double fallback) {
+    string text = request.param(name);
+    return text.empty() ? fallback : atof(text.c_str());
+}
+
+static bool startsWith(const string& text, const string& prefix) {
+    return text.compare(0, prefix.length(), prefix) == 0;
+}
+
+static bool equalsIgnoreCase(const string& a, const char* b) {
+    size_t length = strlen(b);
+    if (a.length() != length) return false;
+    for (size_t i = 0; i < length; ++i) {
+        if (tolower(static_cast<unsigned char>(a[i])) != tolower(static_cast<unsigned char>(b[i]))) return false;
+    }
+    return true;
+}
+
+// --- Request handlers ---
+
+class StoreService {
+private:
+    mutex usersLock;
+    unordered_set<int> knownUsers;    // Users seen to exist; accounts are never renumbered
+
+    static string productJson(const CatalogSnapshot& catalog, int row) {
+        return "{\"id\":" + to_string(catalog.getProductID(row)) + ",\"name\":" + jsonString(catalog.getName(row)) +
+               ",\"category\":" + jsonString(catalog.getCategory(row)) + ",\"price\":" +
+               jsonNumber(catalog.getPrice(row), 2) + ",\"rating\":" + jsonNumber(catalog.getRating(row), 1) +
+               ",\"stock\":" + to_string(catalog.getStock(row)) + ",\"available\":" +
+               to_string(StockReservations::getInstance().available(catalog.getProductID(row), catalog.getStock(row))) + "}";
+    }
+
+    bool userExists(int userID) {
+        if (userID <= 0) return false;
+        {
+            lock_guard<mutex> guard(usersLock);
+            if (knownUsers.count(userID)) return true;
+        }
+        StoreLockSet locks;
+        locks.add(IoStats::Users, StoreLocks::Shared);
+        locks.acquire();
+        User* user = User::getUserByID(userID);
+        bool exists = (user != nullptr);
+        delete user;
+        if (exists) {
+            lock_guard<mutex> guard(usersLock);
+            knownUsers.insert(userID);
+        }
+        return exists;
+    }
+
+    // Reads and checks the user parameter; sets an error response if it is unusable.
+    bool requireUser(const HttpRequest& request, int& userID, HttpResponse& error) {
+        if (!parseInt(request.param("user"), userID)) {
+            error = jsonError(400, "Missing or invalid user parameter");
+            return false;
+        }
+        if (!userExists(userID)) {
+            error = jsonError(404, "Unknown user " + to_string(userID));
+            return false;
+        }
+        return true;
+    }
+
+    // Catalog reads use a snapshot rather than the products lock, so they never wait for
+    // a checkout or an edit in progress.
+    HttpResponse getProduct(int productID) {
+        shared_ptr<const CatalogSnapshot> catalog = ProductCatalog::getInstance().snapshot();
+        int row = catalog->findRow(productID);
+        if (row < 0) return jsonError(404, "Unknown product " + to_string(productID));
+        return HttpResponse(200, productJson(*catalog, row));
+    }
+
+    HttpResponse listProducts(const HttpRequest& request) {
+        long long offset = max(0LL, strtoll(request.param("offset").c_str(), nullptr, 10));
+        long long limit = request.param("limit").empty() ? 50 : strtoll(request.param("limit").c_str(), nullptr, 10);
+        limit = max(0LL, min(limit, 500LL));
+
+        shared_ptr<const CatalogSnapshot> catalog = ProductCatalog::getInstance().snapshot();
+        // Paging through a listing repeats its query; the search cache answers the repeats
+        vector<int> rows = ProductSearch::getInstance().search(catalog,
+            ProductQuery(request.param("q"), request.param("category"), paramDouble(request, "min_price", 0.0),
+                         paramDouble(request, "max_price", 1e18), paramDouble(request, "min_rating", 0.0)));
+        string body = "{\"total\":" + to_string(rows.size()) + ",\"products\":[";
+        size_t first = static_cast<size_t>(min(offset, static_cast<long long>(rows.size())));
+        size_t last = first + min(rows.size() - first, static_cast<size_t>(limit));
+        for (size_t i = first; i < last; ++i) {
+            if (i > first) body += ",";
+            body += productJson(*catalog, rows[i]);
+        }
+        return HttpResponse(200, body + "]}");
+    }
+
+    HttpResponse getCart(const HttpRequest& request) {
+        int userID;
+        HttpResponse error;
+        if (!requireUser(request, userID, error)) return error;
+
+        StoreLockSet locks;
+        locks.addUser(IoStats::Carts, userID);
+        locks.acquire();
+        ShoppingCart cart(userID);
+        vector<pair<int, int> > items = cart.getItems();
+        shared_ptr<const CatalogSnapshot> catalog = ProductCatalog::getInstance().snapshot();
+        double total = 0.0;
+        string body = "{\"user\":" + to_string(userID) + ",\"items\":[";
+        for (size_t i = 0; i < items.size(); ++i) {
+            int row = catalog->findRow(items[i].first);
+            double price = (row >= 0) ? catalog->getPrice(row) : 0.0;
+            total += price * items[i].second;
+            if (i > 0) body += ",";
+            body += "{\"product\":" + to_string(items[i].first) + ",\"quantity\":" + to_string(items[i].second) +
+                    ",\"name\":" + jsonString(row >= 0 ? catalog->getName(row) : "") + ",\"price\":" +
+                    jsonNumber(price, 2) + "}";
+        }
+        return HttpResponse(200, body + "],\"total\":" + jsonNumber(total, 2) + "}");
+    }
+
+    HttpResponse addToCart(const HttpRequest& request) {
+        int userID, productID, quantity = 1;
+        HttpResponse error;
+        if (!requireUser(request, userID, error)) return error;
+        if (!parseInt(request.param("product"), productID)) return jsonError(400, "Missing or invalid product parameter");
+        if (!request.param("quantity").empty() && (!parseInt(request.param("quantity"), quantity) || quantity <= 0)) {
+            return jsonError(400, "Quantity must be a positive integer");
+        }
+
+        StoreLockSet locks;
+        locks.add(IoStats::Products, StoreLocks::Shared);
+        locks.addUser(IoStats::Carts, userID);
+        locks.acquire();
+        ShoppingCart cart(userID);
+        if (!cart.addToCart(productID, quantity)) {
+            return jsonError(409, "Could not add product " + to_string(productID) + ": unknown or not enough stock");
+        }
+        return HttpResponse(200, "{\"ok\":true}");
+    }
+
+    HttpResponse removeFromCart(const HttpRequest& request, int productID) {
+        int userID;
+        HttpResponse error;
+        if (!requireUser(request, userID, error)) return error;
+
+        StoreLockSet locks;
+        locks.addUser(IoStats::Carts, userID);
+        locks.acquire();
+        ShoppingCart cart(userID);
+        if (!cart.removeFromCart(productID)) return jsonError(404, "Product " + to_string(productID) + " is not in the cart");
+        return HttpResponse(200, "{\"ok\":true}");
+    }
+
+    // Stock holds as in the GUI's order summary (see StockReservations.h).
+    HttpResponse holdCart(const HttpRequest& request) {
+        int userID;
+        HttpResponse error;
+        if (!requireUser(request, userID, error)) return error;
+        StockReservations& reservations = StockReservations::getInstance();
+        if (request.method == "DELETE") {
+            reservations.releaseAll(userID);
+            return HttpResponse(200, "{\"ok\":true}");
+        }
+        if (reservations.mode() == StockReservations::Off) return jsonError(409, "Stock holds are turned off");
+
+        StoreLockSet locks;
+        locks.add(IoStats::Products, StoreLocks::Shared);
+        locks.addUser(IoStats::Carts, userID);
+        locks.acquire();
+        ShoppingCart cart(userID);
+        if (cart.isEmpty()) return jsonError(409, "The cart is empty");
+        if (!cart.holdForCheckout()) return jsonError(409, "Some items are selling out and could not be held");
+        return HttpResponse(200, "{\"held\":true,\"seconds\":" + to_string(reservations.holdSeconds()) + "}");
+    }
+
+    HttpResponse checkout(const HttpRequest& request) {
+        int userID;
+        HttpResponse error;
+        if (!requireUser(request, userID, error)) return error;
+        string method = request.param("method").empty() ? "VISA" : request.param("method");
+        string key = request.idempotencyKey.empty() ? request.param("key") : request.idempotencyKey;
+        if (!key.empty() && !IdempotencyIndex::isValidKey(key)) return jsonError(400, "Invalid idempotency key");
+
+        StoreLockSet locks;
+        locks.add(IoStats::Products, StoreLocks::Exclusive);
+        locks.addUser(IoStats::Carts, userID);
+        locks.add(IoStats::Orders, StoreLocks::Exclusive);
+        locks.add(IoStats::Payments, StoreLocks::Exclusive);
+        locks.acquire();
+        if (!key.empty()) {
+            // A repeat is answered before the cart is looked at: the first attempt emptied it
+            IdempotencyIndex::Entry existing;
+            if (IdempotencyIndex::getInstance().lookup(userID, key, existing) == IdempotencyIndex::Completed) {
+                return HttpResponse(200, "{\"order\":" + to_string(existing.orderID) + ",\"total\":" +
+                                         jsonNumber(existing.total, 2) + ",\"replayed\":true}");
+            }
+        }
+        ShoppingCart cart(userID);
+        if (cart.isEmpty()) return jsonError(409, "The cart is empty");
+        Order order(0, userID, "", nullptr, "Pending");
+        int orderID = order.placeOrder(cart, key);
+        if (orderID <= 0) return jsonError(409, "The order could not be placed; an item may be out of stock");
+        Payment payment;
+        if (!payment.simulatePayment(orderID, userID, order.getOrderTotal(), method)) {
+            return jsonError(500, "Order " + to_string(orderID) + " was placed but the payment was not recorded");
+        }
+        return HttpResponse(200, "{\"order\":" + to_string(orderID) + ",\"total\":" +
+                                 jsonNumber(order.getOrderTotal(), 2) + ",\"status\":" + jsonString(order.getStatus()) + "}");
+    }
+
+    HttpResponse getOrder(int orderID) {
+        StoreLockSet locks;
+        locks.add(IoStats::Orders, StoreLocks::Shared);
+        locks.acquire();
+        OrderStore& store = OrderStore::getInstance();
+        int row = store.findRow(orderID);
+        if (row < 0) return jsonError(404, "Unknown order " + to_string(orderID));
+        return HttpResponse(200, "{\"order\":" + to_string(orderID) + ",\"user\":" + to_string(store.getUserID(row)) +
+                                 ",\"status\":" + jsonString(store.getStatus(row)) + ",\"total\":" +
+                                 jsonNumber(store.getTotal(row), 2) + ",\"items\":" + to_string(store.getItemCount(row)) + "}");
+    }
+
+public:
+    // The in-memory stores must be loaded before any worker starts: reads share them
+    // under a shared lock and must never trigger the lazy load.
+    bool load() {
+        return ProductCatalog::getInstance().load() && OrderStore::getInstance().load() &&
+               IdempotencyIndex::getInstance().ensureLoaded();
+    }
+
+    HttpResponse handle(const HttpRequest& request, Route& route) {
+        int id;
+        const string& path = request.path;
+        if (startsWith(path, "/products/") && parseInt(path.substr(10), id)) {
+            route = RouteProduct;
+            return request.method == "GET" ? getProduct(id) : jsonError(405, "Use GET");
+        } else if (path == "/products") {
+            route = RouteProducts;
+            return request.method == "GET" ? listProducts(request) : jsonError(405, "Use GET");
+        } else if (path == "/cart") {
+            route = RouteCart;
+            return request.method == "GET" ? getCart(request) : jsonError(405, "Use GET");
+        } else if (path == "/cart/items") {
+            route = RouteCartAdd;
+            return request.method == "POST" ? addToCart(request) : jsonError(405, "Use POST");
+        } else if (startsWith(path, "/cart/items/") && parseInt(path.substr(12), id)) {
+            route = RouteCartRemove;
+            return request.method == "DELETE" ? removeFromCart(request, id) : jsonError(405, "Use DELETE");
+        } else if (path == "/checkout/hold") {
+            route = RouteHold;
+            return (request.method == "POST" || request.method == "DELETE") ? holdCart(request) : jsonError(405, "Use POST or DELETE");
+        } else if (path == "/checkout") {
+            route = RouteCheckout;
+            return request.method == "POST" ? checkout(request) : jsonError(405, "Use POST");
+        } else if (startsWith(path, "/orders/") && parseInt(path.substr(8), id)) {
+            route = RouteOrder;
+            return request.method == "GET" ? getOrder(id) : jsonError(405, "Use GET");
+        }
+        route = RouteOther;
+        return jsonError(404, "No such endpoint: " + request.method + " " + path);
+    }
+};
+
+// --- Connections and workers ---
+
+struct Connection {
+    string input;
+    string output;
+    size_t outputOffset;
+    bool closeAfterWrite;
+    bool wantRead;
+    bool wantWrite;
+
+    Connection() : outputOffset(0), closeAfterWrite(false), wantRead(true), wantWrite(false) {}
+
+    size_t pendingOutput() const { return output.size() - outputOffset; }
+};
+
+class HttpServer;
+
+class Worker {
+private:
+    HttpServer& server;
+    int epollFd;
+    int wakeFd;
+    mutex pendingLock;
+    vector<int> pending;              // Accepted sockets not yet added to the epoll set
+    unordered_map<int, Connection> connections;
+    thread runner;
+
+    inline void adopt(int fd);
+    inline void closeConnection(int fd);
+    inline void setInterest(int fd, Connection& connection, bool read, bool write);
+    inline bool readInput(int fd, Connection& connection);
+    inline bool processInput(Connection& connection);
+    inline bool flushOutput(int fd, Connection& connection);
+    inline void serveEvent(int fd, unsigned events);
+    inline void run();
+
+public:
+    WorkerStats stats;
+
+    inline explicit Worker(HttpServer& owner);
+    inline ~Worker();
+
+    void start() { runner = thread(&Worker::run, this); }
+    void join() { if (runner.joinable()) runner.join(); }
+
+    // Called by the acceptor thread.
+    void hand(int fd) {
+        {
+            lock_guard<mutex> guard(pendingLock);
+            pending.push_back(fd);
+        }
+        uint64_t one = 1;
+        if (write(wakeFd, &one, sizeof(one)) < 0) {
+            // The counter only overflows after 2^64 wakes; nothing to do
+        }
+    }
+};
+
+class HttpServer {
+private:
+    int listenFd;
+    vector<Worker*> workers;
+    chrono::steady_clock::time_point startedAt;
+
+public:
+    StoreService service;
+    atomic<bool> stopping;
+
+    HttpServer() : listenFd(-1), stopping(false) {}
+    ~HttpServer() {
+        for (size_t i = 0; i < workers.size(); ++i) delete workers[i];
+        if (listenFd >= 0) close(listenFd);
+    }
+
+    bool listenOn(const string& address, int port) {
+        listenFd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listenFd < 0) return false;
+        int yes = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+        sockaddr_in bindAddress;
+        memset(&bindAddress, 0, sizeof(bindAddress));
+        bindAddress.sin_family = AF_INET;
+        bindAddress.sin_port = htons(static_cast<uint16_t>(port));
+        if (inet_pton(AF_INET, address.c_str(), &bindAddress.sin_addr) != 1) return false;
+        if (bind(listenFd, reinterpret_cast<sockaddr*>(&bindAddress), sizeof(bindAddress)) != 0) return false;
+        return listen(listenFd, 1024) == 0;
+    }
+
+    void start(int threads) {
+        startedAt = chrono::steady_clock::now();
+        for (int i = 0; i < threads; ++i) workers.push_back(new Worker(*this));
+        for (size_t i = 0; i < workers.size(); ++i) workers[i]->start();
+    }
+
+    // Accepts until a stop is requested, handing connections to the workers in turn.
+    void acceptLoop(double reportSeconds, ostream& log) {
+        size_t next = 0;
+        chrono::steady_clock::time_point lastReport = chrono::steady_clock::now();
+        chrono::steady_clock::time_point lastExpiry = lastReport;
+        long long lastCount = 0;
+        while (!stopRequested.load()) {
+            pollfd listener = {listenFd, POLLIN, 0};
+            if (poll(&listener, 1, 200) > 0) {
+                int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (fd >= 0) {
+                    int yes = 1;
+                    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+                    workers[next++ % workers.size()]->hand(fd);
+                }
+            }
+            // Expired stock holds go back on sale even while nobody touches the store
+            if (chrono::steady_clock::now() - lastExpiry >= chrono::seconds(1)) {
+                StockReservations::getInstance().expire();
+                lastExpiry = chrono::steady_clock::now();
+            }
+            if (reportSeconds > 0 && chrono::steady_clock::now() - lastReport >= chrono::duration<double>(reportSeconds)) {
+                chrono::steady_clock::time_point now = chrono::steady_clock::now();
+                LatencyHistogram all;
+                mergeStats(nullptr, &all, nullptr);
+                double interval = chrono::duration<double>(now - lastReport).count();
+                log << fixed << setprecision(0) << (all.count() - lastCount) / interval << " req/s, "
+                    << all.count() << " total, p99 since start " << LatencyHistogram::formatNs(static_cast<double>(all.valueAtPercentile(99.0)))
+                    << endl;
+                lastCount = all.count();
+                lastReport = now;
+            }
+        }
+        stopping.store(true);
+        for (size_t i = 0; i < workers.size(); ++i) workers[i]->join();
+    }
+
+    // Sums the workers' statistics, per route and/or over all routes.
+    void mergeStats(LatencyHistogram* perRoute, LatencyHistogram* all, long long* errors) {
+        for (size_t i = 0; i < workers.size(); ++i) {
+            WorkerStats& stats = workers[i]->stats;
+            lock_guard<mutex> guard(stats.lock);
+            for (int route = 0; route < RouteCount; ++route) {
+                if (perRoute) perRoute[route].merge(stats.latency[route]);
+                if (all) all->merge(stats.latency[route]);
+                if (errors) errors[route] += stats.errors[route];
+            }
+        }
+    }
+
+    double uptimeSeconds() const {
+        return chrono::duration<double>(chrono::steady_clock::now() - startedAt).count();
+    }
+
+    string statsJson() {
+        LatencyHistogram perRoute[RouteCount];
+        long long errors[RouteCount] = {0};
+        mergeStats(perRoute, nullptr, errors);
+        double seconds = uptimeSeconds();
+        string body = "{\"uptime\":" + jsonNumber(seconds, 1) + ",\"routes\":[";
+        bool first = true;
+        for (int route = 0; route < RouteCount; ++route) {
+            if (perRoute[route].count() == 0) continue;
+            if (!first) body += ",";
+            first = false;
+            body += "{\"route\":" + jsonString(routeName(route)) + ",\"requests\":" + to_string(perRoute[route].count()) +
+                    ",\"errors\":" + to_string(errors[route]) + ",\"per_second\":" +
+                    jsonNumber(perRoute[route].count() / seconds, 1) + ",\"p50_us\":" +
+                    jsonNumber(perRoute[route].valueAtPercentile(50.0) / 1e3, 1) + ",\"p99_us\":" +
+                    jsonNumber(perRoute[route].valueAtPercentile(99.0) / 1e3, 1) + ",\"max_us\":" +
+                    jsonNumber(perRoute[route].max() / 1e3, 1) + "}";
+        }
+        return body + "]}";
+    }
+
+    void printReport(ostream& out) {
+        LatencyHistogram perRoute[RouteCount];
+        LatencyHistogram all;
+        long long errors[RouteCount] = {0};
+        mergeStats(perRoute, &all, errors);
+        double seconds = uptimeSeconds();
+        out << "\n" << left << setw(22) << "Route" << right << setw(10) << "Requests" << setw(8) << "Errors"
+            << setw(10) << "Req/s" << setw(11) << "p50" << setw(11) << "p99" << setw(11) << "Max" << "\n";
+        for (int route = 0; route < RouteCount; ++route) {
+            const LatencyHistogram& latency = perRoute[route];
+            if (latency.count() == 0) continue;
+            out << left << setw(22) << routeName(route) << right << setw(10) << latency.count() << setw(8) << errors[route]
+                << fixed << setprecision(1) << setw(10) << latency.count() / seconds
+                << setw(11) << LatencyHistogram::formatNs(static_cast<double>(latency.valueAtPercentile(50.0)))
+                << setw(11) << LatencyHistogram::formatNs(static_cast<double>(latency.valueAtPercentile(99.0)))
+                << setw(11) << LatencyHistogram::formatNs(static_cast<double>(latency.max())) << "\n";
+        }
+        out << fixed << setprecision(1) << all.count() << " requests in " << seconds << " s, "
+            << all.count() / seconds << " req/s, p99 " << LatencyHistogram::formatNs(static_cast<double>(all.valueAtPercentile(99.0)))
+            << endl;
+    }
+};
+
+inline Worker::Worker(HttpServer& owner) : server(owner) {
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = wakeFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+}
+
+inline Worker::~Worker() {
+    for (auto it = connections.begin(); it != connections.end(); ++it) close(it->first);
+    close(wakeFd);
+    close(epollFd);
+}
+
+inline void Worker::adopt(int fd) {
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN | EPOLLRDHUP;
+    event.data.fd = fd;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+        close(fd);
+        return;
+    }
+    connections[fd] = Connection();
+}
+
+inline void Worker::closeConnection(int fd) {
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    connections.erase(fd);
+}
+
+inline void Worker::setInterest(int fd, Connection& connection, bool read, bool write) {
+    if (connection.wantRead == read && connection.wantWrite == write) return;
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = (read ? static_cast<uint32_t>(EPOLLIN | EPOLLRDHUP) : 0u) | (write ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+    event.data.fd = fd;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event);
+    connection.wantRead = read;
+    connection.wantWrite = write;
+}
+
+// Reads whatever the socket has, up to MaxPendingInput buffered; false once the peer has
+// closed or failed. The rest stays in the socket and is read once the input is answered.
+inline bool Worker::readInput(int fd, Connection& connection) {
+    char buffer[16384];
+    while (true) {
+        ssize_t received = read(fd, buffer, sizeof(buffer));
+        if (received > 0) {
+            connection.input.append(buffer, static_cast<size_t>(received));
+            if (static_cast<size_t>(received) < sizeof(buffer) || connection.input.size() >= MaxPendingInput) return true;
+        } else if (received == 0) {
+            return false;
+        } else {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+    }
+}
+
+// Answers every complete request in the input buffer, in order, and appends the
+// responses to the output. Returns false if the connection must be dropped.
+inline bool Worker::processInput(Connection& connection) {
+    size_t consumed = 0;
+    while (!connection.closeAfterWrite && connection.pendingOutput() < MaxPendingOutput) {
+        size_t headerEnd = connection.input.find("\r\n\r\n", consumed);
+        if (headerEnd == string::npos) {
+            if (connection.input.size() - consumed > MaxHeaderBytes) {
+                HttpResponse tooLarge = jsonError(431, "Request headers too large");
+                connection.output += "HTTP/1.1 431 " + string(statusText(431)) + "\r\nContent-Type: application/json\r\n"
+                                     "Content-Length: " + to_string(tooLarge.body.size()) + "\r\nConnection: close\r\n\r\n" +
+                                     tooLarge.body;
+                connection.closeAfterWrite = true;
+            }
+            break;
+        }
+
+        chrono::steady_clock::time_point started = chrono::steady_clock::now();
+        HttpRequest request;
+        HttpResponse response;
+        Route route = RouteOther;
+        size_t contentLength = 0;
+        bool badRequest = false;
+
+        stringstream header(connection.input.substr(consumed, headerEnd - consumed));
+        string line, target, version;
+        getline(header, line);
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        stringstream requestLine(line);
+        if (!(requestLine >> request.method >> target >> version) || !startsWith(version, "HTTP/1.")) badRequest = true;
+        request.keepAlive = (version == "HTTP/1.1");
+        while (getline(header, line)) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            size_t colon = line.find(':');
+            if (colon == string::npos) continue;
+            string name = line.substr(0, colon);
+            string value = line.substr(colon + 1);
+            value.erase(0, value.find_first_not_of(" \t"));
+            if (equalsIgnoreCase(name, "Content-Length")) {
+                contentLength = static_cast<size_t>(strtoull(value.c_str(), nullptr, 10));
+            } else if (equalsIgnoreCase(name, "Connection")) {
+                if (equalsIgnoreCase(value, "close")) request.keepAlive = false;
+                else if (equalsIgnoreCase(value, "keep-alive")) request.keepAlive = true;
+            } else if (equalsIgnoreCase(name, "Idempotency-Key")) {
+                request.idempotencyKey = value;
+            }
+        }
+
+        if (contentLength > MaxBodyBytes) {
+            response = jsonError(413, "Request body too large");
+            request.keepAlive = false;
+        } else {
+            size_t bodyStart = headerEnd + 4;
+            if (connection.input.size() < bodyStart + contentLength) break; // Wait for the rest of the body
+            consumed = bodyStart + contentLength;
+            if (badRequest) {
+                response = jsonError(400, "Malformed request line");
+                request.keepAlive = false;
+            } else {
+                size_t question = target.find('?');
+                request.path = urlDecode(target.substr(0, question));
+                if (question != string::npos) parseParams(target.substr(question + 1), request.params);
+                if (contentLength > 0) parseParams(connection.input.substr(bodyStart, contentLength), request.params);
+                if (request.path == "/stats" && request.method == "GET") {
+                    route = RouteStats;
+                    response = HttpResponse(200, server.statsJson());
+                } else {
+                    response = server.service.handle(request, route);
+                }
+            }
+        }
+
+        connection.output += "HTTP/1.1 " + to_string(response.status) + " " + statusText(response.status) +
+                             "\r\nContent-Type: application/json\r\nContent-Length: " + to_string(response.body.size()) +
+                             (request.keepAlive ? "\r\nConnection: keep-alive\r\n\r\n" : "\r\nConnection: close\r\n\r\n") +
+                             response.body;
+        if (!request.keepAlive) connection.closeAfterWrite = true;
+
+        long long elapsed = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - started).count();
+        lock_guard<mutex> guard(stats.lock);
+        stats.latency[route].record(elapsed);
+        if (response.status >= 400) stats.errors[route]++;
+        if (contentLength > MaxBodyBytes) break;
+    }
+    connection.input.erase(0, consumed);
+    return true;
+}
+
+// Writes as much pending output as the socket takes; false if the connection is done.
+inline bool Worker::flushOutput(int fd, Connection& connection) {
+    while (connection.pendingOutput() > 0) {
+        ssize_t sent = send(fd, connection.output.data() + connection.outputOffset, connection.pendingOutput(), MSG_NOSIGNAL);
+        if (sent > 0) {
+            connection.outputOffset += static_cast<size_t>(sent);
+        } else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            setInterest(fd, connection, connection.wantRead, true);
+            return true;
+        } else if (sent < 0 && errno == EINTR) {
+            continue;
+        } else {
+            return false;
+        }
+    }
+    connection.output.clear();
+    connection.outputOffset = 0;
+    setInterest(fd, connection, connection.wantRead, false);
+    return !connection.closeAfterWrite;
+}
+
+inline void Worker::serveEvent(int fd, unsigned events) {
+    auto found = connections.find(fd);
+    if (found == connections.end()) return;
+    Connection& connection = found->second;
+
+    bool open = true;
+    if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) open = readInput(fd, connection);
+    // A client may half-close after its last request; still answer what it sent
+    processInput(connection);
+    bool keep = flushOutput(fd, connection);
+    // Output drained below the limit: pick up requests that were held back
+    while (keep && !connection.input.empty() && connection.pendingOutput() == 0 && !connection.closeAfterWrite) {
+        size_t before = connection.input.size();
+        processInput(connection);
+        keep = flushOutput(fd, connection);
+        if (connection.input.size() == before) break;
+    }
+    if (!keep || (!open && connection.pendingOutput() == 0)) {
+        closeConnection(fd);
+        return;
+    }
+    // A client that does not read its responses is not read from either, so its unread
+    // requests wait in the socket rather than in memory
+    setInterest(fd, connection, open && connection.pendingOutput() < MaxPendingOutput, connection.wantWrite);
+}
+
+inline void Worker::run() {
+    epoll_event events[64];
+    while (!server.stopping.load()) {
+        int ready = epoll_wait(epollFd, events, 64, 200);
+        for (int i = 0; i < ready; ++i) {
+            if (events[i].data.fd == wakeFd) {
+                uint64_t count;
+                if (read(wakeFd, &count, sizeof(count)) < 0) {
+                    // Spurious wake; the pending list is checked either way
+                }
+                vector<int> accepted;
+                {
+                    lock_guard<mutex> guard(pendingLock);
+                    accepted.swap(pending);
+                }
+                for (size_t j = 0; j < accepted.size(); ++j) adopt(accepted[j]);
+                continue;
+            }
+            serveEvent(events[i].data.fd, events[i].events);
+        }
+    }
+}
+
+static void printUsage(const char* program) {
+    cout << "Usage: " << program << " [options]\n"
+         << "  --dir PATH          Directory holding data/ (default: the current directory)\n"
+         << "  --bind ADDRESS      Address to listen on (default 127.0.0.1)\n"
+         << "  --port N            Port to listen on (default 8080)\n"
+         << "  --threads N         Worker threads (default: hardware threads)\n"
+         << "  --report S          Print req/s and p99 every S seconds; 0 turns it off (default 10)\n";
+}
+
+int main(int argc, char* argv[]) {
+    string directory, address = "127.0.0.1";
+    int port = 8080;
+    int threads = max(1, static_cast<int>(thread::hardware_concurrency()));
+    double reportSeconds = 10.0;
+
+    for (int i = 1; i < argc; ++i) {
+        string option = argv[i];
+        if (option == "--help" || option == "-h") {
+            printUsage(argv[0]);
+            return 0;
+        } else if (i + 1 >= argc) {
+            cerr << "Error: Missing value for " << option << "." << endl;
+            printUsage(argv[0]);
+            return 2;
+        }
+        string value = argv[++i];
+        if (option == "--dir") directory = value;
+        else if (option == "--bind") address = value;
+        else if (option == "--port") port = atoi(value.c_str());
+        else if (option == "--threads") threads = max(1, atoi(value.c_str()));
+        else if (option == "--report") reportSeconds = max(0.0, atof(value.c_str()));
+        else {
+            cerr << "Error: Unknown option " << option << "." << endl;
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (!directory.empty() && chdir(directory.c_str()) != 0) {
+        cerr << "Error: Cannot change to directory " << directory << "." << endl;
+        return 1;
+    }
+    const char* directories[] = {"data", "data/cart", "data/wishlist", "data/orders", "data/reviews"};
+    for (size_t i = 0; i < sizeof(directories) / sizeof(directories[0]); ++i) mkdir(directories[i], 0755);
+    if (!Order::migrateLegacyOrders()) {
+        cerr << "Error: Could not migrate existing orders." << endl;
+        return 1;
+    }
+
+    StockReservations::getInstance().configureFromEnvironment();
+    HttpServer server;
+    if (!server.service.load()) {
+        cerr << "Error: Could not load the product catalog and order index from data/." << endl;
+        return 1;
+    }
+    if (!server.listenOn(address, port)) {
+        cerr << "Error: Cannot listen on " << address << ":" << port << " (" << strerror(errno) << ")." << endl;
+        return 1;
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handleStopSignal;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+
+    // The backend reports to the console; with many clients that is only noise
+    streambuf* savedOutput = cout.rdbuf();
+    streambuf* savedErrors = cerr.rdbuf();
+    ostream log(savedErrors);
+    NullBuffer discard;
+    log << "Serving " << ProductCatalog::getInstance().liveSize() << " products on http://" << address << ":" << port
+         << " with " << threads << " worker threads (Ctrl-C stops)" << endl;
+    cout.rdbuf(&discard);
+    cerr.rdbuf(&discard);
+    server.start(threads);
+    server.acceptLoop(reportSeconds, log);
+    cout.rdbuf(savedOutput);
+    cerr.rdbuf(savedErrors);
+
+    server.printReport(cerr);
+    return 0;
+}
@@ -0,0 +1,155 @@
+// editmergetest.cpp - Checks the merge rules of Product::editProduct(int, const Product&,
+// const Product&, string&) against a small products.txt in a scratch directory.
+//
+// Build: see compile_tools.sh. Run: ./editmergetest (exits non-zero if a check fails)
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <memory>
+#include <cstdlib>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "include/Product.h"
+#include "include/ProductCatalog.h"
+#include "include/StoreLocks.h"
+
+using namespace std;
+
+static int checks = 0;
+static int failures = 0;
+
+static void check(bool ok, const string& what) {
+    ++checks;
+    if (!ok) {
+        ++failures;
+        cerr << "FAILED: " << what << endl;
+    }
+}
+
+// Runs in a fresh directory so the data/ of the working tree is never touched
+static bool enterScratchDirectory() {
+    char dir[] = "/tmp/editmergetest.XXXXXX";
+    if (!mkdtemp(dir) || chdir(dir) != 0 || mkdir("data", 0755) != 0) return false;
+    ofstream products("data/products.txt");
+    products << "1,Desk Lamp,Home,25.00,4.0,10" << endl
+             << "2,Kettle,Kitchen,40.00,3.5,5" << endl
+             << "3,Notebook,Office,3.50,4.5,100" << endl;
+    return static_cast<bool>(products);
+}
+
+// An edit of the product as read, with the given changes
+static Product edited(const Product& original, const char* name, double price, int stock) {
+    return Product(original.getProductID(), name ? name : original.getName(), original.getCategory(), "",
+                   price, original.getRating(), stock);
+}
+
+static Product::EditResult save(int productID, const Product& original, const Product& productData, string& conflicts) {
+    StoreLockSet locks;
+    locks.add(IoStats::Products, StoreLocks::Exclusive);
+    locks.acquire();
+    return Product::editProduct(productID, original, productData, conflicts);
+}
+
+// Another writer's change, made between the read and the save
+static void changeMeanwhile(int productID, const char* name, double price, int stock) {
+    unique_ptr<Product> current(Product::getProductForEdit(productID));
+    Product productData = edited(*current, name, price, stock);
+    StoreLockSet locks;
+    locks.add(IoStats::Products, StoreLocks::Exclusive);
+    locks.acquire();
+    Product::editProduct(productID, productData);
+}
+
+static unique_ptr<Product> inFile(int productID) {
+    return unique_ptr<Product>(Product::getProductByID(productID));
+}
+
+int main() {
+    if (!enterScratchDirectory()) {
+        cerr << "Error: could not set up a scratch data directory." << endl;
+        return 1;
+    }
+    if (!ProductCatalog::getInstance().ensureLoaded()) {
+        cerr << "Error: could not load the catalog." << endl;
+        return 1;
+    }
+    string conflicts;
+
+    // Nothing changed since the read: saved as given
+    {
+        unique_ptr<Product> original(Product::getProductForEdit(1));
+        check(original && original->getVersion() != 0, "a product read for edit carries its catalog version");
+        Product::EditResult result = save(1, *original, edited(*original, "Desk Lamp XL", 27.50, 12), conflicts);
+        unique_ptr<Product> now = inFile(1);
+        check(result == Product::EditSaved, "an unchanged product is saved as given");
+        check(string(now->getName()) == "Desk Lamp XL" && now->getStock() == 12, "the edit reaches products.txt");
+    }
+
+    // The version moves on with every change, so an edit read before it is merged
+    {
+        unique_ptr<Product> original(Product::getProductForEdit(2));
+        changeMeanwhile(2, nullptr, 40.00, 3); // Two units sold
+        Product::EditResult result = save(2, *original, edited(*original, nullptr, 45.00, 5), conflicts);
+        unique_ptr<Product> now = inFile(2);
+        check(result == Product::EditMerged, "a product changed since the read is merged");
+        check(now->getPrice() > 44.99 && now->getPrice() < 45.01, "the price edited here is kept");
+        check(now->getStock() == 3, "stock sold meanwhile stays sold when stock was not edited");
+    }
+
+    // Stock edits apply as a difference on top of the current stock
+    {
+        unique_ptr<Product> original(Product::getProductForEdit(3));
+        changeMeanwhile(3, nullptr, 3.50, 90);                // Ten sold
+        Product::EditResult result = save(3, *original, edited(*original, nullptr, 3.50, 150), conflicts); // Fifty restocked
+        check(result == Product::EditMerged, "a restock merges with sales made meanwhile");
+        check(inFile(3)->getStock() == 140, "restock and sales both count");
+    }
+
+    // The same change on both sides is not a conflict
+    {
+        unique_ptr<Product> original(Product::getProductForEdit(3));
+        changeMeanwhile(3, "Notebook A5", 3.50, 140);
+        Product::EditResult result = save(3, *original, edited(*original, "Notebook A5", 3.50, 140), conflicts);
+        check(result == Product::EditMerged && conflicts.empty(), "an identical rename on both sides merges");
+    }
+
+    // Price differences under half a cent are not edits
+    {
+        unique_ptr<Product> original(Product::getProductForEdit(2));
+        changeMeanwhile(2, nullptr, 47.00, 3);
+        Product::EditResult result = save(2, *original, edited(*original, nullptr, original->getPrice() + 0.001, 3), conflicts);
+        check(result == Product::EditMerged, "a sub-cent price difference merges");
+        unique_ptr<Product> now = inFile(2);
+        check(now->getPrice() > 46.99 && now->getPrice() < 47.01, "the price changed meanwhile is kept");
+    }
+
+    // A field changed differently on both sides is a conflict, and nothing is saved
+    {
+        unique_ptr<Product> original(Product::getProductForEdit(1));
+        changeMeanwhile(1, "Floor Lamp", original->getPrice(), original->getStock());
+        Product::EditResult result = save(1, *original, edited(*original, "Reading Lamp", 30.00, original->getStock()), conflicts);
+        unique_ptr<Product> now = inFile(1);
+        check(result == Product::EditConflict && conflicts == "name", "a name changed on both sides conflicts");
+        check(string(now->getName()) == "Floor Lamp" && now->getPrice() < 27.51, "a conflicting edit saves nothing");
+    }
+
+    // Taking away more stock than is left is a conflict
+    {
+        unique_ptr<Product> original(Product::getProductForEdit(2));
+        changeMeanwhile(2, nullptr, original->getPrice(), 1);
+        Product::EditResult result = save(2, *original, edited(*original, nullptr, original->getPrice(), 0), conflicts);
+        check(result == Product::EditConflict && conflicts == "stock", "stock cannot go below zero");
+        check(inFile(2)->getStock() == 1, "the stock conflict saves nothing");
+    }
+
+    // Unknown products fail
+    {
+        Product ghost(99, "Ghost", "None", "", 1.0, 0.0, 1);
+        check(save(99, ghost, ghost, conflicts) == Product::EditFailed, "an unknown product fails");
+    }
+
+    cout << "editmergetest: " << checks << " checks, " << failures << " failed" << endl;
+    return failures == 0 ? 0 : 1;
+}
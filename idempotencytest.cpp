@@ -0,0 +1,141 @@
+// idempotencytest.cpp - Checks that checkout idempotency keys survive a restart: a repeated
+// checkout after IdempotencyIndex re-reads its log gets the first order back and takes no
+// stock, while keys withdrawn or logged for an order that was never stored are forgotten.
+//
+// Build: see compile_tools.sh. Run: ./idempotencytest (exits non-zero if a check fails)
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <memory>
+#include <vector>
+#include <cstdlib>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "include/Product.h"
+#include "include/ShoppingCart.h"
+#include "include/Order.h"
+#include "include/IdempotencyIndex.h"
+#include "include/StoreLocks.h"
+
+using namespace std;
+
+static int checks = 0;
+static int failures = 0;
+
+static void check(bool ok, const string& what) {
+    ++checks;
+    if (!ok) {
+        ++failures;
+        cerr << "FAILED: " << what << endl;
+    }
+}
+
+// Runs in a fresh directory so the data/ of the working tree is never touched
+static bool enterScratchDirectory() {
+    char dir[] = "/tmp/idempotencytest.XXXXXX";
+    if (!mkdtemp(dir) || chdir(dir) != 0) return false;
+    const char* directories[] = {"data", "data/cart", "data/wishlist", "data/orders", "data/reviews"};
+    for (size_t i = 0; i < sizeof(directories) / sizeof(directories[0]); ++i) {
+        if (mkdir(directories[i], 0755) != 0) return false;
+    }
+    ofstream products("data/products.txt");
+    products << "1,Desk Lamp,Home,25.00,4.0,10" << endl
+             << "2,Kettle,Kitchen,40.00,3.5,5" << endl;
+    return static_cast<bool>(products);
+}
+
+// Places an order for the user's cart under the key, as one checkout would.
+static int checkout(int userID, int productID, int quantity, const string& key) {
+    StoreLockSet locks;
+    locks.add(IoStats::Products, StoreLocks::Exclusive);
+    locks.addUser(IoStats::Carts, userID);
+    locks.add(IoStats::Orders, StoreLocks::Exclusive);
+    locks.acquire();
+    ShoppingCart cart(userID);
+    if (cart.isEmpty() && !cart.addToCart(productID, quantity)) return 0;
+    Order order(0, userID, "", nullptr, "Pending");
+    return order.placeOrder(cart, key);
+}
+
+static int stockOf(int productID) {
+    unique_ptr<Product> product(Product::getProductByID(productID));
+    return product ? product->getStock() : -1;
+}
+
+// What a restarted process knows: the in-memory keys are dropped and the log re-read.
+static void restart() {
+    StoreLockSet locks;
+    locks.add(IoStats::Orders, StoreLocks::Exclusive);
+    locks.acquire();
+    IdempotencyIndex::getInstance().reload();
+}
+
+static IdempotencyIndex::State stateOf(int userID, const string& key) {
+    IdempotencyIndex::Entry existing;
+    return IdempotencyIndex::getInstance().lookup(userID, key, existing);
+}
+
+int main() {
+    if (!enterScratchDirectory() || !Order::migrateLegacyOrders()) {
+        cerr << "Error: could not set up a scratch data directory." << endl;
+        return 1;
+    }
+    IdempotencyIndex& keys = IdempotencyIndex::getInstance();
+
+    // A completed checkout is answered from the log after a restart
+    int first = checkout(2, 1, 2, "retry-after-restart");
+    check(first > 0, "the first checkout places an order");
+    check(stockOf(1) == 8, "the first checkout takes the stock");
+    restart();
+    check(stateOf(2, "retry-after-restart") == IdempotencyIndex::Completed, "the key is known after a restart");
+    int repeat = checkout(2, 1, 2, "retry-after-restart");
+    check(repeat == first, "a repeat after a restart gets the first order back");
+    check(stockOf(1) == 8, "a repeat after a restart takes no stock");
+
+    // Keys are scoped to the user
+    check(stateOf(3, "retry-after-restart") == IdempotencyIndex::Unknown, "another user's key of the same name is unknown");
+
+    // A key logged for an order that never reached the segments (a crash in between) is dropped
+    {
+        ofstream log("data/orders/idempotency.txt", ios::app);
+        log << "2,lost-order," << first + 1 << ",25.00,0" << endl;
+    }
+    restart();
+    check(stateOf(2, "lost-order") == IdempotencyIndex::Unknown, "a key whose order was not stored is forgotten");
+    check(stateOf(2, "retry-after-restart") == IdempotencyIndex::Completed, "stored orders keep their keys");
+
+    // A withdrawn key stays withdrawn after a restart
+    {
+        IdempotencyIndex::Entry existing;
+        check(keys.claim(2, "withdrawn", existing) == IdempotencyIndex::Unknown, "a new key can be claimed");
+        IdempotencyIndex::Completion completion;
+        completion.userID = 2;
+        completion.key = "withdrawn";
+        completion.orderID = first;
+        completion.total = 50.0;
+        vector<IdempotencyIndex::Completion> completions(1, completion);
+        keys.complete(completions);
+        keys.withdraw(completions);
+    }
+    restart();
+    check(stateOf(2, "withdrawn") == IdempotencyIndex::Unknown, "a withdrawn key is forgotten after a restart");
+
+    // The key of a checkout that placed no order can be used again
+    {
+        StoreLockSet locks;
+        locks.add(IoStats::Products, StoreLocks::Exclusive);
+        locks.addUser(IoStats::Carts, 4);
+        locks.acquire();
+        ShoppingCart cart(4);
+        cart.addToCart(2, 3);
+        Product::editProduct(2, Product(2, "Kettle", "Kitchen", "", 40.00, 3.5, 1)); // Sold meanwhile
+    }
+    int soldOut = checkout(4, 2, 3, "too-many");
+    check(soldOut == 0, "a checkout beyond the stock fails");
+    check(stateOf(4, "too-many") == IdempotencyIndex::Unknown, "a failed checkout releases its key");
+
+    cout << "idempotencytest: " << checks << " checks, " << failures << " failed" << endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,710 @@
+// Flash-sale load simulator: virtual shoppers browse, search, fill carts and check out
+// against the real storage code from several threads at once.
+//
+//   ./loadsim --dir /tmp/ecom --threads 8 --shoppers 2000 --duration 30
+//   ./loadsim --dir /tmp/ecom --mode open --rate 400 --mix 40:20:25:15 --histograms
+//
+// Closed loop: every shopper waits for its previous operation, then thinks for an
+// exponentially distributed time (--think-ms) before the next one. Open loop: operations
+// arrive as a Poisson stream of --rate per second regardless of how the store keeps up;
+// latency is measured from the scheduled arrival, so queueing delay is included rather
+// than hidden (no coordinated omission).
+//
+// Before the run, --sale-products of the most popular products get --sale-stock units
+// each and a share of the cart adds (--sale-share) goes to them. At the end the sold
+// quantities from the placed orders are checked against the stock that was there, so
+// overselling or a lost stock update shows up in the report.
+//
+// The storage headers assume a single thread. Each operation therefore takes the store
+// locks it needs from StoreLocks.h first (--no-locks skips them, to expose the races; it
+// can corrupt the data set). Lock waits and the I/O counters from IoStats.h make up the
+// contention section of the report. Run it on a copy of a generated data set.
+//
+// --pipeline sends checkouts through CheckoutPipeline.h instead of one Order::placeOrder
+// each; the report then also shows how many checkouts each stage batched together.
+//
+// Every checkout carries an idempotency key. --repeat-share of them are sent twice, the
+// way a double click or a client retry would: through the pipeline the repeat is submitted
+// while the first is still in flight, otherwise right after it. A repeat must come back
+// with the first checkout's order; one that placed a second order also shows up as a
+// stock mismatch.
+//
+// ECOM_STOCK_HOLDS=cart[:seconds] makes every cart add hold its stock (see
+// StockReservations.h), so sale items sit in carts instead of being oversubscribed.
+//
+// --hot-counters gates pipeline checkouts of the sale products on sharded stock counters
+// (ShardedStockCounter.h); after the run each counter must match the stock left.
+#include "include/IoStats.h"
+#include "include/StoreLocks.h"
+#include "include/LatencyHistogram.h"
+#include "include/DataGenerator.h"
+#include "include/Product.h"
+#include "include/User.h"
+#include "include/ShoppingCart.h"
+#include "include/Order.h"
+#include "include/Payment.h"
+#include "include/CheckoutPipeline.h"
+#include "include/IdempotencyIndex.h"
+#include "include/StockReservations.h"
+#include "include/ShardedStockCounter.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <queue>
+#include <atomic>
+#include <thread>
+#include <future>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+enum ShopperOperation { OpLogin, OpBrowse, OpSearch, OpCartAdd, OpCheckout, OperationCount };
+
+static const char* operationName(int operation) {
+    static const char* names[] = {"login", "browse", "search", "cart-add", "checkout"};
+    return names[operation];
+}
+
+struct LoadConfig {
+    string directory;
+    int threads;
+    int shoppers;
+    double durationSeconds;
+    int mix[OperationCount];     // Weights of browse, search, cart-add and checkout; login is implicit
+    double thinkMs;
+    bool openLoop;
+    double arrivalRate;
+    double zipfExponent;
+    unsigned long long seed;
+    int saleProducts;
+    int saleStock;
+    double saleShare;
+    double repeatShare;
+    bool useLocks;
+    bool usePipeline;
+    bool hotCounters;
+    bool histograms;
+
+    LoadConfig() : threads(8), shoppers(1000), durationSeconds(10.0), thinkMs(200.0), openLoop(false),
+                   arrivalRate(200.0), zipfExponent(1.0), seed(42), saleProducts(5), saleStock(200),
+                   saleShare(0.5), repeatShare(0.0), useLocks(true), usePipeline(false), hotCounters(false), histograms(false) {
+        mix[OpLogin] = 0;
+        mix[OpBrowse] = 50;
+        mix[OpSearch] = 20;
+        mix[OpCartAdd] = 20;
+        mix[OpCheckout] = 10;
+    }
+};
+
+// What one worker thread measured; merged after the run.
+struct WorkerResults {
+    LatencyHistogram latency[OperationCount];
+    long long failures[OperationCount];
+    map<int, long long> sold;        // productID -> units in orders this worker placed
+    long long orders;
+    double revenue;
+    long long repeats;               // Checkouts sent a second time under the same key
+    long long repeatMismatches;      // Repeats that did not get the first checkout's order back
+
+    WorkerResults() : orders(0), revenue(0.0), repeats(0), repeatMismatches(0) {
+        for (int i = 0; i < OperationCount; ++i) failures[i] = 0;
+    }
+};
+
+struct Shopper {
+    int userID;                      // Account the shopper logs in as
+    bool loggedIn;
+
+    Shopper() : userID(0), loggedIn(false) {}
+};
+
+// Shared by all workers; everything they write to is either per-thread or per-shopper.
+struct Simulation {
+    const LoadConfig& config;
+    vector<Shopper> shoppers;
+    vector<int> productIDs;          // Sorted by popularity rank, most popular first
+    vector<int> saleProductIDs;
+    ZipfSampler productPopularity;
+    int mixTotal;
+
+    Simulation(const LoadConfig& cfg, const vector<int>& products)
+        : config(cfg), productIDs(products), productPopularity(static_cast<long long>(products.size()), cfg.zipfExponent),
+          mixTotal(0) {
+        for (int i = OpBrowse; i < OperationCount; ++i) mixTotal += config.mix[i];
+        for (int i = 0; i < config.saleProducts && i < static_cast<int>(productIDs.size()); ++i) {
+            saleProductIDs.push_back(productIDs[i]);
+        }
+    }
+};
+
+// Swallows the backend's console chatter. Only the buffer is replaced: the backend still
+// sets cout's format flags (setw, fixed, setprecision) from every worker at once. Those
+// writes race with each other, but only over the formatting of output that is thrown
+// away, and main() restores cout's format once the workers are done.
+class NullBuffer : public streambuf {
+protected:
+    int overflow(int c) override { return traits_type::not_eof(c); }
+    streamsize xsputn(const char*, streamsize count) override { return count; }
+};
+
+typedef chrono::steady_clock Clock;
+
+static long long elapsedNs(Clock::time_point from, Clock::time_point to) {
+    return chrono::duration_cast<chrono::nanoseconds>(to - from).count();
+}
+
+static void printUsage(const char* program) {
+    cout << "Usage: " << program << " [options]\n"
+         << "  --dir PATH          Directory holding data/ (default: the current directory)\n"
+         << "  --threads N         Worker threads (default 8)\n"
+         << "  --shoppers N        Virtual shoppers (default 1000)\n"
+         << "  --duration S        Seconds to run (default 10)\n"
+         << "  --mix B:S:C:O       Weights of browse, search, cart-add, checkout (default 50:20:20:10)\n"
+         << "  --think-ms MS       Mean think time between a shopper's operations (default 200)\n"
+         << "  --mode closed|open  Closed loop (think times) or open loop (arrival rate)\n"
+         << "  --rate N            Open loop: operations per second (default 200)\n"
+         << "  --zipf S            Product popularity skew, 0 is uniform (default 1.0)\n"
+         << "  --seed N            Workload seed (default 42)\n"
+         << "  --sale-products N   Products on sale (default 5)\n"
+         << "  --sale-stock N      Stock each sale product starts with (default 200)\n"
+         << "  --sale-share F      Share of cart adds that go to sale products (default 0.5)\n"
+         << "  --repeat-share F    Share of checkouts sent twice with the same key (default 0)\n"
+         << "  --no-locks          Run without store locks (exposes races, may corrupt data)\n"
+         << "  --pipeline          Check out through the staged checkout pipeline\n"
+         << "  --hot-counters      With --pipeline, admit sale products through sharded stock counters\n"
+         << "  --histograms        Print the full percentile ladder per operation\n";
+}
+
+static bool parseMix(const string& text, LoadConfig& config) {
+    stringstream ss(text);
+    string part;
+    int index = OpBrowse;
+    while (getline(ss, part, ':')) {
+        if (index >= OperationCount) return false;
+        int weight = atoi(part.c_str());
+        if (weight < 0) return false;
+        config.mix[index++] = weight;
+    }
+    return index == OperationCount;
+}
+
+static int countUsers() {
+    TrackedIfstream in(IoStats::Users, "data/users.txt");
+    string line;
+    int count = 0;
+    while (getline(in, line)) {
+        if (!line.empty()) count++;
+    }
+    return count;
+}
+
+// Current stock of every product, keyed by ID.
+static map<int, int> readStock() {
+    map<int, int> stock;
+    int count = 0;
+    Product* products = Product::loadAllProducts(count);
+    for (int i = 0; i < count; ++i) stock[products[i].getProductID()] = products[i].getStock();
+    delete[] products;
+    return stock;
+}
+
+static bool setSaleStock(const vector<int>& productIDs, int units) {
+    for (size_t i = 0; i < productIDs.size(); ++i) {
+        Product* product = Product::getProductByID(productIDs[i]);
+        if (!product) return false;
+        product->setStock(units);
+        bool saved = Product::editProduct(productIDs[i], *product);
+        delete product;
+        if (!saved) return false;
+    }
+    return true;
+}
+
+class ShopperDriver {
+private:
+    Simulation& sim;
+    WorkerResults& results;
+    GeneratorRandom random;
+
+    int pickProduct() {
+        long long rank = sim.productPopularity.sample(random);
+        return sim.productIDs[static_cast<size_t>(rank - 1)];
+    }
+
+    int pickCartProduct() {
+        if (!sim.saleProductIDs.empty() && random.uniform() < sim.config.saleShare) {
+            return sim.saleProductIDs[static_cast<size_t>(random.below(static_cast<long long>(sim.saleProductIDs.size())))];
+        }
+        return pickProduct();
+    }
+
+    void lock(StoreLockSet& locks) {
+        if (sim.config.useLocks) locks.acquire();
+    }
+
+    bool login(Shopper& shopper) {
+        StoreLockSet locks;
+        locks.add(IoStats::Users, StoreLocks::Shared);
+        lock(locks);
+        User user;
+        string name = (shopper.userID == 1) ? "admin" : "user" + to_string(shopper.userID);
+        shopper.loggedIn = user.loginUser(name, "pass" + to_string(shopper.userID));
+        return shopper.loggedIn;
+    }
+
+    bool browse() {
+        StoreLockSet locks;
+        locks.add(IoStats::Products, StoreLocks::Shared);
+        lock(locks);
+        Product* product = Product::getProductByID(pickProduct());
+        bool found = (product != nullptr);
+        delete product;
+        return found;
+    }
+
+    bool search() {
+        // First word of a real product name, so searches find something
+        StoreLockSet locks;
+        locks.add(IoStats::Products, StoreLocks::Shared);
+        lock(locks);
+        Product* product = Product::getProductByID(pickProduct());
+        if (!product || !product->getName()) {
+            delete product;
+            return false;
+        }
+        string name = product->getName();
+        delete product;
+        Product::searchByName(name.substr(0, name.find(' ')));
+        return true;
+    }
+
+    bool addToCart(const Shopper& shopper) {
+        StoreLockSet locks;
+        locks.add(IoStats::Products, StoreLocks::Shared);
+        locks.addUser(IoStats::Carts, shopper.userID);
+        lock(locks);
+        ShoppingCart cart(shopper.userID);
+        return cart.addToCart(pickCartProduct(), 1);
+    }
+
+    bool checkoutThroughPipeline(const Shopper& shopper) {
+        {
+            StoreLockSet locks;
+            locks.add(IoStats::Products, StoreLocks::Shared);
+            locks.addUser(IoStats::Carts, shopper.userID);
+            lock(locks);
+            ShoppingCart cart(shopper.userID);
+            if (cart.isEmpty() && !cart.addToCart(pickCartProduct(), 1)) return false;
+        }
+        CheckoutPipeline& pipeline = CheckoutPipeline::getInstance();
+        string key = IdempotencyIndex::generateKey();
+        CheckoutProgress outcome;
+        if (sim.config.repeatShare <= 0.0 || random.uniform() >= sim.config.repeatShare) {
+            outcome = pipeline.checkout(shopper.userID, "VISA", key);
+        } else {
+            // A double click: the repeat goes in while the first is still in the pipeline
+            shared_ptr<promise<CheckoutProgress> > first = make_shared<promise<CheckoutProgress> >();
+            shared_ptr<promise<CheckoutProgress> > second = make_shared<promise<CheckoutProgress> >();
+            future<CheckoutProgress> firstResult = first->get_future();
+            future<CheckoutProgress> secondResult = second->get_future();
+            if (pipeline.submit(shopper.userID, "VISA", [first](const CheckoutProgress& progress) { first->set_value(progress); }, key) == 0 ||
+                pipeline.submit(shopper.userID, "VISA", [second](const CheckoutProgress& progress) { second->set_value(progress); }, key) == 0) {
+                return false;
+            }
+            outcome = firstResult.get();
+            CheckoutProgress repeated = secondResult.get();
+            results.repeats++;
+            bool bothPlaced = (outcome.stage == CheckoutStage::Completed && repeated.stage == CheckoutStage::Completed);
+            if (bothPlaced && repeated.orderID != outcome.orderID) results.repeatMismatches++;
+            if (!bothPlaced && repeated.stage == CheckoutStage::Completed) {
+                // The first failed and gave up the key, so the repeat was a checkout of its own
+                outcome = repeated;
+            }
+        }
+        if (outcome.stage != CheckoutStage::Completed) {
+            StoreLockSet locks;
+            locks.addUser(IoStats::Carts, shopper.userID);
+            lock(locks);
+            ShoppingCart cart(shopper.userID);
+            cart.clearCart();
+            return false;
+        }
+        for (size_t i = 0; i < outcome.items.size(); ++i) results.sold[outcome.items[i].productID] += outcome.items[i].quantity;
+        results.orders++;
+        results.revenue += outcome.total;
+        return true;
+    }
+
+    bool checkout(const Shopper& shopper) {
+        if (sim.config.usePipeline) return checkoutThroughPipeline(shopper);
+        StoreLockSet locks;
+        locks.add(IoStats::Products, StoreLocks::Exclusive);
+        locks.addUser(IoStats::Carts, shopper.userID);
+        locks.add(IoStats::Orders, StoreLocks::Exclusive);
+        locks.add(IoStats::Payments, StoreLocks::Exclusive);
+        lock(locks);
+
+        ShoppingCart cart(shopper.userID);
+        // Impatient shoppers buy a sale item straight away
+        if (cart.isEmpty() && !cart.addToCart(pickCartProduct(), 1)) return false;
+
+        Order order(0, shopper.userID, "", nullptr, "Pending");
+        string key = IdempotencyIndex::generateKey();
+        int orderID = order.placeOrder(cart, key);
+        if (orderID <= 0) {
+            // Something in the cart sold out; the shopper gives up on it
+            cart.clearCart();
+            return false;
+        }
+        if (sim.config.repeatShare > 0.0 && random.uniform() < sim.config.repeatShare) {
+            // A retry after the first attempt went through
+            Order repeat(0, shopper.userID, "", nullptr, "Pending");
+            results.repeats++;
+            if (repeat.placeOrder(cart, key) != orderID) results.repeatMismatches++;
+        }
+        vector<OrderLineItem> items = Order::parseLineItems(order.getOrderItems());
+        for (size_t i = 0; i < items.size(); ++i) results.sold[items[i].productID] += items[i].quantity;
+        results.orders++;
+        results.revenue += order.getOrderTotal();
+
+        Payment payment;
+        return payment.simulatePayment(orderID, shopper.userID, order.getOrderTotal(), "VISA");
+    }
+
+public:
+    ShopperDriver(Simulation& simulation, WorkerResults& workerResults, uint64_t seed)
+        : sim(simulation), results(workerResults), random(seed) {}
+
+    // A shopper's first operation is always the login.
+    int pickOperation(const Shopper& shopper) {
+        if (!shopper.loggedIn) return OpLogin;
+        long long roll = random.below(max(1, sim.mixTotal));
+        for (int operation = OpBrowse; operation < OperationCount; ++operation) {
+            roll -= sim.config.mix[operation];
+            if (roll < 0) return operation;
+        }
+        return OpBrowse;
+    }
+
+    double thinkNs() {
+        return -log(1.0 - random.uniform()) * sim.config.thinkMs * 1e6;
+    }
+
+    double interArrivalNs(double ratePerThread) {
+        return -log(1.0 - random.uniform()) / ratePerThread * 1e9;
+    }
+
+    size_t pickShopper() {
+        return static_cast<size_t>(random.below(static_cast<long long>(sim.shoppers.size())));
+    }
+
+    // Runs one operation and records its latency, measured from startedAt.
+    void run(Shopper& shopper, int operation, Clock::time_point startedAt) {
+        bool ok = false;
+        switch (operation) {
+            case OpLogin: ok = login(shopper); break;
+            case OpBrowse: ok = browse(); break;
+            case OpSearch: ok = search(); break;
+            case OpCartAdd: ok = addToCart(shopper); break;
+            case OpCheckout: ok = checkout(shopper); break;
+        }
+        results.latency[operation].record(elapsedNs(startedAt, Clock::now()));
+        if (!ok) results.failures[operation]++;
+    }
+};
+
+// Closed loop: this worker owns shoppers first, first + stride, ... and always serves the
+// one whose think time ends first.
+static void runClosedLoop(Simulation& sim, WorkerResults& results, int worker, Clock::time_point deadline) {
+    ShopperDriver driver(sim, results, GeneratorRandom::derive(sim.config.seed, 0x10AD, static_cast<uint64_t>(worker)));
+    typedef pair<Clock::time_point, size_t> ReadyShopper;
+    priority_queue<ReadyShopper, vector<ReadyShopper>, greater<ReadyShopper> > ready;
+    Clock::time_point start = Clock::now();
+    for (size_t i = static_cast<size_t>(worker); i < sim.shoppers.size(); i += static_cast<size_t>(sim.config.threads)) {
+        // Stagger arrivals over one think time so shoppers do not all log in at once
+        ready.push(make_pair(start + chrono::nanoseconds(static_cast<long long>(driver.thinkNs())), i));
+    }
+
+    while (!ready.empty()) {
+        ReadyShopper next = ready.top();
+        ready.pop();
+        if (next.first >= deadline) break;
+        this_thread::sleep_until(next.first);
+
+        Shopper& shopper = sim.shoppers[next.second];
+        Clock::time_point startedAt = Clock::now();
+        driver.run(shopper, driver.pickOperation(shopper), startedAt);
+        ready.push(make_pair(Clock::now() + chrono::nanoseconds(static_cast<long long>(driver.thinkNs())), next.second));
+    }
+}
+
+// Open loop: this worker serves its share of a Poisson arrival stream. Arrivals that find
+// the worker busy start late, and the wait counts towards their latency.
+static void runOpenLoop(Simulation& sim, WorkerResults& results, int worker, Clock::time_point deadline) {
+    ShopperDriver driver(sim, results, GeneratorRandom::derive(sim.config.seed, 0x0BE2, static_cast<uint64_t>(worker)));
+    double ratePerThread = sim.config.arrivalRate / sim.config.threads;
+    Clock::time_point scheduled = Clock::now();
+    while (true) {
+        scheduled += chrono::nanoseconds(static_cast<long long>(driver.interArrivalNs(ratePerThread)));
+        if (scheduled >= deadline) break;
+        this_thread::sleep_until(scheduled);
+
+        // Shoppers are shared between workers here, so keep each shopper on one worker
+        size_t index = driver.pickShopper();
+        index -= index % static_cast<size_t>(sim.config.threads);
+        index += static_cast<size_t>(worker);
+        if (index >= sim.shoppers.size()) index = static_cast<size_t>(worker) % sim.shoppers.size();
+
+        Shopper& shopper = sim.shoppers[index];
+        driver.run(shopper, driver.pickOperation(shopper), scheduled);
+    }
+}
+
+static void printContention(double seconds) {
+    StoreLocks& locks = StoreLocks::getInstance();
+    IoStats::Snapshot io = IoStats::snapshot();
+    cout << "\nStore contention\n"
+         << left << setw(10) << "Store" << right << setw(10) << "Shared" << setw(10) << "Excl"
+         << setw(11) << "Waited" << setw(12) << "Wait total" << setw(12) << "Wait max"
+         << setw(9) << "Opens/s" << setw(11) << "Read MB" << setw(11) << "Write MB" << setw(10) << "Rewrites" << "\n";
+    for (int store = 0; store < IoStats::StoreCount; ++store) {
+        StoreLocks::StatsSnapshot lockStats = locks.snapshot(static_cast<IoStats::Store>(store));
+        long long acquisitions = lockStats.sharedAcquisitions + lockStats.exclusiveAcquisitions;
+        if (acquisitions == 0 && io.values[store][IoStats::Opens] == 0) continue;
+        ostringstream waited;
+        waited << fixed << setprecision(1) << (acquisitions ? 100.0 * lockStats.contended / acquisitions : 0.0) << "%";
+        cout << left << setw(10) << IoStats::storeName(store) << right
+             << setw(10) << lockStats.sharedAcquisitions << setw(10) << lockStats.exclusiveAcquisitions
+             << setw(11) << waited.str()
+             << setw(12) << LatencyHistogram::formatNs(static_cast<double>(lockStats.waitNs))
+             << setw(12) << LatencyHistogram::formatNs(static_cast<double>(lockStats.maxWaitNs))
+             << fixed << setprecision(0) << setw(9) << io.values[store][IoStats::Opens] / seconds
+             << setprecision(1) << setw(11) << io.values[store][IoStats::BytesRead] / 1e6
+             << setw(11) << io.values[store][IoStats::BytesWritten] / 1e6
+             << setw(10) << io.values[store][IoStats::TempRewrites] << "\n";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    LoadConfig config;
+    for (int i = 1; i < argc; ++i) {
+        string option = argv[i];
+        bool hasValue = (i + 1 < argc);
+        if (option == "--help" || option == "-h") {
+            printUsage(argv[0]);
+            return 0;
+        } else if (option == "--no-locks") {
+            config.useLocks = false;
+        } else if (option == "--pipeline") {
+            config.usePipeline = true;
+        } else if (option == "--hot-counters") {
+            config.hotCounters = true;
+        } else if (option == "--histograms") {
+            config.histograms = true;
+        } else if (!hasValue) {
+            cerr << "Error: Missing value for " << option << "." << endl;
+            printUsage(argv[0]);
+            return 2;
+        } else {
+            string value = argv[++i];
+            if (option == "--dir") config.directory = value;
+            else if (option == "--threads") config.threads = max(1, atoi(value.c_str()));
+            else if (option == "--shoppers") config.shoppers = max(1, atoi(value.c_str()));
+            else if (option == "--duration") config.durationSeconds = max(0.1, atof(value.c_str()));
+            else if (option == "--think-ms") config.thinkMs = max(0.0, atof(value.c_str()));
+            else if (option == "--rate") config.arrivalRate = max(0.1, atof(value.c_str()));
+            else if (option == "--zipf") config.zipfExponent = max(0.0, atof(value.c_str()));
+            else if (option == "--seed") config.seed = strtoull(value.c_str(), nullptr, 10);
+            else if (option == "--sale-products") config.saleProducts = max(0, atoi(value.c_str()));
+            else if (option == "--sale-stock") config.saleStock = max(0, atoi(value.c_str()));
+            else if (option == "--sale-share") config.saleShare = min(1.0, max(0.0, atof(value.c_str())));
+            else if (option == "--repeat-share") config.repeatShare = min(1.0, max(0.0, atof(value.c_str())));
+            else if (option == "--mode" && (value == "closed" || value == "open")) config.openLoop = (value == "open");
+            else if (option == "--mix" && parseMix(value, config)) {}
+            else {
+                cerr << "Error: Bad option " << option << " " << value << "." << endl;
+                printUsage(argv[0]);
+                return 2;
+            }
+        }
+    }
+
+    if (!config.directory.empty() && chdir(config.directory.c_str()) != 0) {
+        cerr << "Error: Cannot change to directory " << config.directory << "." << endl;
+        return 1;
+    }
+    const char* directories[] = {"data", "data/cart", "data/wishlist", "data/orders", "data/reviews"};
+    for (size_t i = 0; i < sizeof(directories) / sizeof(directories[0]); ++i) mkdir(directories[i], 0755);
+    if (!Order::migrateLegacyOrders()) {
+        cerr << "Error: Could not migrate existing orders." << endl;
+        return 1;
+    }
+
+    StockReservations::getInstance().configureFromEnvironment();
+    int users = countUsers();
+    map<int, int> initialStock = readStock();
+    if (users < 2 || initialStock.empty()) {
+        cerr << "Error: No users or products under data/; generate a data set with datagen first." << endl;
+        return 1;
+    }
+
+    // Popularity rank follows product ID: the lowest IDs are the hottest and go on sale
+    vector<int> productIDs;
+    for (auto it = initialStock.begin(); it != initialStock.end(); ++it) productIDs.push_back(it->first);
+    Simulation sim(config, productIDs);
+    if (sim.mixTotal == 0) {
+        cerr << "Error: The operation mix has no weight." << endl;
+        return 2;
+    }
+
+    streambuf* savedOutput = cout.rdbuf();
+    streambuf* savedErrors = cerr.rdbuf();
+    NullBuffer discard;
+    cout.rdbuf(&discard);
+    bool saleReady = setSaleStock(sim.saleProductIDs, config.saleStock);
+    cout.rdbuf(savedOutput);
+    if (!saleReady) {
+        cerr << "Error: Could not set the stock of the sale products." << endl;
+        return 1;
+    }
+    for (size_t i = 0; i < sim.saleProductIDs.size(); ++i) initialStock[sim.saleProductIDs[i]] = config.saleStock;
+    if (config.hotCounters) {
+        for (size_t i = 0; i < sim.saleProductIDs.size(); ++i) HotStockCounters::getInstance().track(sim.saleProductIDs[i]);
+    }
+
+    // Shoppers log in as users 2..N (user 1 is the administrator), wrapping if there are fewer
+    sim.shoppers.resize(static_cast<size_t>(config.shoppers));
+    for (size_t i = 0; i < sim.shoppers.size(); ++i) sim.shoppers[i].userID = 2 + static_cast<int>(i % static_cast<size_t>(users - 1));
+
+    cout << "loadsim: " << config.threads << " threads, " << config.shoppers << " shoppers, "
+         << (config.openLoop ? "open loop at " + to_string(static_cast<int>(config.arrivalRate)) + " ops/s"
+                             : "closed loop, think " + to_string(static_cast<int>(config.thinkMs)) + " ms")
+         << ", " << config.durationSeconds << " s, mix " << config.mix[OpBrowse] << ":" << config.mix[OpSearch] << ":"
+         << config.mix[OpCartAdd] << ":" << config.mix[OpCheckout] << ", " << sim.saleProductIDs.size()
+         << " sale products x " << config.saleStock << (config.useLocks ? "" : ", NO LOCKS")
+         << (config.usePipeline ? ", checkout pipeline" : "") << (config.hotCounters ? ", hot counters" : "") << endl;
+
+    IoStats::reset();
+    StoreLocks::getInstance().resetStats();
+    vector<WorkerResults> results(static_cast<size_t>(config.threads));
+    ios savedFormat(nullptr);
+    savedFormat.copyfmt(cout);
+    cout.rdbuf(&discard);
+    cerr.rdbuf(&discard);
+    if (config.usePipeline) CheckoutPipeline::getInstance().start();
+    Clock::time_point start = Clock::now();
+    Clock::time_point deadline = start + chrono::nanoseconds(static_cast<long long>(config.durationSeconds * 1e9));
+    vector<thread> workers;
+    for (int worker = 0; worker < config.threads; ++worker) {
+        workers.push_back(thread([&sim, &results, &config, worker, deadline]() {
+            if (config.openLoop) runOpenLoop(sim, results[static_cast<size_t>(worker)], worker, deadline);
+            else runClosedLoop(sim, results[static_cast<size_t>(worker)], worker, deadline);
+        }));
+    }
+    for (size_t i = 0; i < workers.size(); ++i) workers[i].join();
+    double seconds = elapsedNs(start, Clock::now()) / 1e9;
+    vector<CheckoutPipeline::StageStats> stageStats = CheckoutPipeline::getInstance().stageStats();
+    CheckoutPipeline::getInstance().stop();
+    map<int, int> finalStock = readStock();
+    cout.rdbuf(savedOutput);
+    cerr.rdbuf(savedErrors);
+    cout.copyfmt(savedFormat); // Whatever the backend's output left set
+
+    // Merge the per-thread results
+    WorkerResults total;
+    for (size_t i = 0; i < results.size(); ++i) {
+        for (int operation = 0; operation < OperationCount; ++operation) {
+            total.latency[operation].merge(results[i].latency[operation]);
+            total.failures[operation] += results[i].failures[operation];
+        }
+        for (auto it = results[i].sold.begin(); it != results[i].sold.end(); ++it) total.sold[it->first] += it->second;
+        total.orders += results[i].orders;
+        total.revenue += results[i].revenue;
+        total.repeats += results[i].repeats;
+        total.repeatMismatches += results[i].repeatMismatches;
+    }
+
+    long long operations = 0, failures = 0;
+    cout << "\n" << left << setw(10) << "Operation" << right << setw(9) << "Count" << setw(9) << "Failed"
+         << setw(9) << "Ops/s" << setw(11) << "p50" << setw(11) << "p90" << setw(11) << "p99"
+         << setw(11) << "p99.9" << setw(11) << "Max" << "\n";
+    for (int operation = 0; operation < OperationCount; ++operation) {
+        const LatencyHistogram& latency = total.latency[operation];
+        operations += latency.count();
+        failures += total.failures[operation];
+        cout << left << setw(10) << operationName(operation) << right << setw(9) << latency.count()
+             << setw(9) << total.failures[operation] << fixed << setprecision(1) << setw(9) << latency.count() / seconds
+             << setw(11) << LatencyHistogram::formatNs(static_cast<double>(latency.valueAtPercentile(50.0)))
+             << setw(11) << LatencyHistogram::formatNs(static_cast<double>(latency.valueAtPercentile(90.0)))
+             << setw(11) << LatencyHistogram::formatNs(static_cast<double>(latency.valueAtPercentile(99.0)))
+             << setw(11) << LatencyHistogram::formatNs(static_cast<double>(latency.valueAtPercentile(99.9)))
+             << setw(11) << LatencyHistogram::formatNs(static_cast<double>(latency.max())) << "\n";
+    }
+    cout << fixed << setprecision(1) << "\nThroughput: " << operations / seconds << " ops/s over " << seconds
+         << " s (" << operations << " operations, " << failures << " failed)\n"
+         << "Orders: " << total.orders << setprecision(2) << ", revenue " << total.revenue << "\n";
+
+    // Every unit sold must have come out of stock that existed
+    long long oversold = 0, mismatched = 0, saleUnitsSold = 0;
+    for (auto it = initialStock.begin(); it != initialStock.end(); ++it) {
+        long long sold = total.sold.count(it->first) ? total.sold[it->first] : 0;
+        auto after = finalStock.find(it->first);
+        if (sold > it->second) {
+            oversold++;
+            cout << "OVERSOLD product " << it->first << ": " << sold << " sold from stock of " << it->second << "\n";
+        }
+        if (after == finalStock.end() || after->second != it->second - sold) {
+            mismatched++;
+            cout << "STOCK MISMATCH product " << it->first << ": started " << it->second << ", sold " << sold
+                 << ", now " << (after == finalStock.end() ? string("missing") : to_string(after->second)) << "\n";
+        }
+    }
+    for (size_t i = 0; i < sim.saleProductIDs.size(); ++i) {
+        saleUnitsSold += total.sold.count(sim.saleProductIDs[i]) ? total.sold[sim.saleProductIDs[i]] : 0;
+    }
+    // Once everything has settled, a hot counter holds exactly the stock that is left
+    vector<int> hotProducts = HotStockCounters::getInstance().trackedProducts();
+    for (size_t i = 0; i < hotProducts.size(); ++i) {
+        long long remaining = HotStockCounters::getInstance().remaining(hotProducts[i]);
+        if (finalStock.count(hotProducts[i]) && remaining != finalStock[hotProducts[i]]) {
+            mismatched++;
+            cout << "COUNTER MISMATCH product " << hotProducts[i] << ": counter " << remaining << ", stock "
+                 << finalStock[hotProducts[i]] << "\n";
+        }
+    }
+    cout << "Sale products: " << saleUnitsSold << " of " << static_cast<long long>(sim.saleProductIDs.size()) * config.saleStock
+         << " units sold; oversold products: " << oversold << ", stock mismatches: " << mismatched << "\n";
+    if (config.repeatShare > 0.0) {
+        cout << "Repeated checkouts: " << total.repeats << ", answered with a different order: " << total.repeatMismatches << "\n";
+    }
+
+    printContention(seconds);
+
+    if (config.usePipeline) {
+        cout << "\n" << left << setw(14) << "Stage" << right << setw(9) << "Jobs" << setw(9) << "Batches"
+             << setw(11) << "Avg batch" << setw(9) << "Failed" << "\n";
+        for (size_t stage = 0; stage < stageStats.size(); ++stage) {
+            const CheckoutPipeline::StageStats& entry = stageStats[stage];
+            cout << left << setw(14) << CheckoutPipeline::stageStatsName(stage) << right << setw(9) << entry.jobs
+                 << setw(9) << entry.batches << fixed << setprecision(1) << setw(11)
+                 << (entry.batches ? static_cast<double>(entry.jobs) / entry.batches : 0.0) << setw(9) << entry.failures << "\n";
+        }
+    }
+
+    if (config.histograms) {
+        for (int operation = 0; operation < OperationCount; ++operation) {
+            cout << "\n";
+            total.latency[operation].printPercentiles(cout, operationName(operation));
+        }
+    }
+    return (oversold || mismatched || total.repeatMismatches) ? 1 : 0;
+}
@@ -1,17 +1,51 @@
 #include <QApplication>
 #include "gui/include/MainWindow.h"
+#include "gui/include/StallWatchdog.h"
 #include "src/StyleManager.h"
+#include "include/IoStats.h"
+#include "include/Trace.h"
+#include "include/SessionRecorder.h"
+#include "include/CheckoutPipeline.h"
+#include "include/StockReservations.h"
+#include "include/ShardedStockCounter.h"
+#include "include/TaskScheduler.h"
 #include <QTimer>
 #include <QFile>
 #include <QString>
 #include <QDir>
 #include <QStyle>
 #include <QStyleFactory>
+#include <cstdlib>
+#include <new>
+
+// Count heap allocations for the admin Diagnostics tab (see IoStats.h).
+void* operator new(size_t size) {
+    IoStats::countAllocation();
+    void* block = malloc(size ? size : 1);
+    if (!block) throw std::bad_alloc();
+    return block;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    IoStats::countAllocation();
+    return malloc(size ? size : 1);
+}
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept { return operator new(size, tag); }
+void operator delete(void* block) noexcept { free(block); }
+void operator delete[](void* block) noexcept { free(block); }
+void operator delete(void* block, size_t) noexcept { operator delete(block); }
+void operator delete[](void* block, size_t) noexcept { operator delete(block); }
 
 
 int main(int argc, char *argv[]) {
     QApplication app(argc, argv);
 
+    // ECOM_TRACE=1 (or a file path) records spans from startup and writes them at exit
+    Trace::getInstance().enableFromEnvironment();
+    SessionRecorder::getInstance().enableFromEnvironment();
+    StockReservations::getInstance().configureFromEnvironment();
+    HotStockCounters::getInstance().configureFromEnvironment();
+
     QApplication::setApplicationName("E-Commerce Application");
     QApplication::setOrganizationName("YourOrganization");
     QApplication::setApplicationVersion("0.69420");
@@ -35,10 +69,34 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    // Widgets load their data on the task pool and get the results back on the GUI
+    // thread; installed before any widget exists (see TaskScheduler.h)
+    TaskScheduler::getInstance().setDispatcher([&app](std::function<void()> work) {
+        QMetaObject::invokeMethod(&app, work, Qt::QueuedConnection);
+    });
+
     MainWindow mainWindow;
     mainWindow.show();
 
     QTimer::singleShot(0, &mainWindow, SLOT(showLoginDialog()));
 
-    return app.exec();
+    // Checkouts run off the GUI thread; their change notifications and results come back
+    // through the event loop (see CheckoutPipeline.h)
+    CheckoutPipeline::getInstance().setDispatcher([&app](std::function<void()> work) {
+        QMetaObject::invokeMethod(&app, work, Qt::QueuedConnection);
+    });
+    CheckoutPipeline::getInstance().start();
+
+    // Expired stock holds go back on sale even while nobody touches the store
+    QTimer holdExpiry;
+    QObject::connect(&holdExpiry, &QTimer::timeout, []() { StockReservations::getInstance().expire(); });
+    holdExpiry.start(1000);
+
+    // Watches the event loop for blocks over the stall threshold (see StallWatchdog.h)
+    StallWatchdog::getInstance().start();
+    int exitCode = app.exec();
+    StallWatchdog::getInstance().stop();
+    CheckoutPipeline::getInstance().stop();
+    TaskScheduler::getInstance().shutdown();
+    return exitCode;
 } 
\ No newline at end of file
@@ -0,0 +1,84 @@
+// reservationtest.cpp - Checks StockReservations: holds count against other shoppers'
+// stock, refreshing a hold restarts its lifetime, listings only read, and expire() puts
+// lapsed holds back on sale and reports them through ChangeFeed.
+//
+// Holds run on wall-clock seconds, so this takes a few seconds.
+// Build: see compile_tools.sh. Run: ./reservationtest (exits non-zero if a check fails)
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <ctime>
+#include <unistd.h>
+
+#include "include/StockReservations.h"
+#include "include/ChangeFeed.h"
+
+using namespace std;
+
+static int checks = 0;
+static int failures = 0;
+
+static void check(bool ok, const string& what) {
+    ++checks;
+    if (!ok) {
+        ++failures;
+        cerr << "FAILED: " << what << endl;
+    }
+}
+
+static void waitUntil(long long second) {
+    while (static_cast<long long>(time(nullptr)) < second) usleep(50 * 1000);
+}
+
+int main() {
+    StockReservations& reservations = StockReservations::getInstance();
+    reservations.configure(StockReservations::OnCart, 3);
+
+    vector<int> stockDeltas;
+    int token = ChangeFeed::getInstance().subscribe([&stockDeltas](const EntityDelta& delta) {
+        if (delta.entity == EntityType::Product && (delta.changedFields & ProductField::Stock)) stockDeltas.push_back(delta.entityID);
+    });
+
+    // Holds set stock aside for one shopper. Starting on a fresh second keeps the holds
+    // below within the same one.
+    long long start = static_cast<long long>(time(nullptr)) + 1;
+    waitUntil(start);
+    check(reservations.hold(1, 7, 3, 10), "a hold within the stock is taken");
+    check(reservations.available(7, 10) == 7, "listings show the stock less what is held");
+    check(reservations.heldByOthers(2, 7) == 3 && reservations.heldByOthers(1, 7) == 0,
+          "a hold counts against other shoppers only");
+    check(!reservations.hold(2, 7, 8, 10), "a hold beyond what others leave fails");
+    check(reservations.heldBy(2, 7) == 0 && reservations.available(7, 10) == 7, "a failed hold changes nothing");
+    check(reservations.hold(1, 7, 10, 10), "a shopper's own hold does not stand in their way");
+    check(reservations.hold(1, 7, 3, 10), "a hold can be lowered");
+    check(reservations.hold(2, 8, 1, 5), "holds on other products are independent");
+
+    // Refreshing the second hold restarts its lifetime
+    waitUntil(start + 1);
+    long long refreshed = static_cast<long long>(time(nullptr));
+    check(reservations.hold(2, 8, 1, 5), "a hold can be refreshed");
+
+    // The first hold lapses at start + 3; listings keep showing it until expire() runs
+    waitUntil(start + 3);
+    check(reservations.available(7, 10) == 7, "available() does not expire holds");
+    stockDeltas.clear();
+    check(reservations.expire() == 1, "expire() drops the lapsed hold only");
+    check(reservations.available(7, 10) == 10, "an expired hold goes back on sale");
+    check(reservations.heldBy(2, 8) == 1, "the refreshed hold is still held");
+    check(stockDeltas.size() == 1 && stockDeltas[0] == 7, "expiry publishes a stock delta for the product");
+
+    // The refreshed hold lapses three seconds after its refresh
+    waitUntil(refreshed + 3);
+    check(reservations.expire() == 1 && reservations.holdCount() == 0, "the refreshed hold expires on its own schedule");
+    check(reservations.available(8, 5) == 5, "all stock is back on sale");
+
+    // Releasing ends a hold at once
+    reservations.hold(3, 9, 2, 4);
+    reservations.release(3, 9);
+    check(reservations.available(9, 4) == 4 && reservations.holdCount() == 0, "a released hold is gone");
+
+    ChangeFeed::getInstance().unsubscribe(token);
+    cout << "reservationtest: " << checks << " checks, " << failures << " failed" << endl;
+    return failures == 0 ? 0 : 1;
+}